@@ -561,6 +561,56 @@ void Configurable::config_set(const ConfigKey *key, const Glib::VariantBase &val
 		key->id(), const_cast<GVariant*>(value.gobj())));
 }
 
+map<const ConfigKey *, Glib::VariantBase> Configurable::config_get_many(
+	const vector<const ConfigKey *> &keys) const
+{
+	vector<struct sr_config> configs(keys.size());
+	GSList *list = nullptr;
+
+	for (size_t i = keys.size(); i-- > 0;) {
+		configs[i].key = keys[i]->id();
+		configs[i].data = nullptr;
+		list = g_slist_prepend(list, &configs[i]);
+	}
+
+	const int ret = sr_config_get_many(config_driver, config_sdi,
+		config_channel_group, list);
+	g_slist_free(list);
+
+	map<const ConfigKey *, Glib::VariantBase> result;
+	for (size_t i = 0; i < keys.size(); i++)
+		if (configs[i].data)
+			result[keys[i]] = Glib::VariantBase(configs[i].data);
+
+	/* Keys which are not applicable are just left out. */
+	if (ret != SR_ERR_ARG)
+		check(ret);
+
+	return result;
+}
+
+void Configurable::config_set_many(
+	const map<const ConfigKey *, Glib::VariantBase> &values)
+{
+	vector<struct sr_config> configs;
+	GSList *list = nullptr;
+
+	configs.reserve(values.size());
+	for (const auto &entry : values) {
+		struct sr_config src;
+		src.key = entry.first->id();
+		src.data = const_cast<GVariant*>(entry.second.gobj());
+		configs.push_back(src);
+	}
+	for (size_t i = configs.size(); i-- > 0;)
+		list = g_slist_prepend(list, &configs[i]);
+
+	const int ret = sr_config_set_many(config_sdi, config_channel_group, list);
+	g_slist_free(list);
+
+	check(ret);
+}
+
 set<const Capability *> Configurable::config_capabilities(const ConfigKey *key) const
 {
 	int caps = sr_dev_config_capabilities_list(config_sdi,
@@ -1073,6 +1123,30 @@ string Session::filename() const
 	return _filename;
 }
 
+map<string, uint64_t> Session::stats(shared_ptr<Device> device) const
+{
+	struct sr_session_stats stats;
+
+	check(sr_session_stats_get(_structure,
+		device ? device->_structure : nullptr, &stats));
+
+	return {
+		{"packets", stats.packets},
+		{"bytes", stats.bytes},
+		{"send_time", stats.send_time},
+		{"send_time_max", stats.send_time_max},
+		{"transform_time", stats.transform_time},
+		{"callback_time", stats.callback_time},
+		{"transfers_dropped", stats.transfers_dropped},
+		{"transfers_overrun", stats.transfers_overrun},
+	};
+}
+
+void Session::reset_stats()
+{
+	check(sr_session_stats_reset(_structure));
+}
+
 shared_ptr<Context> Session::context()
 {
 	return _context;
@@ -1471,10 +1545,17 @@ shared_ptr<InputDevice> Input::device()
 
 void Input::send(void *data, size_t length)
 {
-	auto gstr = g_string_new_len(static_cast<char *>(data), length);
-	auto ret = sr_input_send(_structure, gstr);
-	g_string_free(gstr, true);
-	check(ret);
+	/* sr_input_send() doesn't modify the buffer, pass the data in place. */
+	GString gstr;
+	gstr.str = static_cast<char *>(data);
+	gstr.len = length;
+	gstr.allocated_len = length;
+	check(sr_input_send(_structure, &gstr));
+}
+
+void Input::send_file(string filename)
+{
+	check(sr_input_send_file(_structure, filename.c_str()));
 }
 
 void Input::end()
@@ -328,6 +328,15 @@ public:
 	 * @param key ConfigKey to set.
 	 * @param value Value to set. */
 	void config_set(const ConfigKey *key, const Glib::VariantBase &value);
+	/** Read configuration for several keys at once.
+	 * Keys which are not applicable are left out of the result.
+	 * @param keys ConfigKeys to read. */
+	std::map<const ConfigKey *, Glib::VariantBase> config_get_many(
+		const std::vector<const ConfigKey *> &keys) const;
+	/** Set configuration for several keys at once.
+	 * @param values Mapping of (ConfigKey, value) pairs to set. */
+	void config_set_many(
+		const std::map<const ConfigKey *, Glib::VariantBase> &values);
 	/** Enumerate available values for the given configuration key.
 	 * @param key ConfigKey to enumerate values for. */
 	Glib::VariantContainerBase config_list(const ConfigKey *key) const;
@@ -641,6 +650,13 @@ public:
 	void set_trigger(std::shared_ptr<Trigger> trigger);
 	/** Get filename this session was loaded from. */
 	std::string filename() const;
+	/** Get instrumentation counters, by name (see struct sr_session_stats).
+	 * @param device Device to get the counters of, or nullptr for the
+	 *               sum over all devices. */
+	std::map<std::string, uint64_t> stats(
+		std::shared_ptr<Device> device = nullptr) const;
+	/** Reset instrumentation counters. */
+	void reset_stats();
 private:
 	explicit Session(std::shared_ptr<Context> context);
 	Session(std::shared_ptr<Context> context, std::string filename);
@@ -920,6 +936,10 @@ public:
 	 * @param data Next stream data.
 	 * @param length Length of data. */
 	void send(void *data, size_t length);
+	/** Send the content of a file, mapped into memory.
+	 * Returns when the device is ready, call again to continue.
+	 * @param filename Name of the file to send. */
+	void send_file(std::string filename);
 	/** Signal end of input data. */
 	void end();
 	void reset();
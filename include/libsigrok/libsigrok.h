@@ -581,6 +581,60 @@ struct sr_analog_spec {
 	int8_t spec_digits;
 };
 
+/** Policy applied when a session's datafeed queue is full. */
+enum sr_datafeed_queue_policy {
+	/** Block the sender until the consumer made room. */
+	SR_DF_QUEUE_BLOCK = 10000,
+	/** Discard the oldest queued sample data packet. */
+	SR_DF_QUEUE_DROP_OLDEST,
+	/** Reject the packet and stop the acquisition. */
+	SR_DF_QUEUE_FAIL,
+};
+
+/** Statistics of a session's datafeed queue. */
+struct sr_datafeed_queue_stats {
+	/** Number of packets which were put on the queue. */
+	uint64_t queued;
+	/** Number of packets which were passed to transforms and callbacks. */
+	uint64_t delivered;
+	/** Number of sample data packets which were discarded or rejected. */
+	uint64_t dropped;
+	/** Number of times a packet was sent while the queue was full. */
+	uint64_t overruns;
+	/** Number of packets currently waiting on the queue. */
+	uint64_t fill;
+	/** Highest number of packets that were waiting on the queue. */
+	uint64_t fill_max;
+};
+
+/** Instrumentation counters of a session, or of a device in a session. */
+struct sr_session_stats {
+	/** Number of packets sent. */
+	uint64_t packets;
+	/** Number of logic and analog payload bytes sent. */
+	uint64_t bytes;
+	/** Cumulative time spent sending packets, in microseconds. */
+	uint64_t send_time;
+	/** Longest time spent sending a single packet, in microseconds. */
+	uint64_t send_time_max;
+	/** Cumulative time spent in transforms, in microseconds. */
+	uint64_t transform_time;
+	/** Cumulative time spent in datafeed callbacks, in microseconds. */
+	uint64_t callback_time;
+	/** Number of (USB) transfers which drivers reported as lost. */
+	uint64_t transfers_dropped;
+	/** Number of (USB) transfers which drivers reported as overrun. */
+	uint64_t transfers_overrun;
+};
+
+/** Flags of logic channel summary blocks, see sr_session_file_summary(). */
+enum sr_summary_flag {
+	/** The channel is high at the start of the block. */
+	SR_SUMMARY_HIGH = 1 << 0,
+	/** The channel has an edge within the block. */
+	SR_SUMMARY_EDGE = 1 << 1,
+};
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -1371,6 +1425,24 @@ struct sr_dev_driver {
 	/* Dynamic */
 	/** Device driver context, considered private. Initialized by init(). */
 	void *context;
+
+	/* Batched configuration, after the fields of older versions. */
+	/** Query values of several configuration keys at once. Optional.
+	 *  Sets the data field of each struct sr_config in the list the
+	 *  driver handled. Fields left NULL get queried via config_get().
+	 *  @see sr_config_get_many().
+	 */
+	int (*config_get_many) (GSList *configs,
+			const struct sr_dev_inst *sdi,
+			const struct sr_channel_group *cg);
+	/** Set values of several configuration keys at once. Optional.
+	 *  Returns SR_ERR_NA if the driver can't handle this set of keys
+	 *  as a batch, they get set via config_set() then.
+	 *  @see sr_config_set_many().
+	 */
+	int (*config_set_many) (GSList *configs,
+			const struct sr_dev_inst *sdi,
+			const struct sr_channel_group *cg);
 };
 
 /** Serial port descriptor. */
@@ -68,6 +68,8 @@ SR_API int sr_log_loglevel_get(void);
 SR_API int sr_log_callback_set(sr_log_callback cb, void *cb_data);
 SR_API int sr_log_callback_set_default(void);
 SR_API int sr_log_callback_get(sr_log_callback *cb, void **cb_data);
+SR_API int sr_log_async_set(int async);
+SR_API int sr_log_async_get(void);
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -112,6 +114,13 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant *data);
+SR_API int sr_config_get_many(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		GSList *configs);
+SR_API int sr_config_set_many(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		GSList *configs);
 SR_API int sr_config_commit(const struct sr_dev_inst *sdi);
 SR_API int sr_config_list(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
@@ -131,6 +140,21 @@ SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_file_num_samples(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t *num_samples);
+SR_API int sr_session_file_read(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t count,
+		void *buf);
+SR_API int sr_session_file_seek(const struct sr_dev_inst *sdi,
+		uint64_t sample);
+SR_API int sr_session_file_summary(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t block_samples,
+		uint64_t first_block, uint64_t num_blocks, void *buf);
+SR_API int sr_session_file_find_edge(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t *sample);
+SR_API int sr_session_file_prefetch_set(const struct sr_dev_inst *sdi,
+		unsigned int threads, unsigned int depth);
+SR_API int sr_session_file_recover(const char *filename);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -145,6 +169,13 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_queue_set(struct sr_session *session,
+		size_t depth, int policy);
+SR_API int sr_session_datafeed_queue_stats_get(struct sr_session *session,
+		struct sr_datafeed_queue_stats *stats);
+SR_API int sr_session_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_session_stats *stats);
+SR_API int sr_session_stats_reset(struct sr_session *session);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -176,6 +207,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_file(const struct sr_input *in,
+		const char *filename);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
@@ -267,6 +300,8 @@ SR_API int sr_parse_rational(const char *str, struct sr_rational *ret);
 SR_API char *sr_text_trim_spaces(char *s);
 SR_API char *sr_text_next_line(char *s, size_t l, char **next, size_t *taken);
 SR_API char *sr_text_next_word(char *s, char **next);
+SR_API size_t sr_text_line_ends(const char *s, size_t l,
+		size_t *ends, size_t count);
 
 SR_API int sr_next_power_of_two(size_t value, size_t *bits, size_t *power);
 
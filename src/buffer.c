@@ -0,0 +1,570 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Reference counted sample data buffers.
+ *
+ * Drivers which send their sample data from an sr_buffer (see
+ * sr_session_send_buffer()) allow consumers to retain the data beyond
+ * the datafeed callback by means of sr_packet_copy(), which then takes
+ * another reference instead of copying the payload. The buffer's
+ * release callback runs when the last reference drops, which allows
+ * drivers to recycle the memory.
+ *
+ * Buffer pools provide such recycling for drivers, so that acquisition
+ * hot paths don't need to allocate memory in the steady state.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+/* The buffer whose data the current thread is sending, if any. */
+static GPrivate current_buffer = G_PRIVATE_INIT(NULL);
+
+/**
+ * Allocate a reference counted buffer.
+ *
+ * @param size The size of the buffer's data in bytes.
+ * @param release Callback which gets invoked instead of freeing the
+ *                buffer when the last reference drops, or NULL. The
+ *                callback takes over the buffer, and either recycles it
+ *                (re-initializing its reference count) or releases it
+ *                by means of sr_buffer_free().
+ * @param release_data Opaque data for the release callback.
+ *
+ * @return The buffer with a reference count of 1, or NULL when the
+ *         memory could not be allocated.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new_full(size_t size,
+		void (*release)(struct sr_buffer *buf), void *release_data)
+{
+	struct sr_buffer *buf;
+
+	buf = g_malloc0(sizeof(*buf));
+	buf->data = g_try_malloc(size);
+	if (size && !buf->data) {
+		sr_err("Cannot allocate %zu bytes buffer.", size);
+		g_free(buf);
+		return NULL;
+	}
+	buf->size = size;
+	buf->refcount = 1;
+	buf->release = release;
+	buf->release_data = release_data;
+
+	return buf;
+}
+
+/**
+ * Allocate a reference counted buffer which gets freed on last unref.
+ *
+ * @param size The size of the buffer's data in bytes.
+ *
+ * @return The buffer with a reference count of 1, or NULL when the
+ *         memory could not be allocated.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size)
+{
+	return sr_buffer_new_full(size, NULL, NULL);
+}
+
+/**
+ * Free a buffer regardless of its reference count.
+ *
+ * Only to be used for buffers from sr_buffer_new_full(), from within
+ * their release callback.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_free(struct sr_buffer *buf)
+{
+	if (!buf)
+		return;
+
+	g_free(buf->data);
+	g_free(buf);
+}
+
+/**
+ * Take another reference to a buffer.
+ *
+ * This function is thread safe.
+ *
+ * @return The buffer.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/**
+ * Drop a reference to a buffer.
+ *
+ * The buffer is freed, or passed to its release callback, when the last
+ * reference drops. This function is thread safe. The release callback
+ * runs in the context of the thread which dropped the last reference.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_unref(struct sr_buffer *buf)
+{
+	if (!buf)
+		return;
+
+	if (!g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	if (buf->release)
+		buf->release(buf);
+	else
+		sr_buffer_free(buf);
+}
+
+/**
+ * Set the buffer whose data the calling thread is about to send.
+ *
+ * @param buf The buffer, or NULL.
+ *
+ * @return The previously set buffer, to be restored after sending.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_current_set(struct sr_buffer *buf)
+{
+	struct sr_buffer *prev;
+
+	prev = g_private_get(&current_buffer);
+	g_private_set(&current_buffer, buf);
+
+	return prev;
+}
+
+/**
+ * Find the buffer which holds a packet's payload.
+ *
+ * Only the buffer which the calling thread is currently sending from is
+ * considered. Payloads which other code (e.g. transforms) has put into
+ * different memory are not found.
+ *
+ * @param data Start of the payload.
+ * @param len Length of the payload in bytes.
+ *
+ * @return The buffer which fully contains the payload, or NULL.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_current_find(const void *data, size_t len)
+{
+	struct sr_buffer *buf;
+	const uint8_t *p;
+
+	buf = g_private_get(&current_buffer);
+	if (!buf || !data)
+		return NULL;
+
+	p = data;
+	if (p < buf->data || p + len > buf->data + buf->size)
+		return NULL;
+
+	return buf;
+}
+
+/** @cond PRIVATE */
+/* Alignment of pool blocks' data, matches common cache line sizes. */
+#define SR_BUFFER_POOL_ALIGN 64
+/* How long acquisitions wait for consumers to release a pool buffer. */
+#define SR_BUFFER_POOL_WAIT_US (1000 * 1000)
+/** @endcond */
+
+/* A pool's block. Precedes the block's data in the same allocation. */
+struct pool_block {
+	struct sr_buffer buf;
+	struct pool_block *next;
+	void *mem;
+};
+
+/**
+ * A pool of fixed size, recyclable, cache line aligned sample buffers.
+ *
+ * Buffers return to the pool when their last reference drops, which
+ * can happen from any thread. Blocks which are still referenced when
+ * the pool gets destroyed are freed upon their release.
+ */
+struct sr_buffer_pool {
+	size_t block_size;
+	size_t limit;
+
+	/* Everything below is protected by the mutex. */
+	GMutex mutex;
+	GCond cond_released;
+	struct pool_block *free_blocks;
+	gboolean destroyed;
+	struct sr_buffer_pool_stats stats;
+};
+
+static void pool_block_free(struct pool_block *block)
+{
+	g_free(block->mem);
+}
+
+static void pool_free(struct sr_buffer_pool *pool)
+{
+	g_cond_clear(&pool->cond_released);
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+static void pool_release(struct sr_buffer *buf)
+{
+	struct sr_buffer_pool *pool;
+	struct pool_block *block;
+	gboolean free_pool;
+
+	pool = buf->release_data;
+	block = (struct pool_block *)buf;
+
+	g_mutex_lock(&pool->mutex);
+	pool->stats.in_use--;
+	if (pool->destroyed) {
+		pool->stats.allocated--;
+		free_pool = pool->stats.allocated == 0;
+		g_mutex_unlock(&pool->mutex);
+		pool_block_free(block);
+		if (free_pool)
+			pool_free(pool);
+		return;
+	}
+	block->next = pool->free_blocks;
+	pool->free_blocks = block;
+	g_cond_signal(&pool->cond_released);
+	g_mutex_unlock(&pool->mutex);
+}
+
+/* Allocate another block. Must be called with the pool's mutex held. */
+static struct pool_block *pool_block_new(struct sr_buffer_pool *pool)
+{
+	struct pool_block *block;
+	void *mem;
+	uintptr_t data;
+
+	if (pool->limit && pool->stats.allocated >= pool->limit)
+		return NULL;
+
+	mem = g_try_malloc(sizeof(*block) + SR_BUFFER_POOL_ALIGN - 1
+		+ pool->block_size);
+	if (!mem)
+		return NULL;
+
+	data = (uintptr_t)mem + sizeof(*block);
+	data = (data + SR_BUFFER_POOL_ALIGN - 1)
+		& ~(uintptr_t)(SR_BUFFER_POOL_ALIGN - 1);
+	block = (struct pool_block *)(data - sizeof(*block));
+	block->mem = mem;
+	block->next = NULL;
+	block->buf.data = (uint8_t *)data;
+	block->buf.size = pool->block_size;
+	block->buf.refcount = 0;
+	block->buf.release = pool_release;
+	block->buf.release_data = pool;
+
+	pool->stats.allocated++;
+
+	return block;
+}
+
+/**
+ * Create a pool of sample buffers.
+ *
+ * @param block_size The size of each buffer in bytes.
+ * @param prealloc The number of buffers to allocate right away.
+ * @param limit The maximum number of buffers, or 0 for no limit.
+ *
+ * @return The pool, or NULL when the preallocation failed.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t block_size,
+		size_t prealloc, size_t limit)
+{
+	struct sr_buffer_pool *pool;
+	struct pool_block *block;
+
+	pool = g_malloc0(sizeof(*pool));
+	g_mutex_init(&pool->mutex);
+	g_cond_init(&pool->cond_released);
+	pool->block_size = block_size;
+	pool->limit = limit;
+	pool->stats.block_size = block_size;
+
+	while (prealloc--) {
+		block = pool_block_new(pool);
+		if (!block) {
+			sr_err("Cannot allocate %zu bytes pool buffer.",
+				block_size);
+			sr_buffer_pool_destroy(pool);
+			return NULL;
+		}
+		block->next = pool->free_blocks;
+		pool->free_blocks = block;
+	}
+
+	return pool;
+}
+
+/**
+ * Destroy a pool of sample buffers.
+ *
+ * Buffers which are still referenced remain valid, and are freed when
+ * their last reference drops.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_destroy(struct sr_buffer_pool *pool)
+{
+	struct pool_block *block;
+	gboolean free_pool;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->destroyed = TRUE;
+	while ((block = pool->free_blocks)) {
+		pool->free_blocks = block->next;
+		pool->stats.allocated--;
+		pool_block_free(block);
+	}
+	free_pool = pool->stats.allocated == 0;
+	g_mutex_unlock(&pool->mutex);
+
+	if (free_pool)
+		pool_free(pool);
+}
+
+/*
+ * Get a buffer from a pool. Waits up to 'wait_us' microseconds for a
+ * buffer to be released when the pool's limit was reached.
+ */
+static struct sr_buffer *pool_get(struct sr_buffer_pool *pool,
+		int64_t wait_us)
+{
+	struct pool_block *block;
+	int64_t end_time;
+
+	g_mutex_lock(&pool->mutex);
+	pool->stats.requests++;
+	block = pool->free_blocks;
+	if (!block) {
+		pool->stats.misses++;
+		block = pool_block_new(pool);
+	}
+	if (!block && wait_us) {
+		end_time = g_get_monotonic_time() + wait_us;
+		while (!pool->free_blocks && g_cond_wait_until(
+				&pool->cond_released, &pool->mutex, end_time))
+			;
+		block = pool->free_blocks;
+	}
+	if (!block) {
+		pool->stats.failures++;
+		g_mutex_unlock(&pool->mutex);
+		return NULL;
+	}
+	/* Blocks which were allocated right now are not on the list. */
+	if (block == pool->free_blocks)
+		pool->free_blocks = block->next;
+	pool->stats.in_use++;
+	if (pool->stats.in_use > pool->stats.in_use_max)
+		pool->stats.in_use_max = pool->stats.in_use;
+	g_mutex_unlock(&pool->mutex);
+
+	block->next = NULL;
+	block->buf.refcount = 1;
+
+	return &block->buf;
+}
+
+/**
+ * Get a buffer from a pool.
+ *
+ * Recycles a released buffer if one is available. Allocates another
+ * one otherwise, unless the pool's limit was reached.
+ *
+ * @return A buffer of the pool's block size with a reference count of 1,
+ *         or NULL if none is available.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+
+	buf = pool_get(pool, 0);
+	if (!buf)
+		sr_warn("No buffer available in %zu bytes pool.",
+			pool->block_size);
+
+	return buf;
+}
+
+/**
+ * Get a buffer from a pool for a device's acquisition.
+ *
+ * Drivers use this for the buffers which they send to the session. When
+ * the pool's limit was reached because consumers hold on to the buffers,
+ * the session's datafeed queue overrun policy (see
+ * sr_session_datafeed_queue_set()) applies to the pool as well:
+ *
+ * - SR_DF_QUEUE_BLOCK, also for sessions without a datafeed queue: Wait
+ *   for consumers to release a buffer. If none gets released within a
+ *   second, the consumers are assumed to be stuck, and the acquisition
+ *   gets stopped.
+ * - SR_DF_QUEUE_DROP_OLDEST: Return NULL right away. Data which was sent
+ *   already can't be taken back from consumers, the caller drops the
+ *   data which it was going to put into the buffer instead.
+ * - SR_DF_QUEUE_FAIL: Stop the acquisition, return NULL.
+ *
+ * Whenever NULL is returned, the loss of data has been logged and counted
+ * in the session's statistics (see sr_session_stats_get()). Callers drop
+ * the data which they were going to put into the buffer, and otherwise
+ * carry on, the session stops the acquisition where the policy says so.
+ *
+ * @param pool The pool.
+ * @param sdi The device instance which acquires the data.
+ *
+ * @return A buffer of the pool's block size with a reference count of 1,
+ *         or NULL if none is available.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_acquire(struct sr_buffer_pool *pool,
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_buffer *buf;
+	int policy;
+
+	policy = sr_session_datafeed_queue_policy(sdi->session);
+	buf = pool_get(pool, policy == SR_DF_QUEUE_BLOCK ?
+		SR_BUFFER_POOL_WAIT_US : 0);
+	if (buf)
+		return buf;
+
+	sr_session_stats_transfer_error(sdi, FALSE);
+	if (policy == SR_DF_QUEUE_DROP_OLDEST) {
+		sr_warn("No buffer available in %zu bytes pool, "
+			"dropping data.", pool->block_size);
+		return NULL;
+	}
+	sr_err("No buffer available in %zu bytes pool, "
+		"stopping acquisition.", pool->block_size);
+	sr_session_stop(sdi->session);
+
+	return NULL;
+}
+
+/**
+ * Get the pool buffer which holds the specified data.
+ *
+ * @param pool The pool which the buffer was taken from.
+ * @param data The start of the buffer's data, as returned in the
+ *             sr_buffer.data field.
+ *
+ * @return The buffer.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_lookup(struct sr_buffer_pool *pool,
+		void *data)
+{
+	struct pool_block *block;
+
+	block = (struct pool_block *)((uint8_t *)data - sizeof(*block));
+	if (block->buf.release_data != pool || block->buf.data != data) {
+		sr_err("Buffer %p does not belong to pool %p.", data, pool);
+		return NULL;
+	}
+
+	return &block->buf;
+}
+
+/**
+ * Get a pool buffer whose content may get overwritten.
+ *
+ * Drivers which re-use a buffer (e.g. resubmit a USB transfer) must not
+ * overwrite data which consumers still reference. If the caller holds
+ * the only reference, the buffer itself is returned. Otherwise the
+ * caller's reference is dropped, and another buffer from the pool is
+ * returned.
+ *
+ * @param pool The pool which the buffer was taken from.
+ * @param buf The buffer, which the caller holds a reference to.
+ *
+ * @return A buffer which only the caller references. NULL if none is
+ *         available, the caller then still holds its reference to @a buf.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_get_writable(
+		struct sr_buffer_pool *pool, struct sr_buffer *buf)
+{
+	struct sr_buffer *fresh;
+
+	if (g_atomic_int_get(&buf->refcount) == 1)
+		return buf;
+
+	fresh = sr_buffer_pool_get(pool);
+	if (!fresh)
+		return NULL;
+	sr_buffer_unref(buf);
+
+	return fresh;
+}
+
+/**
+ * Get the statistics of a pool.
+ *
+ * @param pool The pool.
+ * @param stats Receives the statistics.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_stats_get(struct sr_buffer_pool *pool,
+		struct sr_buffer_pool_stats *stats)
+{
+	g_mutex_lock(&pool->mutex);
+	*stats = pool->stats;
+	g_mutex_unlock(&pool->mutex);
+}
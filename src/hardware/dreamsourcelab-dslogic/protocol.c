@@ -684,7 +684,12 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
-	g_free(devc->deinterleave_buffer);
+
+	/* Buffers which consumers still hold get freed upon release. */
+	sr_buffer_pool_destroy(devc->transfer_pool);
+	devc->transfer_pool = NULL;
+	sr_buffer_pool_destroy(devc->deinterleave_pool);
+	devc->deinterleave_pool = NULL;
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -696,7 +701,8 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	sr_buffer_unref(sr_buffer_pool_lookup(devc->transfer_pool,
+		transfer->buffer));
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
@@ -748,7 +754,7 @@ static void deinterleave_buffer(const uint8_t *src, size_t length,
 	}
 }
 
-static void send_data(struct sr_dev_inst *sdi,
+static void send_data(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint16_t *data, size_t sample_count)
 {
 	const struct sr_datafeed_logic logic = {
@@ -762,7 +768,7 @@ static void send_data(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	sr_session_send_buffer(sdi, &packet, buf);
 }
 
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
@@ -778,6 +784,8 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset;
+	struct sr_buffer *buf;
+	uint16_t *samples;
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -842,29 +850,45 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 */
 		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
-			devc->deinterleave_buffer, channel_count, channel_mask);
+		/*
+		 * Consumers may retain previously sent data, deinterleave
+		 * into a fresh buffer (a recycled one in the steady state).
+		 * The transfer's own buffer is not sent, and can be re-used.
+		 */
+		buf = sr_buffer_pool_acquire(devc->deinterleave_pool, sdi);
+		samples = buf ? (uint16_t *)buf->data : NULL;
+		if (samples)
+			deinterleave_buffer(transfer->buffer,
+				transfer->actual_length, samples,
+				channel_count, channel_mask);
 
 		/* Send the incoming transfer to the session bus. */
-		if (devc->trigger_pos > devc->sent_samples
+		if (!samples) {
+			/*
+			 * The data is dropped. Keep counting samples, the
+			 * device's trigger position refers to its stream.
+			 */
+			devc->sent_samples += num_samples;
+		} else if (devc->trigger_pos > devc->sent_samples
 			&& devc->trigger_pos <= devc->sent_samples + num_samples) {
 			/* DSLogic trigger in this block. Send trigger position. */
 			trigger_offset = devc->trigger_pos - devc->sent_samples;
 			/* Pre-trigger samples. */
-			send_data(sdi, devc->deinterleave_buffer, trigger_offset);
+			send_data(sdi, buf, samples, trigger_offset);
 			devc->sent_samples += trigger_offset;
 			/* Trigger position. */
 			devc->trigger_pos = 0;
 			std_session_send_df_trigger(sdi);
 			/* Post trigger samples. */
 			num_samples -= trigger_offset;
-			send_data(sdi, devc->deinterleave_buffer
-				+ trigger_offset, num_samples);
+			send_data(sdi, buf, samples + trigger_offset,
+				num_samples);
 			devc->sent_samples += num_samples;
 		} else {
-			send_data(sdi, devc->deinterleave_buffer, num_samples);
+			send_data(sdi, buf, samples, num_samples);
 			devc->sent_samples += num_samples;
 		}
+		sr_buffer_unref(buf);
 	}
 
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
@@ -946,7 +970,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct libusb_transfer *transfer;
 	unsigned int i;
 	int ret;
-	unsigned char *buf;
+	struct sr_buffer *buf;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
@@ -963,30 +987,39 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
-		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
-	if (!devc->deinterleave_buffer) {
+	devc->deinterleave_pool = sr_buffer_pool_new(DSLOGIC_ATOMIC_SAMPLES *
+		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t),
+		2, 1 + SR_BUFFER_POOL_RETAINED);
+	if (!devc->deinterleave_pool) {
 		sr_err("Deinterleave buffer malloc failed.");
-		g_free(devc->deinterleave_buffer);
+		return SR_ERR_MALLOC;
+	}
+
+	devc->transfer_pool = sr_buffer_pool_new(size, num_transfers,
+		num_transfers);
+	if (!devc->transfer_pool) {
+		sr_err("USB transfer buffer malloc failed.");
+		sr_buffer_pool_destroy(devc->deinterleave_pool);
+		devc->deinterleave_pool = NULL;
 		return SR_ERR_MALLOC;
 	}
 
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->transfer_pool))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				6 | LIBUSB_ENDPOINT_IN, buf, size,
+				6 | LIBUSB_ENDPOINT_IN, buf->data, size,
 				receive_transfer, (void *)sdi, timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
+			sr_buffer_unref(buf);
 			abort_acquisition(devc);
 			return SR_ERR;
 		}
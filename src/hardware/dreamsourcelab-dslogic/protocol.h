@@ -132,7 +132,8 @@ struct dev_context {
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
 
-	uint16_t *deinterleave_buffer;
+	struct sr_buffer_pool *transfer_pool;
+	struct sr_buffer_pool *deinterleave_pool;
 
 	uint16_t mode;
 	uint32_t trigger_pos;
@@ -293,11 +293,13 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 
-	/* Free the deinterlace buffers if we had them. */
-	if (g_slist_length(devc->enabled_analog_channels) > 0) {
-		g_free(devc->logic_buffer);
-		g_free(devc->analog_buffer);
-	}
+	/* Buffers which consumers still hold get freed upon release. */
+	sr_buffer_pool_destroy(devc->transfer_pool);
+	devc->transfer_pool = NULL;
+	sr_buffer_pool_destroy(devc->logic_pool);
+	devc->logic_pool = NULL;
+	sr_buffer_pool_destroy(devc->analog_pool);
+	devc->analog_pool = NULL;
 
 	if (devc->stl) {
 		soft_trigger_logic_free(devc->stl);
@@ -314,7 +316,8 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	sr_buffer_unref(sr_buffer_pool_lookup(devc->transfer_pool,
+		transfer->buffer));
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
@@ -330,10 +333,26 @@ static void free_transfer(struct libusb_transfer *transfer)
 		finish_acquisition(sdi);
 }
 
-static void resubmit_transfer(struct libusb_transfer *transfer)
+/*
+ * Resubmit a transfer. Transfers whose buffer was sent are resubmitted
+ * with the 'spare' buffer, consumers may still reference the sent one.
+ */
+static void resubmit_transfer(struct libusb_transfer *transfer,
+		struct sr_buffer *spare)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
 	int ret;
 
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	if (spare) {
+		sr_buffer_unref(sr_buffer_pool_lookup(devc->transfer_pool,
+			transfer->buffer));
+		transfer->buffer = spare->data;
+	}
+
 	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
 		return;
 
@@ -343,32 +362,49 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 }
 
 static void mso_send_data_proc(struct sr_dev_inst *sdi,
-	uint8_t *data, size_t length, size_t sample_width)
+	struct sr_buffer *buf, uint8_t *data, size_t length,
+	size_t sample_width)
 {
 	size_t i;
 	struct dev_context *devc;
+	struct sr_buffer *logic_buf, *analog_buf;
+	uint8_t *logic_data;
+	float *analog_data;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 
+	(void)buf;
 	(void)sample_width;
 
 	devc = sdi->priv;
 
 	length /= 2;
 
+	/* Consumers may retain the previous buffers, use fresh ones. */
+	logic_buf = sr_buffer_pool_acquire(devc->logic_pool, sdi);
+	analog_buf = logic_buf ?
+		sr_buffer_pool_acquire(devc->analog_pool, sdi) : NULL;
+	if (!analog_buf) {
+		/* The pool policy applies, the data is dropped. */
+		sr_buffer_unref(logic_buf);
+		return;
+	}
+	logic_data = logic_buf->data;
+	analog_data = (float *)analog_buf->data;
+
 	/* Send the logic */
 	for (i = 0; i < length; i++) {
-		devc->logic_buffer[i] = data[i * 2];
+		logic_data[i] = data[i * 2];
 		/* Rescale to -10V - +10V from 0-255. */
-		devc->analog_buffer[i] = (data[i * 2 + 1] - 128.0f) / 12.8f;
+		analog_data[i] = (data[i * 2 + 1] - 128.0f) / 12.8f;
 	};
 
 	const struct sr_datafeed_logic logic = {
 		.length = length,
 		.unitsize = 1,
-		.data = devc->logic_buffer
+		.data = logic_data
 	};
 
 	const struct sr_datafeed_packet logic_packet = {
@@ -376,7 +412,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &logic_packet);
+	sr_session_send_buffer(sdi, &logic_packet, logic_buf);
 
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 	analog.meaning->channels = devc->enabled_analog_channels;
@@ -384,18 +420,22 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = 0 /* SR_MQFLAG_DC */;
 	analog.num_samples = length;
-	analog.data = devc->analog_buffer;
+	analog.data = analog_data;
 
 	const struct sr_datafeed_packet analog_packet = {
 		.type = SR_DF_ANALOG,
 		.payload = &analog
 	};
 
-	sr_session_send(sdi, &analog_packet);
+	sr_session_send_buffer(sdi, &analog_packet, analog_buf);
+
+	sr_buffer_unref(logic_buf);
+	sr_buffer_unref(analog_buf);
 }
 
 static void la_send_data_proc(struct sr_dev_inst *sdi,
-	uint8_t *data, size_t length, size_t sample_width)
+	struct sr_buffer *buf, uint8_t *data, size_t length,
+	size_t sample_width)
 {
 	const struct sr_datafeed_logic logic = {
 		.length = length,
@@ -408,13 +448,14 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	sr_session_send_buffer(sdi, &packet, buf);
 }
 
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	struct sr_buffer *buf, *spare;
 	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize, processed_samples;
@@ -450,6 +491,8 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		break;
 	default:
 		packet_has_error = TRUE;
+		sr_session_stats_transfer_error(sdi,
+			transfer->status == LIBUSB_TRANSFER_OVERFLOW);
 		break;
 	}
 
@@ -463,13 +506,27 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			fx2lafw_abort_acquisition(devc);
 			free_transfer(transfer);
 		} else {
-			resubmit_transfer(transfer);
+			resubmit_transfer(transfer, NULL);
 		}
 		return;
 	} else {
 		devc->empty_transfer_count = 0;
 	}
 
+	/*
+	 * Consumers and the soft trigger's pre-trigger window may hold on
+	 * to the transfer's buffer once its data was passed on. Get the
+	 * buffer for the resubmission first, so that the transfer never
+	 * gets lost. Without one, the pool policy applies, and the data
+	 * gets dropped.
+	 */
+	spare = sr_buffer_pool_acquire(devc->transfer_pool, sdi);
+	if (!spare) {
+		resubmit_transfer(transfer, NULL);
+		return;
+	}
+	buf = sr_buffer_pool_lookup(devc->transfer_pool, transfer->buffer);
+
 check_trigger:
 	if (devc->trigger_fired) {
 		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
@@ -478,13 +535,14 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+			devc->send_data_proc(sdi, buf,
+				(uint8_t *)transfer->buffer + processed_samples * unitsize,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
 		}
 	} else {
-		trigger_offset = soft_trigger_logic_check(devc->stl,
+		trigger_offset = soft_trigger_logic_check_buffer(devc->stl, buf,
 			transfer->buffer + processed_samples * unitsize,
 			transfer->actual_length - processed_samples * unitsize,
 			&pre_trigger_samples);
@@ -496,7 +554,7 @@ check_trigger:
 					devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi, buf, (uint8_t *)transfer->buffer
 					+ processed_samples * unitsize
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
@@ -531,9 +589,10 @@ check_trigger:
 	}
 	if (frame_ended && final_frame) {
 		fx2lafw_abort_acquisition(devc);
+		sr_buffer_unref(spare);
 		free_transfer(transfer);
 	} else
-		resubmit_transfer(transfer);
+		resubmit_transfer(transfer, spare);
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -636,8 +695,8 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct libusb_transfer *transfer;
 	unsigned int i, num_transfers;
 	int timeout, ret;
-	unsigned char *buf;
-	size_t size;
+	struct sr_buffer *buf;
+	size_t size, num_retained;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
@@ -650,7 +709,8 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		int pre_trigger_samples = 0;
 		if (devc->limit_samples > 0)
 			pre_trigger_samples = (devc->capture_ratio * devc->limit_samples) / 100;
-		devc->stl = soft_trigger_logic_new(sdi, trigger, pre_trigger_samples);
+		devc->stl = soft_trigger_logic_new_full(sdi, trigger,
+			pre_trigger_samples, TRUE);
 		if (!devc->stl)
 			return SR_ERR_MALLOC;
 		devc->trigger_fired = FALSE;
@@ -670,23 +730,40 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
+	/*
+	 * Allocate some spare buffers, for transfers which need to be
+	 * resubmitted while consumers still hold on to their data. The
+	 * soft trigger additionally holds the buffers which make up the
+	 * pre-trigger window (including partially used ones at both ends),
+	 * and one spare buffer is taken ahead of each resubmission.
+	 */
+	num_retained = SR_BUFFER_POOL_RETAINED + 1;
+	if (devc->stl)
+		num_retained += devc->stl->pre_trigger_size / size + 2;
+	devc->transfer_pool = sr_buffer_pool_new(size, 2 * num_transfers,
+		num_transfers + num_retained);
+	if (!devc->transfer_pool) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
 	timeout = get_timeout(devc);
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->transfer_pool))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
+				2 | LIBUSB_ENDPOINT_IN, buf->data, size,
 				receive_transfer, (void *)sdi, timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
+			sr_buffer_unref(buf);
 			fx2lafw_abort_acquisition(devc);
 			return SR_ERR;
 		}
@@ -738,10 +815,20 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	size = get_buffer_size(devc);
 	/* Prepare for analog sampling. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
-		/* We need a buffer half the size of a transfer. */
-		devc->logic_buffer = g_try_malloc(size / 2);
-		devc->analog_buffer = g_try_malloc(
-			sizeof(float) * size / 2);
+		/* We need buffers for half the samples of a transfer. */
+		devc->logic_pool = sr_buffer_pool_new(size / 2, 2,
+			1 + SR_BUFFER_POOL_RETAINED);
+		devc->analog_pool = sr_buffer_pool_new(sizeof(float) * size / 2,
+			2, 1 + SR_BUFFER_POOL_RETAINED);
+		if (!devc->logic_pool || !devc->analog_pool) {
+			sr_err("Deinterlace buffer malloc failed.");
+			sr_buffer_pool_destroy(devc->logic_pool);
+			devc->logic_pool = NULL;
+			sr_buffer_pool_destroy(devc->analog_pool);
+			devc->analog_pool = NULL;
+			usb_source_remove(sdi->session, devc->ctx);
+			return SR_ERR_MALLOC;
+		}
 	}
 	start_transfers(sdi);
 	if ((ret = command_start_acquisition(sdi)) != SR_OK) {
@@ -120,10 +120,11 @@ struct dev_context {
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
-	void (*send_data_proc)(struct sr_dev_inst *sdi,
+	void (*send_data_proc)(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 		uint8_t *data, size_t length, size_t sample_width);
-	uint8_t *logic_buffer;
-	float *analog_buffer;
+	struct sr_buffer_pool *transfer_pool;
+	struct sr_buffer_pool *logic_pool;
+	struct sr_buffer_pool *analog_pool;
 };
 
 SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di);
@@ -370,12 +370,46 @@ static void dev_acquisition_abort(const struct sr_dev_inst *sdi)
 	struct dev_context *devc = sdi->priv;
 	unsigned int i;
 
+	devc->aborting = TRUE;
 	for (i = 0; i < devc->num_transfers; i++) {
 		if (devc->transfers[i])
 			libusb_cancel_transfer(devc->transfers[i]);
 	}
 }
 
+/* Cancel pending transfers, and release all sample buffers. */
+static void dev_acquisition_cleanup(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc = sdi->priv;
+	struct drv_context *drvc = sdi->driver->context;
+	struct timeval tv;
+	unsigned int tries;
+
+	/* Reaping the transfers returns their buffers to the pool. */
+	dev_acquisition_abort(sdi);
+	for (tries = 0; devc->submitted_transfers && tries < 10; tries++) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	}
+	if (devc->submitted_transfers) {
+		sr_warn("%u transfers still pending.",
+			devc->submitted_transfers);
+	} else {
+		g_free(devc->transfers);
+		devc->transfers = NULL;
+		devc->num_transfers = 0;
+	}
+
+	/* Buffers which consumers still hold get freed upon their release. */
+	sr_buffer_unref(devc->conv_buffer);
+	devc->conv_buffer = NULL;
+	sr_buffer_pool_destroy(devc->conv_pool);
+	devc->conv_pool = NULL;
+	sr_buffer_pool_destroy(devc->transfer_pool);
+	devc->transfer_pool = NULL;
+}
+
 static int dev_acquisition_handle(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi = cb_data;
@@ -399,7 +433,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	struct drv_context *drvc = sdi->driver->context;
 	struct libusb_transfer *transfer;
 	struct sr_usb_dev_inst *usb;
-	uint8_t *buf;
+	struct sr_buffer *buf;
 	unsigned int i, ret;
 
 	ret = saleae_logic_pro_prepare(sdi);
@@ -408,22 +442,47 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	usb = sdi->conn;
 
-	devc->conv_buffer = g_malloc(CONV_BUFFER_SIZE);
+	/*
+	 * Conversion buffers get sent to the session, allow for some of
+	 * them being held by consumers.
+	 */
+	devc->conv_pool = sr_buffer_pool_new(CONV_BUFFER_SIZE, 4,
+		2 + SR_BUFFER_POOL_RETAINED);
+	devc->transfer_pool = sr_buffer_pool_new(BUF_SIZE, BUF_COUNT, BUF_COUNT);
+	if (!devc->conv_pool || !devc->transfer_pool) {
+		sr_err("Cannot allocate sample buffers.");
+		sr_buffer_pool_destroy(devc->conv_pool);
+		devc->conv_pool = NULL;
+		sr_buffer_pool_destroy(devc->transfer_pool);
+		devc->transfer_pool = NULL;
+		return SR_ERR_MALLOC;
+	}
+	devc->conv_buffer = sr_buffer_pool_get(devc->conv_pool);
+	devc->conv_size = 0;
+	if (!devc->conv_buffer) {
+		sr_buffer_pool_destroy(devc->conv_pool);
+		devc->conv_pool = NULL;
+		sr_buffer_pool_destroy(devc->transfer_pool);
+		devc->transfer_pool = NULL;
+		return SR_ERR_MALLOC;
+	}
 
+	devc->aborting = FALSE;
+	devc->submitted_transfers = 0;
 	devc->num_transfers = BUF_COUNT;
 	devc->transfers = g_malloc0(sizeof(*devc->transfers) * BUF_COUNT);
 	for (i = 0; i < devc->num_transfers; i++) {
-		buf = g_malloc(BUF_SIZE);
+		buf = sr_buffer_pool_get(devc->transfer_pool);
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-			2 | LIBUSB_ENDPOINT_IN, buf, BUF_SIZE,
+			2 | LIBUSB_ENDPOINT_IN, buf->data, BUF_SIZE,
 			saleae_logic_pro_receive_data, (void *)sdi, 0);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
-			dev_acquisition_abort(sdi);
+			sr_buffer_unref(buf);
+			dev_acquisition_cleanup(sdi);
 			return SR_ERR;
 		}
 		devc->transfers[i] = transfer;
@@ -443,17 +502,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
-	struct dev_context *devc = sdi->priv;
 	struct drv_context *drvc = sdi->driver->context;
 
 	saleae_logic_pro_stop(sdi);
 
+	dev_acquisition_cleanup(sdi);
+
 	std_session_send_df_end(sdi);
 
 	usb_source_remove(sdi->session, drvc->sr_ctx);
 
-	g_free(devc->conv_buffer);
-
 	return SR_OK;
 }
 
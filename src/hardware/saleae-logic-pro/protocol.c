@@ -825,7 +825,8 @@ SR_PRIV int saleae_logic_pro_stop(const struct sr_dev_inst *sdi)
 }
 
 static void saleae_logic_pro_send_data(const struct sr_dev_inst *sdi,
-				      void *data, size_t length, size_t unitsize)
+				      struct sr_buffer *buf, void *data,
+				      size_t length, size_t unitsize)
 {
 	const struct sr_datafeed_logic logic = {
 		.length = length,
@@ -838,25 +839,44 @@ static void saleae_logic_pro_send_data(const struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	sr_session_send_buffer(sdi, &packet, buf);
 }
 
 /*
  * One batch from the device consists of 32 samples per active digital channel.
  * This stream of batches is packed into USB packets with 16384 bytes each.
  */
-static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
-					 const uint32_t *src, size_t srccnt)
+static int saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
+					const uint32_t *src, size_t srccnt)
 {
 	struct dev_context *devc = sdi->priv;
-	uint8_t *dst = devc->conv_buffer;
+	struct sr_buffer *buf;
+	uint8_t *dst;
 	uint32_t samples;
 	uint16_t channel_mask;
 	unsigned int sample_index, batch_index;
 	uint16_t *dst_batch;
 
+	/*
+	 * Consumers may retain previously sent data, so convert into
+	 * a fresh buffer (a recycled one in the steady state).
+	 */
+	buf = sr_buffer_pool_acquire(devc->conv_pool, sdi);
+	if (!buf) {
+		/*
+		 * Drop the data. Stay in step with the device's batches,
+		 * only the current partial batch lacks some channels then.
+		 */
+		devc->batch_index = (devc->batch_index + srccnt) %
+			devc->dig_channel_cnt;
+		return SR_ERR;
+	}
+	dst = buf->data;
+
 	/* Copy partial batch to the beginning. */
-	memcpy(dst, dst + devc->conv_size, CONV_BATCH_SIZE);
+	memcpy(dst, devc->conv_buffer->data + devc->conv_size, CONV_BATCH_SIZE);
+	sr_buffer_unref(devc->conv_buffer);
+	devc->conv_buffer = buf;
 	/* Reset converted size. */
 	devc->conv_size = 0;
 
@@ -883,6 +903,29 @@ static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
 		}
 	}
 	devc->batch_index = batch_index;
+
+	return SR_OK;
+}
+
+static void saleae_logic_pro_free_transfer(const struct sr_dev_inst *sdi,
+					   struct libusb_transfer *transfer)
+{
+	struct dev_context *devc = sdi->priv;
+	unsigned int i;
+
+	/* Return the transfer's buffer to the pool. */
+	sr_buffer_unref(sr_buffer_pool_lookup(devc->transfer_pool,
+		transfer->buffer));
+	transfer->buffer = NULL;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (devc->transfers[i] == transfer) {
+			devc->transfers[i] = NULL;
+			break;
+		}
+	}
+	libusb_free_transfer(transfer);
+	devc->submitted_transfers--;
 }
 
 SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer)
@@ -891,21 +934,32 @@ SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *t
 	struct dev_context *devc = sdi->priv;
 	int ret;
 
+	if (devc->aborting) {
+		saleae_logic_pro_free_transfer(sdi, transfer);
+		return;
+	}
+
 	switch (transfer->status) {
 	case LIBUSB_TRANSFER_NO_DEVICE:
 		sr_dbg("FIXME no device");
+		saleae_logic_pro_free_transfer(sdi, transfer);
 		return;
 	case LIBUSB_TRANSFER_COMPLETED:
 	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
 		break;
 	default:
 		/* FIXME */
+		saleae_logic_pro_free_transfer(sdi, transfer);
 		return;
 	}
 
-	saleae_logic_pro_convert_data(sdi, (uint32_t*)transfer->buffer, 16 * 1024 / 4);
-	saleae_logic_pro_send_data(sdi, devc->conv_buffer, devc->conv_size, 2);
+	if (saleae_logic_pro_convert_data(sdi, (uint32_t*)transfer->buffer,
+			16 * 1024 / 4) == SR_OK)
+		saleae_logic_pro_send_data(sdi, devc->conv_buffer,
+			devc->conv_buffer->data, devc->conv_size, 2);
 
-	if ((ret = libusb_submit_transfer(transfer)) != LIBUSB_SUCCESS)
+	if ((ret = libusb_submit_transfer(transfer)) != LIBUSB_SUCCESS) {
 		sr_dbg("FIXME resubmit failed");
+		saleae_logic_pro_free_transfer(sdi, transfer);
+	}
 }
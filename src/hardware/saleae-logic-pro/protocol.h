@@ -47,8 +47,11 @@ struct dev_context {
 	unsigned int num_transfers;
 	unsigned int submitted_transfers;
 	struct libusb_transfer **transfers;
+	gboolean aborting;
 
-	uint8_t *conv_buffer;
+	struct sr_buffer_pool *transfer_pool;
+	struct sr_buffer_pool *conv_pool;
+	struct sr_buffer *conv_buffer;
 	unsigned int conv_size;
 	unsigned int batch_index;
 };
@@ -648,6 +648,97 @@ static int config_get(uint32_t key, GVariant **data,
 	return ret;
 }
 
+/* Keys which config_get() queries without any special handling. */
+static const struct {
+	uint32_t key;
+	int cmd;
+	gboolean is_bool;
+} batch_queries[] = {
+	{ SR_CONF_ENABLED, SCPI_CMD_GET_OUTPUT_ENABLED, TRUE },
+	{ SR_CONF_VOLTAGE, SCPI_CMD_GET_MEAS_VOLTAGE, FALSE },
+	{ SR_CONF_VOLTAGE_TARGET, SCPI_CMD_GET_VOLTAGE_TARGET, FALSE },
+	{ SR_CONF_CURRENT, SCPI_CMD_GET_MEAS_CURRENT, FALSE },
+	{ SR_CONF_CURRENT_LIMIT, SCPI_CMD_GET_CURRENT_LIMIT, FALSE },
+	{ SR_CONF_OVER_VOLTAGE_PROTECTION_THRESHOLD,
+		SCPI_CMD_GET_OVER_VOLTAGE_PROTECTION_THRESHOLD, FALSE },
+	{ SR_CONF_OVER_CURRENT_PROTECTION_THRESHOLD,
+		SCPI_CMD_GET_OVER_CURRENT_PROTECTION_THRESHOLD, FALSE },
+};
+
+static gboolean is_devopt(const struct dev_context *devc, uint32_t key)
+{
+	unsigned int i;
+
+	for (i = 0; i < devc->device->num_devopts; i++) {
+		if (devc->device->devopts[i] == key)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Query the plain values among the keys in one compound command, e.g.
+ * a channel's voltage and current readings. All other keys are left to
+ * config_get().
+ */
+static int config_get_many(GSList *configs,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	struct dev_context *devc;
+	struct sr_config *src, *srcs[ARRAY_SIZE(batch_queries)];
+	const GVariantType *gvtypes[ARRAY_SIZE(batch_queries)];
+	GVariant *gvars[ARRAY_SIZE(batch_queries)];
+	int cmds[ARRAY_SIZE(batch_queries)];
+	const char *cmd;
+	size_t count, i, q;
+	GSList *l;
+	int ret;
+
+	if (!sdi)
+		return SR_ERR_ARG;
+
+	devc = sdi->priv;
+
+	count = 0;
+	for (l = configs; l && count < ARRAY_SIZE(srcs); l = l->next) {
+		src = l->data;
+		/* Device wide keys on this model, see config_get(). */
+		if (cg && is_devopt(devc, src->key))
+			continue;
+		for (q = 0; q < ARRAY_SIZE(batch_queries); q++) {
+			if (batch_queries[q].key == src->key)
+				break;
+		}
+		if (q == ARRAY_SIZE(batch_queries))
+			continue;
+		cmd = sr_scpi_cmd_get(devc->device->commands, batch_queries[q].cmd);
+		if (!cmd || strchr(cmd, '%'))
+			continue;
+		srcs[count] = src;
+		cmds[count] = batch_queries[q].cmd;
+		gvtypes[count] = batch_queries[q].is_bool ?
+			G_VARIANT_TYPE_BOOLEAN : G_VARIANT_TYPE_DOUBLE;
+		count++;
+	}
+
+	/* Nothing to gain for a single query. */
+	if (count < 2)
+		return SR_OK;
+
+	ret = sr_scpi_cmd_resp_many(sdi, devc->device->commands,
+		cg ? SCPI_CMD_SELECT_CHANNEL : 0, cg ? cg->name : NULL,
+		gvars, gvtypes, cmds, count);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Keys without a valid reply get queried by config_get(). */
+	for (i = 0; i < count; i++)
+		srcs[i]->data = gvars[i];
+
+	return SR_OK;
+}
+
 static int config_set(uint32_t key, GVariant *data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
@@ -898,8 +989,10 @@ static struct sr_dev_driver scpi_pps_driver_info = {
 	.dev_acquisition_start = dev_acquisition_start,
 	.dev_acquisition_stop = dev_acquisition_stop,
 	.context = NULL,
+	.config_get_many = config_get_many,
 };
 
+/* HP-IB devices in compatibility mode don't take compound SCPI queries. */
 static struct sr_dev_driver hp_ib_pps_driver_info = {
 	.name = "hpib-pps",
 	.longname = "HP-IB PPS",
@@ -42,6 +42,14 @@ static const uint32_t devopts[] = {
 	SR_CONF_CONTINUOUS,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
+};
+
+static const int32_t trigger_matches[] = {
+	SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER,
+	SR_TRIGGER_RISING,
+	SR_TRIGGER_FALLING,
 };
 
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
@@ -254,6 +262,11 @@ static int config_list(uint32_t key, GVariant **data,
 			return ret;
 	}
 
+	if (key == SR_CONF_TRIGGER_MATCH) {
+		*data = std_gvar_array_i32(ARRAY_AND_SIZE(trigger_matches));
+		return SR_OK;
+	}
+
 	return STD_CONFIG_LIST(key, data, sdi, cg, scanopts, drvopts, devopts);
 }
 
@@ -265,9 +278,25 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	void *cb_data;
 	int ret;
 	struct sr_serial_dev_inst *serial;
+	struct sr_trigger *trigger;
 
 	devc = sdi->priv;
 
+	/*
+	 * Readings get discarded until the trigger fires. DMMs are slow,
+	 * there is no pre-trigger data.
+	 */
+	if ((trigger = sr_session_trigger_get(sdi->session))) {
+		devc->sta = soft_trigger_analog_new(sdi, trigger, 0, 0.0);
+		if (!devc->sta)
+			return SR_ERR_MALLOC;
+		if (!devc->sta->stages_valid) {
+			soft_trigger_analog_free(devc->sta);
+			devc->sta = NULL;
+			return SR_ERR_ARG;
+		}
+	}
+
 	sr_sw_limits_acquisition_start(&devc->limits);
 	std_session_send_df_header(sdi);
 
@@ -277,8 +306,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	if (dmm && dmm->acquire_start) {
 		ret = dmm->acquire_start(dmm->dmm_state, sdi,
 			&cb_func, &cb_data);
-		if (ret < 0)
+		if (ret < 0) {
+			soft_trigger_analog_free(devc->sta);
+			devc->sta = NULL;
 			return ret;
+		}
 	}
 
 	serial = sdi->conn;
@@ -288,6 +320,17 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	soft_trigger_analog_free(devc->sta);
+	devc->sta = NULL;
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, VALID, PARSE, DETAILS, \
@@ -309,7 +352,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		VENDOR, MODEL, CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
@@ -39,18 +39,25 @@ static void log_dmm_packet(const uint8_t *buf, size_t len)
 	sr_hexdump_free(text);
 }
 
+/* A channel's reading from a packet, kept until the trigger was checked. */
+struct dmm_reading {
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float floatval;
+	double doubleval;
+};
+
 static void handle_packet(struct sr_dev_inst *sdi,
 	const uint8_t *buf, size_t len, void *info)
 {
 	struct dmm_info *dmm;
 	struct dev_context *devc;
-	float floatval;
-	double doubleval;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
+	struct dmm_reading *readings, *r;
+	float *frame;
+	size_t frame_len;
 	gboolean sent_sample;
 	struct sr_channel *channel;
 	size_t ch_idx;
@@ -60,36 +67,61 @@ static void handle_packet(struct sr_dev_inst *sdi,
 	log_dmm_packet(buf, len);
 	devc = sdi->priv;
 
-	sent_sample = FALSE;
+	readings = g_malloc0(dmm->channel_count * sizeof(*readings));
+	frame = g_malloc(dmm->channel_count * sizeof(*frame));
+	frame_len = 0;
+
 	memset(info, 0, dmm->info_size);
 	for (ch_idx = 0; ch_idx < dmm->channel_count; ch_idx++) {
+		r = &readings[ch_idx];
 		/* Note: digits/spec_digits will be overridden by the DMM parsers. */
-		sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+		sr_analog_init(&r->analog, &r->encoding, &r->meaning, &r->spec, 0);
 
 		channel = g_slist_nth_data(sdi->channels, ch_idx);
-		analog.meaning->channels = g_slist_append(NULL, channel);
-		analog.num_samples = 1;
-		analog.meaning->mq = 0;
+		r->analog.meaning->channels = g_slist_append(NULL, channel);
+		r->analog.num_samples = 1;
+		r->analog.meaning->mq = 0;
 
 		if (dmm->packet_parse) {
-			dmm->packet_parse(buf, &floatval, &analog, info);
-			analog.data = &floatval;
-			analog.encoding->unitsize = sizeof(floatval);
+			dmm->packet_parse(buf, &r->floatval, &r->analog, info);
+			r->analog.data = &r->floatval;
+			r->analog.encoding->unitsize = sizeof(r->floatval);
 		} else if (dmm->packet_parse_len) {
 			dmm->packet_parse_len(dmm->dmm_state, buf, len,
-				&doubleval, &analog, info);
-			analog.data = &doubleval;
-			analog.encoding->unitsize = sizeof(doubleval);
+				&r->doubleval, &r->analog, info);
+			r->floatval = r->doubleval;
+			r->analog.data = &r->doubleval;
+			r->analog.encoding->unitsize = sizeof(r->doubleval);
 		}
 
 		/* If this DMM needs additional handling, call the resp. function. */
 		if (dmm->dmm_details)
-			dmm->dmm_details(&analog, info);
+			dmm->dmm_details(&r->analog, info);
+
+		/*
+		 * Trigger frames hold a value for each enabled channel.
+		 * Channels without a measurement never match.
+		 */
+		if (channel->enabled)
+			frame[frame_len++] = r->analog.meaning->mq ? r->floatval : NAN;
+	}
 
-		if (analog.meaning->mq != 0 && channel->enabled) {
+	/* Discard readings until the trigger fires on one of them. */
+	if (devc->sta) {
+		if (soft_trigger_analog_check(devc->sta, frame, 1, NULL) < 0)
+			goto done;
+		soft_trigger_analog_free(devc->sta);
+		devc->sta = NULL;
+	}
+
+	sent_sample = FALSE;
+	for (ch_idx = 0; ch_idx < dmm->channel_count; ch_idx++) {
+		r = &readings[ch_idx];
+		channel = r->analog.meaning->channels->data;
+		if (r->analog.meaning->mq != 0 && channel->enabled) {
 			/* Got a measurement. */
 			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
+			packet.payload = &r->analog;
 			sr_session_send(sdi, &packet);
 			sent_sample = TRUE;
 		}
@@ -98,6 +130,12 @@ static void handle_packet(struct sr_dev_inst *sdi,
 	if (sent_sample) {
 		sr_sw_limits_update_samples_read(&devc->limits, 1);
 	}
+
+done:
+	for (ch_idx = 0; ch_idx < dmm->channel_count; ch_idx++)
+		g_slist_free(readings[ch_idx].meaning.channels);
+	g_free(frame);
+	g_free(readings);
 }
 
 /** Request packet, if required. */
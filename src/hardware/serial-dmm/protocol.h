@@ -93,6 +93,9 @@ struct dev_context {
 	 * Used only if device needs polling.
 	 */
 	uint64_t req_next_at;
+
+	/** Software trigger, NULL when not set up or after it fired. */
+	struct soft_trigger_analog *sta;
 };
 
 SR_PRIV int req_packet(struct sr_dev_inst *sdi);
@@ -904,6 +904,208 @@ SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+/**
+ * Query values of several configuration keys in a single call.
+ *
+ * Drivers which implement config_get_many() get handed all keys at once,
+ * e.g. to combine the queries into fewer round-trips to the device. All
+ * other keys get queried one by one.
+ *
+ * @param[in] driver The sr_dev_driver struct to query. Must not be NULL.
+ * @param[in] sdi (optional) The device instance, see sr_config_get().
+ * @param[in] cg The channel group on the device, or NULL.
+ * @param[in,out] configs List of struct sr_config with the keys to query.
+ *             The data fields must be NULL. For every key that was read
+ *             successfully, the data field receives the value, which the
+ *             caller must unref after use.
+ *             The data fields of all other keys remain NULL.
+ *
+ * @retval SR_OK All keys were read.
+ * @retval SR_ERR_ARG Invalid arguments, or some keys are not applicable.
+ * @retval other The first error of a key that could not be read. The
+ *         remaining keys are still queried.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_config_get_many(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		GSList *configs)
+{
+	struct sr_config *src;
+	GSList *l, *pending;
+	int ret, err;
+
+	if (!driver)
+		return SR_ERR;
+
+	if (!driver->config_get)
+		return SR_ERR_ARG;
+
+	if (sdi && !sdi->priv) {
+		sr_err("Can't get config (sdi != NULL, sdi->priv == NULL).");
+		return SR_ERR;
+	}
+
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (!src || src->data)
+			return SR_ERR_ARG;
+	}
+
+	err = SR_OK;
+	pending = NULL;
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (check_key(driver, sdi, cg, src->key, SR_CONF_GET, NULL) != SR_OK) {
+			if (err == SR_OK)
+				err = SR_ERR_ARG;
+			continue;
+		}
+		pending = g_slist_append(pending, src);
+	}
+
+	if (pending && driver->config_get_many) {
+		ret = driver->config_get_many(pending, sdi, cg);
+		if (ret != SR_OK)
+			sr_dbg("%s: Batch query failed (%d), querying keys "
+				"individually.", driver->name, ret);
+	}
+
+	for (l = pending; l; l = l->next) {
+		src = l->data;
+		ret = SR_OK;
+		if (!src->data)
+			ret = driver->config_get(src->key, &src->data, sdi, cg);
+		if (ret == SR_OK && src->data) {
+			log_key(sdi, cg, src->key, SR_CONF_GET, src->data);
+			/* Sink the driver's floating reference, see sr_config_get(). */
+			g_variant_ref_sink(src->data);
+		} else {
+			src->data = NULL;
+			if (ret == SR_OK)
+				ret = SR_ERR;
+			if (ret == SR_ERR_CHANNEL_GROUP)
+				sr_err("%s: No channel group specified.",
+					driver->name);
+			if (err == SR_OK)
+				err = ret;
+		}
+	}
+	g_slist_free(pending);
+
+	return err;
+}
+
+/* Set the values of a list of keys, see sr_config_set_many(). */
+static int config_set_many(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg, GSList *configs)
+{
+	struct sr_config *src;
+	GSList *l;
+	int ret, err;
+
+	if (!sdi || !sdi->driver || !sdi->priv)
+		return SR_ERR;
+
+	if (!sdi->driver->config_set)
+		return SR_ERR_ARG;
+
+	if (sdi->status != SR_ST_ACTIVE) {
+		sr_err("%s: Device instance not active, can't set config.",
+			sdi->driver->name);
+		return SR_ERR_DEV_CLOSED;
+	}
+
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (!src || !src->data)
+			return SR_ERR_ARG;
+		if (check_key(sdi->driver, sdi, cg, src->key, SR_CONF_SET,
+				src->data) != SR_OK)
+			return SR_ERR_ARG;
+		if (sr_variant_type_check(src->key, src->data) != SR_OK)
+			return SR_ERR_ARG;
+	}
+
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		log_key(sdi, cg, src->key, SR_CONF_SET, src->data);
+	}
+
+	ret = SR_ERR_NA;
+	if (configs && sdi->driver->config_set_many)
+		ret = sdi->driver->config_set_many(configs, sdi, cg);
+	if (ret != SR_ERR_NA) {
+		if (ret == SR_ERR_CHANNEL_GROUP)
+			sr_err("%s: No channel group specified.",
+				sdi->driver->name);
+		return ret;
+	}
+
+	err = SR_OK;
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		ret = sdi->driver->config_set(src->key, src->data, sdi, cg);
+		if (ret == SR_ERR_CHANNEL_GROUP)
+			sr_err("%s: No channel group specified.",
+				sdi->driver->name);
+		if (ret != SR_OK && err == SR_OK)
+			err = ret;
+	}
+
+	return err;
+}
+
+/**
+ * Set values of several configuration keys in a single call.
+ *
+ * Drivers which implement config_set_many() get handed all keys at once,
+ * otherwise (or if the driver declines the batch) the keys are set one
+ * by one, in list order.
+ *
+ * @param[in] sdi The device instance. Must not be NULL. sdi->driver and
+ *                sdi->priv must not be NULL either.
+ * @param[in] cg The channel group on the device, or NULL.
+ * @param[in,out] configs List of struct sr_config with the keys and values
+ *            to set. Floating references can be passed in, like with
+ *            sr_config_set() the values get sunk and unreferenced after
+ *            use. The data fields are NULL on return.
+ *
+ * @retval SR_OK All keys were set.
+ * @retval SR_ERR_ARG Invalid arguments, or some keys are not applicable.
+ *         None of the keys are set in that case.
+ * @retval other The first error of a key that could not be set.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_config_set_many(const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		GSList *configs)
+{
+	struct sr_config *src;
+	GSList *l;
+	int ret;
+
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (src && src->data)
+			g_variant_ref_sink(src->data);
+	}
+
+	ret = config_set_many(sdi, cg, configs);
+
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (src && src->data) {
+			g_variant_unref(src->data);
+			src->data = NULL;
+		}
+	}
+
+	return ret;
+}
+
 /**
  * Apply configuration settings to the device hardware.
  *
@@ -1016,26 +1218,114 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 	return ret;
 }
 
-static struct sr_key_info *get_keytable(int keytype)
+/*
+ * Lookup indices for the key info tables: entries sorted by key and by
+ * id, for binary searches. Ties keep the table order, so that lookups
+ * find the same entry as a linear scan of the table would.
+ */
+struct key_info_index {
+	const struct sr_key_info **by_key;
+	const struct sr_key_info **by_id;
+	size_t count;
+	size_t id_count;
+};
+
+static int key_info_cmp_key(const void *a, const void *b)
+{
+	const struct sr_key_info *ia, *ib;
+
+	ia = *(const struct sr_key_info **)a;
+	ib = *(const struct sr_key_info **)b;
+	if (ia->key != ib->key)
+		return (ia->key < ib->key) ? -1 : 1;
+
+	return (ia < ib) ? -1 : (ia > ib);
+}
+
+static int key_info_cmp_id(const void *a, const void *b)
 {
-	struct sr_key_info *table;
+	const struct sr_key_info *ia, *ib;
+	int ret;
 
+	ia = *(const struct sr_key_info **)a;
+	ib = *(const struct sr_key_info **)b;
+	if ((ret = strcmp(ia->id, ib->id)))
+		return ret;
+
+	return (ia < ib) ? -1 : (ia > ib);
+}
+
+static void key_info_index_build(struct key_info_index *index,
+		const struct sr_key_info *table)
+{
+	size_t i;
+
+	for (i = 0; table[i].key; i++)
+		;
+	index->count = i;
+	index->by_key = g_malloc(i * sizeof(*index->by_key));
+	index->by_id = g_malloc(i * sizeof(*index->by_id));
+	for (i = 0; i < index->count; i++) {
+		index->by_key[i] = &table[i];
+		if (table[i].id)
+			index->by_id[index->id_count++] = &table[i];
+	}
+	qsort(index->by_key, index->count, sizeof(*index->by_key),
+		key_info_cmp_key);
+	qsort(index->by_id, index->id_count, sizeof(*index->by_id),
+		key_info_cmp_id);
+}
+
+/**
+ * Get the key info table of a namespace, in table order.
+ *
+ * Lookups should use sr_key_info_get() and sr_key_info_name_get().
+ *
+ * @param[in] keytype The namespace.
+ *
+ * @return The table, terminated by an entry with key 0. NULL for an
+ *         invalid namespace.
+ *
+ * @private
+ */
+SR_PRIV const struct sr_key_info *sr_key_info_table_get(int keytype)
+{
 	switch (keytype) {
 	case SR_KEY_CONFIG:
-		table = sr_key_info_config;
-		break;
+		return sr_key_info_config;
 	case SR_KEY_MQ:
-		table = sr_key_info_mq;
-		break;
+		return sr_key_info_mq;
 	case SR_KEY_MQFLAGS:
-		table = sr_key_info_mqflag;
-		break;
+		return sr_key_info_mqflag;
 	default:
-		sr_err("Invalid keytype %d", keytype);
 		return NULL;
 	}
+}
 
-	return table;
+static const struct key_info_index *get_keyindex(int keytype)
+{
+	static struct key_info_index indices[3];
+	static gsize initialized = 0;
+
+	if (g_once_init_enter(&initialized)) {
+		/* Built once, and kept for the lifetime of the library. */
+		key_info_index_build(&indices[0], sr_key_info_config);
+		key_info_index_build(&indices[1], sr_key_info_mq);
+		key_info_index_build(&indices[2], sr_key_info_mqflag);
+		g_once_init_leave(&initialized, 1);
+	}
+
+	switch (keytype) {
+	case SR_KEY_CONFIG:
+		return &indices[0];
+	case SR_KEY_MQ:
+		return &indices[1];
+	case SR_KEY_MQFLAGS:
+		return &indices[2];
+	default:
+		sr_err("Invalid keytype %d", keytype);
+		return NULL;
+	}
 }
 
 /**
@@ -1051,16 +1341,24 @@ static struct sr_key_info *get_keytable(int keytype)
  */
 SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
 {
-	struct sr_key_info *table;
-	int i;
+	const struct key_info_index *index;
+	size_t lo, hi, mid;
 
-	if (!(table = get_keytable(keytype)))
+	if (!(index = get_keyindex(keytype)))
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (table[i].key == key)
-			return &table[i];
+	/* Find the first entry not below the key. */
+	lo = 0;
+	hi = index->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index->by_key[mid]->key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	if (lo < index->count && index->by_key[lo]->key == key)
+		return index->by_key[lo];
 
 	return NULL;
 }
@@ -1078,18 +1376,24 @@ SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
  */
 SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *keyid)
 {
-	struct sr_key_info *table;
-	int i;
+	const struct key_info_index *index;
+	size_t lo, hi, mid;
 
-	if (!(table = get_keytable(keytype)))
+	if (!(index = get_keyindex(keytype)))
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (!table[i].id)
-			continue;
-		if (!strcmp(table[i].id, keyid))
-			return &table[i];
+	/* Find the first entry not below the id. */
+	lo = 0;
+	hi = index->id_count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(index->by_id[mid]->id, keyid) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	if (lo < index->id_count && !strcmp(index->by_id[lo]->id, keyid))
+		return index->by_id[lo];
 
 	return NULL;
 }
@@ -127,12 +127,13 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, struct sr_input_data *data)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	struct context *inc;
-	gsize chunk_size, i;
+	const char *rdptr;
+	gsize chunk_size, len, i;
 	gsize chunk;
 	uint16_t unitsize;
 
@@ -158,49 +159,58 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = unitsize;
 
 	/* Cut off at multiple of unitsize. Avoid sending the "header". */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
-	chunk_size = MIN(chunk_size, inc->samples_remain * unitsize);
-
-	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
-		chunk = MIN(CHUNK_SIZE, chunk_size - i);
-		if (chunk) {
-			logic.length = chunk;
-			sr_session_send(in->sdi, &packet);
-			inc->samples_remain -= chunk / unitsize;
+	while ((rdptr = sr_input_data_peek(in, data, unitsize, &len))) {
+		chunk_size = len / logic.unitsize * logic.unitsize;
+		chunk_size = MIN(chunk_size, inc->samples_remain * unitsize);
+		if (!chunk_size)
+			break;
+		for (i = 0; i < chunk_size; i += chunk) {
+			logic.data = (void *)(rdptr + i);
+			chunk = MIN(CHUNK_SIZE, chunk_size - i);
+			if (chunk) {
+				logic.length = chunk;
+				sr_session_send(in->sdi, &packet);
+				inc->samples_remain -= chunk / unitsize;
+			}
 		}
+		sr_input_data_consume(in, data, chunk_size);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+	sr_input_data_keep(in, data);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
+	struct sr_input_data data;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	sr_input_data_init(&data, buf);
 
 	if (!in->sdi_ready) {
+		sr_input_data_keep(in, &data);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	ret = process_buffer(in, &data);
 
 	return ret;
 }
 
 static int end(struct sr_input *in)
 {
+	struct sr_input_data data;
 	struct context *inc;
 	int ret;
 
-	if (in->sdi_ready)
-		ret = process_buffer(in);
-	else
+	if (in->sdi_ready) {
+		sr_input_data_init(&data, NULL);
+		ret = process_buffer(in, &data);
+	} else {
 		ret = SR_OK;
+	}
 
 	inc = in->priv;
 	if (inc->started)
@@ -33,6 +33,9 @@
 #define LOG_PREFIX "input/csv"
 
 #define CHUNK_SIZE	(4 * 1024 * 1024)
+#define MAX_THREADS	32
+/* Text size of the blocks of lines which worker threads parse. */
+#define BLOCK_SIZE	(256 * 1024)
 
 /*
  * The CSV input module has the following options:
@@ -91,6 +94,11 @@
  *     up to the end of the current text line. Can be empty to disable
  *     comment support. Defaults to semicolon.
  *
+ * threads: Specifies the number of worker threads which parse the input
+ *     text. The text gets cut into blocks of lines which are parsed in
+ *     parallel, and are sent to the session in input order. Defaults to
+ *     0, which parses the text while receiving it.
+ *
  * Typical examples of using these options:
  * - ... -I csv:column_formats=*l ...
  *   All columns are single-bit logic data. Identical to the previous
@@ -250,8 +258,13 @@ struct context {
 	int *analog_datafeed_digits;
 	GSList **analog_datafeed_channels;
 
-	/* Current line number. */
+	/* Current line number, and its columns' text. */
 	size_t line_number;
+	char **columns;
+
+	/* Worker threads which parse blocks of text lines. */
+	size_t num_threads;
+	struct csv_workers *workers;
 
 	/* List of previously created sigrok channels. */
 	GSList *prev_sr_channels;
@@ -311,14 +324,16 @@ static void set_logic_level(struct context *inc, size_t ch_idx, int on)
 	inc->sample_buffer[byte_idx] |= bit_mask;
 }
 
-static int flush_logic_samples(const struct sr_input *in)
+/*
+ * Send the queued logic samples of a context. Which either is the input
+ * module's context, or the copy that was used to parse a block of text.
+ */
+static int send_logic_samples(const struct sr_input *in, struct context *inc)
 {
-	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	int rc;
 
-	inc = in->priv;
 	if (!inc->datafeed_buf_fill)
 		return SR_OK;
 
@@ -343,6 +358,11 @@ static int flush_logic_samples(const struct sr_input *in)
 	return SR_OK;
 }
 
+static int flush_logic_samples(const struct sr_input *in)
+{
+	return send_logic_samples(in, in->priv);
+}
+
 static int queue_logic_samples(const struct sr_input *in)
 {
 	struct context *inc;
@@ -382,9 +402,9 @@ static void set_analog_value(struct context *inc, size_t ch_idx, csv_analog_t va
 	inc->analog_sample_buffer[ch_idx * inc->analog_datafeed_buf_size] = value;
 }
 
-static int flush_analog_samples(const struct sr_input *in)
+/* Send the queued analog samples of a context, see send_logic_samples(). */
+static int send_analog_samples(const struct sr_input *in, struct context *inc)
 {
-	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
@@ -395,7 +415,6 @@ static int flush_analog_samples(const struct sr_input *in)
 	int digits;
 	int rc;
 
-	inc = in->priv;
 	if (!inc->analog_datafeed_buf_fill)
 		return SR_OK;
 
@@ -436,6 +455,11 @@ static int flush_analog_samples(const struct sr_input *in)
 	return SR_OK;
 }
 
+static int flush_analog_samples(const struct sr_input *in)
+{
+	return send_analog_samples(in, in->priv);
+}
+
 static int queue_analog_samples(const struct sr_input *in)
 {
 	struct context *inc;
@@ -772,6 +796,46 @@ static char **split_line(char *buf, struct context *inc)
 	return fields;
 }
 
+/**
+ * Splits a text line into columns in place, without allocations.
+ *
+ * @param[in] buf	The input text line to split.
+ * @param[in] delimiter	The column separator.
+ * @param[out] columns	The columns' text, at least max_count entries.
+ * @param[in] max_count	The maximum number of columns to split.
+ *
+ * @returns The number of columns that were found.
+ *
+ * Splits off at most max_count - 1 columns, the last column keeps the
+ * remainder of the text line. Is equivalent to split_line() for those
+ * columns which get inspected.
+ */
+static size_t split_columns(char *buf, const GString *delimiter,
+	char **columns, size_t max_count)
+{
+	size_t count, idx;
+	char *sep;
+
+	count = 0;
+	while (count < max_count) {
+		columns[count++] = buf;
+		if (count == max_count)
+			break;
+		if (delimiter->len == 1)
+			sep = strchr(buf, delimiter->str[0]);
+		else
+			sep = strstr(buf, delimiter->str);
+		if (!sep)
+			break;
+		*sep = '\0';
+		buf = sep + delimiter->len;
+	}
+	for (idx = 0; idx < count && idx < max_count - 1; idx++)
+		g_strchomp(columns[idx]);
+
+	return count;
+}
+
 /**
  * Parse a multi-bit field into several logic channels.
  *
@@ -1048,6 +1112,87 @@ static const col_parse_cb col_parse_funcs[] = {
 	[FORMAT_TIME] = parse_timestamp,
 };
 
+/*
+ * Check whether a text line needs no further processing. Skips lines
+ * before the start line, blank and comment-only lines, and the header
+ * line. Strips comments off the text line as a side effect.
+ */
+static gboolean skip_line(struct context *inc, char *line)
+{
+	if (inc->line_number < inc->start_line) {
+		sr_spew("Line %zu skipped (before start).", inc->line_number);
+		return TRUE;
+	}
+	if (line[0] == '\0') {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return TRUE;
+	}
+
+	/* Remove trailing comment. */
+	strip_comment(line, inc->comment);
+	if (line[0] == '\0') {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return TRUE;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->use_header && !inc->header_seen) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header_seen = TRUE;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Split a text line into columns, and have the columns processed. Sets
+ * the current sample set of the context from the text line's content.
+ */
+static int parse_line(struct context *inc, char *line, char **columns)
+{
+	size_t num_columns, col_idx, col_nr;
+	const struct column_details *details;
+	col_parse_cb parse_func;
+	int ret;
+
+	/* Split the line into columns, check for minimum length. */
+	num_columns = split_columns(line, inc->delimiter, columns,
+		inc->column_want_count + 1);
+	if (num_columns < inc->column_want_count) {
+		sr_err("Insufficient column count %zu in line %zu.",
+			num_columns, inc->line_number);
+		return SR_ERR;
+	}
+
+	/* Have the columns of the current text line processed. */
+	clear_logic_samples(inc);
+	clear_analog_samples(inc);
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		col_nr = col_idx + 1;
+		details = lookup_column_details(inc, col_nr);
+		if (!details || !details->text_format)
+			continue;
+		parse_func = col_parse_funcs[details->text_format];
+		if (!parse_func)
+			continue;
+		ret = parse_func(columns[col_idx], inc, details);
+		if (ret != SR_OK)
+			return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/* Find the next line termination in NUL terminated text. */
+static char *find_termination(char *text, const char *termination)
+{
+	if (!termination[1])
+		return strchr(text, termination[0]);
+
+	return strstr(text, termination);
+}
+
 /*
  * BEWARE! Implementor's notes. Sync with feature set and default option
  * values required during maintenance of the input module implementation.
@@ -1218,6 +1363,11 @@ static int init(struct sr_input *in, GHashTable *options)
 		sr_err("Invalid start line %zu.", inc->start_line);
 		return SR_ERR_ARG;
 	}
+	inc->num_threads = g_variant_get_uint32(g_hash_table_lookup(options, "threads"));
+	if (inc->num_threads > MAX_THREADS) {
+		sr_warn("Limiting parsing to %d threads.", MAX_THREADS);
+		inc->num_threads = MAX_THREADS;
+	}
 
 	/*
 	 * Scan flexible, to get prefered format specs which describe
@@ -1418,6 +1568,8 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 		ret = SR_ERR_DATA;
 		goto out;
 	}
+	inc->columns = g_malloc((inc->column_want_count + 1) *
+		sizeof(inc->columns[0]));
 
 	/*
 	 * Allocate buffer memory for datafeed submission of sample data.
@@ -1527,16 +1679,343 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
+/*
+ * Parallel parsing of text lines. The received text gets cut into blocks
+ * at line boundaries, worker threads parse the blocks into sample data
+ * of their own, which gets sent to the session in input order. Line
+ * numbers of blocks get counted upfront, such that messages about the
+ * input text remain accurate.
+ */
+struct csv_block {
+	/* Copy of the module's context, which queues the block's samples. */
+	struct context ctx;
+	char *text;
+	gboolean done;
+	int ret;
+};
+
+struct csv_workers {
+	size_t num_threads;
+	GThread **threads;
+	size_t max_blocks;
+	/* Blocks in input order, only used by the session thread. */
+	GQueue blocks;
+	/* Everything below is protected by the mutex. */
+	GMutex mutex;
+	GCond cond_pending;
+	GCond cond_done;
+	GQueue pending;
+	gboolean shutdown;
+};
+
+static void csv_block_free(struct csv_block *block)
+{
+	g_free(block->ctx.datafeed_buffer);
+	g_free(block->ctx.analog_datafeed_buffer);
+	g_free(block->ctx.columns);
+	g_free(block);
+}
+
+/*
+ * Create a block from NUL terminated text. The block's sample buffers
+ * hold as many samples as the text has lines.
+ */
+static struct csv_block *csv_block_new(struct context *inc, char *text)
+{
+	struct csv_block *block;
+	struct context *ctx;
+	size_t line_count, term_len;
+	char *line;
+
+	line_count = 1;
+	term_len = strlen(inc->termination);
+	line = text;
+	while ((line = find_termination(line, inc->termination))) {
+		line += term_len;
+		line_count++;
+	}
+
+	block = g_malloc0(sizeof(*block));
+	block->text = text;
+	ctx = &block->ctx;
+	*ctx = *inc;
+	ctx->workers = NULL;
+	ctx->datafeed_buffer = NULL;
+	ctx->datafeed_buf_fill = 0;
+	ctx->analog_datafeed_buffer = NULL;
+	ctx->analog_datafeed_buf_fill = 0;
+	ctx->columns = g_malloc((inc->column_want_count + 1) *
+		sizeof(ctx->columns[0]));
+	if (inc->logic_channels) {
+		ctx->datafeed_buf_size = line_count * inc->sample_unit_size;
+		ctx->datafeed_buffer = g_try_malloc(ctx->datafeed_buf_size);
+	}
+	if (inc->analog_channels) {
+		ctx->analog_datafeed_buf_size = line_count;
+		ctx->analog_datafeed_buffer = g_try_malloc(line_count *
+			inc->analog_channels * sizeof(csv_analog_t));
+	}
+	if ((inc->logic_channels && !ctx->datafeed_buffer) ||
+			(inc->analog_channels && !ctx->analog_datafeed_buffer)) {
+		sr_err("Cannot allocate sample buffer for %zu lines.",
+			line_count);
+		csv_block_free(block);
+		return NULL;
+	}
+
+	/* The block's lines are taken from the input stream. */
+	inc->line_number += line_count;
+
+	return block;
+}
+
+/* Parse the text lines of a block. Runs in worker threads. */
+static int csv_block_parse(struct csv_block *block)
+{
+	struct context *inc;
+	size_t term_len;
+	char *line, *next;
+	int ret;
+
+	inc = &block->ctx;
+	term_len = strlen(inc->termination);
+	for (line = block->text; line; line = next) {
+		next = find_termination(line, inc->termination);
+		if (next) {
+			*next = '\0';
+			next += term_len;
+		}
+		inc->line_number++;
+		if (skip_line(inc, line))
+			continue;
+		ret = parse_line(inc, line, inc->columns);
+		if (ret != SR_OK)
+			return SR_ERR;
+		if (inc->logic_channels)
+			inc->datafeed_buf_fill += inc->sample_unit_size;
+		if (inc->analog_channels)
+			inc->analog_datafeed_buf_fill++;
+	}
+
+	return SR_OK;
+}
+
+/* Send a parsed block's samples to the session. */
+static int csv_block_send(const struct sr_input *in, struct csv_block *block)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	if (block->ret != SR_OK)
+		return block->ret;
+
+	/* Take a samplerate which the block's timestamps have provided. */
+	if (!inc->calc_samplerate) {
+		inc->calc_samplerate = block->ctx.calc_samplerate;
+		inc->prev_timestamp = block->ctx.prev_timestamp;
+	}
+
+	ret = send_logic_samples(in, &block->ctx);
+	ret += send_analog_samples(in, &block->ctx);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send parsed blocks in input order.
+ *
+ * @param[in] in The input module instance.
+ * @param[in] max_pending Wait for blocks until no more than this number
+ *                        of blocks remains in flight.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int csv_blocks_send(const struct sr_input *in, size_t max_pending)
+{
+	struct context *inc;
+	struct csv_workers *workers;
+	struct csv_block *block;
+	gboolean done;
+	int ret;
+
+	inc = in->priv;
+	workers = inc->workers;
+	ret = SR_OK;
+	while ((block = g_queue_peek_head(&workers->blocks))) {
+		g_mutex_lock(&workers->mutex);
+		if (g_queue_get_length(&workers->blocks) > max_pending) {
+			while (!block->done)
+				g_cond_wait(&workers->cond_done, &workers->mutex);
+		}
+		done = block->done;
+		g_mutex_unlock(&workers->mutex);
+		if (!done)
+			break;
+		g_queue_pop_head(&workers->blocks);
+		if (ret == SR_OK)
+			ret = csv_block_send(in, block);
+		csv_block_free(block);
+	}
+
+	return ret;
+}
+
+static gpointer csv_worker_thread(gpointer data)
+{
+	struct csv_workers *workers;
+	struct csv_block *block;
+	int ret;
+
+	workers = data;
+
+	g_mutex_lock(&workers->mutex);
+	while (TRUE) {
+		while (g_queue_is_empty(&workers->pending) && !workers->shutdown)
+			g_cond_wait(&workers->cond_pending, &workers->mutex);
+		block = g_queue_pop_head(&workers->pending);
+		if (!block)
+			break;
+		g_mutex_unlock(&workers->mutex);
+
+		ret = csv_block_parse(block);
+
+		g_mutex_lock(&workers->mutex);
+		block->ret = ret;
+		block->done = TRUE;
+		g_cond_broadcast(&workers->cond_done);
+	}
+	g_mutex_unlock(&workers->mutex);
+
+	return NULL;
+}
+
+static void csv_workers_start(struct context *inc)
+{
+	struct csv_workers *workers;
+	GError *error;
+	size_t i;
+
+	workers = g_malloc0(sizeof(*workers));
+	g_mutex_init(&workers->mutex);
+	g_cond_init(&workers->cond_pending);
+	g_cond_init(&workers->cond_done);
+	workers->threads = g_malloc0(sizeof(workers->threads[0]) *
+		inc->num_threads);
+	for (i = 0; i < inc->num_threads; i++) {
+		error = NULL;
+		workers->threads[i] = g_thread_try_new("sr-csv",
+			csv_worker_thread, workers, &error);
+		if (!workers->threads[i]) {
+			sr_warn("Cannot create parse thread: %s.",
+				error->message);
+			g_error_free(error);
+			break;
+		}
+	}
+	workers->num_threads = i;
+	/* Bound the memory held by blocks in flight. */
+	workers->max_blocks = 2 * workers->num_threads;
+	inc->workers = workers;
+	sr_dbg("Using %zu parse threads.", workers->num_threads);
+}
+
+static void csv_workers_stop(struct context *inc)
+{
+	struct csv_workers *workers;
+	size_t i;
+
+	workers = inc->workers;
+	if (!workers)
+		return;
+
+	g_mutex_lock(&workers->mutex);
+	workers->shutdown = TRUE;
+	g_cond_broadcast(&workers->cond_pending);
+	g_mutex_unlock(&workers->mutex);
+
+	for (i = 0; i < workers->num_threads; i++)
+		g_thread_join(workers->threads[i]);
+	g_queue_foreach(&workers->blocks, (GFunc)csv_block_free, NULL);
+	g_queue_clear(&workers->blocks);
+	g_queue_clear(&workers->pending);
+	g_mutex_clear(&workers->mutex);
+	g_cond_clear(&workers->cond_pending);
+	g_cond_clear(&workers->cond_done);
+	g_free(workers->threads);
+	g_free(workers);
+	inc->workers = NULL;
+}
+
+/*
+ * Have worker threads parse the remaining NUL terminated text. Cuts the
+ * text into blocks at line boundaries, and sends the blocks' samples
+ * after the samples of previous text lines.
+ */
+static int process_blocks(const struct sr_input *in, char *text)
+{
+	struct context *inc;
+	struct csv_workers *workers;
+	struct csv_block *block;
+	size_t term_len;
+	char *end, *next;
+	int ret;
+
+	inc = in->priv;
+	workers = inc->workers;
+
+	ret = flush_logic_samples(in);
+	ret += flush_analog_samples(in);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	term_len = strlen(inc->termination);
+	end = text + strlen(text);
+	while (text) {
+		next = NULL;
+		if (end - text > BLOCK_SIZE)
+			next = find_termination(text + BLOCK_SIZE, inc->termination);
+		if (next) {
+			*next = '\0';
+			next += term_len;
+		}
+		block = csv_block_new(inc, text);
+		if (!block) {
+			ret = SR_ERR_MALLOC;
+			break;
+		}
+		g_queue_push_tail(&workers->blocks, block);
+		g_mutex_lock(&workers->mutex);
+		g_queue_push_tail(&workers->pending, block);
+		g_cond_signal(&workers->cond_pending);
+		g_mutex_unlock(&workers->mutex);
+		ret = csv_blocks_send(in, workers->max_blocks);
+		if (ret != SR_OK)
+			break;
+		text = next;
+	}
+	if (ret == SR_OK)
+		ret = csv_blocks_send(in, 0);
+	/* Drop the remaining blocks after errors. */
+	if (ret != SR_OK)
+		csv_workers_stop(inc);
+
+	return ret;
+}
+
 static int process_buffer(struct sr_input *in, gboolean is_eof)
 {
 	struct context *inc;
-	gsize num_columns;
-	size_t line_idx, col_idx, col_nr;
-	const struct column_details *details;
-	col_parse_cb parse_func;
+	size_t term_len;
 	int ret;
 	char *processed_up_to;
-	char **lines, *line, **columns, *column;
+	char *line, *next;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -1570,83 +2049,45 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 		processed_up_to += strlen(inc->termination);
 	}
 
-	/* Split input text lines and process their columns. */
+	if (inc->num_threads && !inc->workers)
+		csv_workers_start(inc);
+
+	/*
+	 * Split input text lines in place and process their columns.
+	 * Worker threads take over when only data lines remain.
+	 */
 	ret = SR_OK;
-	lines = g_strsplit(in->buf->str, inc->termination, 0);
-	for (line_idx = 0; (line = lines[line_idx]); line_idx++) {
-		inc->line_number++;
-		if (inc->line_number < inc->start_line) {
-			sr_spew("Line %zu skipped (before start).", inc->line_number);
-			continue;
-		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
+	term_len = strlen(inc->termination);
+	for (line = in->buf->str; line; line = next) {
+		if (inc->workers && inc->workers->num_threads &&
+				inc->line_number + 1 >= inc->start_line &&
+				(!inc->use_header || inc->header_seen)) {
+			ret = process_blocks(in, line);
+			if (ret != SR_OK)
+				return SR_ERR;
+			break;
 		}
-
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
+		next = find_termination(line, inc->termination);
+		if (next) {
+			*next = '\0';
+			next += term_len;
 		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->use_header && !inc->header_seen) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header_seen = TRUE;
+		inc->line_number++;
+		if (skip_line(inc, line))
 			continue;
-		}
 
-		/* Split the line into columns, check for minimum length. */
-		columns = split_line(line, inc);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
+		ret = parse_line(inc, line, inc->columns);
+		if (ret != SR_OK)
 			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (num_columns < inc->column_want_count) {
-			sr_err("Insufficient column count %zu in line %zu.",
-				num_columns, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		/* Have the columns of the current text line processed. */
-		clear_logic_samples(inc);
-		clear_analog_samples(inc);
-		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
-			column = columns[col_idx];
-			col_nr = col_idx + 1;
-			details = lookup_column_details(inc, col_nr);
-			if (!details || !details->text_format)
-				continue;
-			parse_func = col_parse_funcs[details->text_format];
-			if (!parse_func)
-				continue;
-			ret = parse_func(column, inc, details);
-			if (ret != SR_OK) {
-				g_strfreev(columns);
-				g_strfreev(lines);
-				return SR_ERR;
-			}
-		}
 
 		/* Send sample data to the session bus (buffered). */
 		ret = queue_logic_samples(in);
 		ret += queue_analog_samples(in);
 		if (ret != SR_OK) {
 			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
 			return SR_ERR;
 		}
-
-		g_strfreev(columns);
 	}
-	g_strfreev(lines);
 	g_string_erase(in->buf, 0, processed_up_to - in->buf->str);
 
 	return ret;
@@ -1712,6 +2153,9 @@ static void cleanup(struct sr_input *in)
 	/* Release dynamically allocated resources. */
 	inc = in->priv;
 
+	csv_workers_stop(inc);
+	g_free(inc->columns);
+	inc->columns = NULL;
 	g_free(inc->termination);
 	inc->termination = NULL;
 	g_free(inc->datafeed_buffer);
@@ -1734,6 +2178,7 @@ static void cleanup(struct sr_input *in)
 	inc->column_formats = save_ctx.column_formats;
 	inc->start_line = save_ctx.start_line;
 	inc->use_header = save_ctx.use_header;
+	inc->num_threads = save_ctx.num_threads;
 	inc->prev_sr_channels = save_ctx.prev_sr_channels;
 	inc->prev_df_channels = save_ctx.prev_df_channels;
 }
@@ -1761,6 +2206,7 @@ enum option_index {
 	OPT_SAMPLERATE,
 	OPT_COL_SEP,
 	OPT_COMMENT,
+	OPT_THREADS,
 	OPT_MAX,
 };
 
@@ -1815,6 +2261,11 @@ static struct sr_option options[] = {
 		"The text which starts comments at the end of text lines, semicolon by default.",
 		NULL, NULL,
 	},
+	[OPT_THREADS] = {
+		"threads", "Parse threads",
+		"Number of worker threads which parse blocks of text lines, 0 parses while receiving data.",
+		NULL, NULL,
+	},
 	[OPT_MAX] = ALL_ZERO,
 };
 
@@ -1838,6 +2289,7 @@ static const struct sr_option *get_options(void)
 		options[OPT_SAMPLERATE].def = g_variant_ref_sink(g_variant_new_uint64(0));
 		options[OPT_COL_SEP].def = g_variant_ref_sink(g_variant_new_string(","));
 		options[OPT_COMMENT].def = g_variant_ref_sink(g_variant_new_string(";"));
+		options[OPT_THREADS].def = g_variant_ref_sink(g_variant_new_uint32(0));
 	}
 
 	return options;
@@ -590,15 +590,216 @@ SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in)
  * the chance to examine the device instance, attach session callbacks
  * and so on.
  *
+ * The caller's buffer doesn't get modified, and no reference to it is
+ * kept. Callers may reuse the buffer after this call returned. Some
+ * modules send packets which point into the buffer. Transforms modify
+ * packets in place, so when the device's session has transforms, the
+ * module gets a copy of the buffer.
+ *
  * @since 0.4.0
  */
 SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 {
+	GString *copy;
 	size_t len;
+	int ret;
 
 	len = buf ? buf->len : 0;
 	sr_spew("Sending %zu bytes to %s module.", len, in->module->id);
-	return in->module->receive((struct sr_input *)in, buf);
+	if (!buf || !in->sdi || !in->sdi->session ||
+			!in->sdi->session->transforms)
+		return in->module->receive((struct sr_input *)in, buf);
+
+	copy = g_string_new_len(buf->str, buf->len);
+	ret = in->module->receive((struct sr_input *)in, copy);
+	g_string_free(copy, TRUE);
+
+	return ret;
+}
+
+/**
+ * Start accessing the data of a receive() call in place.
+ *
+ * @param[out] data The read position to initialize.
+ * @param[in] recv The caller's buffer, or NULL when there is none
+ *   (like in end(), where only previously kept data is pending).
+ *
+ * Modules which process their input in fixed size units can avoid
+ * copying every received byte into in->buf, and removing processed
+ * data from its start later. sr_input_data_peek() hands out pending
+ * data, sr_input_data_consume() marks it as processed, and before
+ * returning from receive() sr_input_data_keep() stashes what was not
+ * processed. The caller's buffer is never modified.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_data_init(struct sr_input_data *data,
+	const GString *recv)
+{
+	data->recv = recv;
+	data->pos = 0;
+}
+
+/**
+ * Get the next piece of input data for processing.
+ *
+ * @param[in] in The input instance.
+ * @param[in] data The read position.
+ * @param[in] unitsize The size of the units the module processes.
+ * @param[out] len The number of available bytes.
+ *
+ * @return The start of the available data, or NULL when there is none.
+ *
+ * Data which was kept from previous calls gets returned first. In that
+ * case only as many bytes of the received data get copied as are needed
+ * to complete a unit. Subsequent calls then return the caller's buffer
+ * in place. The returned data may end in a partial unit, which callers
+ * should leave unconsumed.
+ *
+ * @private
+ */
+SR_PRIV const char *sr_input_data_peek(struct sr_input *in,
+	struct sr_input_data *data, size_t unitsize, size_t *len)
+{
+	size_t avail, fill;
+
+	avail = data->recv ? data->recv->len - data->pos : 0;
+	if (in->buf->len) {
+		fill = in->buf->len % MAX(unitsize, 1);
+		if (fill)
+			fill = MIN(unitsize - fill, avail);
+		if (fill) {
+			g_string_append_len(in->buf,
+				data->recv->str + data->pos, fill);
+			data->pos += fill;
+		}
+		*len = in->buf->len;
+		return in->buf->str;
+	}
+
+	*len = avail;
+	if (!avail)
+		return NULL;
+	return data->recv->str + data->pos;
+}
+
+/**
+ * Mark input data as processed.
+ *
+ * @param[in] in The input instance.
+ * @param[in] data The read position.
+ * @param[in] len The number of bytes which were processed, at most the
+ *   length which the most recent sr_input_data_peek() call returned.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_data_consume(struct sr_input *in,
+	struct sr_input_data *data, size_t len)
+{
+	if (in->buf->len) {
+		if (len == in->buf->len)
+			g_string_truncate(in->buf, 0);
+		else
+			g_string_erase(in->buf, 0, len);
+		return;
+	}
+	data->pos += len;
+}
+
+/**
+ * Keep unprocessed input data for subsequent calls.
+ *
+ * @param[in] in The input instance.
+ * @param[in] data The read position.
+ *
+ * Copies the remainder of the caller's buffer to in->buf, because the
+ * caller's buffer is not valid after receive() returned.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_data_keep(struct sr_input *in,
+	struct sr_input_data *data)
+{
+	if (!data->recv || data->pos >= data->recv->len)
+		return;
+	g_string_append_len(in->buf, data->recv->str + data->pos,
+		data->recv->len - data->pos);
+	data->pos = data->recv->len;
+}
+
+/**
+ * Send the content of a file to the specified input instance.
+ *
+ * @param in_ro The input instance.
+ * @param filename The name of the file to send.
+ *
+ * Maps the file into memory and passes it to the input module in chunks
+ * which reference the mapping, instead of reading the file into buffers.
+ * Modules which process binary data in place send packets to the session
+ * which point into the mapped file. The mapping is read-only, so when the
+ * device's session has transforms, which modify packets in place, the
+ * chunks get copied like in sr_input_send().
+ *
+ * Like sr_input_send(), this returns the moment the input instance's
+ * device is ready, so that the caller can add it to a session. Another
+ * call continues where the previous one stopped, and returns when the
+ * end of the file was reached. Callers then use sr_input_end() as usual.
+ * The file stays mapped until sr_input_reset() or sr_input_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The file could not be mapped.
+ * @retval other Error code from the input module.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_file(const struct sr_input *in_ro,
+	const char *filename)
+{
+	struct sr_input *in;
+	GError *error;
+	GString chunk;
+	const char *contents;
+	size_t size, len;
+	gboolean was_ready;
+	int ret;
+
+	in = (struct sr_input *)in_ro;	/* "un-const" */
+	if (!in || !filename || !filename[0])
+		return SR_ERR_ARG;
+
+	if (!in->mapped) {
+		error = NULL;
+		in->mapped = g_mapped_file_new(filename, FALSE, &error);
+		if (!in->mapped) {
+			sr_err("Failed to map %s: %s", filename, error->message);
+			g_error_free(error);
+			return SR_ERR_IO;
+		}
+		in->mapped_pos = 0;
+	}
+	contents = g_mapped_file_get_contents(in->mapped);
+	size = g_mapped_file_get_length(in->mapped);
+
+	/*
+	 * Modules only read the buffer, wrap the mapping in place.
+	 * sr_input_send() copies it when transforms may modify packets.
+	 */
+	was_ready = in->sdi_ready;
+	while (in->mapped_pos < size) {
+		len = MIN(size - in->mapped_pos, CHUNK_SIZE);
+		chunk.str = (char *)&contents[in->mapped_pos];
+		chunk.len = len;
+		chunk.allocated_len = len;
+		in->mapped_pos += len;
+		ret = sr_input_send(in, &chunk);
+		if (ret != SR_OK)
+			return ret;
+		if (!was_ready && in->sdi_ready)
+			break;
+	}
+
+	return SR_OK;
 }
 
 /**
@@ -651,8 +852,9 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	 * in common logic. This agrees with how input module's receive()
 	 * and end() routines "amend but never seed" the 'in' information.
 	 *
-	 * Void potentially accumulated receive() buffer content, and
-	 * clear the sdi_ready flag. This makes sure that subsequent
+	 * Void potentially accumulated receive() buffer content, release
+	 * the file which sr_input_send_file() may have mapped, and clear
+	 * the sdi_ready flag. This makes sure that subsequent
 	 * processing will scan the header again before sample data gets
 	 * interpreted, and stale content from previous calls won't affect
 	 * the result.
@@ -665,6 +867,10 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	if (in->buf)
 		g_string_truncate(in->buf, 0);
 	in->sdi_ready = FALSE;
+	if (in->mapped) {
+		g_mapped_file_unref(in->mapped);
+		in->mapped = NULL;
+	}
 
 	return rc;
 }
@@ -699,6 +905,8 @@ SR_API void sr_input_free(const struct sr_input *in)
 			" unprocessed bytes at free time.", in->buf->len);
 	}
 	g_string_free(in->buf, TRUE);
+	if (in->mapped)
+		g_mapped_file_unref(in->mapped);
 	g_free(in->priv);
 	g_free((gpointer)in);
 }
@@ -152,10 +152,11 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_buffer(struct sr_input *in, struct sr_input_data *data)
 {
 	struct context *inc;
-	unsigned int offset, chunk_size;
+	const char *rdptr;
+	size_t samplesize, len, offset, chunk_size, max_samples;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -169,64 +170,61 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	/* Round down to the last channels * unitsize boundary. */
-	inc->analog.num_samples = CHUNK_SIZE / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
-	offset = 0;
-
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
-		offset += chunk_size;
-	}
-
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
-	chunk_size = inc->analog.num_samples * inc->samplesize;
-	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
-		sr_session_send(in->sdi, &inc->packet);
-		offset += chunk_size;
-	}
-
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else {
-		g_string_truncate(in->buf, 0);
+	/*
+	 * Send received data in place, in chunks which are rounded down
+	 * to the last channels * unitsize boundary. A trailing partial
+	 * sample gets stashed for next time.
+	 */
+	samplesize = inc->samplesize;
+	max_samples = CHUNK_SIZE / samplesize;
+	while ((rdptr = sr_input_data_peek(in, data, samplesize, &len))) {
+		if (len < samplesize)
+			break;
+		for (offset = 0; offset + samplesize <= len; offset += chunk_size) {
+			inc->analog.num_samples = (len - offset) / samplesize;
+			inc->analog.num_samples = MIN(inc->analog.num_samples, max_samples);
+			chunk_size = inc->analog.num_samples * samplesize;
+			inc->analog.data = (void *)(rdptr + offset);
+			sr_session_send(in->sdi, &inc->packet);
+		}
+		sr_input_data_consume(in, data, offset);
 	}
+	sr_input_data_keep(in, data);
 
 	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
 {
+	struct sr_input_data data;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	sr_input_data_init(&data, buf);
 
 	if (!in->sdi_ready) {
+		sr_input_data_keep(in, &data);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	ret = process_buffer(in, &data);
 
 	return ret;
 }
 
 static int end(struct sr_input *in)
 {
+	struct sr_input_data data;
 	struct context *inc;
 	int ret;
 
-	if (in->sdi_ready)
-		ret = process_buffer(in);
-	else
+	if (in->sdi_ready) {
+		sr_input_data_init(&data, NULL);
+		ret = process_buffer(in, &data);
+	} else {
 		ret = SR_OK;
+	}
 
 	inc = in->priv;
 	if (inc->started)
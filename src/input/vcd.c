@@ -122,6 +122,8 @@
 
 #define CHUNK_SIZE (4 * 1024 * 1024)
 #define SCOPE_SEP '.'
+/* Number of line ends to look up at a time. */
+#define LINE_ENDS_BATCH 256
 
 struct context {
 	struct vcd_user_opt {
@@ -143,6 +145,7 @@ struct context {
 	gboolean ignore_end_keyword;
 	gboolean skip_until_end;
 	GSList *channels;
+	GHashTable *signals; /* VCD identifier -> list of vcd_channel */
 	size_t unit_size;
 	size_t logic_count;
 	size_t analog_count;
@@ -1042,6 +1045,37 @@ static gboolean check_header_in_reread(const struct sr_input *in)
 	return TRUE;
 }
 
+/*
+ * Build the index which maps VCD identifiers to the channels which
+ * they feed. Value changes in the data section only carry the short
+ * identifier, looking it up in a hash table keeps the cost per value
+ * change independent from the number of VCD signals. One identifier
+ * can be shared by several signals (identical values), the lists keep
+ * declaration order. Ignored identifiers are kept with an empty list,
+ * to tell them apart from unknown ones.
+ */
+static void build_signal_index(struct context *inc)
+{
+	GSList *l, *list;
+	struct vcd_channel *vcd_ch;
+	char *id;
+
+	inc->signals = g_hash_table_new_full(g_str_hash, g_str_equal,
+		NULL, (GDestroyNotify)g_slist_free);
+	for (l = inc->ignored_signals; l; l = l->next) {
+		id = l->data;
+		g_hash_table_insert(inc->signals, id, NULL);
+	}
+	for (l = inc->channels; l; l = l->next) {
+		vcd_ch = l->data;
+		id = vcd_ch->identifier;
+		list = g_hash_table_lookup(inc->signals, id);
+		list = g_slist_append(list, vcd_ch);
+		g_hash_table_steal(inc->signals, id);
+		g_hash_table_insert(inc->signals, id, list);
+	}
+}
+
 /* Parse VCD file header sections (rate and variables declarations). */
 static int parse_header(const struct sr_input *in, GString *buf)
 {
@@ -1108,6 +1142,7 @@ done_section:
 	if (!check_header_in_reread(in))
 		return SR_ERR_DATA;
 	create_feeds(in);
+	build_signal_index(inc);
 
 	/*
 	 * Allocate space for text to number conversion, and buffers to
@@ -1189,6 +1224,13 @@ static gint vcd_compare_id(gconstpointer a, gconstpointer b)
 static gboolean is_ignored(struct context *inc, const char *id)
 {
 	GSList *ignored;
+	gpointer list;
+
+	if (inc->signals) {
+		if (!g_hash_table_lookup_extended(inc->signals, id, NULL, &list))
+			return FALSE;
+		return list == NULL;
+	}
 
 	ignored = g_slist_find_custom(inc->ignored_signals, id, vcd_compare_id);
 	return ignored != NULL;
@@ -1241,10 +1283,8 @@ static void process_bits(struct context *inc, char *identifier,
 	size = 0;
 	have_int = FALSE;
 	int_val = 0;
-	for (l = inc->channels; l; l = l->next) {
+	for (l = g_hash_table_lookup(inc->signals, identifier); l; l = l->next) {
 		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 		if (vcd_ch->type == SR_CHANNEL_ANALOG) {
 			/* Special case for 'integer' VCD signal types. */
 			size = vcd_ch->size; /* Flag for "VCD signal found". */
@@ -1315,12 +1355,10 @@ static void process_real(struct context *inc, char *identifier, float real_val)
 	struct vcd_channel *vcd_ch;
 
 	found = FALSE;
-	for (l = inc->channels; l; l = l->next) {
+	for (l = g_hash_table_lookup(inc->signals, identifier); l; l = l->next) {
 		vcd_ch = l->data;
 		if (vcd_ch->type != SR_CHANNEL_ANALOG)
 			continue;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 
 		/* Found our (analog) channel. */
 		found = TRUE;
@@ -1869,8 +1907,9 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	uint64_t samplerate;
 	GVariant *gvar;
 	int ret;
-	char *rdptr, *line;
-	size_t taken, rdlen;
+	char *line, *eol;
+	size_t ends[LINE_ENDS_BATCH];
+	size_t base, taken, count, i;
 
 	inc = in->priv;
 
@@ -1898,21 +1937,29 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	if (is_eof)
 		g_string_append_c(in->buf, '\n');
 
-	/* Find and process complete text lines in the input data. */
+	/*
+	 * Find and process complete text lines in the input data. Look
+	 * up the ends of many lines at once, instead of searching for
+	 * every single line. Embedded NUL characters reject the text.
+	 */
 	ret = SR_OK;
-	rdptr = in->buf->str;
 	taken = 0;
-	while (rdptr) {
-		rdlen = &in->buf->str[in->buf->len] - rdptr;
-		line = sr_text_next_line(rdptr, rdlen, &rdptr, &taken);
-		if (!line)
-			break;
-		if (!*line)
-			continue;
-		ret = parse_textline(in, line);
-		if (ret != SR_OK)
-			break;
-	}
+	do {
+		base = taken;
+		count = sr_text_line_ends(&in->buf->str[base],
+			in->buf->len - base, ends, ARRAY_SIZE(ends));
+		for (i = 0; i < count && ret == SR_OK; i++) {
+			line = &in->buf->str[taken];
+			eol = &in->buf->str[base + ends[i]];
+			if (memchr(line, '\0', eol - line))
+				break;
+			*eol = '\0';
+			taken = base + ends[i] + 1;
+			line = sr_text_trim_spaces(line);
+			if (*line)
+				ret = parse_textline(in, line);
+		}
+	} while (ret == SR_OK && i == ARRAY_SIZE(ends));
 	g_string_erase(in->buf, 0, taken);
 
 	return ret;
@@ -2059,6 +2106,9 @@ static void cleanup(struct sr_input *in)
 
 	keep_header_for_reread(in);
 
+	if (inc->signals)
+		g_hash_table_destroy(inc->signals);
+	inc->signals = NULL;
 	g_slist_free_full(inc->channels, free_channel);
 	inc->channels = NULL;
 	feed_queue_logic_free(inc->feed_logic);
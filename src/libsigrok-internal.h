@@ -1238,6 +1238,22 @@ struct sr_input {
 	struct sr_dev_inst *sdi;
 	gboolean sdi_ready;
 	void *priv;
+	/** The file which sr_input_send_file() sends, and the position. */
+	GMappedFile *mapped;
+	size_t mapped_pos;
+};
+
+/**
+ * Position in the data which an input module received, see
+ * sr_input_data_peek(). Allows modules to read the caller's buffer in
+ * place, and only keep the unprocessed tail in the 'buf' of the input
+ * instance.
+ */
+struct sr_input_data {
+	/** The caller's buffer in the current receive() call, or NULL. */
+	const GString *recv;
+	/** Number of bytes in 'recv' which were consumed already. */
+	size_t pos;
 };
 
 /** Input (file) module driver. */
@@ -1690,14 +1706,26 @@ struct drv_context {
 #define ATTR_FMT_PRINTF(fmt_pos, arg_pos)	G_GNUC_PRINTF(fmt_pos, arg_pos)
 #endif
 
+SR_PRIV extern int sr_log_level_cur;
+
 SR_PRIV int sr_log(int loglevel, const char *format, ...) ATTR_FMT_PRINTF(2, 3);
 
+/*
+ * Check the loglevel before the call, so that messages which won't get
+ * shown cost a load and a compare, and their arguments aren't evaluated.
+ */
+#define sr_log_level_enabled(level)	G_UNLIKELY((level) <= sr_log_level_cur)
+#define sr_log_level(level, ...) do { \
+		if (sr_log_level_enabled(level)) \
+			sr_log(level, __VA_ARGS__); \
+	} while (0)
+
 /* Message logging helpers with subsystem-specific prefix string. */
-#define sr_spew(...)	sr_log(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_dbg(...)	sr_log(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
-#define sr_info(...)	sr_log(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_warn(...)	sr_log(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_err(...)	sr_log(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_spew(...)	sr_log_level(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_dbg(...)	sr_log_level(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_info(...)	sr_log_level(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_warn(...)	sr_log_level(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_err(...)	sr_log_level(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -1811,11 +1839,82 @@ SR_PRIV void sr_usbtmc_dev_inst_free(struct sr_usbtmc_dev_inst *usbtmc);
 SR_PRIV const GVariantType *sr_variant_type_get(int datatype);
 SR_PRIV int sr_variant_type_check(uint32_t key, GVariant *data);
 SR_PRIV void sr_hw_cleanup_all(const struct sr_context *ctx);
+SR_PRIV const struct sr_key_info *sr_key_info_table_get(int keytype);
 SR_PRIV struct sr_config *sr_config_new(uint32_t key, GVariant *data);
 SR_PRIV void sr_config_free(struct sr_config *src);
 SR_PRIV int sr_dev_acquisition_start(struct sr_dev_inst *sdi);
 SR_PRIV int sr_dev_acquisition_stop(struct sr_dev_inst *sdi);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+/** Reference counted sample data buffer. */
+struct sr_buffer {
+	/** The buffer's memory. */
+	uint8_t *data;
+	/** Size of the buffer's memory in bytes. */
+	size_t size;
+	/** Number of references, only to be accessed atomically. */
+	gint refcount;
+	/** Invoked instead of freeing the buffer when the last reference drops. */
+	void (*release)(struct sr_buffer *buf);
+	/** Opaque data for the release callback. */
+	void *release_data;
+};
+
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size);
+SR_PRIV struct sr_buffer *sr_buffer_new_full(size_t size,
+		void (*release)(struct sr_buffer *buf), void *release_data);
+SR_PRIV void sr_buffer_free(struct sr_buffer *buf);
+SR_PRIV struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf);
+SR_PRIV void sr_buffer_unref(struct sr_buffer *buf);
+SR_PRIV struct sr_buffer *sr_buffer_current_set(struct sr_buffer *buf);
+SR_PRIV struct sr_buffer *sr_buffer_current_find(const void *data, size_t len);
+
+struct sr_buffer_pool;
+
+/**
+ * Number of sample buffers which consumers may hold on to, in addition
+ * to the buffers which a driver itself uses.
+ *
+ * Consumers retain sent data beyond the datafeed callback, e.g. the
+ * session's datafeed queue until the packet got delivered, or transforms
+ * and frontends by means of sr_packet_copy(). Drivers add this allowance
+ * to the limit of pools whose buffers they send, so that pools absorb
+ * slow consumers for a while, but don't grow without bounds.
+ */
+#define SR_BUFFER_POOL_RETAINED	32
+
+/** Statistics of a buffer pool. */
+struct sr_buffer_pool_stats {
+	/** Size of each of the pool's buffers in bytes. */
+	size_t block_size;
+	/** Number of buffers which are currently allocated. */
+	size_t allocated;
+	/** Number of buffers which are currently in use. */
+	size_t in_use;
+	/** Highest number of buffers which were in use at the same time. */
+	size_t in_use_max;
+	/** Number of requests for a buffer. */
+	uint64_t requests;
+	/** Number of requests which had to allocate another buffer. */
+	uint64_t misses;
+	/** Number of requests which could not be satisfied. */
+	uint64_t failures;
+};
+
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t block_size,
+		size_t prealloc, size_t limit);
+SR_PRIV void sr_buffer_pool_destroy(struct sr_buffer_pool *pool);
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_PRIV struct sr_buffer *sr_buffer_pool_acquire(struct sr_buffer_pool *pool,
+		const struct sr_dev_inst *sdi);
+SR_PRIV struct sr_buffer *sr_buffer_pool_lookup(struct sr_buffer_pool *pool,
+		void *data);
+SR_PRIV struct sr_buffer *sr_buffer_pool_get_writable(
+		struct sr_buffer_pool *pool, struct sr_buffer *buf);
+SR_PRIV void sr_buffer_pool_stats_get(struct sr_buffer_pool *pool,
+		struct sr_buffer_pool_stats *stats);
+
 /*--- session.c -------------------------------------------------------------*/
 
 struct sr_session {
@@ -1848,6 +1947,20 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/**
+	 * Optional datafeed queue. When set, sr_session_send() queues
+	 * packets for a consumer thread instead of running transforms
+	 * and callbacks in the sender's context.
+	 */
+	struct sr_datafeed_queue *datafeed_queue;
+
+	/** Unique ID, identifies the session in per-thread caches. */
+	guint stats_id;
+	/** Mutex protecting the list of instrumentation counters. */
+	GMutex stats_mutex;
+	/** Instrumentation counters, one set per device and thread. */
+	GSList *stats_blocks;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1878,6 +1991,11 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV void sr_session_stats_transfer_error(const struct sr_dev_inst *sdi,
+		gboolean overrun);
+SR_PRIV int sr_session_datafeed_queue_policy(struct sr_session *session);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
@@ -1893,6 +2011,83 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/*--- session_driver.c ------------------------------------------------------*/
+
+SR_PRIV int sr_session_vdev_num_samples(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t *num_samples);
+SR_PRIV int sr_session_vdev_read(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t count,
+		void *buf);
+SR_PRIV int sr_session_vdev_seek(const struct sr_dev_inst *sdi,
+		uint64_t sample);
+SR_PRIV int sr_session_vdev_summary(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t block_samples,
+		uint64_t first_block, uint64_t num_blocks, void *buf);
+SR_PRIV int sr_session_vdev_find_edge(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t *sample);
+SR_PRIV int sr_session_vdev_prefetch_set(const struct sr_dev_inst *sdi,
+		unsigned int threads, unsigned int depth);
+
+/*--- zip_archive.c ---------------------------------------------------------*/
+
+/* ZIP archive record signatures and sizes. */
+#define ZIP_LOCAL_HEADER_SIG	0x04034b50
+#define ZIP_CENTRAL_HEADER_SIG	0x02014b50
+#define ZIP_EOCD_SIG		0x06054b50
+#define ZIP64_EOCD_SIG		0x06064b50
+#define ZIP64_LOCATOR_SIG	0x07064b50
+#define ZIP_LOCAL_HEADER_SIZE	30
+#define ZIP_CENTRAL_HEADER_SIZE	46
+#define ZIP_EOCD_SIZE		22
+#define ZIP64_EOCD_SIZE		56
+#define ZIP64_LOCATOR_SIZE	20
+#define ZIP64_EXTRA_ID		0x0001
+#define ZIP64_EXTRA_SIZE	12
+#define ZIP_VERSION		20
+#define ZIP64_VERSION		45
+#define ZIP_METHOD_STORE	0
+#define ZIP_METHOD_DEFLATE	8
+#define ZIP_FLAG_ENCRYPTED	0x0001
+/* Sizes and CRC only follow the member data. */
+#define ZIP_FLAG_DATA_DESC	0x0008
+
+/** An archive member, as its local and central headers describe it. */
+struct sr_zip_entry {
+	char *name;
+	/** Offset of the member's local header. */
+	uint64_t offset;
+	uint16_t flags;
+	uint16_t method;
+	uint16_t dos_time;
+	uint16_t dos_date;
+	uint32_t crc;
+	uint64_t comp_size;
+	uint64_t size;
+};
+
+SR_PRIV uint32_t sr_zip_crc32(const uint8_t *buf, size_t len);
+SR_PRIV void sr_zip_local_header_write(uint8_t *header,
+		const struct sr_zip_entry *entry, size_t extra_len);
+SR_PRIV gboolean sr_zip_local_header_parse(const uint8_t *base, uint64_t size,
+		uint64_t offset, struct sr_zip_entry *entry, uint64_t *data_offset);
+SR_PRIV void sr_zip_cd_entry_append(GByteArray *cd,
+		const struct sr_zip_entry *entry);
+SR_PRIV void sr_zip_cd_end_append(GByteArray *cd, uint64_t num_entries,
+		uint64_t cd_offset, uint64_t cd_size);
+SR_PRIV GArray *sr_zip_cd_read(const uint8_t *base, uint64_t size);
+SR_PRIV void sr_zip_entries_free(GArray *entries);
+
+/*--- input/input.c ---------------------------------------------------------*/
+
+SR_PRIV void sr_input_data_init(struct sr_input_data *data,
+		const GString *recv);
+SR_PRIV const char *sr_input_data_peek(struct sr_input *in,
+		struct sr_input_data *data, size_t unitsize, size_t *len);
+SR_PRIV void sr_input_data_consume(struct sr_input *in,
+		struct sr_input_data *data, size_t len);
+SR_PRIV void sr_input_data_keep(struct sr_input *in,
+		struct sr_input_data *data);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -2012,17 +2207,25 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_stage;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
+	struct soft_trigger_stage *stages;
+	int num_stages;
+	gboolean stages_valid;
 	int unitsize;
 	int cur_stage;
+	gboolean have_prev_sample;
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* Retained sample buffers instead of the above circular buffer. */
+	gboolean retain_buffers;
+	GQueue *pre_trigger_segments;
 };
 
 SR_PRIV int logic_channel_unitsize(GSList *channels);
@@ -2030,8 +2233,49 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples);
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
+SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new_full(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, gboolean retain_buffers);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
+SR_PRIV int soft_trigger_logic_check_buffer(struct soft_trigger_logic *stl,
+		struct sr_buffer *sbuf, uint8_t *buf, int len,
+		int *pre_trigger_samples);
+
+struct soft_trigger_analog_stage;
+
+struct soft_trigger_analog_channel {
+	struct sr_channel *ch;
+	/* Used for pre-trigger packets, drivers set them up after _new(). */
+	enum sr_mq mq;
+	enum sr_unit unit;
+	enum sr_mqflag mqflags;
+	int digits;
+};
+
+struct soft_trigger_analog {
+	const struct sr_dev_inst *sdi;
+	const struct sr_trigger *trigger;
+	struct soft_trigger_analog_channel *channels;
+	int num_channels;
+	struct soft_trigger_analog_stage *stages;
+	int num_stages;
+	gboolean stages_valid;
+	int cur_stage;
+	float hysteresis;
+	float *pre_trigger_buffer;
+	float *pre_trigger_chan;
+	int pre_trigger_size;
+	int pre_trigger_head;
+	int pre_trigger_fill;
+};
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis);
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta);
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *data, int num_frames, int *pre_trigger_samples);
 
 /*--- serial.c --------------------------------------------------------------*/
 
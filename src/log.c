@@ -42,8 +42,11 @@
  * @{
  */
 
-/* Currently selected libsigrok loglevel. Default: SR_LOG_WARN. */
-static int cur_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
+/*
+ * Currently selected libsigrok loglevel. Default: SR_LOG_WARN.
+ * Checked by the sr_spew() etc. macros before calling sr_log().
+ */
+SR_PRIV int sr_log_level_cur = SR_LOG_WARN; /* Show errors+warnings per default. */
 
 /* Function prototype. */
 static int sr_logv(void *cb_data, int loglevel, const char *format,
@@ -63,6 +66,42 @@ static void *sr_log_cb_data = NULL;
 /** @endcond */
 static int64_t sr_log_start_time = 0;
 
+/*
+ * Asynchronous logging: callers format their message into a slot of a
+ * bounded lock-free ring buffer (multiple producers, see D. Vyukov's
+ * bounded MPMC queue), a background thread passes the messages on to
+ * the log callback. Messages get truncated to the slot size, and are
+ * dropped (and counted) while the ring is full. The thread sleeps on a
+ * condition variable while the ring is empty, producers only take the
+ * mutex to wake it up.
+ */
+/** @cond PRIVATE */
+#define LOG_ASYNC_SLOTS 512
+#define LOG_ASYNC_MSG_LEN 256
+/** @endcond */
+
+struct log_slot {
+	gint seq;
+	int loglevel;
+	int64_t time;
+	char msg[LOG_ASYNC_MSG_LEN];
+};
+
+static struct log_slot log_ring[LOG_ASYNC_SLOTS];
+static gboolean log_ring_ready;
+static gint log_enqueue_pos;
+static guint log_dequeue_pos;
+static gint log_dropped;
+static gint log_async;
+static GThread *log_thread;
+static GMutex log_async_mutex;
+static GMutex log_wake_mutex;
+static GCond log_wake_cond;
+static gint log_sleeping;
+
+/* Time of the message the log thread currently passes on, if any. */
+static GPrivate log_emit_time;
+
 /**
  * Set the libsigrok loglevel.
  *
@@ -90,7 +129,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
 	if (loglevel >= LOGLEVEL_TIMESTAMP && sr_log_start_time == 0)
 		sr_log_start_time = g_get_monotonic_time();
 
-	cur_loglevel = loglevel;
+	sr_log_level_cur = loglevel;
 
 	sr_dbg("libsigrok loglevel set to %d.", loglevel);
 
@@ -106,7 +145,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
  */
 SR_API int sr_log_loglevel_get(void)
 {
-	return cur_loglevel;
+	return sr_log_level_cur;
 }
 
 /**
@@ -185,6 +224,7 @@ SR_API int sr_log_callback_get(sr_log_callback *cb, void **cb_data)
 static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args)
 {
 	int ret;
+	const int64_t *emit_time;
 	uint64_t elapsed_us, minutes;
 	unsigned int rest_us, seconds, microseconds;
 	char *raw_output, *output, c;
@@ -202,8 +242,13 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	ret = fputs("sr: ", stderr);
 	if (ret < 0)
 		return SR_ERR;
-	if (cur_loglevel >= LOGLEVEL_TIMESTAMP) {
-		elapsed_us = g_get_monotonic_time() - sr_log_start_time;
+	if (sr_log_level_cur >= LOGLEVEL_TIMESTAMP) {
+		/* Queued messages are stamped when they were emitted. */
+		emit_time = g_private_get(&log_emit_time);
+		if (emit_time)
+			elapsed_us = *emit_time - sr_log_start_time;
+		else
+			elapsed_us = g_get_monotonic_time() - sr_log_start_time;
 
 		minutes = elapsed_us / G_TIME_SPAN_MINUTE;
 		rest_us = elapsed_us % G_TIME_SPAN_MINUTE;
@@ -250,6 +295,215 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	return SR_OK;
 }
 
+/* Pass a preformatted message on to the log callback. */
+static int log_cb_call(int loglevel, const char *format, ...)
+{
+	int ret;
+	va_list args;
+
+	va_start(args, format);
+	ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+static int log_ring_push(int loglevel, const char *format, va_list args)
+{
+	struct log_slot *slot;
+	guint pos;
+	gint diff;
+
+	pos = (guint)g_atomic_int_get(&log_enqueue_pos);
+	for (;;) {
+		slot = &log_ring[pos % LOG_ASYNC_SLOTS];
+		diff = (gint)((guint)g_atomic_int_get(&slot->seq) - pos);
+		if (diff == 0) {
+			/* Slot is free, try to claim it. */
+			if (g_atomic_int_compare_and_exchange(&log_enqueue_pos,
+					(gint)pos, (gint)(pos + 1)))
+				break;
+			pos = (guint)g_atomic_int_get(&log_enqueue_pos);
+		} else if (diff < 0) {
+			/* Ring is full. */
+			g_atomic_int_inc(&log_dropped);
+			return SR_OK;
+		} else {
+			/* Another producer claimed it, retry. */
+			pos = (guint)g_atomic_int_get(&log_enqueue_pos);
+		}
+	}
+
+	slot->loglevel = loglevel;
+	slot->time = g_get_monotonic_time();
+	g_vsnprintf(slot->msg, sizeof(slot->msg), format, args);
+	g_atomic_int_set(&slot->seq, (gint)(pos + 1));
+
+	/* Wake the log thread up if it waits for messages. */
+	if (g_atomic_int_get(&log_sleeping)) {
+		g_mutex_lock(&log_wake_mutex);
+		g_cond_signal(&log_wake_cond);
+		g_mutex_unlock(&log_wake_mutex);
+	}
+
+	return SR_OK;
+}
+
+static gboolean log_ring_empty(void)
+{
+	struct log_slot *slot;
+
+	slot = &log_ring[log_dequeue_pos % LOG_ASYNC_SLOTS];
+	if ((guint)g_atomic_int_get(&slot->seq) == log_dequeue_pos + 1)
+		return FALSE;
+
+	return g_atomic_int_get(&log_dropped) == 0;
+}
+
+/* Pass all queued messages on to the log callback. Single consumer. */
+static void log_ring_drain(void)
+{
+	struct log_slot *slot;
+	guint pos;
+	gint dropped;
+
+	for (;;) {
+		pos = log_dequeue_pos;
+		slot = &log_ring[pos % LOG_ASYNC_SLOTS];
+		if ((guint)g_atomic_int_get(&slot->seq) != pos + 1)
+			break;
+		if (sr_log_cb) {
+			g_private_set(&log_emit_time, &slot->time);
+			log_cb_call(slot->loglevel, "%s", slot->msg);
+			g_private_set(&log_emit_time, NULL);
+		}
+		g_atomic_int_set(&slot->seq, (gint)(pos + LOG_ASYNC_SLOTS));
+		log_dequeue_pos = pos + 1;
+	}
+
+	dropped = g_atomic_int_get(&log_dropped);
+	if (!dropped)
+		return;
+	g_atomic_int_add(&log_dropped, -dropped);
+	if (sr_log_cb)
+		log_cb_call(SR_LOG_WARN, "log: %d messages dropped.", dropped);
+}
+
+static gpointer log_thread_func(gpointer data)
+{
+	(void)data;
+
+	while (g_atomic_int_get(&log_async)) {
+		log_ring_drain();
+		/*
+		 * Producers check the flag after publishing a message, so
+		 * either they see it set, or the check below sees their
+		 * message.
+		 */
+		g_mutex_lock(&log_wake_mutex);
+		g_atomic_int_set(&log_sleeping, 1);
+		while (log_ring_empty() && g_atomic_int_get(&log_async))
+			g_cond_wait(&log_wake_cond, &log_wake_mutex);
+		g_atomic_int_set(&log_sleeping, 0);
+		g_mutex_unlock(&log_wake_mutex);
+	}
+	log_ring_drain();
+
+	return NULL;
+}
+
+/*
+ * Output the messages of producers which raced with sr_log_async_set()
+ * disabling asynchronous logging. Unless the log thread got restarted,
+ * the caller is the only consumer while holding the mutex.
+ */
+static void log_ring_flush(void)
+{
+	g_mutex_lock(&log_async_mutex);
+	if (!log_thread)
+		log_ring_drain();
+	g_mutex_unlock(&log_async_mutex);
+}
+
+/**
+ * Enable or disable asynchronous logging.
+ *
+ * With asynchronous logging, log messages get formatted into a lock-free
+ * ring buffer by the code that emits them, and a background thread
+ * passes them on to the log callback. This keeps slow log output (e.g.
+ * to a terminal) out of timing-sensitive paths like USB transfer
+ * handling, at the expense of a delay in the output. The log callback
+ * gets called from the background thread, and receives preformatted
+ * messages, which are truncated to 255 characters. Messages get dropped
+ * while the buffer is full, a warning reports how many. Time stamps of
+ * the default log callback are taken when a message gets emitted.
+ *
+ * Disabling asynchronous logging outputs all pending messages.
+ *
+ * @param async TRUE to enable asynchronous logging, FALSE to disable it.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The background thread could not be started.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_async_set(int async)
+{
+	GError *error;
+	int i;
+
+	g_mutex_lock(&log_async_mutex);
+
+	if (async && !log_thread) {
+		/* The ring stays consistent across restarts, set it up once. */
+		if (!log_ring_ready) {
+			for (i = 0; i < LOG_ASYNC_SLOTS; i++)
+				g_atomic_int_set(&log_ring[i].seq, i);
+			log_ring_ready = TRUE;
+		}
+		g_atomic_int_set(&log_async, 1);
+		error = NULL;
+		log_thread = g_thread_try_new("sr-log", log_thread_func,
+			NULL, &error);
+		if (!log_thread) {
+			g_atomic_int_set(&log_async, 0);
+			g_mutex_unlock(&log_async_mutex);
+			sr_err("Cannot start log thread: %s.", error->message);
+			g_error_free(error);
+			return SR_ERR;
+		}
+	} else if (!async && log_thread) {
+		g_atomic_int_set(&log_async, 0);
+		g_mutex_lock(&log_wake_mutex);
+		g_cond_signal(&log_wake_cond);
+		g_mutex_unlock(&log_wake_mutex);
+		g_thread_join(log_thread);
+		log_thread = NULL;
+		/*
+		 * Catch messages which got published after the thread's last
+		 * pass. Later ones get output by their producers, see
+		 * log_ring_flush().
+		 */
+		log_ring_drain();
+	}
+
+	g_mutex_unlock(&log_async_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Check whether asynchronous logging is enabled.
+ *
+ * @return TRUE if asynchronous logging is enabled, FALSE otherwise.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_async_get(void)
+{
+	return g_atomic_int_get(&log_async) != 0;
+}
+
 /** @private */
 SR_PRIV int sr_log(int loglevel, const char *format, ...)
 {
@@ -257,7 +511,7 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 	va_list args;
 
 	/* Only output messages of at least the selected loglevel(s). */
-	if (loglevel > cur_loglevel)
+	if (loglevel > sr_log_level_cur)
 		return SR_OK;
 
 	/* Silently succeed when no logging callback is registered. */
@@ -265,7 +519,13 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 		return SR_OK;
 
 	va_start(args, format);
-	ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
+	if (g_atomic_int_get(&log_async)) {
+		ret = log_ring_push(loglevel, format, args);
+		if (!g_atomic_int_get(&log_async))
+			log_ring_flush();
+	} else {
+		ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
+	}
 	va_end(args);
 
 	return ret;
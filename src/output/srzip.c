@@ -23,12 +23,142 @@
 #include <errno.h>
 #include <glib.h>
 #include <glib/gstdio.h>
-#include <zip.h>
+#include <stdio.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#include "minilzo/minilzo.h"
 
 #define LOG_PREFIX "output/srzip"
 #define CHUNK_SIZE (4 * 1024 * 1024)
+#define MAX_THREADS 32
+
+/*
+ * The archive is written by a minimal sequential ZIP writer. libzip
+ * holds on to every added source until zip_close(), which then writes
+ * the whole archive, and reopening the archive for each chunk makes
+ * zip_close() rewrite it. Neither scales to long captures. The ZIP
+ * records are shared with the session file code, see zip_archive.c.
+ *
+ * Stored members get their data aligned by a padding extra field (the
+ * ID zipalign uses), so that readers can use the data in a memory
+ * mapping of the archive as is.
+ */
+#define ZIP_ALIGN_EXTRA_ID	0xd935
+#define ZIP_ALIGN_EXTRA_SIZE	6
+#define ZIP_DATA_ALIGN		64
+
+/*
+ * Sample data chunks can be compressed with LZO1X-1, which is several
+ * times faster than deflate in both directions. Such chunks are stored
+ * archive members named "<chunk name>.lzo", holding a header with the
+ * magic and the uncompressed size (32 bit little endian), followed by
+ * the compressed data. Files which may contain them are version 3.
+ */
+#define LZO_CHUNK_SUFFIX	".lzo"
+#define LZO_CHUNK_MAGIC		"SRLZ"
+#define LZO_CHUNK_HEADER_SIZE	8
+
+/*
+ * Logic data chunks can be stored as value transitions, which suits
+ * mostly idle signals. Such members are named "<chunk name>.rle", and
+ * get deflated or stored like other members. They hold a header with
+ * the magic and the size of the sample data (32 bit little endian),
+ * followed by runs of equal samples: the number of samples in the run
+ * (LEB128), and the sample value (unit size bytes). Files which may
+ * contain them are version 4.
+ */
+#define RLE_CHUNK_SUFFIX	".rle"
+#define RLE_CHUNK_MAGIC		"SRRL"
+#define RLE_CHUNK_HEADER_SIZE	8
+/* Largest encoding of a 64 bit run length. */
+#define RLE_RUN_MAX_SIZE	10
+
+/*
+ * Multi-resolution summaries of the sample data let viewers render
+ * zoomed out views and find edges without reading every sample. The
+ * summary of a stream is an archive member "<stream name>.summary".
+ * It starts with a header:
+ * - the magic "SRSM"
+ * - the number of samples per block of the finest level, log2 (8 bit)
+ * - the factor between the block sizes of two levels, log2 (8 bit)
+ * - the unit size of logic data, 0 for analog data (16 bit)
+ * - the number of samples (64 bit)
+ * - the number of levels (32 bit)
+ * The blocks of all levels follow, the finest level first, until one
+ * block covers all samples.
+ *
+ * A logic block holds a mask of the bits which have an edge within the
+ * block, followed by the sample value at the start of the block. An
+ * edge is a sample which differs from its predecessor. An analog block
+ * holds the minimum and the maximum value, as floats in host byte order
+ * like the sample data. The header fields are little endian.
+ */
+#define SUMMARY_SUFFIX		".summary"
+#define SUMMARY_MAGIC		"SRSM"
+#define SUMMARY_HEADER_SIZE	20
+#define SUMMARY_BLOCK_SHIFT	10
+#define SUMMARY_LEVEL_SHIFT	4
+
+/* Summary of a stream, which gets built while the stream is written. */
+struct summary {
+	char *name;
+	/* Logic data unit size, 0 for analog data. */
+	size_t unitsize;
+	size_t block_size;
+	uint64_t num_samples;
+	/* Blocks of the finest level, the last one may be incomplete. */
+	GByteArray *blocks;
+	/* Last logic sample. */
+	uint8_t *prev;
+};
+
+/* Per-thread compression state. */
+struct zip_compressor {
+#ifdef HAVE_ZLIB
+	z_stream zstrm;
+	gboolean zstrm_init;
+#endif
+	int level;
+	/* Use LZO instead of deflate for sample data chunks. */
+	gboolean lzo;
+	lzo_voidp lzo_wrkmem;
+	/* Encode logic data chunks as transitions. */
+	gboolean transitions;
+};
+
+/*
+ * A member on its way into the archive. Jobs get compressed by any
+ * worker thread, and are committed to the file in submission order.
+ */
+struct zip_job {
+	struct sr_zip_entry entry;
+	const uint8_t *data;
+	size_t len;
+	/* Chunk buffer to recycle after commit, NULL for borrowed data. */
+	uint8_t *buff;
+	/* Unit size of logic data chunks, 0 for other members. */
+	size_t unitsize;
+	/* Transition encoded logic data, which replaces the chunk data. */
+	uint8_t *enc_data;
+	/* Compressed data, NULL when the member gets stored. */
+	uint8_t *comp_data;
+	/* Whether the central directory lists the member. */
+	gboolean listed;
+	gboolean done;
+	int ret;
+};
+
+struct zip_worker {
+	struct out_context *outc;
+	GThread *thread;
+	struct zip_compressor comp;
+};
 
 struct out_context {
 	gboolean zip_created;
@@ -37,6 +167,38 @@ struct out_context {
 	size_t first_analog_index;
 	size_t analog_ch_count;
 	gint *analog_index_map;
+	/*
+	 * The archive is written sequentially and stays open for the
+	 * whole session. Members are appended as chunks complete, the
+	 * metadata and the central directory are written at SR_DF_END.
+	 * In journal mode, every member gets flushed to the disk, and
+	 * the metadata is written upfront as well.
+	 */
+	FILE *archive;
+	gboolean journal;
+	uint64_t archive_size;
+	GArray *entries;
+	uint16_t dos_time, dos_date;
+	GKeyFile *meta;
+	size_t logic_chunk_num;
+	size_t *analog_chunk_num;
+	gboolean summaries;
+	struct summary *logic_summary;
+	struct summary **analog_summaries;
+	struct zip_compressor comp;
+	/* Empty chunk buffers, only used by the session thread. */
+	GSList *spare_buffs;
+	/* Compression worker threads and their queues. */
+	size_t num_workers;
+	struct zip_worker *workers;
+	size_t max_jobs;
+	GQueue jobs;
+	/* Everything below is protected by the mutex. */
+	GMutex mutex;
+	GCond cond_pending;
+	GCond cond_done;
+	GQueue pending;
+	gboolean shutdown;
 	struct logic_buff {
 		size_t zip_unit_size;
 		size_t alloc_size;
@@ -53,38 +215,838 @@ struct out_context {
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
-
-	(void)options;
+	const char *compression;
+	gboolean lzo, transitions, summaries, journal;
+	int level;
 
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
 	}
 
+	compression = g_variant_get_string(g_hash_table_lookup(options,
+		"compression"), NULL);
+	lzo = FALSE;
+	if (!strcmp(compression, "store")) {
+		level = 0;
+	} else if (!strcmp(compression, "lzo")) {
+		/* Other members than sample data get deflated. */
+		level = 6;
+		lzo = TRUE;
+	} else if (!strcmp(compression, "deflate")) {
+		level = g_variant_get_uint32(g_hash_table_lookup(options, "level"));
+		if (level < 1 || level > 9) {
+			sr_err("Invalid compression level %d.", level);
+			return SR_ERR_ARG;
+		}
+	} else {
+		sr_err("Unsupported compression '%s'.", compression);
+		return SR_ERR_ARG;
+	}
+	transitions = g_variant_get_boolean(g_hash_table_lookup(options,
+		"transitions"));
+	summaries = g_variant_get_boolean(g_hash_table_lookup(options,
+		"summaries"));
+	journal = g_variant_get_boolean(g_hash_table_lookup(options,
+		"journal"));
+#ifndef HAVE_ZLIB
+	if (level) {
+		sr_info("No zlib support, storing uncompressed %s.",
+			lzo ? "metadata" : "data");
+		level = 0;
+	}
+#endif
+
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	outc->comp.level = level;
+	outc->comp.lzo = lzo;
+	outc->comp.transitions = transitions;
+	outc->summaries = summaries;
+	outc->journal = journal;
+	outc->num_workers = g_variant_get_uint32(g_hash_table_lookup(options,
+		"threads"));
+	if (outc->num_workers > MAX_THREADS) {
+		sr_warn("Limiting compression to %d threads.", MAX_THREADS);
+		outc->num_workers = MAX_THREADS;
+	}
+	if (!level && !lzo && !transitions)
+		outc->num_workers = 0;
+	g_mutex_init(&outc->mutex);
+	g_cond_init(&outc->cond_pending);
+	g_cond_init(&outc->cond_done);
 	o->priv = outc;
 
 	return SR_OK;
 }
 
+#ifdef HAVE_ZLIB
+/**
+ * Deflate a member's data.
+ *
+ * @param[in] comp Compression state of the calling thread.
+ * @param[in] job The member to compress, receives the compressed data.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_deflate(struct zip_compressor *comp, struct zip_job *job)
+{
+	size_t bound;
+	int ret;
+
+	if (!comp->zstrm_init) {
+		/* Raw deflate stream, ZIP members carry no zlib header. */
+		ret = deflateInit2(&comp->zstrm, comp->level,
+			Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+		if (ret != Z_OK)
+			return SR_ERR;
+		comp->zstrm_init = TRUE;
+	} else if (deflateReset(&comp->zstrm) != Z_OK) {
+		return SR_ERR;
+	}
+
+	bound = deflateBound(&comp->zstrm, job->len);
+	job->comp_data = g_try_malloc(bound);
+	if (!job->comp_data)
+		return SR_ERR_MALLOC;
+
+	comp->zstrm.next_in = (Bytef *)job->data;
+	comp->zstrm.avail_in = job->len;
+	comp->zstrm.next_out = job->comp_data;
+	comp->zstrm.avail_out = bound;
+	if (deflate(&comp->zstrm, Z_FINISH) != Z_STREAM_END)
+		return SR_ERR;
+	job->entry.comp_size = comp->zstrm.total_out;
+
+	return SR_OK;
+}
+#endif
+
+/**
+ * Compress a sample data chunk with LZO, and rename its member.
+ *
+ * Chunks which LZO cannot shrink are kept as plain, stored members.
+ *
+ * @param[in] comp Compression state of the calling thread.
+ * @param[in] job The chunk to compress, receives the compressed data.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_lzo(struct zip_compressor *comp, struct zip_job *job)
+{
+	lzo_uint comp_len;
+	uint8_t *wrptr;
+	char *name;
+	int ret;
+
+	if (!comp->lzo_wrkmem) {
+		comp->lzo_wrkmem = g_try_malloc(LZO1X_1_MEM_COMPRESS);
+		if (!comp->lzo_wrkmem)
+			return SR_ERR_MALLOC;
+	}
+
+	/* Worst case expansion of incompressible data. */
+	job->comp_data = g_try_malloc(LZO_CHUNK_HEADER_SIZE +
+		job->len + job->len / 16 + 64 + 3);
+	if (!job->comp_data)
+		return SR_ERR_MALLOC;
+	wrptr = job->comp_data;
+	memcpy(wrptr, LZO_CHUNK_MAGIC, 4);
+	wrptr += 4;
+	write_u32le_inc(&wrptr, job->len);
+
+	ret = lzo1x_1_compress(job->data, job->len, wrptr, &comp_len,
+		comp->lzo_wrkmem);
+	if (ret != LZO_E_OK) {
+		sr_err("Failed to compress '%s': LZO error %d.",
+			job->entry.name, ret);
+		return SR_ERR;
+	}
+	if (LZO_CHUNK_HEADER_SIZE + comp_len >= job->len) {
+		g_free(job->comp_data);
+		job->comp_data = NULL;
+		job->entry.crc = sr_zip_crc32(job->data, job->len);
+		return SR_OK;
+	}
+
+	/* The member gets stored, its content is the LZO chunk. */
+	name = g_strconcat(job->entry.name, LZO_CHUNK_SUFFIX, NULL);
+	g_free(job->entry.name);
+	job->entry.name = name;
+	job->entry.comp_size = LZO_CHUNK_HEADER_SIZE + comp_len;
+	job->entry.size = job->entry.comp_size;
+	job->entry.crc = sr_zip_crc32(job->comp_data, job->entry.comp_size);
+
+	return SR_OK;
+}
+
+/**
+ * Encode a logic data chunk as value transitions, and rename its member.
+ *
+ * The encoded data replaces the chunk's data for compression. Chunks
+ * which the encoding does not shrink are kept as they are.
+ *
+ * @param[in] job The chunk to encode.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_transitions(struct zip_job *job)
+{
+	const uint8_t *rdptr, *end, *value;
+	uint8_t *wrptr, *limit;
+	size_t unitsize;
+	uint64_t run;
+	char *name;
+
+	unitsize = job->unitsize;
+	if (job->len <= RLE_CHUNK_HEADER_SIZE || job->len % unitsize != 0)
+		return SR_OK;
+
+	/* Give up when the encoding gets as large as the raw data. */
+	job->enc_data = g_try_malloc(job->len);
+	if (!job->enc_data)
+		return SR_ERR_MALLOC;
+	wrptr = job->enc_data;
+	limit = job->enc_data + job->len;
+	memcpy(wrptr, RLE_CHUNK_MAGIC, 4);
+	wrptr += 4;
+	write_u32le_inc(&wrptr, job->len);
+
+	rdptr = job->data;
+	end = job->data + job->len;
+	while (rdptr < end) {
+		value = rdptr;
+		rdptr += unitsize;
+		if (unitsize == 1) {
+			while (rdptr < end && *rdptr == *value)
+				rdptr++;
+		} else {
+			while (rdptr < end && !memcmp(rdptr, value, unitsize))
+				rdptr += unitsize;
+		}
+		if ((size_t)(limit - wrptr) < RLE_RUN_MAX_SIZE + unitsize) {
+			g_free(job->enc_data);
+			job->enc_data = NULL;
+			return SR_OK;
+		}
+		run = (rdptr - value) / unitsize;
+		while (run >= 0x80) {
+			*wrptr++ = (run & 0x7f) | 0x80;
+			run >>= 7;
+		}
+		*wrptr++ = run;
+		memcpy(wrptr, value, unitsize);
+		wrptr += unitsize;
+	}
+
+	name = g_strconcat(job->entry.name, RLE_CHUNK_SUFFIX, NULL);
+	g_free(job->entry.name);
+	job->entry.name = name;
+	job->data = job->enc_data;
+	job->len = wrptr - job->enc_data;
+
+	return SR_OK;
+}
+
+static void zip_compressor_free(struct zip_compressor *comp)
+{
+#ifdef HAVE_ZLIB
+	if (comp->zstrm_init)
+		deflateEnd(&comp->zstrm);
+	comp->zstrm_init = FALSE;
+#endif
+	g_free(comp->lzo_wrkmem);
+	comp->lzo_wrkmem = NULL;
+}
+
+/**
+ * Compress a member's data, or prepare it for being stored.
+ *
+ * The data is deflated when compression is enabled and pays off,
+ * and stored otherwise. Sample data chunks may get LZO compressed
+ * instead, see zip_lzo(). Logic data chunks may get transition
+ * encoded first, see zip_transitions(). Those get deflated or stored.
+ * This runs in worker threads, and only accesses the job and the
+ * calling thread's compression state.
+ *
+ * @param[in] comp Compression state of the calling thread.
+ * @param[in] job The member to compress.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_compress(struct zip_compressor *comp, struct zip_job *job)
+{
+	int ret;
+
+	if (comp->transitions && job->unitsize) {
+		ret = zip_transitions(job);
+		if (ret != SR_OK) {
+			sr_err("Failed to encode '%s'.", job->entry.name);
+			return ret;
+		}
+	}
+
+	job->entry.method = ZIP_METHOD_STORE;
+	job->entry.size = job->len;
+	job->entry.comp_size = job->len;
+	/* Only chunks come in buffers, other members are borrowed. */
+	if (comp->lzo && job->buff && job->len && !job->enc_data)
+		return zip_lzo(comp, job);
+
+	job->entry.crc = sr_zip_crc32(job->data, job->len);
+	if (!job->len || !comp->level)
+		return SR_OK;
+
+#ifdef HAVE_ZLIB
+	ret = zip_deflate(comp, job);
+#else
+	ret = SR_ERR_BUG;
+#endif
+	if (ret != SR_OK) {
+		sr_err("Failed to compress '%s'.", job->entry.name);
+		return ret;
+	}
+	if (job->entry.comp_size < job->len) {
+		job->entry.method = ZIP_METHOD_DEFLATE;
+	} else {
+		g_free(job->comp_data);
+		job->comp_data = NULL;
+		job->entry.comp_size = job->len;
+	}
+
+	return SR_OK;
+}
+
+static int zip_write(struct out_context *outc, const void *buf, size_t len)
+{
+	if (len && fwrite(buf, len, 1, outc->archive) != 1) {
+		sr_err("Failed to write to '%s': %s.",
+			outc->filename, g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	outc->archive_size += len;
+
+	return SR_OK;
+}
+
+/* Get the members written so far onto the disk, to survive a crash. */
+static int zip_sync(struct out_context *outc)
+{
+	int fd;
+
+	if (fflush(outc->archive) != 0)
+		goto err;
+	fd = fileno(outc->archive);
+#if GLIB_CHECK_VERSION(2, 38, 0)
+	if (g_fsync(fd) != 0)
+		goto err;
+#elif !defined(_WIN32)
+	if (fsync(fd) != 0)
+		goto err;
+#else
+	(void)fd;
+#endif
+
+	return SR_OK;
+
+err:
+	sr_err("Failed to flush '%s': %s.", outc->filename, g_strerror(errno));
+	return SR_ERR_IO;
+}
+
+/* Release a job's resources, and keep its chunk buffer for reuse. */
+static void zip_job_free(struct out_context *outc, struct zip_job *job)
+{
+	if (job->buff)
+		outc->spare_buffs = g_slist_prepend(outc->spare_buffs, job->buff);
+	g_free(job->enc_data);
+	g_free(job->comp_data);
+	g_free(job->entry.name);
+	g_free(job);
+}
+
+/**
+ * Write a compressed member to the archive and release the job.
+ *
+ * Members are written with their local header immediately, and only
+ * get recorded in the central directory when the archive is closed.
+ *
+ * @param[in] outc Output module context.
+ * @param[in] job The member to write, which has completed compression.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_commit(struct out_context *outc, struct zip_job *job)
+{
+	uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+	uint8_t extra[ZIP_ALIGN_EXTRA_SIZE + ZIP_DATA_ALIGN], *extra_ptr;
+	size_t name_len, extra_len;
+	int ret;
+
+	ret = job->ret;
+	if (ret == SR_OK && !outc->archive)
+		ret = SR_ERR_BUG;
+	if (ret != SR_OK) {
+		zip_job_free(outc, job);
+		return ret;
+	}
+
+	job->entry.offset = outc->archive_size;
+	job->entry.dos_time = outc->dos_time;
+	job->entry.dos_date = outc->dos_date;
+	name_len = strlen(job->entry.name);
+	extra_len = 0;
+	if (job->entry.method == ZIP_METHOD_STORE) {
+		extra_len = ZIP_ALIGN_EXTRA_SIZE;
+		extra_len += (ZIP_DATA_ALIGN - (outc->archive_size +
+			ZIP_LOCAL_HEADER_SIZE + name_len + extra_len) %
+			ZIP_DATA_ALIGN) % ZIP_DATA_ALIGN;
+		memset(extra, 0, sizeof(extra));
+		extra_ptr = extra;
+		write_u16le_inc(&extra_ptr, ZIP_ALIGN_EXTRA_ID);
+		write_u16le_inc(&extra_ptr, extra_len - 4);
+		write_u16le_inc(&extra_ptr, ZIP_DATA_ALIGN);
+	}
+
+	sr_zip_local_header_write(header, &job->entry, extra_len);
+	ret = zip_write(outc, header, sizeof(header));
+	if (ret == SR_OK)
+		ret = zip_write(outc, job->entry.name, name_len);
+	if (ret == SR_OK && extra_len)
+		ret = zip_write(outc, extra, extra_len);
+	if (ret == SR_OK)
+		ret = zip_write(outc, job->comp_data ? job->comp_data : job->data,
+			job->entry.comp_size);
+	if (ret == SR_OK && outc->journal)
+		ret = zip_sync(outc);
+	if (ret == SR_OK && job->listed) {
+		g_array_append_val(outc->entries, job->entry);
+		job->entry.name = NULL;
+	}
+	zip_job_free(outc, job);
+
+	return ret;
+}
+
+/**
+ * Commit completed jobs in submission order.
+ *
+ * @param[in] outc Output module context.
+ * @param[in] max_pending Wait for jobs until no more than this number
+ *                        of jobs remains in flight.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_commit_jobs(struct out_context *outc, size_t max_pending)
+{
+	struct zip_job *job;
+	gboolean done;
+	int ret;
+
+	ret = SR_OK;
+	while ((job = g_queue_peek_head(&outc->jobs))) {
+		g_mutex_lock(&outc->mutex);
+		if (g_queue_get_length(&outc->jobs) > max_pending) {
+			while (!job->done)
+				g_cond_wait(&outc->cond_done, &outc->mutex);
+		}
+		done = job->done;
+		g_mutex_unlock(&outc->mutex);
+		if (!done)
+			break;
+		g_queue_pop_head(&outc->jobs);
+		if (ret == SR_OK)
+			ret = zip_commit(outc, job);
+		else
+			zip_job_free(outc, job);
+	}
+
+	return ret;
+}
+
+static gpointer zip_worker_thread(gpointer data)
+{
+	struct zip_worker *worker;
+	struct out_context *outc;
+	struct zip_job *job;
+	int ret;
+
+	worker = data;
+	outc = worker->outc;
+
+	g_mutex_lock(&outc->mutex);
+	while (TRUE) {
+		while (g_queue_is_empty(&outc->pending) && !outc->shutdown)
+			g_cond_wait(&outc->cond_pending, &outc->mutex);
+		job = g_queue_pop_head(&outc->pending);
+		if (!job)
+			break;
+		g_mutex_unlock(&outc->mutex);
+
+		ret = zip_compress(&worker->comp, job);
+
+		g_mutex_lock(&outc->mutex);
+		job->ret = ret;
+		job->done = TRUE;
+		g_cond_broadcast(&outc->cond_done);
+	}
+	g_mutex_unlock(&outc->mutex);
+
+	zip_compressor_free(&worker->comp);
+
+	return NULL;
+}
+
+static int zip_workers_start(struct out_context *outc)
+{
+	struct zip_worker *worker;
+	GError *error;
+	size_t i;
+
+	if (!outc->num_workers)
+		return SR_OK;
+
+	/* Bound the memory held by chunks in flight. */
+	outc->max_jobs = 2 * outc->num_workers;
+	outc->workers = g_malloc0(sizeof(*outc->workers) * outc->num_workers);
+	for (i = 0; i < outc->num_workers; i++) {
+		worker = &outc->workers[i];
+		worker->outc = outc;
+		worker->comp.level = outc->comp.level;
+		worker->comp.lzo = outc->comp.lzo;
+		worker->comp.transitions = outc->comp.transitions;
+		error = NULL;
+		worker->thread = g_thread_try_new("sr-srzip", zip_worker_thread,
+			worker, &error);
+		if (!worker->thread) {
+			sr_warn("Cannot create compression thread: %s.",
+				error->message);
+			g_error_free(error);
+			break;
+		}
+	}
+	/* Fall back to compressing in the session thread. */
+	outc->num_workers = i;
+	sr_dbg("Using %zu compression threads.", outc->num_workers);
+
+	return SR_OK;
+}
+
+static void zip_workers_stop(struct out_context *outc)
+{
+	size_t i;
+
+	if (!outc->workers)
+		return;
+
+	g_mutex_lock(&outc->mutex);
+	outc->shutdown = TRUE;
+	g_cond_broadcast(&outc->cond_pending);
+	g_mutex_unlock(&outc->mutex);
+
+	for (i = 0; i < outc->num_workers; i++)
+		g_thread_join(outc->workers[i].thread);
+	g_free(outc->workers);
+	outc->workers = NULL;
+	outc->num_workers = 0;
+}
+
+/**
+ * Submit a member for compression and writing to the archive.
+ *
+ * Members get compressed by the worker threads if there are any, and
+ * immediately otherwise. Either way they are written in the order of
+ * submission.
+ *
+ * @param[in] outc Output module context.
+ * @param[in] name Member name.
+ * @param[in] buff Chunk buffer holding the member data, which the
+ *                 archive writer takes ownership of. NULL when the
+ *                 data is only borrowed for the duration of the call.
+ * @param[in] data Member data.
+ * @param[in] len Member data length in bytes.
+ * @param[in] unitsize Unit size of logic data chunks, 0 for other
+ *                     members.
+ * @param[in] listed Whether the central directory lists the member.
+ *                   Unlisted members only serve the recovery of an
+ *                   incomplete archive.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_submit(struct out_context *outc, const char *name,
+	uint8_t *buff, const uint8_t *data, size_t len, size_t unitsize,
+	gboolean listed)
+{
+	struct zip_job *job;
+
+	job = g_malloc0(sizeof(*job));
+	job->entry.name = g_strdup(name);
+	job->buff = buff;
+	job->unitsize = unitsize;
+	job->listed = listed;
+	job->data = data;
+	job->len = len;
+	if (len >= G_MAXUINT32 || strlen(name) > G_MAXUINT16) {
+		zip_job_free(outc, job);
+		return SR_ERR_ARG;
+	}
+
+	if (!outc->num_workers || !buff) {
+		job->ret = zip_compress(&outc->comp, job);
+		job->done = TRUE;
+		g_queue_push_tail(&outc->jobs, job);
+		return zip_commit_jobs(outc, 0);
+	}
+
+	g_queue_push_tail(&outc->jobs, job);
+	g_mutex_lock(&outc->mutex);
+	g_queue_push_tail(&outc->pending, job);
+	g_cond_signal(&outc->cond_pending);
+	g_mutex_unlock(&outc->mutex);
+
+	return zip_commit_jobs(outc, outc->max_jobs);
+}
+
+/* Get an empty chunk buffer, preferably one which was used before. */
+static uint8_t *zip_buffer_get(struct out_context *outc)
+{
+	uint8_t *buff;
+
+	if (outc->spare_buffs) {
+		buff = outc->spare_buffs->data;
+		outc->spare_buffs = g_slist_delete_link(outc->spare_buffs,
+			outc->spare_buffs);
+		return buff;
+	}
+
+	return g_try_malloc(CHUNK_SIZE);
+}
+
+/**
+ * Write the srzip archive's central directory and close the file.
+ *
+ * Member offsets beyond 4GiB and more than 65535 members are covered
+ * by ZIP64 extensions, which libzip handles when reading the file.
+ *
+ * @param[in] outc Output module context.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_close_archive(struct out_context *outc)
+{
+	GByteArray *cd;
+	uint64_t cd_offset;
+	guint i;
+	int ret;
+
+	cd = g_byte_array_new();
+	cd_offset = outc->archive_size;
+	for (i = 0; i < outc->entries->len; i++) {
+		sr_zip_cd_entry_append(cd,
+			&g_array_index(outc->entries, struct sr_zip_entry, i));
+	}
+	sr_zip_cd_end_append(cd, outc->entries->len, cd_offset, cd->len);
+	ret = zip_write(outc, cd->data, cd->len);
+	g_byte_array_free(cd, TRUE);
+
+	if (fclose(outc->archive) != 0 && ret == SR_OK) {
+		sr_err("Failed to close '%s': %s.",
+			outc->filename, g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+	outc->archive = NULL;
+
+	return ret;
+}
+
+static struct summary *summary_new(const char *name, size_t unitsize)
+{
+	struct summary *sm;
+
+	sm = g_malloc0(sizeof(*sm));
+	sm->name = g_strconcat(name, SUMMARY_SUFFIX, NULL);
+	sm->unitsize = unitsize;
+	sm->block_size = unitsize ? 2 * unitsize : 2 * sizeof(float);
+	sm->blocks = g_byte_array_new();
+	sm->prev = g_malloc0(unitsize + 1);
+
+	return sm;
+}
+
+static void summary_free(struct summary *sm)
+{
+	if (!sm)
+		return;
+	g_free(sm->name);
+	g_byte_array_free(sm->blocks, TRUE);
+	g_free(sm->prev);
+	g_free(sm);
+}
+
+/* Get the block of the finest level for the next sample. */
+static uint8_t *summary_block(struct summary *sm, gboolean *is_new)
+{
+	*is_new = !(sm->num_samples % (1 << SUMMARY_BLOCK_SHIFT));
+	if (*is_new)
+		g_byte_array_set_size(sm->blocks, sm->blocks->len + sm->block_size);
+
+	return sm->blocks->data + sm->blocks->len - sm->block_size;
+}
+
+/* Add logic data to a summary, in complete units. */
+static void summary_add_logic(struct summary *sm,
+	const uint8_t *data, size_t len)
+{
+	uint8_t *edges, acc;
+	size_t unitsize, count, n, i, j;
+	gboolean is_new;
+
+	unitsize = sm->unitsize;
+	count = len / unitsize;
+	while (count) {
+		edges = summary_block(sm, &is_new);
+		if (is_new) {
+			memset(edges, 0, unitsize);
+			memcpy(edges + unitsize, data, unitsize);
+		}
+		n = (1 << SUMMARY_BLOCK_SHIFT) -
+			(sm->num_samples % (1 << SUMMARY_BLOCK_SHIFT));
+		n = MIN(n, count);
+
+		if (sm->num_samples) {
+			for (j = 0; j < unitsize; j++)
+				edges[j] |= data[j] ^ sm->prev[j];
+		}
+		if (unitsize == 1) {
+			acc = 0;
+			for (i = 1; i < n; i++)
+				acc |= data[i] ^ data[i - 1];
+			edges[0] |= acc;
+		} else {
+			for (i = unitsize; i < n * unitsize; i += unitsize) {
+				for (j = 0; j < unitsize; j++)
+					edges[j] |= data[i + j] ^ data[i + j - unitsize];
+			}
+		}
+		memcpy(sm->prev, data + (n - 1) * unitsize, unitsize);
+
+		data += n * unitsize;
+		count -= n;
+		sm->num_samples += n;
+	}
+}
+
+/* Add analog data to a summary. */
+static void summary_add_analog(struct summary *sm,
+	const float *values, size_t count)
+{
+	float *minmax;
+	gboolean is_new;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		minmax = (float *)summary_block(sm, &is_new);
+		if (is_new) {
+			minmax[0] = minmax[1] = values[i];
+		} else {
+			minmax[0] = MIN(minmax[0], values[i]);
+			minmax[1] = MAX(minmax[1], values[i]);
+		}
+		sm->num_samples++;
+	}
+}
+
+/*
+ * Write a summary to the archive. The coarser levels get built from
+ * the finest one here, each of their blocks covers a group of blocks
+ * of the previous level.
+ */
+static int summary_write(struct out_context *outc, struct summary *sm)
+{
+	GByteArray *buf;
+	uint8_t header[SUMMARY_HEADER_SIZE], *wrptr;
+	const uint8_t *src;
+	uint8_t *dst;
+	float *minmax;
+	const float *child;
+	size_t level_len, next_len, group, i, j, k;
+	uint32_t num_levels;
+	guint level_start;
+	int ret;
+
+	if (!sm || !sm->num_samples)
+		return SR_OK;
+
+	buf = g_byte_array_new();
+	g_byte_array_set_size(buf, SUMMARY_HEADER_SIZE);
+	g_byte_array_append(buf, sm->blocks->data, sm->blocks->len);
+	level_start = SUMMARY_HEADER_SIZE;
+	level_len = sm->blocks->len / sm->block_size;
+	num_levels = 1;
+	group = 1 << SUMMARY_LEVEL_SHIFT;
+	while (level_len > 1) {
+		next_len = (level_len + group - 1) / group;
+		g_byte_array_set_size(buf, buf->len + next_len * sm->block_size);
+		for (i = 0; i < next_len; i++) {
+			src = buf->data + level_start + i * group * sm->block_size;
+			dst = buf->data + level_start +
+				(level_len + i) * sm->block_size;
+			memcpy(dst, src, sm->block_size);
+			for (j = 1; j < group && i * group + j < level_len; j++) {
+				src += sm->block_size;
+				if (sm->unitsize) {
+					for (k = 0; k < sm->unitsize; k++)
+						dst[k] |= src[k];
+				} else {
+					minmax = (float *)dst;
+					child = (const float *)src;
+					minmax[0] = MIN(minmax[0], child[0]);
+					minmax[1] = MAX(minmax[1], child[1]);
+				}
+			}
+		}
+		level_start += level_len * sm->block_size;
+		level_len = next_len;
+		num_levels++;
+	}
+
+	wrptr = header;
+	memcpy(wrptr, SUMMARY_MAGIC, 4);
+	wrptr += 4;
+	write_u8_inc(&wrptr, SUMMARY_BLOCK_SHIFT);
+	write_u8_inc(&wrptr, SUMMARY_LEVEL_SHIFT);
+	write_u16le_inc(&wrptr, sm->unitsize);
+	write_u64le_inc(&wrptr, sm->num_samples);
+	write_u32le_inc(&wrptr, num_levels);
+	memcpy(buf->data, header, sizeof(header));
+
+	ret = zip_submit(outc, sm->name, NULL, buf->data, buf->len, 0, TRUE);
+	if (ret != SR_OK)
+		sr_err("Failed to add summary '%s'.", sm->name);
+	g_byte_array_free(buf, TRUE);
+
+	return ret;
+}
+
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
 	struct sr_channel *ch;
 	size_t ch_nr;
 	size_t alloc_size;
 	GVariant *gvar;
 	GKeyFile *meta;
+	GDateTime *now;
 	GSList *l;
 	const char *devgroup;
-	char *s, *metabuf;
-	gsize metalen;
+	char *s;
 	guint logic_channels, enabled_logic_channels;
 	guint enabled_analog_channels;
 	guint index;
+	const char *version;
+	char *metabuf;
+	gsize metalen;
+	int ret;
 
 	outc = o->priv;
 
@@ -94,24 +1056,47 @@ static int zip_create(const struct sr_output *o)
 		g_variant_unref(gvar);
 	}
 
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	g_unlink(outc->filename);
-	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
-	if (!zipfile)
-		return SR_ERR;
+	outc->archive = g_fopen(outc->filename, "wb");
+	if (!outc->archive) {
+		sr_err("Failed to create '%s': %s.",
+			outc->filename, g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	outc->archive_size = 0;
+	outc->entries = g_array_new(FALSE, FALSE, sizeof(struct sr_zip_entry));
+	if ((ret = zip_workers_start(outc)) != SR_OK)
+		return ret;
+
+	/* All members share the archive's creation time, in DOS format. */
+	now = g_date_time_new_now_local();
+	outc->dos_time = g_date_time_get_hour(now) << 11;
+	outc->dos_time |= g_date_time_get_minute(now) << 5;
+	outc->dos_time |= g_date_time_get_second(now) / 2;
+	outc->dos_date = MAX(g_date_time_get_year(now) - 1980, 0) << 9;
+	outc->dos_date |= g_date_time_get_month(now) << 5;
+	outc->dos_date |= g_date_time_get_day_of_month(now);
+	g_date_time_unref(now);
 
 	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
-	if (zip_file_add(zipfile, "version", versrc, 0) < 0) {
-		sr_err("Error saving version into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(versrc);
-		zip_discard(zipfile);
-		return SR_ERR;
+	if (outc->comp.transitions)
+		version = "4";
+	else if (outc->comp.lzo)
+		version = "3";
+	else
+		version = "2";
+	ret = zip_submit(outc, "version", NULL, (const uint8_t *)version, 1, 0,
+		TRUE);
+	if (ret != SR_OK) {
+		sr_err("Error saving version into zipfile.");
+		return ret;
 	}
 
-	/* init "metadata" */
+	/*
+	 * init "metadata", it gets completed and written when the
+	 * archive is closed
+	 */
 	meta = g_key_file_new();
+	outc->meta = meta;
 
 	g_key_file_set_string(meta, "global", "sigrok version",
 			sr_package_version_string_get());
@@ -160,6 +1145,8 @@ static int zip_create(const struct sr_output *o)
 	outc->analog_ch_count = enabled_analog_channels;
 	alloc_size = sizeof(gint) * outc->analog_ch_count + 1;
 	outc->analog_index_map = g_malloc0(alloc_size);
+	alloc_size = sizeof(size_t) * outc->analog_ch_count + 1;
+	outc->analog_chunk_num = g_malloc0(alloc_size);
 
 	index = 0;
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -194,7 +1181,7 @@ static int zip_create(const struct sr_output *o)
 	 * type widths.
 	 *
 	 * These buffers are intended to reduce the number of ZIP
-	 * archive update calls, and decouple the srzip output module
+	 * archive members, and decouple the srzip output module
 	 * from implementation details in other acquisition device
 	 * drivers and input modules.
 	 *
@@ -227,161 +1214,143 @@ static int zip_create(const struct sr_output *o)
 		outc->analog_buff[index].fill_size = 0;
 	}
 
-	metabuf = g_key_file_to_data(meta, &metalen, NULL);
-	g_key_file_free(meta);
-
-	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_file_add(zipfile, "metadata", metasrc, 0) < 0) {
-		sr_err("Error saving metadata into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(metasrc);
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
+	if (outc->summaries) {
+		if (enabled_logic_channels > 0) {
+			outc->logic_summary = summary_new("logic-1",
+				outc->logic_buff.zip_unit_size);
+		}
+		outc->analog_summaries = g_malloc0(sizeof(struct summary *) *
+			(outc->analog_ch_count + 1));
+		for (index = 0; index < outc->analog_ch_count; index++) {
+			s = g_strdup_printf("analog-1-%zu",
+				outc->first_analog_index + index);
+			outc->analog_summaries[index] = summary_new(s, 0);
+			g_free(s);
+		}
 	}
 
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
+	/*
+	 * In journal mode, a copy of the metadata goes into the archive
+	 * right away, so sr_session_file_recover() can turn what was
+	 * written before a crash into a readable session file. The copy
+	 * is left out of the central directory, which lists the final
+	 * metadata instead.
+	 */
+	if (outc->journal) {
+		if (enabled_logic_channels > 0) {
+			g_key_file_set_integer(meta, devgroup, "unitsize",
+				outc->logic_buff.zip_unit_size);
+		}
+		metabuf = g_key_file_to_data(meta, &metalen, NULL);
+		g_key_file_remove_key(meta, devgroup, "unitsize", NULL);
+		ret = zip_submit(outc, "metadata", NULL,
+			(const uint8_t *)metabuf, metalen, 0, FALSE);
 		g_free(metabuf);
-		return SR_ERR;
+		if (ret != SR_OK) {
+			sr_err("Error saving metadata into zipfile.");
+			return ret;
+		}
 	}
-	g_free(metabuf);
 
 	return SR_OK;
 }
 
 /**
- * Append a block of logic data to an srzip archive.
+ * Complete the metadata and close the srzip archive.
  *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Byte sequence length (in bytes, not samples).
  *
  * @returns SR_OK et al error codes.
  */
-static int zip_append(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length)
+static int zip_finish(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
 	char *metabuf;
 	gsize metalen;
-	char *chunkname;
-	unsigned int next_chunk_num;
-
-	if (!length)
-		return SR_OK;
+	size_t idx;
+	int ret;
 
 	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
 
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
+	ret = summary_write(outc, outc->logic_summary);
+	for (idx = 0; ret == SR_OK && outc->analog_summaries &&
+			idx < outc->analog_ch_count; idx++)
+		ret = summary_write(outc, outc->analog_summaries[idx]);
+	if (ret != SR_OK) {
+		zip_workers_stop(outc);
+		fclose(outc->archive);
+		outc->archive = NULL;
+		return ret;
 	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
+
+	/* Files without any logic chunk don't carry a unitsize. */
+	if (outc->logic_chunk_num) {
+		g_key_file_set_integer(outc->meta, "device 1", "unitsize",
+			outc->logic_buff.zip_unit_size);
+	}
+	metabuf = g_key_file_to_data(outc->meta, &metalen, NULL);
+	ret = zip_submit(outc, "metadata", NULL,
+		(const uint8_t *)metabuf, metalen, 0, TRUE);
+	g_free(metabuf);
+	zip_workers_stop(outc);
+	if (ret != SR_OK) {
+		sr_err("Error saving metadata into zipfile.");
+		fclose(outc->archive);
+		outc->archive = NULL;
+		return ret;
 	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
-		}
-		g_clear_error(&error);
 
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
+	return zip_close_archive(outc);
+}
 
-		if (zip_file_replace(archive, zs.index, metasrc, 0) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
-		}
-	}
-	g_key_file_free(kf);
+/**
+ * Append the queued block of logic data to an srzip archive.
+ *
+ * The logic buffer is handed over to the archive writer, and gets
+ * replaced by an empty one.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] unitsize Logic data unit size (bytes per sample).
+ * @param[in] length Byte sequence length (in bytes, not samples).
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append(const struct sr_output *o,
+	size_t unitsize, size_t length)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	char *chunkname;
+	int ret;
 
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_file_rename(archive, i, "logic-1-1", 0) < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
-			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
-	}
+	if (!length)
+		return SR_OK;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
 
 	if (length % unitsize != 0) {
 		sr_warn("Chunk size %zu not a multiple of the"
 			" unit size %zu.", length, unitsize);
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_file_add(archive, chunkname, logicsrc, 0);
+	if (outc->logic_summary)
+		summary_add_logic(outc->logic_summary, buff->samples, length);
+	chunkname = g_strdup_printf("logic-1-%zu", outc->logic_chunk_num + 1);
+	ret = zip_submit(outc, chunkname, buff->samples, buff->samples, length,
+		unitsize, TRUE);
+	if (ret != SR_OK)
+		sr_err("Failed to add chunk '%s'.", chunkname);
+	else
+		outc->logic_chunk_num++;
 	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	g_free(metabuf);
 
-	return SR_OK;
+	buff->samples = zip_buffer_get(outc);
+	if (!buff->samples && ret == SR_OK)
+		ret = SR_ERR_MALLOC;
+
+	return ret;
 }
 
 /**
@@ -479,7 +1448,7 @@ static int zip_append_queue(const struct sr_output *o,
 			remain -= copy_count;
 		}
 		if (send_count && !remain) {
-			ret = zip_append(o, buff->samples, buff->zip_unit_size,
+			ret = zip_append(o, buff->zip_unit_size,
 				buff->fill_size * buff->zip_unit_size);
 			if (ret != SR_OK)
 				return ret;
@@ -489,7 +1458,7 @@ static int zip_append_queue(const struct sr_output *o,
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append(o, buff->samples, buff->zip_unit_size,
+		ret = zip_append(o, buff->zip_unit_size,
 			buff->fill_size * buff->zip_unit_size);
 		if (ret != SR_OK)
 			return ret;
@@ -500,80 +1469,49 @@ static int zip_append_queue(const struct sr_output *o,
 }
 
 /**
- * Append analog data of a channel to an srzip archive.
+ * Append the queued analog data of a channel to an srzip archive.
+ *
+ * The channel's buffer is handed over to the archive writer, and gets
+ * replaced by an empty one.
  *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
  * @param[in] count Number of samples (float items, not bytes).
- * @param[in] ch_nr 1-based channel number.
+ * @param[in] idx 0-based index of the enabled analog channel.
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+	size_t count, size_t idx)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	size_t size;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
+	struct analog_buff *buff;
+	uint8_t *data;
 	char *chunkname;
-	unsigned int next_chunk_num;
+	int ret;
 
 	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
 
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
-	}
-
-	basename = g_strdup_printf("analog-1-%zu", ch_nr);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
-	}
-
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_file_add(archive, chunkname, analogsrc, 0);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		g_free(basename);
-		zip_source_free(analogsrc);
-		zip_discard(archive);
-		return SR_ERR;
-	}
+	if (outc->analog_summaries)
+		summary_add_analog(outc->analog_summaries[idx], buff->samples, count);
+	data = (uint8_t *)buff->samples;
+	chunkname = g_strdup_printf("analog-1-%zu-%zu",
+		outc->first_analog_index + idx, outc->analog_chunk_num[idx] + 1);
+	ret = zip_submit(outc, chunkname, data, data,
+		sizeof(buff->samples[0]) * count, 0, TRUE);
+	if (ret != SR_OK)
+		sr_err("Failed to add chunk '%s'.", chunkname);
+	else
+		outc->analog_chunk_num[idx]++;
 	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		g_free(basename);
-		zip_discard(archive);
-		return SR_ERR;
-	}
 
-	g_free(basename);
+	buff->samples = (float *)zip_buffer_get(outc);
+	if (!buff->samples && ret == SR_OK)
+		ret = SR_ERR_MALLOC;
 
-	return SR_OK;
+	return ret;
 }
 
 /**
@@ -590,7 +1528,7 @@ static int zip_append_analog_queue(const struct sr_output *o,
 {
 	struct out_context *outc;
 	const struct sr_channel *ch;
-	size_t idx, nr;
+	size_t idx;
 	struct analog_buff *buff;
 	float *values, *wrptr, *rdptr;
 	size_t send_size, remain, copy_size;
@@ -601,12 +1539,10 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	/* Is this the DF_END flush call without samples submission? */
 	if (!analog && flush) {
 		for (idx = 0; idx < outc->analog_ch_count; idx++) {
-			nr = outc->first_analog_index + idx;
 			buff = &outc->analog_buff[idx];
 			if (!buff->fill_size)
 				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff->fill_size, idx);
 			if (ret != SR_OK)
 				return ret;
 			buff->fill_size = 0;
@@ -627,7 +1563,6 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	}
 	if (idx == outc->analog_ch_count)
 		return SR_ERR_ARG;
-	nr = outc->first_analog_index + idx;
 	buff = &outc->analog_buff[idx];
 
 	/* Convert the analog data to an array of float values. */
@@ -658,8 +1593,7 @@ static int zip_append_analog_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff->fill_size, idx);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
@@ -672,7 +1606,7 @@ static int zip_append_analog_queue(const struct sr_output *o,
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+		ret = zip_append_analog(o, buff->fill_size, idx);
 		if (ret != SR_OK)
 			return ret;
 		buff->fill_size = 0;
@@ -712,6 +1646,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
+		if (!outc->archive) {
+			sr_err("Session file was already completed.");
+			return SR_ERR;
+		}
 		logic = packet->payload;
 		ret = zip_append_queue(o,
 			logic->data, logic->unitsize, logic->length,
@@ -725,19 +1663,26 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
+		if (!outc->archive) {
+			sr_err("Session file was already completed.");
+			return SR_ERR;
+		}
 		analog = packet->payload;
 		ret = zip_append_analog_queue(o, analog, FALSE);
 		if (ret != SR_OK)
 			return ret;
 		break;
 	case SR_DF_END:
-		if (outc->zip_created) {
+		if (outc->archive) {
 			ret = zip_append_queue(o, NULL, 0, 0, TRUE);
 			if (ret != SR_OK)
 				return ret;
 			ret = zip_append_analog_queue(o, NULL, TRUE);
 			if (ret != SR_OK)
 				return ret;
+			ret = zip_finish(o);
+			if (ret != SR_OK)
+				return ret;
 		}
 		break;
 	}
@@ -746,27 +1691,81 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"compression", "Compression", "Compression method of the sample data: deflate is smallest, lzo is fastest to write, store is fastest to replay", NULL, NULL},
+	{"level", "Compression level", "Deflate compression level, 1 (fastest) to 9 (smallest)", NULL, NULL},
+	{"threads", "Compression threads", "Number of background compression threads, 0 compresses while receiving data", NULL, NULL},
+	{"transitions", "Store transitions", "Store logic data as value transitions, which suits mostly idle signals", NULL, NULL},
+	{"summaries", "Store summaries", "Store multi-resolution summaries for zoomed out views and edge searches", NULL, NULL},
+	{"journal", "Journal mode", "Flush every chunk to the disk, so the file can be recovered after a crash", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	GSList *l = NULL;
+	guint threads;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string("deflate"));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("deflate")));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("store")));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("lzo")));
+		options[0].values = l;
+		options[1].def = g_variant_ref_sink(g_variant_new_uint32(6));
+		/* Leave a processor for acquisition and the session thread. */
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		threads = g_get_num_processors();
+#else
+		threads = 2;
+#endif
+		threads = CLAMP(threads - 1, 1, 8);
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(threads));
+		options[3].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+		options[4].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+		options[5].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+	}
+
 	return options;
 }
 
 static int cleanup(struct sr_output *o)
 {
 	struct out_context *outc;
+	struct zip_job *job;
 	size_t idx;
 
 	outc = o->priv;
 
+	/* Keep what was captured when the session ended without SR_DF_END. */
+	if (outc->archive) {
+		zip_append_queue(o, NULL, 0, 0, TRUE);
+		zip_append_analog_queue(o, NULL, TRUE);
+		zip_finish(o);
+	}
+	zip_workers_stop(outc);
+	while ((job = g_queue_pop_head(&outc->jobs)))
+		zip_job_free(outc, job);
+	g_slist_free_full(outc->spare_buffs, g_free);
+	zip_compressor_free(&outc->comp);
+	g_cond_clear(&outc->cond_done);
+	g_cond_clear(&outc->cond_pending);
+	g_mutex_clear(&outc->mutex);
+	sr_zip_entries_free(outc->entries);
+	if (outc->meta)
+		g_key_file_free(outc->meta);
 	g_free(outc->analog_index_map);
+	g_free(outc->analog_chunk_num);
 	g_free(outc->filename);
 	g_free(outc->logic_buff.samples);
 	for (idx = 0; idx < outc->analog_ch_count; idx++)
 		g_free(outc->analog_buff[idx].samples);
 	g_free(outc->analog_buff);
+	summary_free(outc->logic_summary);
+	if (outc->analog_summaries) {
+		for (idx = 0; idx < outc->analog_ch_count; idx++)
+			summary_free(outc->analog_summaries[idx]);
+		g_free(outc->analog_summaries);
+	}
 
 	g_free(outc);
 	o->priv = NULL;
@@ -143,6 +143,9 @@ SR_PRIV int sr_scpi_read_response(struct sr_scpi_dev_inst *scpi,
 			GString *response, gint64 abs_timeout_us);
 SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 			const char *command, char **scpi_response);
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			const char *const *commands, size_t count,
+			char **scpi_responses);
 SR_PRIV int sr_scpi_get_bool(struct sr_scpi_dev_inst *scpi,
 			const char *command, gboolean *scpi_response);
 SR_PRIV int sr_scpi_get_int(struct sr_scpi_dev_inst *scpi,
@@ -177,6 +180,11 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 		const struct scpi_command *cmdtable,
 		int channel_command, const char *channel_name,
 		GVariant **gvar, const GVariantType *gvtype, int command, ...);
+SR_PRIV int sr_scpi_cmd_resp_many(const struct sr_dev_inst *sdi,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		GVariant **gvars, const GVariantType *const *gvtypes,
+		const int *commands, size_t count);
 
 /*--- GPIB only functions ---------------------------------------------------*/
 
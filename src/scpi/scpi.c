@@ -609,27 +609,16 @@ SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi)
 	g_free(scpi);
 }
 
-/**
- * Send a SCPI command, receive the reply and store the reply in scpi_response.
- *
- * Callers must free the allocated memory regardless of the routine's
- * return code. See @ref g_free().
- *
- * @param[in] scpi Previously initialised SCPI device structure.
- * @param[in] command The SCPI command to send to the device (can be NULL).
- * @param[out] scpi_response Pointer where to store the SCPI response.
- *
- * @return SR_OK on success, SR_ERR* on failure.
- */
-SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
-			       const char *command, char **scpi_response)
+/* Like sr_scpi_get_string(), without mutex. */
+static int scpi_get_string(struct sr_scpi_dev_inst *scpi,
+			   const char *command, char **scpi_response)
 {
 	GString *response;
 
 	*scpi_response = NULL;
 
 	response = g_string_sized_new(1024);
-	if (sr_scpi_get_data(scpi, command, &response) != SR_OK) {
+	if (scpi_get_data(scpi, command, &response) != SR_OK) {
 		if (response)
 			g_string_free(response, TRUE);
 		return SR_ERR;
@@ -651,6 +640,128 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 	return SR_OK;
 }
 
+/**
+ * Send a SCPI command, receive the reply and store the reply in scpi_response.
+ *
+ * Callers must free the allocated memory regardless of the routine's
+ * return code. See @ref g_free().
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The SCPI command to send to the device (can be NULL).
+ * @param[out] scpi_response Pointer where to store the SCPI response.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
+			       const char *command, char **scpi_response)
+{
+	int ret;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_get_string(scpi, command, scpi_response);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
+/* Like sr_scpi_get_strings(), without mutex. */
+static int scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			    const char *const *commands, size_t count,
+			    char **scpi_responses)
+{
+	GString *cmd;
+	char *response, *p, *start;
+	gboolean quoted, complete;
+	size_t i, n;
+	int ret;
+
+	for (i = 0; i < count; i++)
+		scpi_responses[i] = NULL;
+	if (!count)
+		return SR_OK;
+
+	cmd = g_string_sized_new(256);
+	for (i = 0; i < count; i++) {
+		if (i)
+			g_string_append_c(cmd, ';');
+		if (i && commands[i][0] != ':')
+			g_string_append_c(cmd, ':');
+		g_string_append(cmd, commands[i]);
+	}
+	ret = scpi_get_string(scpi, cmd->str, &response);
+	g_string_free(cmd, TRUE);
+
+	if (ret == SR_OK) {
+		/* Split at semicolons which are not within quotes. */
+		n = 0;
+		quoted = FALSE;
+		start = response;
+		for (p = response; ; p++) {
+			if (*p == '"')
+				quoted = !quoted;
+			if (*p && (*p != ';' || quoted))
+				continue;
+			if (n == count)
+				break;
+			scpi_responses[n++] = g_strndup(start, p - start);
+			start = p + 1;
+			if (!*p)
+				break;
+		}
+		/* All replies, and nothing left over. */
+		complete = n == count && !*p;
+		g_free(response);
+		if (complete)
+			return SR_OK;
+		sr_dbg("Compound query got %zu of %zu replies.", n, count);
+	}
+
+	/* Fall back to individual queries. */
+	for (i = 0; i < count; i++) {
+		g_free(scpi_responses[i]);
+		scpi_responses[i] = NULL;
+	}
+	for (i = 0; i < count; i++) {
+		ret = scpi_get_string(scpi, commands[i], &scpi_responses[i]);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send several SCPI queries as one compound command, and split the reply.
+ *
+ * The queries get joined by semicolons (each as a root level command),
+ * so that the device answers all of them in a single round-trip. If the
+ * device doesn't return the expected number of replies, the queries are
+ * sent one by one instead.
+ *
+ * Callers must g_free() all responses regardless of the routine's
+ * return code.
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] commands The SCPI queries to send.
+ * @param[in] count The number of queries.
+ * @param[out] scpi_responses Array of count pointers where to store the
+ *             responses.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_get_strings(struct sr_scpi_dev_inst *scpi,
+			const char *const *commands, size_t count,
+			char **scpi_responses)
+{
+	int ret;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_get_strings(scpi, commands, count, scpi_responses);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
 /**
  * Do a non-blocking read of up to the allocated length, and
  * check if a timeout has occured.
@@ -1334,6 +1445,31 @@ SR_PRIV int sr_scpi_cmd(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+/* Convert a reply to a value of the given type. */
+static int scpi_resp_convert(const char *s, const GVariantType *gvtype,
+		GVariant **gvar)
+{
+	gboolean b;
+	double d;
+	int ret;
+
+	ret = SR_OK;
+	if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_BOOLEAN)) {
+		if ((ret = parse_strict_bool(s, &b)) == SR_OK)
+			*gvar = g_variant_new_boolean(b);
+	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_DOUBLE)) {
+		if ((ret = sr_atod_ascii(s, &d)) == SR_OK)
+			*gvar = g_variant_new_double(d);
+	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_STRING)) {
+		*gvar = g_variant_new_string(s);
+	} else {
+		sr_err("Unable to convert to desired GVariant type.");
+		ret = SR_ERR_NA;
+	}
+
+	return ret;
+}
+
 SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 		const struct scpi_command *cmdtable,
 		int channel_command, const char *channel_name,
@@ -1345,8 +1481,6 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 	const char *cmd;
 	GString *response;
 	char *s;
-	gboolean b;
-	double d;
 	int ret;
 
 	scpi = sdi->conn;
@@ -1399,21 +1533,90 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 
 	s = g_string_free(response, FALSE);
 
+	ret = scpi_resp_convert(s, gvtype, gvar);
+
+	g_free(s);
+
+	return ret;
+}
+
+/**
+ * Send several queries from a command table as one compound command,
+ * and convert the replies.
+ *
+ * All queries go to the same channel, which gets selected first. See
+ * sr_scpi_get_strings() for how the reply is split up, and for the
+ * fallback to individual queries.
+ *
+ * @param[in] sdi The device instance.
+ * @param[in] cmdtable The device's command table.
+ * @param[in] channel_command The command which selects a channel.
+ * @param[in] channel_name The channel to select, or NULL.
+ * @param[out] gvars Array of count pointers which receive the values.
+ *             Values of replies which can't be converted are NULL.
+ * @param[in] gvtypes The types to convert the replies to.
+ * @param[in] commands The query commands.
+ * @param[in] count The number of queries.
+ *
+ * @retval SR_OK The queries were answered.
+ * @retval SR_ERR_NA The device does not implement one of the commands,
+ *         or one of them takes arguments.
+ * @retval other Communication error, all values are NULL.
+ */
+SR_PRIV int sr_scpi_cmd_resp_many(const struct sr_dev_inst *sdi,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		GVariant **gvars, const GVariantType *const *gvtypes,
+		const int *commands, size_t count)
+{
+	struct sr_scpi_dev_inst *scpi;
+	const char *channel_cmd;
+	const char **cmds;
+	char **responses;
+	size_t i;
+	int ret;
+
+	scpi = sdi->conn;
+
+	for (i = 0; i < count; i++)
+		gvars[i] = NULL;
+
+	cmds = g_malloc0(count * sizeof(*cmds));
+	for (i = 0; i < count; i++) {
+		cmds[i] = sr_scpi_cmd_get(cmdtable, commands[i]);
+		/* Compound queries can't pass arguments. */
+		if (!cmds[i] || strchr(cmds[i], '%')) {
+			g_free(cmds);
+			return SR_ERR_NA;
+		}
+	}
+	responses = g_malloc0(count * sizeof(*responses));
+
+	g_mutex_lock(&scpi->scpi_mutex);
+
+	/* Select channel. */
 	ret = SR_OK;
-	if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_BOOLEAN)) {
-		if ((ret = parse_strict_bool(s, &b)) == SR_OK)
-			*gvar = g_variant_new_boolean(b);
-	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_DOUBLE)) {
-		if ((ret = sr_atod_ascii(s, &d)) == SR_OK)
-			*gvar = g_variant_new_double(d);
-	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_STRING)) {
-		*gvar = g_variant_new_string(s);
-	} else {
-		sr_err("Unable to convert to desired GVariant type.");
-		ret = SR_ERR_NA;
+	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
+	if (channel_cmd && channel_name &&
+			g_strcmp0(channel_name, scpi->actual_channel_name)) {
+		sr_spew("sr_scpi_cmd_resp_many(): new channel = %s", channel_name);
+		g_free(scpi->actual_channel_name);
+		scpi->actual_channel_name = g_strdup(channel_name);
+		ret = scpi_send(scpi, channel_cmd, channel_name);
 	}
 
-	g_free(s);
+	if (ret == SR_OK)
+		ret = scpi_get_strings(scpi, cmds, count, responses);
+
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	for (i = 0; i < count; i++) {
+		if (ret == SR_OK && responses[i])
+			scpi_resp_convert(responses[i], gvtypes[i], &gvars[i]);
+		g_free(responses[i]);
+	}
+	g_free(responses);
+	g_free(cmds);
 
 	return ret;
 }
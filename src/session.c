@@ -51,6 +51,411 @@ struct datafeed_callback {
 	void *cb_data;
 };
 
+/*
+ * Sample buffers which packet copies reference instead of holding a
+ * copy of the sample data, keyed by the copies' logic or analog
+ * payloads. Keeping them here instead of in the copies themselves
+ * lets sr_packet_free() find them without accessing memory beyond
+ * the packet and payload structs it was given.
+ */
+static GMutex retained_mutex;
+static GHashTable *retained_buffers;
+
+/** A packet which waits on the datafeed queue, and the sending device. */
+struct datafeed_queue_item {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+};
+
+/**
+ * Bounded queue between sr_session_send() and a consumer thread.
+ *
+ * Drivers put (copies of) packets on the queue and immediately return
+ * to their acquisition, while a single consumer thread runs transforms
+ * and datafeed callbacks in the order in which packets were sent.
+ */
+struct sr_datafeed_queue {
+	/* Configuration, immutable while the session is running. */
+	size_t depth;
+	int policy;
+
+	/* Everything below is protected by the mutex. */
+	GMutex mutex;
+	GCond cond_not_empty;
+	GCond cond_not_full;
+	GQueue items;
+	GThread *thread;
+	gboolean consuming;
+	gboolean shutdown;
+	struct sr_datafeed_queue_stats stats;
+};
+
+/**
+ * Instrumentation counters of one device, which only a single thread
+ * updates. Readers sum up the blocks of all threads. Counters get
+ * updated and read with relaxed atomic operations, which are as cheap
+ * as plain accesses, so that the datafeed path takes no locks.
+ */
+struct stats_block {
+	const struct sr_dev_inst *sdi;
+	GThread *thread;
+	struct sr_session_stats stats;
+};
+
+/** Per-thread cache of the most recently used counters. */
+struct stats_cache {
+	guint session_id;
+	const struct sr_dev_inst *sdi;
+	struct stats_block *block;
+};
+
+static GPrivate stats_cache_key = G_PRIVATE_INIT(g_free);
+static gint stats_session_id;
+
+static int datafeed_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+
+/* Remember the buffer which a packet copy's payload references. */
+static void retained_buffer_add(const void *payload, struct sr_buffer *buf)
+{
+	g_mutex_lock(&retained_mutex);
+	if (!retained_buffers)
+		retained_buffers = g_hash_table_new(g_direct_hash,
+			g_direct_equal);
+	g_hash_table_insert(retained_buffers, (gpointer)payload, buf);
+	g_mutex_unlock(&retained_mutex);
+}
+
+/*
+ * Get the buffer which a packet copy's payload references, NULL if
+ * the payload holds its own copy of the data. Optionally forget it.
+ */
+static struct sr_buffer *retained_buffer_get(const void *payload,
+		gboolean remove)
+{
+	struct sr_buffer *buf;
+
+	buf = NULL;
+	g_mutex_lock(&retained_mutex);
+	if (retained_buffers && payload)
+		buf = g_hash_table_lookup(retained_buffers, payload);
+	if (buf && remove) {
+		g_hash_table_remove(retained_buffers, payload);
+		if (!g_hash_table_size(retained_buffers)) {
+			g_hash_table_destroy(retained_buffers);
+			retained_buffers = NULL;
+		}
+	}
+	g_mutex_unlock(&retained_mutex);
+
+	return buf;
+}
+
+/* Get the calling thread's counters for a device in a session. */
+static struct stats_block *stats_local_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	struct stats_cache *cache;
+	struct stats_block *block;
+	GThread *self;
+	GSList *l;
+
+	cache = g_private_get(&stats_cache_key);
+	if (G_LIKELY(cache && cache->session_id == session->stats_id
+			&& cache->sdi == sdi))
+		return cache->block;
+
+	if (!cache) {
+		cache = g_malloc0(sizeof(*cache));
+		g_private_set(&stats_cache_key, cache);
+	}
+
+	self = g_thread_self();
+	block = NULL;
+	g_mutex_lock(&session->stats_mutex);
+	for (l = session->stats_blocks; l; l = l->next) {
+		block = l->data;
+		if (block->sdi == sdi && block->thread == self)
+			break;
+		block = NULL;
+	}
+	if (!block) {
+		block = g_malloc0(sizeof(*block));
+		block->sdi = sdi;
+		block->thread = self;
+		session->stats_blocks = g_slist_prepend(session->stats_blocks,
+			block);
+	}
+	g_mutex_unlock(&session->stats_mutex);
+
+	cache->session_id = session->stats_id;
+	cache->sdi = sdi;
+	cache->block = block;
+
+	return block;
+}
+
+/* Add to one of the calling thread's counters. */
+static void stats_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+/* Raise one of the calling thread's maximum values. */
+static void stats_max(uint64_t *counter, uint64_t value)
+{
+	uint64_t cur;
+
+	cur = __atomic_load_n(counter, __ATOMIC_RELAXED);
+	while (value > cur && !__atomic_compare_exchange_n(counter, &cur,
+			value, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static uint64_t stats_read(const uint64_t *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static uint64_t packet_payload_size(const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		return logic->length;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		return (uint64_t)analog->num_samples * analog->encoding->unitsize;
+	default:
+		return 0;
+	}
+}
+
+static void datafeed_queue_item_free(struct datafeed_queue_item *item)
+{
+	sr_packet_free(item->packet);
+	g_free(item);
+}
+
+static gboolean datafeed_queue_item_is_data(struct datafeed_queue_item *item)
+{
+	return item->packet->type == SR_DF_LOGIC
+		|| item->packet->type == SR_DF_ANALOG;
+}
+
+/** Consumer thread: deliver queued packets until shutdown is requested. */
+static gpointer datafeed_queue_thread(gpointer data)
+{
+	struct sr_datafeed_queue *queue;
+	struct datafeed_queue_item *item;
+
+	queue = data;
+
+	g_mutex_lock(&queue->mutex);
+	while (TRUE) {
+		while (g_queue_is_empty(&queue->items) && !queue->shutdown)
+			g_cond_wait(&queue->cond_not_empty, &queue->mutex);
+		/* Pending packets get delivered before shutdown completes. */
+		item = g_queue_pop_head(&queue->items);
+		if (!item)
+			break;
+		queue->stats.fill--;
+		g_cond_signal(&queue->cond_not_full);
+		g_mutex_unlock(&queue->mutex);
+
+		/* Let callbacks retain buffered data without copying. */
+		sr_buffer_current_set(retained_buffer_get(
+			item->packet->payload, FALSE));
+		datafeed_dispatch(item->sdi, item->packet);
+		sr_buffer_current_set(NULL);
+		datafeed_queue_item_free(item);
+
+		g_mutex_lock(&queue->mutex);
+		queue->stats.delivered++;
+	}
+	/* Wake up senders, they have to deliver synchronously now. */
+	queue->consuming = FALSE;
+	g_cond_broadcast(&queue->cond_not_full);
+	g_mutex_unlock(&queue->mutex);
+
+	return NULL;
+}
+
+static int datafeed_queue_start(struct sr_session *session)
+{
+	struct sr_datafeed_queue *queue;
+	GThread *thread;
+	GError *error;
+
+	queue = session->datafeed_queue;
+	if (!queue)
+		return SR_OK;
+
+	/* Hold the lock so that the consumer sees consistent state. */
+	g_mutex_lock(&queue->mutex);
+	queue->shutdown = FALSE;
+	error = NULL;
+	thread = g_thread_try_new("sr-datafeed", datafeed_queue_thread,
+		queue, &error);
+	if (!thread) {
+		g_mutex_unlock(&queue->mutex);
+		sr_err("Cannot create datafeed thread: %s.", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+	queue->thread = thread;
+	queue->consuming = TRUE;
+	g_mutex_unlock(&queue->mutex);
+
+	sr_dbg("Datafeed queue started (depth %zu, policy %d).",
+		queue->depth, queue->policy);
+
+	return SR_OK;
+}
+
+static void datafeed_queue_stop(struct sr_session *session)
+{
+	struct sr_datafeed_queue *queue;
+	GThread *thread;
+
+	queue = session->datafeed_queue;
+	if (!queue)
+		return;
+
+	g_mutex_lock(&queue->mutex);
+	thread = queue->thread;
+	queue->shutdown = TRUE;
+	g_cond_broadcast(&queue->cond_not_empty);
+	g_mutex_unlock(&queue->mutex);
+
+	if (!thread)
+		return;
+
+	/*
+	 * Senders which still run in parallel keep queueing while the
+	 * consumer drains. Once it has terminated, they fall back to
+	 * synchronous delivery.
+	 */
+	g_thread_join(thread);
+
+	g_mutex_lock(&queue->mutex);
+	queue->thread = NULL;
+	g_mutex_unlock(&queue->mutex);
+
+	sr_dbg("Datafeed queue stopped.");
+}
+
+static void datafeed_queue_free(struct sr_datafeed_queue *queue)
+{
+	struct datafeed_queue_item *item;
+
+	if (!queue)
+		return;
+
+	while ((item = g_queue_pop_head(&queue->items)))
+		datafeed_queue_item_free(item);
+	g_cond_clear(&queue->cond_not_full);
+	g_cond_clear(&queue->cond_not_empty);
+	g_mutex_clear(&queue->mutex);
+	g_free(queue);
+}
+
+/**
+ * Put a packet on the datafeed queue.
+ *
+ * @retval SR_OK The packet was queued, or was dropped by policy.
+ * @retval SR_ERR_NA No consumer is running, the caller must deliver.
+ * @retval SR_ERR The queue is full and the policy rejected the packet.
+ */
+static int datafeed_queue_push(struct sr_session *session,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_datafeed_queue *queue;
+	struct datafeed_queue_item *item, *oldest;
+	struct sr_datafeed_packet *copy;
+	gboolean is_data, direct;
+	GList *l;
+	int ret;
+
+	queue = session->datafeed_queue;
+
+	/*
+	 * Without a consumer, or when the consumer itself is sending
+	 * (waiting for room in the queue would deadlock), the caller
+	 * delivers synchronously. The consumer may terminate after this
+	 * check, that case gets handled below.
+	 */
+	g_mutex_lock(&queue->mutex);
+	direct = !queue->consuming || queue->thread == g_thread_self();
+	g_mutex_unlock(&queue->mutex);
+	if (direct)
+		return SR_ERR_NA;
+
+	/* The sender may re-use its buffers as soon as we return. */
+	ret = sr_packet_copy(packet, &copy);
+	if (ret != SR_OK)
+		return ret;
+	item = g_malloc(sizeof(*item));
+	item->sdi = sdi;
+	item->packet = copy;
+
+	g_mutex_lock(&queue->mutex);
+
+	/*
+	 * Only sample data is subject to the overrun policy. Control
+	 * packets like SR_DF_HEADER, SR_DF_END, or SR_DF_META must never
+	 * get lost, so these always wait for room in the queue.
+	 */
+	is_data = datafeed_queue_item_is_data(item);
+	if (queue->consuming && queue->stats.fill >= queue->depth) {
+		queue->stats.overruns++;
+		if (is_data && queue->policy == SR_DF_QUEUE_FAIL) {
+			queue->stats.dropped++;
+			g_mutex_unlock(&queue->mutex);
+			datafeed_queue_item_free(item);
+			sr_err("Datafeed queue overrun, stopping acquisition.");
+			sr_session_stop(session);
+			return SR_ERR;
+		}
+		if (is_data && queue->policy == SR_DF_QUEUE_DROP_OLDEST) {
+			oldest = NULL;
+			for (l = queue->items.head; l; l = l->next) {
+				oldest = l->data;
+				if (datafeed_queue_item_is_data(oldest))
+					break;
+			}
+			if (l) {
+				g_queue_delete_link(&queue->items, l);
+				datafeed_queue_item_free(oldest);
+				queue->stats.fill--;
+				queue->stats.dropped++;
+			}
+		}
+		while (queue->consuming && queue->stats.fill >= queue->depth)
+			g_cond_wait(&queue->cond_not_full, &queue->mutex);
+	}
+	if (!queue->consuming) {
+		/* The consumer has terminated while we were waiting. */
+		g_mutex_unlock(&queue->mutex);
+		datafeed_queue_item_free(item);
+		return SR_ERR_NA;
+	}
+
+	g_queue_push_tail(&queue->items, item);
+	queue->stats.queued++;
+	queue->stats.fill++;
+	if (queue->stats.fill > queue->stats.fill_max)
+		queue->stats.fill_max = queue->stats.fill;
+	g_cond_signal(&queue->cond_not_empty);
+	g_mutex_unlock(&queue->mutex);
+
+	return SR_OK;
+}
+
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
  */
@@ -226,6 +631,9 @@ SR_API int sr_session_new(struct sr_context *ctx,
 
 	g_mutex_init(&session->main_mutex);
 
+	session->stats_id = (guint)g_atomic_int_add(&stats_session_id, 1) + 1;
+	g_mutex_init(&session->stats_mutex);
+
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
 	 */
@@ -259,10 +667,16 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	sr_session_datafeed_callback_remove_all(session);
 
+	datafeed_queue_stop(session);
+	datafeed_queue_free(session->datafeed_queue);
+
 	g_hash_table_unref(session->event_sources);
 
 	g_mutex_clear(&session->main_mutex);
 
+	g_slist_free_full(session->stats_blocks, g_free);
+	g_mutex_clear(&session->stats_mutex);
+
 	g_free(session);
 
 	return SR_OK;
@@ -505,6 +919,244 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Configure the datafeed queue of a session.
+ *
+ * By default, sr_session_send() runs all transforms and datafeed callbacks
+ * synchronously, in the context of the driver which produced the packet.
+ * Slow consumers then delay the driver's acquisition (e.g. the resubmission
+ * of USB transfers), which can result in lost samples.
+ *
+ * With a queue depth other than zero, packets are copied onto a bounded
+ * queue instead, and a separate thread which is started along with the
+ * session passes them to transforms and datafeed callbacks, in the order
+ * in which they were sent. Datafeed callbacks then run in the context of
+ * that thread. All queued packets have been delivered when the session's
+ * stopped callback gets invoked, or sr_session_run() returns.
+ *
+ * The policy determines what happens when a sample data packet is sent
+ * while the queue is full. Other packet types always wait for room in the
+ * queue, and never get lost. Drivers which send from bounded buffer pools
+ * apply the same policy when consumers hold on to all of their buffers.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param depth The maximum number of queued packets, 0 to disable queueing.
+ * @param policy The queue overrun policy, see enum sr_datafeed_queue_policy.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_queue_set(struct sr_session *session,
+		size_t depth, int policy)
+{
+	struct sr_datafeed_queue *queue;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	switch (policy) {
+	case SR_DF_QUEUE_BLOCK:
+	case SR_DF_QUEUE_DROP_OLDEST:
+	case SR_DF_QUEUE_FAIL:
+		break;
+	default:
+		sr_err("%s: invalid queue policy %d", __func__, policy);
+		return SR_ERR_ARG;
+	}
+
+	if (session->running) {
+		sr_err("Cannot change datafeed queue of a running session.");
+		return SR_ERR;
+	}
+
+	if (!depth) {
+		datafeed_queue_free(session->datafeed_queue);
+		session->datafeed_queue = NULL;
+		return SR_OK;
+	}
+
+	queue = session->datafeed_queue;
+	if (!queue) {
+		queue = g_malloc0(sizeof(*queue));
+		g_mutex_init(&queue->mutex);
+		g_cond_init(&queue->cond_not_empty);
+		g_cond_init(&queue->cond_not_full);
+		g_queue_init(&queue->items);
+		session->datafeed_queue = queue;
+	}
+	queue->depth = depth;
+	queue->policy = policy;
+
+	return SR_OK;
+}
+
+/**
+ * Get the statistics of a session's datafeed queue.
+ *
+ * The counters accumulate over all runs of the session, and get reset
+ * when the queue is disabled by sr_session_datafeed_queue_set().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Pointer to a struct which receives the statistics.
+ *              Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The session has no datafeed queue.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_queue_stats_get(struct sr_session *session,
+		struct sr_datafeed_queue_stats *stats)
+{
+	struct sr_datafeed_queue *queue;
+
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	queue = session->datafeed_queue;
+	if (!queue)
+		return SR_ERR_NA;
+
+	g_mutex_lock(&queue->mutex);
+	*stats = queue->stats;
+	g_mutex_unlock(&queue->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Get a session's instrumentation counters.
+ *
+ * Counters are kept per device and per sending thread, and get summed
+ * up here. Each thread's counters are read consistently, counters of
+ * different threads may be from slightly different points in time.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param sdi The device to get the counters of, or NULL for the sum
+ *            over all devices of the session.
+ * @param stats Pointer to a struct that receives the counters.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_get(struct sr_session *session,
+		const struct sr_dev_inst *sdi, struct sr_session_stats *stats)
+{
+	struct stats_block *block;
+	const struct sr_session_stats *s;
+	GSList *l;
+
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	memset(stats, 0, sizeof(*stats));
+	g_mutex_lock(&session->stats_mutex);
+	for (l = session->stats_blocks; l; l = l->next) {
+		block = l->data;
+		if (sdi && block->sdi != sdi)
+			continue;
+		s = &block->stats;
+		stats->packets += stats_read(&s->packets);
+		stats->bytes += stats_read(&s->bytes);
+		stats->send_time += stats_read(&s->send_time);
+		stats->send_time_max = MAX(stats->send_time_max,
+			stats_read(&s->send_time_max));
+		stats->transform_time += stats_read(&s->transform_time);
+		stats->callback_time += stats_read(&s->callback_time);
+		stats->transfers_dropped += stats_read(&s->transfers_dropped);
+		stats->transfers_overrun += stats_read(&s->transfers_overrun);
+	}
+	g_mutex_unlock(&session->stats_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Reset a session's instrumentation counters.
+ *
+ * @param session The session to use. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_reset(struct sr_session *session)
+{
+	struct sr_session_stats *s;
+	GSList *l;
+
+	if (!session)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->stats_mutex);
+	for (l = session->stats_blocks; l; l = l->next) {
+		s = &((struct stats_block *)l->data)->stats;
+		__atomic_store_n(&s->packets, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->bytes, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->send_time, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->send_time_max, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->transform_time, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->callback_time, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->transfers_dropped, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&s->transfers_overrun, 0, __ATOMIC_RELAXED);
+	}
+	g_mutex_unlock(&session->stats_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Count a (USB) transfer which a driver lost or which overran.
+ *
+ * @param sdi The device instance the transfer belongs to.
+ * @param overrun TRUE if the device reported an overrun, FALSE if the
+ *                transfer's data was lost otherwise.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_stats_transfer_error(const struct sr_dev_inst *sdi,
+		gboolean overrun)
+{
+	struct stats_block *block;
+
+	if (!sdi || !sdi->session)
+		return;
+
+	block = stats_local_get(sdi->session, sdi);
+	if (overrun)
+		stats_add(&block->stats.transfers_overrun, 1);
+	else
+		stats_add(&block->stats.transfers_dropped, 1);
+}
+
+/**
+ * Get the overrun policy of a session's datafeed queue.
+ *
+ * @param session The session, or NULL.
+ *
+ * @return The policy, see enum sr_datafeed_queue_policy. SR_DF_QUEUE_BLOCK
+ *         for sessions without a datafeed queue, which deliver packets
+ *         synchronously and thus never lose them.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_datafeed_queue_policy(struct sr_session *session)
+{
+	if (!session || !session->datafeed_queue)
+		return SR_DF_QUEUE_BLOCK;
+
+	return session->datafeed_queue->policy;
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -692,6 +1344,9 @@ static gboolean delayed_stop_check(void *data)
 	session->running = FALSE;
 	unset_main_context(session);
 
+	/* Deliver queued packets before the stop is announced. */
+	datafeed_queue_stop(session);
+
 	sr_info("Stopped.");
 
 	/* This indicates a bug in user code, since it is not valid to
@@ -806,6 +1461,12 @@ SR_API int sr_session_start(struct sr_session *session)
 	if (ret != SR_OK)
 		return ret;
 
+	ret = datafeed_queue_start(session);
+	if (ret != SR_OK) {
+		unset_main_context(session);
+		return ret;
+	}
+
 	sr_info("Starting.");
 
 	session->running = TRUE;
@@ -838,6 +1499,7 @@ SR_API int sr_session_start(struct sr_session *session)
 		session->running = FALSE;
 
 		unset_main_context(session);
+		datafeed_queue_stop(session);
 		return ret;
 	}
 
@@ -1108,42 +1770,19 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
-/**
- * Send a packet to whatever is listening on the datafeed bus.
- *
- * Hardware drivers use this to send a data packet to the frontend.
- *
- * @param sdi TODO.
- * @param packet The datafeed packet to send to the session bus.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
- *
- * @private
- */
-SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+/** Run a packet through the transforms, and pass it to all callbacks. */
+static int datafeed_dispatch(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
 	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
 	struct sr_transform *t;
+	struct stats_block *block;
+	int64_t start;
 	int ret;
 
-	if (!sdi) {
-		sr_err("%s: sdi was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!packet) {
-		sr_err("%s: packet was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!sdi->session) {
-		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
-	}
+	block = stats_local_get(sdi->session, sdi);
 
 	/*
 	 * Pass the packet to the first transform module. If that returns
@@ -1154,7 +1793,10 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	for (l = sdi->session->transforms; l; l = l->next) {
 		t = l->data;
 		sr_spew("Running transform module '%s'.", t->module->id);
+		start = g_get_monotonic_time();
 		ret = t->module->receive(t, packet_in, &packet_out);
+		stats_add(&block->stats.transform_time,
+			g_get_monotonic_time() - start);
 		if (ret < 0) {
 			sr_err("Error while running transform module: %d.", ret);
 			return SR_ERR;
@@ -1180,16 +1822,110 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * If the last transform did output a packet, pass it to all datafeed
 	 * callbacks.
 	 */
+	start = g_get_monotonic_time();
 	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+		if (sr_log_level_enabled(SR_LOG_DBG))
 			datafeed_dump(packet);
 		cb_struct = l->data;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
 	}
+	stats_add(&block->stats.callback_time,
+		g_get_monotonic_time() - start);
 
 	return SR_OK;
 }
 
+/**
+ * Send a packet to whatever is listening on the datafeed bus.
+ *
+ * Hardware drivers use this to send a data packet to the frontend.
+ *
+ * When the session has a datafeed queue, the packet gets copied and
+ * is delivered later from the queue's consumer thread. The caller may
+ * re-use the packet's memory as soon as this function returns.
+ *
+ * @param sdi TODO.
+ * @param packet The datafeed packet to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct stats_block *block;
+	struct sr_session_stats *stats;
+	int64_t start;
+	uint64_t elapsed;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!packet) {
+		sr_err("%s: packet was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	start = g_get_monotonic_time();
+
+	ret = SR_ERR_NA;
+	if (sdi->session->datafeed_queue)
+		ret = datafeed_queue_push(sdi->session, sdi, packet);
+	if (ret == SR_ERR_NA)
+		ret = datafeed_dispatch(sdi, packet);
+
+	/* The dispatch may have run in this thread, get counters after it. */
+	block = stats_local_get(sdi->session, sdi);
+	elapsed = g_get_monotonic_time() - start;
+	stats = &block->stats;
+	stats_add(&stats->packets, 1);
+	stats_add(&stats->bytes, packet_payload_size(packet));
+	stats_add(&stats->send_time, elapsed);
+	stats_max(&stats->send_time_max, elapsed);
+
+	return ret;
+}
+
+/**
+ * Send a packet whose sample data lives in a reference counted buffer.
+ *
+ * Works like sr_session_send(), but consumers which retain the packet
+ * by means of sr_packet_copy() take a reference to the buffer instead
+ * of copying the sample data. The caller keeps its own reference, and
+ * must not modify the buffer's content while other references exist.
+ *
+ * @param sdi The device instance to send the packet from.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buf The buffer which holds the packet's sample data.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	struct sr_buffer *prev;
+	int ret;
+
+	prev = sr_buffer_current_set(buf);
+	ret = sr_session_send(sdi, packet);
+	sr_buffer_current_set(prev);
+
+	return ret;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -1494,6 +2230,21 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	meta_copy->config = g_slist_append(meta_copy->config, item);
 }
 
+/**
+ * Copy a datafeed packet.
+ *
+ * Use this to retain a packet beyond the datafeed callback which
+ * received it. Sample data which a driver sent from a reference counted
+ * buffer is not copied, the copy takes another reference instead.
+ *
+ * @param packet The packet to copy. Must not be NULL.
+ * @param copy Receives the copy, which must be freed by sr_packet_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unknown packet type, or allocation failure.
+ *
+ * @since 0.4.0
+ */
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy)
 {
@@ -1506,7 +2257,9 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_analog_encoding *encoding_copy;
 	struct sr_analog_meaning *meaning_copy;
 	struct sr_analog_spec *spec_copy;
+	struct sr_buffer *buf;
 	uint8_t *payload;
+	size_t size;
 
 	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
@@ -1514,6 +2267,8 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1524,31 +2279,50 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
 		logic_copy = g_malloc(sizeof(*logic_copy));
-		if (!logic_copy)
-			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
-		if (!logic_copy->data) {
-			g_free(logic_copy);
-			return SR_ERR;
+		/* The logic payload's length is in bytes. */
+		size = logic->length;
+		buf = sr_buffer_current_find(logic->data, size);
+		if (buf) {
+			logic_copy->data = logic->data;
+			retained_buffer_add(logic_copy, sr_buffer_ref(buf));
+		} else {
+			logic_copy->data = g_try_malloc(size);
+			if (size && !logic_copy->data) {
+				g_free(logic_copy);
+				g_free(*copy);
+				*copy = NULL;
+				return SR_ERR;
+			}
+			memcpy(logic_copy->data, logic->data, size);
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		size = (size_t)analog->encoding->unitsize * analog->num_samples;
+		buf = sr_buffer_current_find(analog->data, size);
+		if (buf) {
+			analog_copy->data = analog->data;
+			retained_buffer_add(analog_copy, sr_buffer_ref(buf));
+		} else {
+			analog_copy->data = g_try_malloc(size);
+			if (size && !analog_copy->data) {
+				g_free(analog_copy);
+				g_free(*copy);
+				*copy = NULL;
+				return SR_ERR;
+			}
+			memcpy(analog_copy->data, analog->data, size);
+		}
 		analog_copy->num_samples = analog->num_samples;
 #if GLIB_CHECK_VERSION(2, 67, 3)
 		encoding_copy = g_memdup2(analog->encoding, sizeof(*analog->encoding));
@@ -1568,23 +2342,41 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
+		g_free(*copy);
+		*copy = NULL;
 		return SR_ERR;
 	}
 
 	return SR_OK;
 }
 
+/**
+ * Free a datafeed packet which was created by sr_packet_copy().
+ *
+ * Copies which reference a sample buffer instead of holding their own
+ * copy of the sample data drop that reference.
+ *
+ * @param packet The packet to free, or NULL.
+ *
+ * @since 0.4.0
+ */
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 	struct sr_config *src;
+	struct sr_buffer *buf;
 	GSList *l;
 
+	if (!packet)
+		return;
+
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1603,12 +2395,18 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
+		if ((buf = retained_buffer_get(logic, TRUE)))
+			sr_buffer_unref(buf);
+		else
+			g_free(logic->data);
 		g_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
+		if ((buf = retained_buffer_get(analog, TRUE)))
+			sr_buffer_unref(buf);
+		else
+			g_free(analog->data);
 		g_free(analog->encoding);
 		g_slist_free(analog->meaning->channels);
 		g_free(analog->meaning);
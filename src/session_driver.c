@@ -21,11 +21,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
 #include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#include "minilzo/minilzo.h"
 
 #define LOG_PREFIX "virtual-session"
 
@@ -34,22 +36,159 @@
 #define CHUNKSIZE (4 * 1024 * 1024)
 /** @endcond */
 
+#define MAX_PREFETCH_THREADS 32
+/*
+ * Chunks per stream decompressed ahead by default. Every one of them
+ * holds a decoded chunk, so this doesn't grow with the thread count.
+ */
+#define DEFAULT_PREFETCH_DEPTH 2
+
+/*
+ * Encoded sample data chunks, see output/srzip.c. Both encodings start
+ * with a header of the magic and the size of the sample data.
+ */
+#define LZO_CHUNK_SUFFIX	".lzo"
+#define LZO_CHUNK_MAGIC		"SRLZ"
+#define RLE_CHUNK_SUFFIX	".rle"
+#define RLE_CHUNK_MAGIC		"SRRL"
+#define CHUNK_HEADER_SIZE	8
+
+/* Summaries of the sample data, see output/srzip.c. */
+#define SUMMARY_SUFFIX		".summary"
+#define SUMMARY_MAGIC		"SRSM"
+#define SUMMARY_HEADER_SIZE	20
+#define SUMMARY_MAX_LEVELS	64
+
+enum chunk_encoding {
+	CHUNK_RAW,
+	/* LZO compressed sample data. */
+	CHUNK_LZO,
+	/* Logic data as runs of equal samples. */
+	CHUNK_RLE,
+};
+
 SR_PRIV struct sr_dev_driver session_driver_info;
 
+/* Location of a chunk within a capture stream. */
+struct chunk_info {
+	/* Archive member index. */
+	zip_uint64_t index;
+	/* Chunk number from the member name, 0 for unchunked captures. */
+	uint64_t number;
+	/* Number of the chunk's first sample within the stream. */
+	uint64_t start;
+	uint64_t num_samples;
+	/* Size of the chunk's sample data in bytes. */
+	uint64_t size;
+	enum chunk_encoding encoding;
+	uint64_t member_size;
+	/* Member data in the memory mapped session file, for stored members. */
+	const uint8_t *data;
+	/* CRC-32 of the mapped member, and whether it was checked. */
+	uint32_t crc;
+	gint crc_checked;
+};
+
+/* Multi-resolution summary of a stream, as read from the archive. */
+struct stream_summary {
+	uint8_t *buf;
+	unsigned int block_shift;
+	unsigned int level_shift;
+	unsigned int num_levels;
+	size_t block_size;
+	const uint8_t *levels[SUMMARY_MAX_LEVELS];
+	uint64_t level_len[SUMMARY_MAX_LEVELS];
+};
+
+/* Index of the chunks which make up a logic or analog capture stream. */
+struct stream_index {
+	char *basename;
+	/* Analog channel of the stream, NULL for logic data. */
+	struct sr_channel *ch;
+	size_t unitsize;
+	GArray *chunks;
+	uint64_t num_samples;
+	/* Summary member, which only gets loaded when it's needed. */
+	gboolean has_summary;
+	zip_uint64_t summary_index;
+	struct stream_summary *summary;
+};
+
+/* A chunk which gets decompressed by a worker ahead of playback. */
+struct prefetch_job {
+	const struct stream_index *stream;
+	guint chunk;
+	uint8_t *data;
+	gboolean done;
+	int ret;
+};
+
+/* Worker threads which decompress chunks ahead of playback. */
+struct prefetch {
+	char *sessionfile;
+	/* Number of chunks per stream to decompress ahead. */
+	unsigned int depth;
+	GThread **threads;
+	unsigned int num_threads;
+	/* Everything below is protected by the mutex. */
+	GMutex mutex;
+	GCond cond_pending;
+	GCond cond_done;
+	GQueue pending;
+	gboolean shutdown;
+};
+
+/* Sequential reading position within a stream. */
+struct stream_cursor {
+	const struct stream_index *stream;
+	struct zip *archive;
+	struct zip_file *zf;
+	guint chunk;
+	/* Byte position within the current chunk. */
+	uint64_t offset;
+	/* The current chunk's data, if it is available in memory. */
+	const uint8_t *chunk_data;
+	/* Buffer for decoded chunks. */
+	uint8_t *decoded;
+	size_t decoded_size;
+	/* Playback buffer of the stream. */
+	uint8_t *buf;
+	gboolean done;
+	/*
+	 * Chunks which get prefetched, in order, the job of the current
+	 * chunk, and the next chunk to prefetch. Only used for playback.
+	 */
+	struct prefetch *prefetch;
+	GQueue jobs;
+	struct prefetch_job *job;
+	guint next_prefetch;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
 	struct zip *archive;
-	struct zip_file *capfile;
+	struct stream_cursor *cursors;
+	size_t block_samples;
 	int bytes_read;
 	uint64_t samplerate;
 	int unitsize;
 	int num_logic_channels;
 	int num_analog_channels;
-	int cur_analog_channel;
-	GArray *analog_channels;
-	int cur_chunk;
+	/*
+	 * The chunk index gets built from the archive's directory, and
+	 * stays valid until the session file's layout gets reconfigured.
+	 * Random access reads use their own archive handle.
+	 */
+	GArray *streams;
+	struct zip *index_archive;
+	GMappedFile *map;
+	uint64_t start_sample;
 	gboolean finished;
+	/* Decompression ahead of playback, if it's enabled. */
+	unsigned int prefetch_threads;
+	unsigned int prefetch_depth;
+	struct prefetch *prefetch;
 };
 
 static const uint32_t devopts[] = {
@@ -61,143 +200,1455 @@ static const uint32_t devopts[] = {
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
 };
 
+static void index_free(struct session_vdev *vdev)
+{
+	struct stream_index *stream;
+	guint i;
+
+	if (vdev->streams) {
+		for (i = 0; i < vdev->streams->len; i++) {
+			stream = &g_array_index(vdev->streams,
+				struct stream_index, i);
+			g_free(stream->basename);
+			g_array_free(stream->chunks, TRUE);
+			if (stream->summary) {
+				g_free(stream->summary->buf);
+				g_free(stream->summary);
+			}
+		}
+		g_array_free(vdev->streams, TRUE);
+		vdev->streams = NULL;
+	}
+	if (vdev->index_archive) {
+		zip_discard(vdev->index_archive);
+		vdev->index_archive = NULL;
+	}
+	if (vdev->map) {
+		g_mapped_file_unref(vdev->map);
+		vdev->map = NULL;
+	}
+}
+
+static void stream_add(struct session_vdev *vdev, char *basename,
+	struct sr_channel *ch, size_t unitsize)
+{
+	struct stream_index stream;
+
+	stream.basename = basename;
+	stream.ch = ch;
+	stream.unitsize = unitsize;
+	stream.chunks = g_array_new(FALSE, FALSE, sizeof(struct chunk_info));
+	stream.num_samples = 0;
+	stream.has_summary = FALSE;
+	stream.summary_index = 0;
+	stream.summary = NULL;
+	g_array_append_val(vdev->streams, stream);
+}
+
+/*
+ * Get the chunk number of an archive member of a stream. Chunks are
+ * named "<basename>-<number>", or just "<basename>" for captures which
+ * were written in one piece. Encoded chunks carry a suffix.
+ */
+static gboolean stream_chunk_number(const struct stream_index *stream,
+	const char *name, uint64_t *number, enum chunk_encoding *encoding)
+{
+	size_t len, name_len;
+	char *end;
+
+	name_len = strlen(name);
+	*encoding = CHUNK_RAW;
+	if (g_str_has_suffix(name, LZO_CHUNK_SUFFIX)) {
+		*encoding = CHUNK_LZO;
+		name_len -= strlen(LZO_CHUNK_SUFFIX);
+	} else if (g_str_has_suffix(name, RLE_CHUNK_SUFFIX)) {
+		/* Only logic data gets transition encoded. */
+		if (stream->ch)
+			return FALSE;
+		*encoding = CHUNK_RLE;
+		name_len -= strlen(RLE_CHUNK_SUFFIX);
+	}
+	len = strlen(stream->basename);
+	if (name_len < len || strncmp(name, stream->basename, len) != 0)
+		return FALSE;
+	if (name_len == len) {
+		*number = 0;
+		return TRUE;
+	}
+	if (name[len] != '-' || !g_ascii_isdigit(name[len + 1]))
+		return FALSE;
+	*number = g_ascii_strtoull(name + len + 1, &end, 10);
+
+	return end == name + name_len && *number > 0;
+}
+
+static gint chunk_number_compare(gconstpointer a, gconstpointer b)
+{
+	const struct chunk_info *ca, *cb;
+
+	ca = a;
+	cb = b;
+	if (ca->number != cb->number)
+		return ca->number < cb->number ? -1 : 1;
+
+	return 0;
+}
+
+/* A stored member in the memory mapped session file. */
+struct mapped_member {
+	const uint8_t *data;
+	uint32_t crc;
+};
+
+/*
+ * Find the data of all stored members in a memory mapped ZIP archive.
+ * libzip does not tell where a member's data starts, so the central
+ * directory and local headers get parsed here. Returns a table which
+ * maps member names to struct mapped_member, or NULL if the directory
+ * could not be found.
+ */
+static GHashTable *map_stored_members(const uint8_t *base, uint64_t size)
+{
+	GHashTable *members;
+	GArray *entries;
+	struct sr_zip_entry *entry;
+	struct mapped_member *member;
+	uint64_t offset;
+	guint i;
+
+	if (!(entries = sr_zip_cd_read(base, size)))
+		return NULL;
+
+	members = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, g_free);
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index(entries, struct sr_zip_entry, i);
+		/* Only unencrypted members without compression qualify. */
+		if ((entry->flags & ZIP_FLAG_ENCRYPTED) ||
+				entry->method != ZIP_METHOD_STORE ||
+				entry->comp_size != entry->size)
+			continue;
+		if (!sr_zip_local_header_parse(base, size, entry->offset,
+				NULL, &offset))
+			continue;
+		if (offset > size || size - offset < entry->size)
+			continue;
+		member = g_malloc(sizeof(*member));
+		member->data = base + offset;
+		member->crc = entry->crc;
+		g_hash_table_insert(members, entry->name, member);
+		entry->name = NULL;
+	}
+	sr_zip_entries_free(entries);
+
+	return members;
+}
+
+/*
+ * Map the session file into memory, so that stored chunks can be
+ * used without copying them through libzip. Compressed chunks, and
+ * all chunks if the file cannot be mapped, still get read via libzip.
+ */
+static void index_map(struct session_vdev *vdev)
+{
+	struct stream_index *stream;
+	struct chunk_info *chunk;
+	struct mapped_member *member;
+	GHashTable *members;
+	GError *error;
+	const char *name;
+	guint i, j, num_mapped;
+
+	error = NULL;
+	if (!(vdev->map = g_mapped_file_new(vdev->sessionfile, FALSE, &error))) {
+		sr_dbg("Cannot map session file '%s': %s.",
+			vdev->sessionfile, error->message);
+		g_error_free(error);
+		return;
+	}
+	members = map_stored_members(
+		(const uint8_t *)g_mapped_file_get_contents(vdev->map),
+		g_mapped_file_get_length(vdev->map));
+	if (!members) {
+		sr_dbg("No ZIP directory found in mapped session file.");
+		g_mapped_file_unref(vdev->map);
+		vdev->map = NULL;
+		return;
+	}
+
+	num_mapped = 0;
+	for (i = 0; i < vdev->streams->len; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		for (j = 0; j < stream->chunks->len; j++) {
+			chunk = &g_array_index(stream->chunks, struct chunk_info, j);
+			name = zip_get_name(vdev->index_archive, chunk->index, 0);
+			if (!name)
+				continue;
+			if (!(member = g_hash_table_lookup(members, name)))
+				continue;
+			chunk->data = member->data;
+			chunk->crc = member->crc;
+			num_mapped++;
+		}
+	}
+	g_hash_table_destroy(members);
+
+	if (!num_mapped) {
+		g_mapped_file_unref(vdev->map);
+		vdev->map = NULL;
+		return;
+	}
+	sr_dbg("Mapped %u stored chunks.", num_mapped);
+}
+
+/* Get the sample data size of an encoded chunk from its header. */
+static int chunk_decoded_size(struct session_vdev *vdev,
+	struct chunk_info *chunk)
+{
+	uint8_t header[CHUNK_HEADER_SIZE];
+	const uint8_t *p;
+	const char *magic;
+	struct zip_file *zf;
+	zip_int64_t ret;
+
+	if (chunk->member_size < CHUNK_HEADER_SIZE)
+		return SR_ERR_DATA;
+	if (!(p = chunk->data)) {
+		zf = zip_fopen_index(vdev->index_archive, chunk->index, 0);
+		if (!zf)
+			return SR_ERR_DATA;
+		ret = zip_fread(zf, header, sizeof(header));
+		zip_fclose(zf);
+		if (ret != sizeof(header))
+			return SR_ERR_DATA;
+		p = header;
+	}
+	magic = chunk->encoding == CHUNK_LZO ? LZO_CHUNK_MAGIC : RLE_CHUNK_MAGIC;
+	if (memcmp(p, magic, strlen(magic)) != 0)
+		return SR_ERR_DATA;
+	chunk->size = RL32(p + 4);
+
+	return SR_OK;
+}
+
+/**
+ * Build the chunk index of a session file device.
+ *
+ * The index only takes the archive's directory, no data needs to be
+ * decompressed. The logic stream comes first, followed by the analog
+ * channels in channel order.
+ */
+static int index_build(const struct sr_dev_inst *sdi)
+{
+	struct session_vdev *vdev;
+	struct stream_index *stream;
+	struct chunk_info chunk, *c;
+	struct zip_stat zs;
+	struct sr_channel *ch;
+	zip_int64_t num_entries, i;
+	uint64_t number;
+	enum chunk_encoding encoding;
+	GSList *l;
+	guint j, k;
+	int ret, analog_nr;
+
+	vdev = sdi->priv;
+	if (vdev->streams)
+		return SR_OK;
+	if (!vdev->sessionfile)
+		return SR_ERR;
+
+	if (!(vdev->index_archive = zip_open(vdev->sessionfile, 0, &ret))) {
+		sr_err("Failed to open session file '%s': "
+		       "zip error %d.", vdev->sessionfile, ret);
+		return SR_ERR;
+	}
+
+	vdev->streams = g_array_new(FALSE, FALSE, sizeof(struct stream_index));
+	/* unitsize is not defined for purely analog session files. */
+	if (vdev->capturefile && vdev->unitsize)
+		stream_add(vdev, g_strdup(vdev->capturefile), NULL, vdev->unitsize);
+	analog_nr = vdev->num_logic_channels;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		stream_add(vdev, g_strdup_printf("analog-1-%d", ++analog_nr),
+			ch, sizeof(float));
+	}
+
+	num_entries = zip_get_num_entries(vdev->index_archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		if (zip_stat_index(vdev->index_archive, i, 0, &zs) < 0)
+			continue;
+		for (j = 0; j < vdev->streams->len; j++) {
+			stream = &g_array_index(vdev->streams,
+				struct stream_index, j);
+			if (g_str_has_prefix(zs.name, stream->basename) &&
+					!strcmp(zs.name + strlen(stream->basename),
+					SUMMARY_SUFFIX)) {
+				stream->has_summary = TRUE;
+				stream->summary_index = i;
+				break;
+			}
+			if (!stream_chunk_number(stream, zs.name, &number,
+					&encoding))
+				continue;
+			chunk.index = i;
+			chunk.number = number;
+			chunk.size = zs.size;
+			chunk.encoding = encoding;
+			chunk.member_size = zs.size;
+			chunk.data = NULL;
+			chunk.crc = 0;
+			chunk.crc_checked = FALSE;
+			g_array_append_val(stream->chunks, chunk);
+			break;
+		}
+	}
+
+	index_map(vdev);
+
+	for (j = 0; j < vdev->streams->len; j++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, j);
+		if (!stream->chunks->len)
+			sr_warn("No capture file '%s' in session file '%s'.",
+				stream->basename, vdev->sessionfile);
+		g_array_sort(stream->chunks, chunk_number_compare);
+		for (k = 0; k < stream->chunks->len; k++) {
+			c = &g_array_index(stream->chunks, struct chunk_info, k);
+			if (c->encoding != CHUNK_RAW &&
+					chunk_decoded_size(vdev, c) != SR_OK) {
+				sr_err("Invalid encoded chunk %" PRIu64 " of '%s'.",
+					c->number, stream->basename);
+				index_free(vdev);
+				return SR_ERR_DATA;
+			}
+			if (c->size % stream->unitsize != 0)
+				sr_warn("Size of chunk %" PRIu64 " of '%s' not a"
+					" multiple of the unit size %zu.", c->number,
+					stream->basename, stream->unitsize);
+			c->num_samples = c->size / stream->unitsize;
+			c->start = stream->num_samples;
+			stream->num_samples += c->num_samples;
+		}
+		sr_dbg("Indexed '%s': %u chunks, %" PRIu64 " samples.",
+			stream->basename, stream->chunks->len, stream->num_samples);
+	}
+
+	return SR_OK;
+}
+
+/* Get the stream of an analog channel, or the logic stream. */
+static struct stream_index *stream_find(struct session_vdev *vdev,
+	const struct sr_channel *ch)
+{
+	struct stream_index *stream;
+	guint i;
+
+	if (ch && ch->type != SR_CHANNEL_ANALOG)
+		ch = NULL;
+	for (i = 0; i < vdev->streams->len; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		if (stream->ch == ch)
+			return stream;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find the chunk which holds a sample, and the sample's byte offset
+ * within the chunk. Positions past the end of the stream yield the
+ * number of chunks.
+ */
+static guint stream_locate(const struct stream_index *stream,
+	uint64_t sample, uint64_t *offset)
+{
+	const struct chunk_info *chunk;
+	guint lo, hi, mid;
+
+	*offset = 0;
+	if (sample >= stream->num_samples)
+		return stream->chunks->len;
+
+	/* Binary search for the last chunk which starts at or before. */
+	lo = 0;
+	hi = stream->chunks->len;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		chunk = &g_array_index(stream->chunks, struct chunk_info, mid);
+		if (chunk->start <= sample)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	chunk = &g_array_index(stream->chunks, struct chunk_info, lo);
+	*offset = (sample - chunk->start) * stream->unitsize;
+
+	return lo;
+}
+
+static void cursor_init(struct stream_cursor *cursor, struct zip *archive,
+	const struct stream_index *stream, uint64_t sample)
+{
+	memset(cursor, 0, sizeof(*cursor));
+	cursor->stream = stream;
+	cursor->archive = archive;
+	cursor->chunk = stream_locate(stream, sample, &cursor->offset);
+}
+
+static void prefetch_job_free(struct prefetch_job *job)
+{
+	if (!job)
+		return;
+	g_free(job->data);
+	g_free(job);
+}
+
+/*
+ * Release the cursor's resources. Prefetch workers must not work on
+ * any of the cursor's chunks anymore.
+ */
+static void cursor_close(struct stream_cursor *cursor)
+{
+	struct prefetch_job *job;
+
+	if (cursor->zf) {
+		zip_fclose(cursor->zf);
+		cursor->zf = NULL;
+	}
+	cursor->chunk_data = NULL;
+	g_free(cursor->decoded);
+	cursor->decoded = NULL;
+	cursor->decoded_size = 0;
+	prefetch_job_free(cursor->job);
+	cursor->job = NULL;
+	while ((job = g_queue_pop_head(&cursor->jobs)))
+		prefetch_job_free(job);
+}
+
+/* Open the cursor's current chunk, and skip to the cursor position. */
+static int cursor_open(struct stream_cursor *cursor)
+{
+	const struct stream_index *stream;
+	const struct chunk_info *chunk;
+	zip_int64_t ret;
+	uint64_t skip;
+	uint8_t *scratch;
+
+	stream = cursor->stream;
+	chunk = &g_array_index(stream->chunks, struct chunk_info, cursor->chunk);
+	if (!(cursor->zf = zip_fopen_index(cursor->archive, chunk->index, 0))) {
+		sr_err("Failed to open chunk %u of '%s'.",
+			cursor->chunk, stream->basename);
+		return SR_ERR_DATA;
+	}
+	sr_dbg("Opened chunk %u of '%s'.", cursor->chunk, stream->basename);
+
+	/* Compressed data can only be skipped by decompressing it. */
+	skip = cursor->offset;
+	scratch = skip ? g_malloc(MIN(skip, CHUNKSIZE)) : NULL;
+	while (skip) {
+		ret = zip_fread(cursor->zf, scratch, MIN(skip, CHUNKSIZE));
+		if (ret <= 0)
+			break;
+		skip -= ret;
+	}
+	g_free(scratch);
+	if (skip) {
+		sr_err("Failed to skip in chunk %u of '%s'.",
+			cursor->chunk, stream->basename);
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Expand transition encoded logic data. Fails unless the runs exactly
+ * fill the sample data.
+ */
+static gboolean rle_decode(const uint8_t *src, size_t src_len,
+	uint8_t *dst, size_t dst_len, size_t unitsize)
+{
+	const uint8_t *end;
+	uint64_t run;
+	size_t bytes, i;
+	unsigned int shift;
+
+	end = src + src_len;
+	while (src < end) {
+		run = 0;
+		shift = 0;
+		do {
+			if (src == end || shift > 63)
+				return FALSE;
+			run |= (uint64_t)(*src & 0x7f) << shift;
+			shift += 7;
+		} while (*src++ & 0x80);
+		if ((size_t)(end - src) < unitsize || run == 0 ||
+				run > dst_len / unitsize)
+			return FALSE;
+		bytes = run * unitsize;
+		if (unitsize == 1) {
+			memset(dst, *src, bytes);
+		} else {
+			/* Keep doubling the samples written so far. */
+			memcpy(dst, src, unitsize);
+			for (i = unitsize; i < bytes; i *= 2)
+				memcpy(dst + i, dst, MIN(i, bytes - i));
+		}
+		src += unitsize;
+		dst += bytes;
+		dst_len -= bytes;
+	}
+
+	return dst_len == 0;
+}
+
+/*
+ * Chunks which are used from the mapping bypass libzip, which checks
+ * the CRC of members it reads. Check it the first time a mapped chunk
+ * gets used instead. Prefetch workers may check a chunk concurrently
+ * with the session thread, which is harmless.
+ */
+static int chunk_mapped_check(const struct stream_index *stream,
+	struct chunk_info *chunk, guint number)
+{
+	if (g_atomic_int_get(&chunk->crc_checked))
+		return SR_OK;
+	if (sr_zip_crc32(chunk->data, chunk->member_size) != chunk->crc) {
+		sr_err("CRC error in chunk %u of '%s'.",
+			number, stream->basename);
+		return SR_ERR_DATA;
+	}
+	g_atomic_int_set(&chunk->crc_checked, TRUE);
+
+	return SR_OK;
+}
+
+/*
+ * Read a whole chunk into a buffer of the chunk's size. Encoded chunks
+ * get decoded, straight from the mapping if they are stored there.
+ */
+static int chunk_read(struct zip *archive, const struct stream_index *stream,
+	guint number, uint8_t *dst)
+{
+	struct chunk_info *chunk;
+	struct zip_file *zf;
+	const uint8_t *member;
+	uint8_t *buf;
+	lzo_uint len;
+	zip_int64_t ret;
+	gboolean ok;
+	int rc;
+
+	chunk = &g_array_index(stream->chunks, struct chunk_info, number);
+
+	/* Stored members get decoded straight from the mapping. */
+	buf = NULL;
+	if ((member = chunk->data)) {
+		rc = chunk_mapped_check(stream, chunk, number);
+		if (rc != SR_OK)
+			return rc;
+	} else {
+		zf = zip_fopen_index(archive, chunk->index, 0);
+		if (chunk->encoding != CHUNK_RAW)
+			buf = g_try_malloc(chunk->member_size);
+		ret = -1;
+		if (zf && (buf || chunk->encoding == CHUNK_RAW))
+			ret = zip_fread(zf, buf ? buf : dst, chunk->member_size);
+		if (zf)
+			zip_fclose(zf);
+		if (ret < 0 || (uint64_t)ret != chunk->member_size) {
+			sr_err("Failed to read chunk %u of '%s'.",
+				number, stream->basename);
+			g_free(buf);
+			return SR_ERR_DATA;
+		}
+		if (chunk->encoding == CHUNK_RAW)
+			return SR_OK;
+		member = buf;
+	}
+
+	if (chunk->encoding == CHUNK_LZO) {
+		len = chunk->size;
+		rc = lzo1x_decompress_safe(member + CHUNK_HEADER_SIZE,
+			chunk->member_size - CHUNK_HEADER_SIZE, dst, &len, NULL);
+		ok = rc == LZO_E_OK && len == chunk->size;
+	} else {
+		ok = rle_decode(member + CHUNK_HEADER_SIZE,
+			chunk->member_size - CHUNK_HEADER_SIZE,
+			dst, chunk->size, stream->unitsize);
+	}
+	g_free(buf);
+	if (!ok) {
+		sr_err("Failed to decode chunk %u of '%s'.",
+			number, stream->basename);
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+/* Decode the cursor's current chunk, which is LZO or RLE encoded. */
+static int cursor_decode(struct stream_cursor *cursor)
+{
+	const struct chunk_info *chunk;
+	int ret;
+
+	chunk = &g_array_index(cursor->stream->chunks, struct chunk_info,
+		cursor->chunk);
+	if (cursor->decoded_size < chunk->size) {
+		g_free(cursor->decoded);
+		cursor->decoded_size = 0;
+		if (!(cursor->decoded = g_try_malloc(chunk->size)))
+			return SR_ERR_MALLOC;
+		cursor->decoded_size = chunk->size;
+	}
+	ret = chunk_read(cursor->archive, cursor->stream, cursor->chunk,
+		cursor->decoded);
+	if (ret != SR_OK)
+		return ret;
+	cursor->chunk_data = cursor->decoded;
+
+	return SR_OK;
+}
+
+static gpointer prefetch_thread(gpointer data)
+{
+	struct prefetch *pf;
+	struct prefetch_job *job;
+	const struct chunk_info *chunk;
+	struct zip *archive;
+	int ret;
+
+	pf = data;
+
+	/* libzip archive handles must not be shared between threads. */
+	if (!(archive = zip_open(pf->sessionfile, 0, &ret)))
+		sr_err("Failed to open session file '%s': zip error %d.",
+			pf->sessionfile, ret);
+
+	g_mutex_lock(&pf->mutex);
+	while (TRUE) {
+		while (g_queue_is_empty(&pf->pending) && !pf->shutdown)
+			g_cond_wait(&pf->cond_pending, &pf->mutex);
+		if (pf->shutdown)
+			break;
+		job = g_queue_pop_head(&pf->pending);
+		g_mutex_unlock(&pf->mutex);
+
+		chunk = &g_array_index(job->stream->chunks, struct chunk_info,
+			job->chunk);
+		job->data = g_try_malloc(MAX(chunk->size, 1));
+		if (!archive)
+			ret = SR_ERR_DATA;
+		else if (!job->data)
+			ret = SR_ERR_MALLOC;
+		else
+			ret = chunk_read(archive, job->stream, job->chunk,
+				job->data);
+
+		g_mutex_lock(&pf->mutex);
+		job->ret = ret;
+		job->done = TRUE;
+		g_cond_broadcast(&pf->cond_done);
+	}
+	g_mutex_unlock(&pf->mutex);
+
+	if (archive)
+		zip_discard(archive);
+
+	return NULL;
+}
+
+/*
+ * Queue the cursor's next chunks for decompression, up to the prefetch
+ * depth. Chunks which are stored in the mapping need no work.
+ */
+static void prefetch_submit(struct stream_cursor *cursor)
+{
+	struct prefetch *pf;
+	struct prefetch_job *job;
+	const struct stream_index *stream;
+	const struct chunk_info *chunk;
+
+	pf = cursor->prefetch;
+	stream = cursor->stream;
+	while (g_queue_get_length(&cursor->jobs) < pf->depth &&
+			cursor->next_prefetch < stream->chunks->len) {
+		chunk = &g_array_index(stream->chunks, struct chunk_info,
+			cursor->next_prefetch);
+		if (chunk->encoding == CHUNK_RAW && chunk->data) {
+			cursor->next_prefetch++;
+			continue;
+		}
+		job = g_malloc0(sizeof(*job));
+		job->stream = stream;
+		job->chunk = cursor->next_prefetch++;
+		g_queue_push_tail(&cursor->jobs, job);
+		g_mutex_lock(&pf->mutex);
+		g_queue_push_tail(&pf->pending, job);
+		g_cond_signal(&pf->cond_pending);
+		g_mutex_unlock(&pf->mutex);
+	}
+}
+
+/* Take the cursor's current chunk from the prefetch workers. */
+static int cursor_prefetched(struct stream_cursor *cursor)
+{
+	struct prefetch *pf;
+	struct prefetch_job *job;
+
+	pf = cursor->prefetch;
+	prefetch_submit(cursor);
+	job = g_queue_pop_head(&cursor->jobs);
+	if (!job || job->chunk != cursor->chunk) {
+		sr_err("Prefetched chunks of '%s' out of order.",
+			cursor->stream->basename);
+		prefetch_job_free(job);
+		return SR_ERR_BUG;
+	}
+	/* Keep the workers busy with the following chunks. */
+	prefetch_submit(cursor);
+
+	g_mutex_lock(&pf->mutex);
+	while (!job->done)
+		g_cond_wait(&pf->cond_done, &pf->mutex);
+	g_mutex_unlock(&pf->mutex);
+	cursor->job = job;
+	if (job->ret != SR_OK)
+		return job->ret;
+	cursor->chunk_data = job->data;
+
+	return SR_OK;
+}
+
+/*
+ * Prepare reading the cursor's current chunk. Stored chunks get used
+ * from the mapping, encoded chunks get decoded into memory as a whole,
+ * by prefetch workers during playback. Everything else gets read
+ * through libzip, or also comes from the prefetch workers.
+ */
+static int cursor_load(struct stream_cursor *cursor)
+{
+	struct chunk_info *chunk;
+	int ret;
+
+	chunk = &g_array_index(cursor->stream->chunks, struct chunk_info,
+		cursor->chunk);
+	if (chunk->encoding == CHUNK_RAW && chunk->data) {
+		ret = chunk_mapped_check(cursor->stream, chunk, cursor->chunk);
+		if (ret != SR_OK)
+			return ret;
+		cursor->chunk_data = chunk->data;
+		return SR_OK;
+	}
+	if (cursor->prefetch)
+		return cursor_prefetched(cursor);
+	if (chunk->encoding != CHUNK_RAW)
+		return cursor_decode(cursor);
+
+	return cursor_open(cursor);
+}
+
+/* Move on to the next chunk. */
+static void cursor_next(struct stream_cursor *cursor)
+{
+	if (cursor->zf) {
+		zip_fclose(cursor->zf);
+		cursor->zf = NULL;
+	}
+	prefetch_job_free(cursor->job);
+	cursor->job = NULL;
+	cursor->chunk_data = NULL;
+	cursor->chunk++;
+	cursor->offset = 0;
+}
+
+/*
+ * Get the data at the cursor position in memory, if the next len bytes
+ * are available within the current chunk. The cursor does not move.
+ * The data pointer is NULL when the data needs to be read.
+ */
+static int cursor_peek(struct stream_cursor *cursor, size_t len,
+	const uint8_t **data)
+{
+	const struct stream_index *stream;
+	const struct chunk_info *chunk;
+	int ret;
+
+	stream = cursor->stream;
+	*data = NULL;
+	while (cursor->chunk < stream->chunks->len) {
+		if (!cursor->zf && !cursor->chunk_data &&
+				(ret = cursor_load(cursor)) != SR_OK)
+			return ret;
+		if (!cursor->chunk_data)
+			return SR_OK;
+		chunk = &g_array_index(stream->chunks, struct chunk_info,
+			cursor->chunk);
+		if (cursor->offset < chunk->size) {
+			if (chunk->size - cursor->offset >= len)
+				*data = cursor->chunk_data + cursor->offset;
+			break;
+		}
+		cursor_next(cursor);
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Read data of a stream, continuing across chunk boundaries.
+ *
+ * Less than the requested amount of data only gets read at the end
+ * of the stream.
+ */
+static int cursor_read(struct stream_cursor *cursor, uint8_t *buf,
+	size_t len, size_t *read_len)
+{
+	const struct stream_index *stream;
+	const struct chunk_info *chunk;
+	zip_int64_t ret;
+
+	stream = cursor->stream;
+	*read_len = 0;
+	while (len) {
+		if (!cursor->zf && !cursor->chunk_data) {
+			if (cursor->chunk >= stream->chunks->len)
+				break;
+			if ((ret = cursor_load(cursor)) != SR_OK)
+				return ret;
+		}
+		if (cursor->chunk_data) {
+			chunk = &g_array_index(stream->chunks, struct chunk_info,
+				cursor->chunk);
+			ret = MIN(len, chunk->size - MIN(cursor->offset,
+				chunk->size));
+			memcpy(buf, cursor->chunk_data + cursor->offset, ret);
+		} else {
+			ret = zip_fread(cursor->zf, buf, len);
+			if (ret < 0) {
+				sr_err("Failed to read chunk %u of '%s': %s",
+					cursor->chunk, stream->basename,
+					zip_file_strerror(cursor->zf));
+				return SR_ERR_DATA;
+			}
+		}
+		if (ret == 0) {
+			cursor_next(cursor);
+			continue;
+		}
+		cursor->offset += ret;
+		buf += ret;
+		len -= ret;
+		*read_len += ret;
+	}
+
+	return SR_OK;
+}
+
+static void prefetch_stop(struct session_vdev *vdev)
+{
+	struct prefetch *pf;
+	unsigned int i;
+
+	if (!(pf = vdev->prefetch))
+		return;
+
+	g_mutex_lock(&pf->mutex);
+	pf->shutdown = TRUE;
+	g_cond_broadcast(&pf->cond_pending);
+	g_mutex_unlock(&pf->mutex);
+	for (i = 0; i < pf->num_threads; i++)
+		g_thread_join(pf->threads[i]);
+	g_queue_clear(&pf->pending);
+	g_cond_clear(&pf->cond_done);
+	g_cond_clear(&pf->cond_pending);
+	g_mutex_clear(&pf->mutex);
+	g_free(pf->threads);
+	g_free(pf->sessionfile);
+	g_free(pf);
+	vdev->prefetch = NULL;
+}
+
+/*
+ * Start the workers which decompress chunks ahead of playback, unless
+ * all chunks are stored in the mapping anyway.
+ */
+static void prefetch_start(struct session_vdev *vdev)
+{
+	struct prefetch *pf;
+	struct stream_index *stream;
+	struct chunk_info *chunk;
+	GError *error;
+	gboolean needed;
+	guint i, j;
+
+	if (!vdev->prefetch_threads)
+		return;
+	needed = FALSE;
+	for (i = 0; i < vdev->streams->len && !needed; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		for (j = 0; j < stream->chunks->len && !needed; j++) {
+			chunk = &g_array_index(stream->chunks,
+				struct chunk_info, j);
+			needed = chunk->encoding != CHUNK_RAW || !chunk->data;
+		}
+	}
+	if (!needed)
+		return;
+
+	pf = g_malloc0(sizeof(*pf));
+	pf->sessionfile = g_strdup(vdev->sessionfile);
+	pf->depth = vdev->prefetch_depth;
+	g_mutex_init(&pf->mutex);
+	g_cond_init(&pf->cond_pending);
+	g_cond_init(&pf->cond_done);
+	g_queue_init(&pf->pending);
+	pf->threads = g_malloc0(sizeof(*pf->threads) * vdev->prefetch_threads);
+	for (i = 0; i < vdev->prefetch_threads; i++) {
+		error = NULL;
+		pf->threads[i] = g_thread_try_new("sr-session-prefetch",
+			prefetch_thread, pf, &error);
+		if (!pf->threads[i]) {
+			sr_warn("Cannot create prefetch thread: %s.",
+				error->message);
+			g_error_free(error);
+			break;
+		}
+	}
+	pf->num_threads = i;
+	vdev->prefetch = pf;
+	if (!pf->num_threads) {
+		/* Fall back to decompressing in the session thread. */
+		prefetch_stop(vdev);
+		return;
+	}
+	sr_dbg("Using %u prefetch threads, %u chunks ahead.",
+		pf->num_threads, pf->depth);
+}
+
+static void playback_free(struct session_vdev *vdev)
+{
+	guint i;
+
+	prefetch_stop(vdev);
+	if (vdev->cursors) {
+		for (i = 0; i < vdev->streams->len; i++) {
+			cursor_close(&vdev->cursors[i]);
+			g_free(vdev->cursors[i].buf);
+		}
+		g_free(vdev->cursors);
+		vdev->cursors = NULL;
+	}
+	if (vdev->archive) {
+		zip_discard(vdev->archive);
+		vdev->archive = NULL;
+	}
+}
+
+/*
+ * Prepare playback of all streams in lockstep. Each stream gets a
+ * buffer for one block of samples, blocks are limited to CHUNKSIZE
+ * bytes for the stream with the largest unit size.
+ */
+static int playback_init(struct session_vdev *vdev)
+{
+	struct stream_index *stream;
+	size_t unitsize;
+	guint i;
+	int ret;
+
+	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
+		sr_err("Failed to open session file '%s': "
+		       "zip error %d.", vdev->sessionfile, ret);
+		return SR_ERR;
+	}
+
+	unitsize = 1;
+	for (i = 0; i < vdev->streams->len; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		unitsize = MAX(unitsize, stream->unitsize);
+	}
+	vdev->block_samples = CHUNKSIZE / unitsize;
+
+	vdev->cursors = g_new0(struct stream_cursor, vdev->streams->len);
+	for (i = 0; i < vdev->streams->len; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		cursor_init(&vdev->cursors[i], vdev->archive, stream,
+			vdev->start_sample);
+		vdev->cursors[i].buf = g_malloc(vdev->block_samples *
+			stream->unitsize);
+	}
+
+	prefetch_start(vdev);
+	for (i = 0; vdev->prefetch && i < vdev->streams->len; i++) {
+		vdev->cursors[i].prefetch = vdev->prefetch;
+		vdev->cursors[i].next_prefetch = vdev->cursors[i].chunk;
+		prefetch_submit(&vdev->cursors[i]);
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Send the next block of samples of all streams. Logic and analog
+ * packets of a round cover the same range of sample numbers, so that
+ * consumers can process mixed signal data without buffering a stream.
+ */
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct stream_cursor *cursor;
+	const struct stream_index *stream;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
+	const uint8_t *data;
+	gboolean got_data;
+	size_t len;
+	guint i;
 
-	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
+	got_data = FALSE;
+	for (i = 0; i < vdev->streams->len; i++) {
+		cursor = &vdev->cursors[i];
+		stream = cursor->stream;
+		if (cursor->done)
+			continue;
+		len = vdev->block_samples * stream->unitsize;
+		/*
+		 * Blocks within a chunk in memory get sent without copying,
+		 * straight from the mapping or the decoded chunk data.
+		 * Analog data must be aligned for float access, and
+		 * transforms modify packets in place, so they get a copy.
+		 */
+		data = NULL;
+		if (!sdi->session->transforms &&
+				cursor_peek(cursor, len, &data) != SR_OK)
+			return FALSE;
+		if (data && stream->ch && (uintptr_t)data % sizeof(float) != 0)
+			data = NULL;
+		if (data) {
+			cursor->offset += len;
 		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
+			if (cursor_read(cursor, cursor->buf, len, &len) != SR_OK)
 				return FALSE;
-			}
+			data = cursor->buf;
+		}
+		if (len % stream->unitsize != 0) {
+			sr_warn("Size of '%s' not a multiple of the unit"
+				" size %zu.", stream->basename, stream->unitsize);
+			len -= len % stream->unitsize;
+		}
+		if (!len) {
+			cursor->done = TRUE;
+			cursor_close(cursor);
+			continue;
 		}
-	}
-
-	buf = g_malloc(CHUNKSIZE);
 
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
-			got_data = TRUE;
+		if (stream->ch) {
 			packet.type = SR_DF_ANALOG;
 			packet.payload = &analog;
 			/* TODO: Use proper 'digits' value for this device (and its modes). */
 			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-			analog.meaning->channels = g_slist_prepend(NULL,
-					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
+			analog.meaning->channels = g_slist_prepend(NULL, stream->ch);
+			analog.num_samples = len / sizeof(float);
 			analog.meaning->mq = SR_MQ_VOLTAGE;
 			analog.meaning->unit = SR_UNIT_VOLT;
 			analog.meaning->mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
-		} else if (vdev->unitsize) {
-			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
+			analog.data = (float *)data;
+		} else {
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
+			logic.length = len;
+			logic.unitsize = stream->unitsize;
+			logic.data = (void *)data;
+		}
+		vdev->bytes_read += len;
+		sr_session_send(sdi, &packet);
+		if (stream->ch)
+			g_slist_free(analog.meaning->channels);
+		got_data = TRUE;
+	}
+
+	return got_data;
+}
+
+/* Read and check the summary of a stream, if there is one. */
+static int summary_load(struct session_vdev *vdev, struct stream_index *stream)
+{
+	struct stream_summary *sm;
+	struct zip_stat zs;
+	struct zip_file *zf;
+	const uint8_t *p;
+	uint64_t num_samples, len, total;
+	size_t unitsize;
+	unsigned int i;
+	zip_int64_t ret;
+
+	if (stream->summary)
+		return SR_OK;
+	if (!stream->has_summary)
+		return SR_ERR_NA;
+
+	if (zip_stat_index(vdev->index_archive, stream->summary_index, 0, &zs) < 0
+			|| zs.size < SUMMARY_HEADER_SIZE)
+		goto invalid;
+	sm = g_malloc0(sizeof(*sm));
+	if (!(sm->buf = g_try_malloc(zs.size))) {
+		g_free(sm);
+		return SR_ERR_MALLOC;
+	}
+	ret = -1;
+	if ((zf = zip_fopen_index(vdev->index_archive, stream->summary_index, 0))) {
+		ret = zip_fread(zf, sm->buf, zs.size);
+		zip_fclose(zf);
+	}
+	if (ret < 0 || (zip_uint64_t)ret != zs.size)
+		goto invalid_free;
+
+	p = sm->buf;
+	if (memcmp(p, SUMMARY_MAGIC, 4) != 0)
+		goto invalid_free;
+	sm->block_shift = p[4];
+	sm->level_shift = p[5];
+	unitsize = RL16(p + 6);
+	num_samples = RL64(p + 8);
+	sm->num_levels = RL32(p + 16);
+	if (sm->block_shift >= 64 || !sm->level_shift || sm->level_shift >= 64)
+		goto invalid_free;
+	if (unitsize != (stream->ch ? 0 : stream->unitsize))
+		goto invalid_free;
+	if (num_samples != stream->num_samples)
+		goto invalid_free;
+	if (!sm->num_levels || sm->num_levels > SUMMARY_MAX_LEVELS)
+		goto invalid_free;
+	sm->block_size = unitsize ? 2 * unitsize : 2 * sizeof(float);
+
+	/* Each level's blocks cover a group of the previous level's. */
+	p += SUMMARY_HEADER_SIZE;
+	total = 0;
+	len = (num_samples >> sm->block_shift) +
+		!!(num_samples & ((UINT64_C(1) << sm->block_shift) - 1));
+	for (i = 0; i < sm->num_levels; i++) {
+		if (total + len * sm->block_size > zs.size - SUMMARY_HEADER_SIZE)
+			goto invalid_free;
+		sm->levels[i] = p + total;
+		sm->level_len[i] = len;
+		total += len * sm->block_size;
+		len = (len >> sm->level_shift) +
+			!!(len & ((UINT64_C(1) << sm->level_shift) - 1));
+	}
+	if (total != zs.size - SUMMARY_HEADER_SIZE ||
+			sm->level_len[sm->num_levels - 1] != 1)
+		goto invalid_free;
+	stream->summary = sm;
+
+	return SR_OK;
+
+invalid_free:
+	g_free(sm->buf);
+	g_free(sm);
+invalid:
+	sr_err("Invalid summary of '%s'.", stream->basename);
+	return SR_ERR_DATA;
+}
+
+/*
+ * Scan the sample data of a logic channel for the first edge in the
+ * range from start to end. The sample before start gets read as well,
+ * to see an edge at start. Yields end when there is no edge.
+ */
+static int stream_scan_edge(struct session_vdev *vdev,
+	const struct stream_index *stream, size_t byte, uint8_t mask,
+	uint64_t start, uint64_t end, uint64_t *sample)
+{
+	struct stream_cursor cursor;
+	uint8_t *buf, value, prev;
+	uint64_t pos, count;
+	size_t unitsize, len, read_len, i;
+	int ret;
+
+	*sample = end;
+	if (!start)
+		start = 1;
+	if (start >= end)
+		return SR_OK;
+
+	unitsize = stream->unitsize;
+	count = MIN(end - start + 1, CHUNKSIZE / unitsize);
+	buf = g_malloc(count * unitsize);
+	cursor_init(&cursor, vdev->index_archive, stream, start - 1);
+	ret = SR_OK;
+	prev = 0;
+	pos = start - 1;
+	while (pos < end && *sample == end) {
+		len = MIN(end - pos, count);
+		ret = cursor_read(&cursor, buf, len * unitsize, &read_len);
+		if (ret == SR_OK && read_len != len * unitsize)
+			ret = SR_ERR_DATA;
+		if (ret != SR_OK)
+			break;
+		for (i = 0; i < len; i++, pos++) {
+			value = buf[i * unitsize + byte] & mask;
+			if (pos >= start && value != prev) {
+				*sample = pos;
+				break;
+			}
+			prev = value;
+		}
+	}
+	cursor_close(&cursor);
+	g_free(buf);
+
+	return ret;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_num_samples(const struct sr_dev_inst *sdi,
+	const struct sr_channel *ch, uint64_t *num_samples)
+{
+	struct stream_index *stream;
+	int ret;
+
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+	if (!(stream = stream_find(sdi->priv, ch)))
+		return SR_ERR_NA;
+	*num_samples = stream->num_samples;
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_read(const struct sr_dev_inst *sdi,
+	const struct sr_channel *ch, uint64_t start, uint64_t count,
+	void *buf)
+{
+	struct session_vdev *vdev;
+	struct stream_index *stream;
+	struct stream_cursor cursor;
+	size_t len, read_len;
+	int ret;
+
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+	vdev = sdi->priv;
+	if (!(stream = stream_find(vdev, ch)))
+		return SR_ERR_NA;
+	if (start > stream->num_samples || count > stream->num_samples - start)
+		return SR_ERR_ARG;
+
+	len = count * stream->unitsize;
+	cursor_init(&cursor, vdev->index_archive, stream, start);
+	ret = cursor_read(&cursor, buf, len, &read_len);
+	cursor_close(&cursor);
+	if (ret == SR_OK && read_len != len)
+		ret = SR_ERR_DATA;
+
+	return ret;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_seek(const struct sr_dev_inst *sdi,
+	uint64_t sample)
+{
+	struct session_vdev *vdev;
+	struct stream_index *stream;
+	guint i;
+	int ret;
+
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+	vdev = sdi->priv;
+	for (i = 0; i < vdev->streams->len; i++) {
+		stream = &g_array_index(vdev->streams, struct stream_index, i);
+		if (sample > stream->num_samples)
+			return SR_ERR_ARG;
+	}
+	vdev->start_sample = sample;
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_summary(const struct sr_dev_inst *sdi,
+	const struct sr_channel *ch, uint64_t block_samples,
+	uint64_t first_block, uint64_t num_blocks, void *buf)
+{
+	struct session_vdev *vdev;
+	struct stream_index *stream;
+	const struct stream_summary *sm;
+	const uint8_t *src;
+	const float *minmax;
+	uint8_t *flags, mask;
+	float *out;
+	uint64_t num_out, first, last, i, j;
+	unsigned int shift, level;
+	size_t byte;
+	int ret;
+
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+	vdev = sdi->priv;
+	if (!(stream = stream_find(vdev, ch)))
+		return SR_ERR_NA;
+	if (!stream->ch && ch->index >= (int)stream->unitsize * 8)
+		return SR_ERR_ARG;
+	if ((ret = summary_load(vdev, stream)) != SR_OK)
+		return ret;
+	sm = stream->summary;
+
+	if (!block_samples || (block_samples & (block_samples - 1)))
+		return SR_ERR_ARG;
+	for (shift = 0; (UINT64_C(1) << shift) < block_samples; shift++);
+	if (shift < sm->block_shift)
+		return SR_ERR_ARG;
+	num_out = stream->num_samples / block_samples +
+		!!(stream->num_samples % block_samples);
+	if (first_block > num_out || num_blocks > num_out - first_block)
+		return SR_ERR_ARG;
+
+	/* Use the coarsest level with blocks no larger than requested. */
+	shift -= sm->block_shift;
+	level = MIN(shift / sm->level_shift, sm->num_levels - 1);
+	shift -= level * sm->level_shift;
+
+	byte = ch->index / 8;
+	mask = 1 << (ch->index % 8);
+	flags = buf;
+	out = buf;
+	for (i = 0; i < num_blocks; i++) {
+		first = (first_block + i) << shift;
+		last = MIN(first + (UINT64_C(1) << shift),
+			sm->level_len[level]);
+		src = sm->levels[level] + first * sm->block_size;
+		if (!stream->ch) {
+			flags[i] = (src[stream->unitsize + byte] & mask) ?
+				SR_SUMMARY_HIGH : 0;
+			for (j = first; j < last; j++) {
+				if (src[byte] & mask) {
+					flags[i] |= SR_SUMMARY_EDGE;
+					break;
+				}
+				src += sm->block_size;
+			}
 		} else {
-			/*
-			 * Neither analog data, nor logic which has
-			 * unitsize, must be an unexpected API use.
-			 */
-			sr_warn("Neither analog nor logic data. Ignoring.");
+			minmax = (const float *)src;
+			out[2 * i] = minmax[0];
+			out[2 * i + 1] = minmax[1];
+			for (j = first + 1; j < last; j++) {
+				minmax += 2;
+				out[2 * i] = MIN(out[2 * i], minmax[0]);
+				out[2 * i + 1] = MAX(out[2 * i + 1], minmax[1]);
+			}
 		}
-		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
+	}
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_find_edge(const struct sr_dev_inst *sdi,
+	const struct sr_channel *ch, uint64_t start, uint64_t *sample)
+{
+	struct session_vdev *vdev;
+	struct stream_index *stream;
+	const struct stream_summary *sm;
+	uint64_t block, pos, end, group;
+	unsigned int level;
+	size_t byte;
+	uint8_t mask;
+	int ret;
+
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+	vdev = sdi->priv;
+	if (!(stream = stream_find(vdev, NULL)))
+		return SR_ERR_NA;
+	if (ch->index >= (int)stream->unitsize * 8 ||
+			start > stream->num_samples)
+		return SR_ERR_ARG;
+	byte = ch->index / 8;
+	mask = 1 << (ch->index % 8);
+
+	ret = summary_load(vdev, stream);
+	if (ret == SR_ERR_NA)
+		return stream_scan_edge(vdev, stream, byte, mask, start,
+			stream->num_samples, sample);
+	if (ret != SR_OK)
+		return ret;
+	sm = stream->summary;
+
+	/* Scan the rest of the block which holds the start. */
+	block = start >> sm->block_shift;
+	end = MIN((block + 1) << sm->block_shift, stream->num_samples);
+	ret = stream_scan_edge(vdev, stream, byte, mask, start, end, sample);
+	if (ret != SR_OK || *sample < end || end == stream->num_samples)
+		return ret;
+
+	/*
+	 * Find the next block of the finest level with an edge. Move up
+	 * a level at the end of each group of blocks, and back down into
+	 * the first block of a level which has the edge.
+	 */
+	group = UINT64_C(1) << sm->level_shift;
+	level = 0;
+	pos = block + 1;
+	while (pos < sm->level_len[level]) {
+		if (sm->levels[level][pos * sm->block_size + byte] & mask) {
+			if (!level)
+				break;
+			level--;
+			pos <<= sm->level_shift;
+			continue;
 		}
-	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+		pos++;
+		if (!(pos & (group - 1)) && level + 1 < sm->num_levels) {
+			level++;
+			pos >>= sm->level_shift;
 		}
 	}
-	g_free(buf);
+	if (pos >= sm->level_len[level]) {
+		*sample = stream->num_samples;
+		return SR_OK;
+	}
 
-	return got_data;
+	start = pos << sm->block_shift;
+	end = MIN(start + (UINT64_C(1) << sm->block_shift),
+		stream->num_samples);
+	ret = stream_scan_edge(vdev, stream, byte, mask, start, end, sample);
+	if (ret == SR_OK && *sample == end) {
+		sr_err("Summary of '%s' has no edge in block %" PRIu64 ".",
+			stream->basename, pos);
+		return SR_ERR_DATA;
+	}
+
+	return ret;
+}
+
+/** @private */
+SR_PRIV int sr_session_vdev_prefetch_set(const struct sr_dev_inst *sdi,
+	unsigned int threads, unsigned int depth)
+{
+	struct session_vdev *vdev;
+
+	if (threads > MAX_PREFETCH_THREADS || (threads && !depth))
+		return SR_ERR_ARG;
+	vdev = sdi->priv;
+	vdev->prefetch_threads = threads;
+	vdev->prefetch_depth = depth;
+
+	return SR_OK;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -216,14 +1667,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
-	}
+	playback_free(vdev);
 
 	std_session_send_df_end(sdi);
 
@@ -237,10 +1681,19 @@ static int dev_open(struct sr_dev_inst *sdi)
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct session_vdev *vdev;
+	unsigned int threads;
 
 	di = sdi->driver;
 	drvc = di->context;
 	vdev = g_malloc0(sizeof(struct session_vdev));
+	/* Leave a processor for the session thread. */
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	threads = g_get_num_processors();
+#else
+	threads = 2;
+#endif
+	vdev->prefetch_threads = CLAMP(threads - 1, 1, 8);
+	vdev->prefetch_depth = DEFAULT_PREFETCH_DEPTH;
 	sdi->priv = vdev;
 	drvc->instances = g_slist_append(drvc->instances, sdi);
 
@@ -249,7 +1702,9 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
-	const struct session_vdev *const vdev = sdi->priv;
+	struct session_vdev *vdev = sdi->priv;
+	playback_free(vdev);
+	index_free(vdev);
 	g_free(vdev->sessionfile);
 	g_free(vdev->capturefile);
 
@@ -300,22 +1755,27 @@ static int config_set(uint32_t key, GVariant *data,
 		sr_info("Setting samplerate to %" PRIu64 ".", vdev->samplerate);
 		break;
 	case SR_CONF_SESSIONFILE:
+		index_free(vdev);
 		g_free(vdev->sessionfile);
 		vdev->sessionfile = g_strdup(g_variant_get_string(data, NULL));
 		sr_info("Setting sessionfile to '%s'.", vdev->sessionfile);
 		break;
 	case SR_CONF_CAPTUREFILE:
+		index_free(vdev);
 		g_free(vdev->capturefile);
 		vdev->capturefile = g_strdup(g_variant_get_string(data, NULL));
 		sr_info("Setting capturefile to '%s'.", vdev->capturefile);
 		break;
 	case SR_CONF_CAPTURE_UNITSIZE:
+		index_free(vdev);
 		vdev->unitsize = g_variant_get_uint64(data);
 		break;
 	case SR_CONF_NUM_LOGIC_CHANNELS:
+		index_free(vdev);
 		vdev->num_logic_channels = g_variant_get_int32(data);
 		break;
 	case SR_CONF_NUM_ANALOG_CHANNELS:
+		index_free(vdev);
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
 	default:
@@ -335,30 +1795,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
 	int ret;
-	GSList *l;
-	struct sr_channel *ch;
 
 	vdev = sdi->priv;
 	vdev->bytes_read = 0;
-	vdev->cur_analog_channel = 0;
-	vdev->analog_channels = g_array_sized_new(FALSE, FALSE,
-			sizeof(struct sr_channel *), vdev->num_analog_channels);
-	for (l = sdi->channels; l; l = l->next) {
-		ch = l->data;
-		if (ch->type == SR_CHANNEL_ANALOG)
-			g_array_append_val(vdev->analog_channels, ch);
-	}
-	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
 
+	if ((ret = index_build(sdi)) != SR_OK)
+		return ret;
+
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
-	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
-		sr_err("Failed to open session file '%s': "
-		       "zip error %d.", vdev->sessionfile, ret);
-		return SR_ERR;
-	}
+	playback_free(vdev);
+	if ((ret = playback_init(vdev)) != SR_OK)
+		return ret;
 
 	std_session_send_df_header(sdi);
 
@@ -20,6 +20,7 @@
 #include <config.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <zip.h>
 #include <errno.h>
 #include <glib.h>
@@ -151,7 +152,11 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	zip_fclose(zf);
 	s[ret] = '\0';
 	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	/*
+	 * Version 3 files may hold LZO compressed sample data chunks,
+	 * version 4 files transition encoded logic data chunks.
+	 */
+	if (version == 0 || version > 4) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
@@ -393,4 +398,446 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+/* Check whether a device instance was created by sr_session_load(). */
+static gboolean is_session_file_dev(const struct sr_dev_inst *sdi)
+{
+	return sdi && sdi->driver == &session_driver && sdi->priv;
+}
+
+/**
+ * Get the number of samples of a loaded session file device.
+ *
+ * The session file's chunk index gets built on first use. It only
+ * takes the archive's directory, no sample data is decompressed.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param ch An analog channel of the device, or NULL (or any logic
+ *           channel) for the logic data.
+ * @param num_samples Pointer to store the number of samples in.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_NA The device has no data for the channel.
+ * @retval SR_ERR The session file could not be opened.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_num_samples(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t *num_samples)
+{
+	if (!is_session_file_dev(sdi) || !num_samples)
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_num_samples(sdi, ch, num_samples);
+}
+
+/**
+ * Read a range of samples from a loaded session file device.
+ *
+ * Only the chunks which cover the range get decompressed, so that any
+ * window of a capture can be fetched in time proportional to the
+ * window and chunk sizes, regardless of its position in the file.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param ch An analog channel of the device, or NULL (or any logic
+ *           channel) for the logic data.
+ * @param start Number of the first sample to read.
+ * @param count Number of samples to read.
+ * @param buf Buffer which receives the samples. Logic data takes
+ *            @a count times the unit size bytes, analog data takes
+ *            @a count float values.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments, or range past the end of data.
+ * @retval SR_ERR_NA The device has no data for the channel.
+ * @retval SR_ERR_DATA The session file's data is damaged.
+ * @retval SR_ERR The session file could not be opened.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_read(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t count,
+		void *buf)
+{
+	if (!is_session_file_dev(sdi) || (count && !buf))
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_read(sdi, ch, start, count, buf);
+}
+
+/**
+ * Set the position where playback of a loaded session file starts.
+ *
+ * Subsequent runs of the session send the data of all of the device's
+ * channels from the given sample on.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param sample Number of the first sample to send.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments, or position past the end of data.
+ * @retval SR_ERR The session file could not be opened.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_seek(const struct sr_dev_inst *sdi,
+		uint64_t sample)
+{
+	if (!is_session_file_dev(sdi))
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_seek(sdi, sample);
+}
+
+/**
+ * Get a zoomed out view of a channel of a loaded session file.
+ *
+ * This uses the summaries which the srzip output module stores with
+ * the "summaries" option, so the cost does not depend on the number of
+ * samples covered. Each block of the view covers block_samples samples,
+ * the last block of the capture may cover less.
+ *
+ * For logic channels, each block of the view is a byte of
+ * enum sr_summary_flag values. For analog channels, each block
+ * is a pair of floats, the minimum and the maximum value.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param ch The channel to summarize.
+ * @param block_samples Number of samples per block, a power of two of
+ *                      at least 1024.
+ * @param first_block Number of the first block to get.
+ * @param num_blocks Number of blocks to get.
+ * @param buf Buffer which receives the blocks.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments, or blocks past the end of data.
+ * @retval SR_ERR_NA The session file has no summary of the channel.
+ * @retval SR_ERR_DATA The summary is inconsistent with the sample data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_summary(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t block_samples,
+		uint64_t first_block, uint64_t num_blocks, void *buf)
+{
+	if (!is_session_file_dev(sdi) || !ch || (num_blocks && !buf))
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_summary(sdi, ch, block_samples,
+		first_block, num_blocks, buf);
+}
+
+/**
+ * Find the next edge of a logic channel of a loaded session file.
+ *
+ * An edge is a sample in which the channel differs from the previous
+ * sample. With a summary in the session file, the search takes
+ * logarithmic time. Without one, all samples get scanned.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param ch The logic channel to search.
+ * @param start Number of the first sample to consider.
+ * @param sample Receives the number of the sample with the edge, or the
+ *               number of samples when there is no edge.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_DATA The session file could not be read.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_find_edge(const struct sr_dev_inst *sdi,
+		const struct sr_channel *ch, uint64_t start, uint64_t *sample)
+{
+	if (!is_session_file_dev(sdi) || !ch || !sample ||
+			ch->type != SR_CHANNEL_LOGIC)
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_find_edge(sdi, ch, start, sample);
+}
+
+/**
+ * Configure the decompression of a loaded session file during playback.
+ *
+ * Chunks of sample data which are compressed or encoded get decoded by
+ * worker threads ahead of playback, while the session thread sends the
+ * current chunk. Packets still get sent in order. By default, one
+ * thread less than there are processors is used, up to 8 threads, with
+ * two chunks per stream decompressed ahead. Each of those chunks takes
+ * up memory, so larger depths mostly help files with few streams. The
+ * settings take effect when the session gets started.
+ *
+ * @param sdi A device of a session which was loaded by sr_session_load().
+ * @param threads Number of worker threads, up to 32. With 0 threads,
+ *                chunks get decompressed in the session thread.
+ * @param depth Number of chunks per stream to decompress ahead, at
+ *              least 1 if there are worker threads.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_prefetch_set(const struct sr_dev_inst *sdi,
+		unsigned int threads, unsigned int depth)
+{
+	if (!is_session_file_dev(sdi))
+		return SR_ERR_ARG;
+
+	return sr_session_vdev_prefetch_set(sdi, threads, depth);
+}
+
+/** @cond PRIVATE */
+#define RECOVER_BUF_SIZE	(1024 * 1024)
+/** @endcond */
+
+/* A complete member found in a damaged session file. */
+struct recover_entry {
+	/* The member as its local header describes it. */
+	struct sr_zip_entry zip;
+	/* End of the member data. */
+	uint64_t end;
+	/* Whether the central directory lists the member. */
+	gboolean keep;
+};
+
+/* Find the complete members of an archive by their local headers. */
+static GArray *recover_scan(const uint8_t *base, uint64_t size)
+{
+	GArray *entries;
+	struct recover_entry entry;
+	uint64_t offset, data_offset;
+
+	entries = g_array_new(FALSE, FALSE, sizeof(struct recover_entry));
+	offset = 0;
+	while (sr_zip_local_header_parse(base, size, offset, &entry.zip,
+			&data_offset)) {
+		if ((entry.zip.flags & ZIP_FLAG_DATA_DESC) || !entry.zip.name[0] ||
+				entry.zip.comp_size == G_MAXUINT32 ||
+				size - data_offset < entry.zip.comp_size) {
+			g_free(entry.zip.name);
+			break;
+		}
+		entry.end = data_offset + entry.zip.comp_size;
+		entry.keep = FALSE;
+		g_array_append_val(entries, entry);
+		offset = entry.end;
+	}
+
+	return entries;
+}
+
+/*
+ * Select the members which end before the limit. Of several members
+ * with the same name, like the journal copy and the final version of
+ * the metadata, the last one wins.
+ */
+static GPtrArray *recover_select(GArray *entries, uint64_t limit)
+{
+	struct recover_entry *entry;
+	GHashTable *names;
+	GPtrArray *members;
+	guint i;
+
+	names = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = entries->len; i-- > 0; ) {
+		entry = &g_array_index(entries, struct recover_entry, i);
+		entry->keep = entry->end <= limit &&
+			!g_hash_table_contains(names, entry->zip.name);
+		if (entry->keep)
+			g_hash_table_add(names, entry->zip.name);
+	}
+	g_hash_table_destroy(names);
+
+	members = g_ptr_array_new();
+	for (i = 0; i < entries->len; i++) {
+		entry = &g_array_index(entries, struct recover_entry, i);
+		if (entry->keep)
+			g_ptr_array_add(members, entry);
+	}
+
+	return members;
+}
+
+static gboolean recover_has_member(GPtrArray *members, const char *name)
+{
+	const struct recover_entry *entry;
+	guint i;
+
+	for (i = 0; i < members->len; i++) {
+		entry = g_ptr_array_index(members, i);
+		if (!strcmp(entry->zip.name, name))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Replace everything after the last member by a central directory
+ * which lists the members.
+ */
+static int recover_write_directory(const char *filename, GPtrArray *members)
+{
+	const struct recover_entry *entry;
+	GByteArray *cd;
+	uint64_t cd_offset;
+	FILE *f;
+	guint i;
+	int ret;
+
+	cd_offset = 0;
+	if (members->len) {
+		entry = g_ptr_array_index(members, members->len - 1);
+		cd_offset = entry->end;
+	}
+
+	cd = g_byte_array_new();
+	for (i = 0; i < members->len; i++) {
+		entry = g_ptr_array_index(members, i);
+		sr_zip_cd_entry_append(cd, &entry->zip);
+	}
+	sr_zip_cd_end_append(cd, members->len, cd_offset, cd->len);
+
+	/* Writes in append mode go to the end of the truncated file. */
+	ret = SR_OK;
+	if (!(f = g_fopen(filename, "ab"))) {
+		sr_err("Failed to open '%s': %s.", filename, g_strerror(errno));
+		g_byte_array_free(cd, TRUE);
+		return SR_ERR_IO;
+	}
+	if (ftruncate(fileno(f), cd_offset) != 0 ||
+			fwrite(cd->data, cd->len, 1, f) != 1) {
+		sr_err("Failed to write '%s': %s.", filename, g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+	if (fclose(f) != 0 && ret == SR_OK) {
+		sr_err("Failed to close '%s': %s.", filename, g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+	g_byte_array_free(cd, TRUE);
+
+	return ret;
+}
+
+/*
+ * Read all members of the rebuilt archive, which checks their CRC.
+ * Yields the number of members before the first damaged one.
+ */
+static int recover_verify(const char *filename, guint *num_good)
+{
+	struct zip *archive;
+	struct zip_file *zf;
+	zip_int64_t num_entries, i, len;
+	uint8_t *buf;
+	int ret;
+
+	if (!(archive = zip_open(filename, 0, &ret))) {
+		sr_err("Failed to open rebuilt '%s': zip error %d.",
+			filename, ret);
+		return SR_ERR_DATA;
+	}
+	buf = g_malloc(RECOVER_BUF_SIZE);
+	num_entries = zip_get_num_entries(archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		if (!(zf = zip_fopen_index(archive, i, 0)))
+			break;
+		while ((len = zip_fread(zf, buf, RECOVER_BUF_SIZE)) > 0)
+			;
+		zip_fclose(zf);
+		if (len < 0)
+			break;
+	}
+	g_free(buf);
+	zip_discard(archive);
+	*num_good = i;
+
+	return SR_OK;
+}
+
+/**
+ * Recover a session file which was not completed.
+ *
+ * When the srzip output module's writer gets interrupted, for example
+ * by a crash, the session file lacks the archive's central directory.
+ * This rebuilds the directory from the members which were completely
+ * written, in place. Damaged members and everything after them get
+ * dropped. Files which are complete are left alone.
+ *
+ * Only session files which were written in journal mode carry the
+ * metadata before the sample data, and can be recovered.
+ *
+ * @param filename The name of the session file.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_IO The file could not be read or written.
+ * @retval SR_ERR_DATA Too little of the session file was written to
+ *                     recover it.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_file_recover(const char *filename)
+{
+	struct zip *archive;
+	struct recover_entry *entry;
+	GMappedFile *map;
+	GError *error;
+	GArray *entries;
+	GPtrArray *members;
+	uint64_t limit;
+	guint i, num_good;
+	int ret;
+
+	if (!filename)
+		return SR_ERR_ARG;
+
+	if ((archive = zip_open(filename, 0, &ret))) {
+		zip_discard(archive);
+		sr_info("Session file '%s' is complete.", filename);
+		return SR_OK;
+	}
+
+	error = NULL;
+	if (!(map = g_mapped_file_new(filename, FALSE, &error))) {
+		sr_err("Failed to map '%s': %s.", filename, error->message);
+		g_error_free(error);
+		return SR_ERR_IO;
+	}
+	entries = recover_scan((const uint8_t *)g_mapped_file_get_contents(map),
+		g_mapped_file_get_length(map));
+	g_mapped_file_unref(map);
+
+	limit = G_MAXUINT64;
+	while (TRUE) {
+		members = recover_select(entries, limit);
+		if (!recover_has_member(members, "version") ||
+				!recover_has_member(members, "metadata")) {
+			sr_err("No metadata in '%s', cannot recover it.",
+				filename);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		ret = recover_write_directory(filename, members);
+		if (ret == SR_OK)
+			ret = recover_verify(filename, &num_good);
+		if (ret != SR_OK || num_good == members->len)
+			break;
+		entry = g_ptr_array_index(members, num_good);
+		sr_warn("Dropping damaged member '%s' of '%s' and all "
+			"members after it.", entry->zip.name, filename);
+		limit = entry->zip.offset;
+		g_ptr_array_free(members, TRUE);
+	}
+	if (ret == SR_OK)
+		sr_info("Recovered %u members of '%s'.", members->len, filename);
+	g_ptr_array_free(members, TRUE);
+
+	for (i = 0; i < entries->len; i++)
+		g_free(g_array_index(entries, struct recover_entry, i).zip.name);
+	g_array_free(entries, TRUE);
+
+	return ret;
+}
+
 /** @} */
@@ -26,6 +26,37 @@
 #define LOG_PREFIX "soft-trigger"
 /** @endcond */
 
+/*
+ * A trigger stage gets compiled into per-channel bit masks in the
+ * layout of a logic sample. For up to 64 logic channels the masks are
+ * also kept as (little endian) words, so that a sample gets checked
+ * by a few word-wide operations.
+ */
+struct soft_trigger_stage {
+	gboolean has_edges;
+	uint8_t *masks;
+	uint8_t *level_mask;
+	uint8_t *level_value;
+	uint8_t *rising;
+	uint8_t *falling;
+	uint8_t *edge;
+	uint64_t level_mask64;
+	uint64_t level_value64;
+	uint64_t rising64;
+	uint64_t falling64;
+	uint64_t edge64;
+};
+
+/* A part of a retained sample buffer, held for pre-trigger data. */
+struct pre_trigger_segment {
+	struct sr_buffer *buf;
+	uint8_t *data;
+	int len;
+};
+
+#define BYTES_ONES  0x0101010101010101ULL
+#define BYTES_HIGHS 0x8080808080808080ULL
+
 SR_PRIV int logic_channel_unitsize(GSList *channels)
 {
 	int number = 0;
@@ -41,9 +72,130 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+static inline uint64_t sample_word(const uint8_t *p, int unitsize)
+{
+	uint64_t word;
+
+	switch (unitsize) {
+	case 1:
+		return p[0];
+	case 2:
+		return RL16(p);
+	case 4:
+		return RL32(p);
+	case 8:
+		return RL64(p);
+	}
+
+	word = 0;
+	while (unitsize--)
+		word = (word << 8) | p[unitsize];
+
+	return word;
+}
+
+static int stage_compile(struct soft_trigger_logic *stl,
+		struct soft_trigger_stage *cs, const struct sr_trigger_stage *stage)
+{
+	const struct sr_trigger_match *match;
+	const struct sr_channel *ch;
+	GSList *l;
+	uint8_t *mask, bit;
+	int unitsize, idx;
+
+	unitsize = stl->unitsize;
+	cs->masks = g_malloc0(5 * unitsize);
+	cs->level_mask = cs->masks;
+	cs->level_value = cs->level_mask + unitsize;
+	cs->rising = cs->level_value + unitsize;
+	cs->falling = cs->rising + unitsize;
+	cs->edge = cs->falling + unitsize;
+
+	if (!stage->matches)
+		/* No matches supplied, client error. */
+		return SR_ERR_ARG;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		ch = match->channel;
+		if (!ch->enabled)
+			/* Ignore disabled channels with a trigger. */
+			continue;
+		idx = ch->index;
+		if (ch->type != SR_CHANNEL_LOGIC || idx >= unitsize * 8) {
+			sr_err("Cannot soft trigger on channel %s.", ch->name);
+			return SR_ERR_ARG;
+		}
+		bit = 1 << (idx % 8);
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+		case SR_TRIGGER_ONE:
+			cs->level_mask[idx / 8] |= bit;
+			if (match->match == SR_TRIGGER_ONE)
+				cs->level_value[idx / 8] |= bit;
+			continue;
+		case SR_TRIGGER_RISING:
+			mask = cs->rising;
+			break;
+		case SR_TRIGGER_FALLING:
+			mask = cs->falling;
+			break;
+		case SR_TRIGGER_EDGE:
+			mask = cs->edge;
+			break;
+		default:
+			sr_err("Unsupported trigger match %d on channel %s.",
+				match->match, ch->name);
+			return SR_ERR_ARG;
+		}
+		mask[idx / 8] |= bit;
+		cs->has_edges = TRUE;
+	}
+
+	if (unitsize <= 8) {
+		cs->level_mask64 = sample_word(cs->level_mask, unitsize);
+		cs->level_value64 = sample_word(cs->level_value, unitsize);
+		cs->rising64 = sample_word(cs->rising, unitsize);
+		cs->falling64 = sample_word(cs->falling, unitsize);
+		cs->edge64 = sample_word(cs->edge, unitsize);
+	}
+
+	return SR_OK;
+}
+
+static void stages_compile(struct soft_trigger_logic *stl)
+{
+	GSList *l;
+	int i;
+
+	stl->num_stages = g_slist_length(stl->trigger->stages);
+	stl->stages = g_malloc0(stl->num_stages * sizeof(*stl->stages));
+	stl->stages_valid = stl->num_stages > 0;
+	for (l = stl->trigger->stages, i = 0; l; l = l->next, i++) {
+		if (stage_compile(stl, &stl->stages[i], l->data) != SR_OK)
+			stl->stages_valid = FALSE;
+	}
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
+{
+	return soft_trigger_logic_new_full(sdi, trigger,
+		pre_trigger_samples, FALSE);
+}
+
+/*
+ * With 'retain_buffers' set, pre-trigger data is kept by holding
+ * references to the sample buffers passed to
+ * soft_trigger_logic_check_buffer() instead of copying it into a
+ * circular buffer, and gets sent from these buffers on trigger. This
+ * suits deep pre-trigger windows, the driver's buffer pool has to be
+ * able to hand out replacement buffers meanwhile.
+ */
+SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new_full(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, gboolean retain_buffers)
 {
 	struct soft_trigger_logic *stl;
 
@@ -52,7 +204,13 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	stl->trigger = trigger;
 	stl->unitsize = logic_channel_unitsize(sdi->channels);
 	stl->prev_sample = g_malloc0(stl->unitsize);
+	stages_compile(stl);
 	stl->pre_trigger_size = stl->unitsize * pre_trigger_samples;
+	if (retain_buffers) {
+		stl->retain_buffers = TRUE;
+		stl->pre_trigger_segments = g_queue_new();
+		return stl;
+	}
 	stl->pre_trigger_buffer = g_try_malloc(stl->pre_trigger_size);
 	if (pre_trigger_samples > 0 && !stl->pre_trigger_buffer) {
 		/*
@@ -73,16 +231,85 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	return stl;
 }
 
+static void pre_trigger_segment_free(struct pre_trigger_segment *seg)
+{
+	sr_buffer_unref(seg->buf);
+	g_free(seg);
+}
+
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	struct pre_trigger_segment *seg;
+	int i;
+
+	if (stl->pre_trigger_segments) {
+		while ((seg = g_queue_pop_head(stl->pre_trigger_segments)))
+			pre_trigger_segment_free(seg);
+		g_queue_free(stl->pre_trigger_segments);
+	}
+	for (i = 0; i < stl->num_stages; i++)
+		g_free(stl->stages[i].masks);
+	g_free(stl->stages);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
 }
 
+static void pre_trigger_retain(struct soft_trigger_logic *stl,
+		struct sr_buffer *sbuf, uint8_t *buf, int len)
+{
+	struct pre_trigger_segment *seg;
+	GQueue *segs;
+
+	segs = stl->pre_trigger_segments;
+	if (len == 0 || stl->pre_trigger_size == 0)
+		return;
+
+	seg = g_malloc(sizeof(*seg));
+	if (sbuf) {
+		seg->buf = sr_buffer_ref(sbuf);
+		seg->data = buf;
+	} else {
+		/* Not in a sample buffer, have to keep a copy. */
+		if (len > stl->pre_trigger_size) {
+			buf += len - stl->pre_trigger_size;
+			len = stl->pre_trigger_size;
+		}
+		seg->buf = sr_buffer_new(len);
+		if (!seg->buf) {
+			sr_err("Cannot keep %d bytes of pre-trigger data.", len);
+			g_free(seg);
+			return;
+		}
+		memcpy(seg->buf->data, buf, len);
+		seg->data = seg->buf->data;
+	}
+	seg->len = len;
+	g_queue_push_tail(segs, seg);
+	stl->pre_trigger_fill += len;
+
+	/* Release the buffers which dropped out of the pre-trigger window. */
+	while ((seg = g_queue_peek_head(segs)) &&
+			stl->pre_trigger_fill - seg->len >= stl->pre_trigger_size) {
+		g_queue_pop_head(segs);
+		stl->pre_trigger_fill -= seg->len;
+		pre_trigger_segment_free(seg);
+	}
+	if (seg && stl->pre_trigger_fill > stl->pre_trigger_size) {
+		seg->data += stl->pre_trigger_fill - stl->pre_trigger_size;
+		seg->len -= stl->pre_trigger_fill - stl->pre_trigger_size;
+		stl->pre_trigger_fill = stl->pre_trigger_size;
+	}
+}
+
 static void pre_trigger_append(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len)
+		struct sr_buffer *sbuf, uint8_t *buf, int len)
 {
+	if (stl->retain_buffers) {
+		pre_trigger_retain(stl, sbuf, buf, len);
+		return;
+	}
+
 	/* Avoid uselessly copying more than the pre-trigger size. */
 	if (len > stl->pre_trigger_size) {
 		buf += len - stl->pre_trigger_size;
@@ -112,6 +339,7 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct pre_trigger_segment *seg;
 
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
@@ -120,6 +348,20 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	if (pre_trigger_samples)
 		*pre_trigger_samples = 0;
 
+	if (stl->retain_buffers) {
+		/* Send the retained buffers' data without copying it. */
+		while ((seg = g_queue_pop_head(stl->pre_trigger_segments))) {
+			logic.length = seg->len;
+			logic.data = seg->data;
+			sr_session_send_buffer(stl->sdi, &packet, seg->buf);
+			if (pre_trigger_samples)
+				*pre_trigger_samples += seg->len / stl->unitsize;
+			pre_trigger_segment_free(seg);
+		}
+		stl->pre_trigger_fill = 0;
+		return;
+	}
+
 	/* If pre-trigger buffer not full, rewind head to the first valid sample. */
 	if (stl->pre_trigger_fill < stl->pre_trigger_size)
 		stl->pre_trigger_head = stl->pre_trigger_buffer;
@@ -138,36 +380,143 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+static inline gboolean stage_match_word(const struct soft_trigger_stage *cs,
+		uint64_t cur, uint64_t prev)
 {
-	int bit, prev_bit;
-	gboolean result;
+	uint64_t changed;
+
+	if ((cur ^ cs->level_value64) & cs->level_mask64)
+		return FALSE;
+	if (!cs->has_edges)
+		return TRUE;
+
+	changed = cur ^ prev;
+	if (cs->edge64 & ~changed)
+		return FALSE;
+	if (cs->rising64 & ~(changed & cur))
+		return FALSE;
+	if (cs->falling64 & ~(changed & ~cur))
+		return FALSE;
+
+	return TRUE;
+}
+
+static gboolean stage_match_bytes(const struct soft_trigger_stage *cs,
+		int unitsize, const uint8_t *cur, const uint8_t *prev)
+{
+	uint8_t changed;
+	int i;
 
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	for (i = 0; i < unitsize; i++) {
+		if ((cur[i] ^ cs->level_value[i]) & cs->level_mask[i])
+			return FALSE;
+		if (!cs->has_edges)
+			continue;
+		changed = cur[i] ^ prev[i];
+		if (cs->edge[i] & ~changed)
+			return FALSE;
+		if (cs->rising[i] & ~(changed & cur[i]))
+			return FALSE;
+		if (cs->falling[i] & ~(changed & ~cur[i]))
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
 	}
 
-	return result;
+	return TRUE;
+}
+
+/* Check whether the sample at index 'idx' within buf matches a stage. */
+static inline gboolean stage_match(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *buf, int idx)
+{
+	const uint8_t *cur, *prev;
+	int unitsize;
+
+	unitsize = stl->unitsize;
+	cur = buf + idx * unitsize;
+	if (idx > 0)
+		prev = cur - unitsize;
+	else if (stl->have_prev_sample)
+		prev = stl->prev_sample;
+	else if (cs->has_edges)
+		/* First sample, don't have enough for an edge match yet. */
+		return FALSE;
+	else
+		prev = cur;
+
+	if (unitsize <= 8)
+		return stage_match_word(cs, sample_word(cur, unitsize),
+			sample_word(prev, unitsize));
+
+	return stage_match_bytes(cs, unitsize, cur, prev);
+}
+
+/*
+ * Skip blocks of eight single byte samples which cannot match a stage.
+ * Each byte of the word-wide result is zero where the sample matches.
+ * Previous samples are read from buf, so 'idx' must be at least 1.
+ * Returns the index of the first block which may contain a match, or
+ * of the trailing partial block.
+ */
+static int stage_skip_u8(const struct soft_trigger_stage *cs,
+		const uint8_t *buf, int idx, int count)
+{
+	uint64_t level_mask, level_value, rising, falling, edge;
+	uint64_t cur, changed, res;
+
+	level_mask = cs->level_mask64 * BYTES_ONES;
+	level_value = cs->level_value64 * BYTES_ONES;
+	rising = cs->rising64 * BYTES_ONES;
+	falling = cs->falling64 * BYTES_ONES;
+	edge = cs->edge64 * BYTES_ONES;
+
+	while (idx + 8 <= count) {
+		cur = RL64(buf + idx);
+		changed = cur ^ RL64(buf + idx - 1);
+		res = (cur ^ level_value) & level_mask;
+		res |= edge & ~changed;
+		res |= rising & ~(changed & cur);
+		res |= falling & ~(changed & ~cur);
+		if ((res - BYTES_ONES) & ~res & BYTES_HIGHS)
+			break;
+		idx += 8;
+	}
+
+	return idx;
+}
+
+/* Returns the index of the first sample from 'idx' on matching a stage. */
+static int stage_find(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *buf,
+		int idx, int count)
+{
+	int end;
+
+	if (stl->unitsize != 1) {
+		for (; idx < count; idx++) {
+			if (stage_match(stl, cs, buf, idx))
+				break;
+		}
+		return idx;
+	}
+
+	/* The first sample's predecessor is not in buf. */
+	if (idx == 0) {
+		if (count > 0 && stage_match(stl, cs, buf, 0))
+			return 0;
+		idx = 1;
+	}
+
+	/* Check candidate blocks sample by sample, skip the others. */
+	while (idx < count) {
+		idx = stage_skip_u8(cs, buf, idx, count);
+		end = MIN(idx + 8, count);
+		for (; idx < end; idx++) {
+			if (stage_match(stl, cs, buf, idx))
+				return idx;
+		}
+	}
+
+	return count;
 }
 
 /* Returns the offset (in samples) within buf of where the trigger
@@ -175,45 +524,53 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
+	return soft_trigger_logic_check_buffer(stl, NULL, buf, len,
+		pre_trigger_samples);
+}
+
+/*
+ * Like soft_trigger_logic_check(), with 'buf' pointing into the sample
+ * buffer 'sbuf', which gets retained for pre-trigger data if the
+ * trigger was created with retain_buffers set.
+ */
+SR_PRIV int soft_trigger_logic_check_buffer(struct soft_trigger_logic *stl,
+		struct sr_buffer *sbuf, uint8_t *buf, int len,
+		int *pre_trigger_samples)
+{
+	const struct soft_trigger_stage *cs;
 	int offset;
-	int i;
+	int i, count;
 	gboolean match_found;
 
-	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
-			/* No matches supplied, client error. */
-			return SR_ERR_ARG;
+	if (!stl->stages_valid)
+		return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+	offset = -1;
+	count = len / stl->unitsize;
+	for (i = 0; i < count; i++) {
+		cs = &stl->stages[stl->cur_stage];
+		if (stl->cur_stage == 0) {
+			/* Scan ahead for the first stage's match. */
+			i = stage_find(stl, cs, buf, i, count);
+			if (i >= count)
 				break;
-			}
+			match_found = TRUE;
+		} else {
+			match_found = stage_match(stl, cs, buf, i);
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage < stl->num_stages - 1) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
 				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
+				pre_trigger_append(stl, sbuf, buf,
+					i * stl->unitsize);
 				pre_trigger_send(stl, pre_trigger_samples);
 
 				/* Fire trigger. */
-				offset = i / stl->unitsize;
+				offset = i;
 
 				std_session_send_df_trigger(stl->sdi);
 				break;
@@ -228,7 +585,7 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 			 * which the counter increment at the end of the loop
 			 * takes care of.
 			 */
-			i -= stl->cur_stage * stl->unitsize;
+			i -= stl->cur_stage;
 			if (i < -1)
 				i = -1; /* Oops, went back past this buffer. */
 			/* Reset trigger stage. */
@@ -236,8 +593,427 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		}
 	}
 
+	/* Keep the last inspected sample for edge matches on the next buffer. */
+	if (count > 0) {
+		i = offset >= 0 ? offset : count - 1;
+		memcpy(stl->prev_sample, buf + i * stl->unitsize, stl->unitsize);
+		stl->have_prev_sample = TRUE;
+	}
+
+	if (offset == -1)
+		pre_trigger_append(stl, sbuf, buf, len);
+
+	return offset;
+}
+
+/*
+ * Analog soft triggers.
+ *
+ * Samples are passed in as frames of interleaved floats, one value per
+ * enabled analog channel of the device, in the order of sdi->channels.
+ * Matches of a stage must all hold on the same frame. SR_TRIGGER_OVER
+ * and SR_TRIGGER_UNDER compare against the match value (exclusive).
+ * An OVER and an UNDER match on the same channel and stage hold when
+ * the value is inside the window: above the OVER value, and below the
+ * UNDER value. A trigger on leaving a window cannot be expressed by a
+ * single stage, as all matches of a stage are ANDed.
+ * SR_TRIGGER_RISING and SR_TRIGGER_FALLING fire when the signal crosses
+ * the match value, after it was at least 'hysteresis' below (above) it.
+ */
+
+struct soft_trigger_analog_cond {
+	int chan;
+	int match;
+	float value;
+	gboolean armed;
+};
+
+struct soft_trigger_analog_stage {
+	struct soft_trigger_analog_cond *conds;
+	int num_conds;
+};
+
+/* Block size of the branch free (vectorizable) comparison loops. */
+#define ANALOG_SCAN_BLOCK 16
+
+/*
+ * Generate functions which return the index of the first frame from
+ * 'idx' on whose value compares true against 'level', or 'count' if
+ * there is none.
+ */
+#define ANALOG_SCAN_FUNC(name, op) \
+static int name(const float *data, int stride, int idx, int count, \
+		float level) \
+{ \
+	int i, hits; \
+\
+	while (idx + ANALOG_SCAN_BLOCK <= count) { \
+		hits = 0; \
+		for (i = 0; i < ANALOG_SCAN_BLOCK; i++) \
+			hits |= data[(idx + i) * stride] op level; \
+		if (hits) \
+			break; \
+		idx += ANALOG_SCAN_BLOCK; \
+	} \
+	for (; idx < count; idx++) { \
+		if (data[idx * stride] op level) \
+			break; \
+	} \
+\
+	return idx; \
+}
+
+ANALOG_SCAN_FUNC(analog_scan_above, >)
+ANALOG_SCAN_FUNC(analog_scan_below, <)
+ANALOG_SCAN_FUNC(analog_scan_at_or_above, >=)
+ANALOG_SCAN_FUNC(analog_scan_at_or_below, <=)
+
+static int analog_stage_compile(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_stage *cs,
+		const struct sr_trigger_stage *stage)
+{
+	const struct sr_trigger_match *match;
+	struct soft_trigger_analog_cond *cond;
+	GSList *l;
+	int i;
+
+	cs->conds = g_malloc0(g_slist_length(stage->matches) * sizeof(*cs->conds));
+
+	if (!stage->matches)
+		/* No matches supplied, client error. */
+		return SR_ERR_ARG;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			/* Ignore disabled channels with a trigger. */
+			continue;
+		for (i = 0; i < sta->num_channels; i++) {
+			if (sta->channels[i].ch == match->channel)
+				break;
+		}
+		if (i == sta->num_channels) {
+			sr_err("Cannot soft trigger on channel %s.",
+				match->channel->name);
+			return SR_ERR_ARG;
+		}
+		switch (match->match) {
+		case SR_TRIGGER_OVER:
+		case SR_TRIGGER_UNDER:
+		case SR_TRIGGER_RISING:
+		case SR_TRIGGER_FALLING:
+			break;
+		default:
+			sr_err("Unsupported trigger match %d on channel %s.",
+				match->match, match->channel->name);
+			return SR_ERR_ARG;
+		}
+		cond = &cs->conds[cs->num_conds++];
+		cond->chan = i;
+		cond->match = match->match;
+		cond->value = match->value;
+	}
+
+	return SR_OK;
+}
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis)
+{
+	struct soft_trigger_analog *sta;
+	struct sr_channel *ch;
+	GSList *l;
+	int i;
+
+	sta = g_malloc0(sizeof(struct soft_trigger_analog));
+	sta->sdi = sdi;
+	sta->trigger = trigger;
+	sta->hysteresis = hysteresis;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_ANALOG && ch->enabled)
+			sta->num_channels++;
+	}
+	sta->channels = g_malloc0(sta->num_channels * sizeof(*sta->channels));
+	i = 0;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_ANALOG && ch->enabled)
+			sta->channels[i++].ch = ch;
+	}
+
+	sta->num_stages = g_slist_length(trigger->stages);
+	sta->stages = g_malloc0(sta->num_stages * sizeof(*sta->stages));
+	sta->stages_valid = sta->num_stages > 0 && sta->num_channels > 0;
+	for (l = trigger->stages, i = 0; l; l = l->next, i++) {
+		if (analog_stage_compile(sta, &sta->stages[i], l->data) != SR_OK)
+			sta->stages_valid = FALSE;
+	}
+
+	if (pre_trigger_samples > 0) {
+		sta->pre_trigger_size = pre_trigger_samples;
+		sta->pre_trigger_buffer = g_try_malloc(pre_trigger_samples
+			* sta->num_channels * sizeof(float));
+		sta->pre_trigger_chan = g_try_malloc(pre_trigger_samples
+			* sizeof(float));
+		if (!sta->pre_trigger_buffer || !sta->pre_trigger_chan) {
+			soft_trigger_analog_free(sta);
+			return NULL;
+		}
+	}
+
+	return sta;
+}
+
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta)
+{
+	int i;
+
+	if (!sta)
+		return;
+
+	for (i = 0; i < sta->num_stages; i++)
+		g_free(sta->stages[i].conds);
+	g_free(sta->stages);
+	g_free(sta->channels);
+	g_free(sta->pre_trigger_buffer);
+	g_free(sta->pre_trigger_chan);
+	g_free(sta);
+}
+
+static void analog_pre_trigger_append(struct soft_trigger_analog *sta,
+		const float *data, int num_frames)
+{
+	int size;
+
+	if (sta->pre_trigger_size == 0)
+		return;
+
+	/* Avoid uselessly copying more than the pre-trigger size. */
+	if (num_frames > sta->pre_trigger_size) {
+		data += (num_frames - sta->pre_trigger_size) * sta->num_channels;
+		num_frames = sta->pre_trigger_size;
+	}
+
+	sta->pre_trigger_fill = MIN(sta->pre_trigger_fill + num_frames,
+	                            sta->pre_trigger_size);
+
+	while (num_frames > 0) {
+		size = MIN(sta->pre_trigger_size - sta->pre_trigger_head,
+			num_frames);
+		memcpy(sta->pre_trigger_buffer
+			+ sta->pre_trigger_head * sta->num_channels, data,
+			size * sta->num_channels * sizeof(float));
+		sta->pre_trigger_head += size;
+		if (sta->pre_trigger_head == sta->pre_trigger_size)
+			sta->pre_trigger_head = 0;
+		data += size * sta->num_channels;
+		num_frames -= size;
+	}
+}
+
+static void analog_pre_trigger_send(struct soft_trigger_analog *sta,
+		int *pre_trigger_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct soft_trigger_analog_channel *ch;
+	int first, frame, i, c;
+
+	if (pre_trigger_samples)
+		*pre_trigger_samples = sta->pre_trigger_fill;
+	if (sta->pre_trigger_fill == 0)
+		return;
+
+	/* Oldest frame in the circular buffer. */
+	first = sta->pre_trigger_head - sta->pre_trigger_fill;
+	if (first < 0)
+		first += sta->pre_trigger_size;
+
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	for (c = 0; c < sta->num_channels; c++) {
+		ch = &sta->channels[c];
+		frame = first;
+		for (i = 0; i < sta->pre_trigger_fill; i++) {
+			sta->pre_trigger_chan[i] = sta->pre_trigger_buffer[
+				frame * sta->num_channels + c];
+			if (++frame == sta->pre_trigger_size)
+				frame = 0;
+		}
+		sr_analog_init(&analog, &encoding, &meaning, &spec, ch->digits);
+		meaning.mq = ch->mq;
+		meaning.unit = ch->unit;
+		meaning.mqflags = ch->mqflags;
+		meaning.channels = g_slist_append(NULL, ch->ch);
+		analog.num_samples = sta->pre_trigger_fill;
+		analog.data = sta->pre_trigger_chan;
+		sr_session_send(sta->sdi, &packet);
+		g_slist_free(meaning.channels);
+	}
+
+	sta->pre_trigger_head = 0;
+	sta->pre_trigger_fill = 0;
+}
+
+static inline gboolean analog_cond_check(struct soft_trigger_analog_cond *cond,
+		float value, float hysteresis)
+{
+	switch (cond->match) {
+	case SR_TRIGGER_OVER:
+		return value > cond->value;
+	case SR_TRIGGER_UNDER:
+		return value < cond->value;
+	case SR_TRIGGER_RISING:
+		if (value < cond->value - hysteresis)
+			cond->armed = TRUE;
+		else if (value >= cond->value && cond->armed) {
+			cond->armed = FALSE;
+			return TRUE;
+		}
+		return FALSE;
+	case SR_TRIGGER_FALLING:
+		if (value > cond->value + hysteresis)
+			cond->armed = TRUE;
+		else if (value <= cond->value && cond->armed) {
+			cond->armed = FALSE;
+			return TRUE;
+		}
+		return FALSE;
+	}
+
+	return FALSE;
+}
+
+/* Check all conditions of a stage, edge states get updated for each. */
+static gboolean analog_stage_match(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_stage *cs, const float *frame)
+{
+	struct soft_trigger_analog_cond *cond;
+	gboolean result;
+	int i;
+
+	result = TRUE;
+	for (i = 0; i < cs->num_conds; i++) {
+		cond = &cs->conds[i];
+		if (!analog_cond_check(cond, frame[cond->chan], sta->hysteresis))
+			result = FALSE;
+	}
+
+	return result;
+}
+
+/*
+ * Returns the index of the first frame from 'idx' on matching a stage
+ * with a single condition, or 'count'. Scans the buffer in blocks.
+ */
+static int analog_stage_find_single(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_cond *cond, const float *data,
+		int idx, int count)
+{
+	int stride;
+
+	stride = sta->num_channels;
+	data += cond->chan;
+
+	switch (cond->match) {
+	case SR_TRIGGER_OVER:
+		return analog_scan_above(data, stride, idx, count, cond->value);
+	case SR_TRIGGER_UNDER:
+		return analog_scan_below(data, stride, idx, count, cond->value);
+	case SR_TRIGGER_RISING:
+		if (!cond->armed) {
+			idx = analog_scan_below(data, stride, idx, count,
+				cond->value - sta->hysteresis);
+			if (idx == count)
+				return count;
+			cond->armed = TRUE;
+		}
+		idx = analog_scan_at_or_above(data, stride, idx, count,
+			cond->value);
+		break;
+	case SR_TRIGGER_FALLING:
+		if (!cond->armed) {
+			idx = analog_scan_above(data, stride, idx, count,
+				cond->value + sta->hysteresis);
+			if (idx == count)
+				return count;
+			cond->armed = TRUE;
+		}
+		idx = analog_scan_at_or_below(data, stride, idx, count,
+			cond->value);
+		break;
+	default:
+		return count;
+	}
+
+	if (idx < count)
+		cond->armed = FALSE;
+
+	return idx;
+}
+
+/*
+ * Returns the offset (in frames) within data of where the trigger
+ * occurred, or -1 if not triggered. 'num_frames' counts frames of
+ * sta->num_channels interleaved values each.
+ */
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *data, int num_frames, int *pre_trigger_samples)
+{
+	struct soft_trigger_analog_stage *cs;
+	int offset, i;
+	gboolean match_found;
+
+	if (!sta->stages_valid)
+		return SR_ERR_ARG;
+
+	offset = -1;
+	for (i = 0; i < num_frames; i++) {
+		cs = &sta->stages[sta->cur_stage];
+		if (sta->cur_stage == 0 && cs->num_conds == 1) {
+			/* Scan ahead for the first stage's match. */
+			i = analog_stage_find_single(sta, &cs->conds[0], data,
+				i, num_frames);
+			if (i >= num_frames)
+				break;
+			match_found = TRUE;
+		} else {
+			match_found = analog_stage_match(sta, cs,
+				data + i * sta->num_channels);
+		}
+		if (match_found) {
+			if (sta->cur_stage < sta->num_stages - 1) {
+				/* Advance to next stage. */
+				sta->cur_stage++;
+			} else {
+				/* Matched on last stage, send pre-trigger data. */
+				analog_pre_trigger_append(sta, data, i);
+				analog_pre_trigger_send(sta, pre_trigger_samples);
+
+				/* Fire trigger. */
+				offset = i;
+
+				std_session_send_df_trigger(sta->sdi);
+				break;
+			}
+		} else if (sta->cur_stage > 0) {
+			/*
+			 * Stage sequences must match on consecutive frames.
+			 * Edge conditions carry state, so don't go back in
+			 * the data but start over with the next frame.
+			 */
+			sta->cur_stage = 0;
+		}
+	}
+
 	if (offset == -1)
-		pre_trigger_append(stl, buf, len);
+		analog_pre_trigger_append(sta, data, num_frames);
 
 	return offset;
 }
@@ -35,6 +35,7 @@
 #include <string.h>
 #include <strings.h>
 #include <errno.h>
+#include <float.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -294,6 +295,102 @@ SR_PRIV int sr_atof(const char *str, float *ret)
 	return SR_OK;
 }
 
+/*
+ * Fast path for the plain decimal numbers which dominate in input files
+ * like CSV. Accepts an optional sign, digits with an optional fraction,
+ * and an optional exponent, and nothing else. The result is exact when
+ * the digits fit into the 53 bit mantissa and the power of ten is exact
+ * as well: a single multiplication or division then rounds correctly,
+ * and yields the same value as g_ascii_strtod() does. Other input falls
+ * back to the slow path, as do platforms with excess precision for
+ * intermediate results (x87).
+ */
+static gboolean atod_fast(const char *str, double *ret)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22,
+	};
+	const char *p;
+	gboolean negative, exp_negative, have_digits;
+	uint64_t mantissa;
+	int digits, frac_digits, exp10, exp_value;
+	double value;
+
+	p = str;
+	negative = FALSE;
+	if (*p == '-' || *p == '+')
+		negative = *p++ == '-';
+
+	/* Leading zeros don't count, 19 digits always fit into 64 bits. */
+	mantissa = 0;
+	digits = 0;
+	frac_digits = 0;
+	have_digits = FALSE;
+	while (*p >= '0' && *p <= '9') {
+		mantissa = mantissa * 10 + (*p++ - '0');
+		have_digits = TRUE;
+		if (mantissa && ++digits > 19)
+			return FALSE;
+	}
+	if (*p == '.') {
+		p++;
+		while (*p >= '0' && *p <= '9') {
+			mantissa = mantissa * 10 + (*p++ - '0');
+			have_digits = TRUE;
+			frac_digits++;
+			if (mantissa && ++digits > 19)
+				return FALSE;
+		}
+	}
+	if (!have_digits)
+		return FALSE;
+
+	exp_value = 0;
+	if (*p == 'e' || *p == 'E') {
+		p++;
+		exp_negative = FALSE;
+		if (*p == '-' || *p == '+')
+			exp_negative = *p++ == '-';
+		if (*p < '0' || *p > '9')
+			return FALSE;
+		while (*p >= '0' && *p <= '9') {
+			exp_value = exp_value * 10 + (*p++ - '0');
+			if (exp_value > 1000)
+				return FALSE;
+		}
+		if (exp_negative)
+			exp_value = -exp_value;
+	}
+	if (*p)
+		return FALSE;
+
+	if (mantissa > (UINT64_C(1) << 53))
+		return FALSE;
+	exp10 = exp_value - frac_digits;
+	value = (double)mantissa;
+	if (exp10 < 0) {
+		if (-exp10 >= (int)G_N_ELEMENTS(pow10))
+			return FALSE;
+		value /= pow10[-exp10];
+	} else if (exp10 > 0) {
+		if (exp10 >= (int)G_N_ELEMENTS(pow10))
+			return FALSE;
+		value *= pow10[exp10];
+	}
+	*ret = negative ? -value : value;
+
+	return TRUE;
+#else
+	(void)str;
+	(void)ret;
+
+	return FALSE;
+#endif
+}
+
 /**
  * Convert a string representation of a numeric value to a double. The
  * conversion is strict and will fail if the complete string does not represent
@@ -314,6 +411,10 @@ SR_PRIV int sr_atod_ascii(const char *str, double *ret)
 	char *endptr = NULL;
 
 	errno = 0;
+	if (atod_fast(str, &tmp)) {
+		*ret = tmp;
+		return SR_OK;
+	}
 	tmp = g_ascii_strtod(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
@@ -375,6 +476,10 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	char *endptr = NULL;
 
 	errno = 0;
+	if (atod_fast(str, &tmp)) {
+		*ret = (float) tmp;
+		return SR_OK;
+	}
 	tmp = g_ascii_strtod(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
@@ -1719,6 +1824,15 @@ SR_API void sr_free_probe_names(char **names)
 	g_strfreev(names);
 }
 
+/*
+ * Whitespace like isspace() in the "C" locale. Is independent of the
+ * application's locale, and cheaper than the library's lookup.
+ */
+static inline gboolean text_is_space(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
 /**
  * Trim leading and trailing whitespace off text.
  *
@@ -1738,9 +1852,9 @@ SR_API char *sr_text_trim_spaces(char *s)
 		return s;
 
 	p = s + strlen(s);
-	while (p > s && isspace((int)p[-1]))
+	while (p > s && text_is_space(p[-1]))
 		*(--p) = '\0';
-	while (isspace((int)*s))
+	while (text_is_space(*s))
 		s++;
 
 	return s;
@@ -1803,9 +1917,13 @@ SR_API char *sr_text_next_line(char *s, size_t l, char **next, size_t *taken)
 	if (!s || !*s || !l)
 		return NULL;
 
-	/* Search for the next line termination. NUL terminate. */
-	p = g_strstr_len(s, l, "\n");
-	if (!p)
+	/*
+	 * Search for the next line termination. NUL terminate. The C
+	 * library's memchr() scans many characters at a time. Embedded
+	 * NUL characters before the line end still reject the text.
+	 */
+	p = memchr(s, '\n', l);
+	if (!p || memchr(s, '\0', p - s))
 		return NULL;
 	*p++ = '\0';
 	if (taken)
@@ -1846,7 +1964,7 @@ SR_API char *sr_text_next_word(char *s, char **next)
 		return NULL;
 
 	/* Advance over optional leading whitespace. */
-	while (isspace((int)*word))
+	while (text_is_space(*word))
 		word++;
 	if (!*word)
 		return NULL;
@@ -1857,12 +1975,12 @@ SR_API char *sr_text_next_word(char *s, char **next)
 	 * return the position of trailing text.
 	 */
 	p = word;
-	while (*p && !isspace((int)*p))
+	while (*p && !text_is_space(*p))
 		p++;
 	if (!*p)
 		return word;
 	*p++ = '\0';
-	while (isspace((int)*p))
+	while (text_is_space(*p))
 		p++;
 	if (!*p)
 		return word;
@@ -1871,6 +1989,49 @@ SR_API char *sr_text_next_word(char *s, char **next)
 	return word;
 }
 
+/**
+ * Find the positions of all line terminations in a text buffer.
+ *
+ * @param[in] s The input text.
+ * @param[in] l The input text length.
+ * @param[out] ends The offsets of the LF characters in the input text.
+ * @param[in] count The number of entries in the 'ends' array.
+ *
+ * @return The number of stored offsets. Equals 'count' when the array
+ *   was filled, more line terminations may follow.
+ *
+ * Gets all complete text lines of a buffer with a single call, which
+ * callers can process without another search for each line. Like with
+ * sr_text_next_line() the end-of-line condition is the LF character.
+ * Does not modify the input text, NUL characters are not special.
+ * Callers resume after the last stored position when the 'ends' array
+ * is full.
+ *
+ * @since 0.6.0
+ */
+SR_API size_t sr_text_line_ends(const char *s, size_t l,
+	size_t *ends, size_t count)
+{
+	const char *p, *end;
+	size_t found;
+
+	if (!s || !ends)
+		return 0;
+
+	found = 0;
+	p = s;
+	end = s + l;
+	while (found < count && p < end) {
+		p = memchr(p, '\n', end - p);
+		if (!p)
+			break;
+		ends[found++] = p - s;
+		p++;
+	}
+
+	return found;
+}
+
 /**
  * Get the number of necessary bits to hold a given value. Also gets
  * the next power-of-two value at or above the caller provided value.
@@ -0,0 +1,407 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "zip"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * ZIP archive records, for code which works on session files without
+ * libzip: the srzip output writes archives sequentially, the session
+ * file loader finds stored members in a memory mapping, and session
+ * file recovery rebuilds the central directory.
+ *
+ * Only what these need is covered. Members are neither encrypted nor
+ * spanned, and their sizes in local headers fit 32 bits. Offsets past
+ * 4GiB and more than 65535 members get ZIP64 records.
+ */
+
+#ifndef HAVE_ZLIB
+static uint32_t crc32_table[256];
+
+static void crc32_table_init(void)
+{
+	static gsize init;
+	uint32_t crc;
+	unsigned int i, bit;
+
+	if (!g_once_init_enter(&init))
+		return;
+	for (i = 0; i < ARRAY_SIZE(crc32_table); i++) {
+		crc = i;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+		crc32_table[i] = crc;
+	}
+	g_once_init_leave(&init, 1);
+}
+#endif
+
+/**
+ * Compute the CRC-32 which ZIP archives keep for each member.
+ *
+ * @param[in] buf The member data.
+ * @param[in] len The member data length in bytes.
+ *
+ * @return The CRC-32 of the data.
+ *
+ * @private
+ */
+SR_PRIV uint32_t sr_zip_crc32(const uint8_t *buf, size_t len)
+{
+#ifdef HAVE_ZLIB
+	return crc32(crc32(0L, Z_NULL, 0), buf, len);
+#else
+	uint32_t crc;
+
+	crc32_table_init();
+	crc = 0xffffffff;
+	while (len--)
+		crc = crc32_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc ^ 0xffffffff;
+#endif
+}
+
+/**
+ * Write the local header of an archive member.
+ *
+ * The member's name and extra field follow the header, the caller
+ * writes those.
+ *
+ * @param[out] header Buffer of ZIP_LOCAL_HEADER_SIZE bytes.
+ * @param[in] entry The member.
+ * @param[in] extra_len Size of the member's extra field.
+ *
+ * @private
+ */
+SR_PRIV void sr_zip_local_header_write(uint8_t *header,
+		const struct sr_zip_entry *entry, size_t extra_len)
+{
+	write_u32le_inc(&header, ZIP_LOCAL_HEADER_SIG);
+	write_u16le_inc(&header, ZIP_VERSION);
+	write_u16le_inc(&header, entry->flags);
+	write_u16le_inc(&header, entry->method);
+	write_u16le_inc(&header, entry->dos_time);
+	write_u16le_inc(&header, entry->dos_date);
+	write_u32le_inc(&header, entry->crc);
+	write_u32le_inc(&header, entry->comp_size);
+	write_u32le_inc(&header, entry->size);
+	write_u16le_inc(&header, strlen(entry->name));
+	write_u16le_inc(&header, extra_len);
+}
+
+/**
+ * Parse the local header of an archive member.
+ *
+ * @param[in] base The archive's contents.
+ * @param[in] size The archive's size.
+ * @param[in] offset Offset of the local header.
+ * @param[out] entry The member's information, can be NULL. The caller
+ *                   must g_free() the name.
+ * @param[out] data_offset Offset of the member's data.
+ *
+ * @return TRUE if a complete local header was found, FALSE otherwise.
+ *         The member's data is not checked to be within the archive.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_zip_local_header_parse(const uint8_t *base, uint64_t size,
+		uint64_t offset, struct sr_zip_entry *entry, uint64_t *data_offset)
+{
+	const uint8_t *p;
+	uint64_t name_len, extra_len;
+
+	if (offset > size || size - offset < ZIP_LOCAL_HEADER_SIZE)
+		return FALSE;
+	p = base + offset;
+	if (RL32(p) != ZIP_LOCAL_HEADER_SIG)
+		return FALSE;
+	name_len = RL16(p + 26);
+	extra_len = RL16(p + 28);
+	if (size - offset - ZIP_LOCAL_HEADER_SIZE < name_len + extra_len)
+		return FALSE;
+
+	if (entry) {
+		entry->name = g_strndup((const char *)p + ZIP_LOCAL_HEADER_SIZE,
+			name_len);
+		entry->offset = offset;
+		entry->flags = RL16(p + 6);
+		entry->method = RL16(p + 8);
+		entry->dos_time = RL16(p + 10);
+		entry->dos_date = RL16(p + 12);
+		entry->crc = RL32(p + 14);
+		entry->comp_size = RL32(p + 18);
+		entry->size = RL32(p + 22);
+	}
+	*data_offset = offset + ZIP_LOCAL_HEADER_SIZE + name_len + extra_len;
+
+	return TRUE;
+}
+
+/**
+ * Append a member's central directory header.
+ *
+ * @param[in,out] cd The central directory.
+ * @param[in] entry The member.
+ *
+ * @private
+ */
+SR_PRIV void sr_zip_cd_entry_append(GByteArray *cd,
+		const struct sr_zip_entry *entry)
+{
+	uint8_t header[ZIP_CENTRAL_HEADER_SIZE + ZIP64_EXTRA_SIZE], *wrptr;
+	size_t name_len;
+	gboolean zip64;
+
+	name_len = strlen(entry->name);
+	zip64 = entry->offset >= G_MAXUINT32;
+	wrptr = header;
+	write_u32le_inc(&wrptr, ZIP_CENTRAL_HEADER_SIG);
+	write_u16le_inc(&wrptr, zip64 ? ZIP64_VERSION : ZIP_VERSION);
+	write_u16le_inc(&wrptr, zip64 ? ZIP64_VERSION : ZIP_VERSION);
+	write_u16le_inc(&wrptr, entry->flags);
+	write_u16le_inc(&wrptr, entry->method);
+	write_u16le_inc(&wrptr, entry->dos_time);
+	write_u16le_inc(&wrptr, entry->dos_date);
+	write_u32le_inc(&wrptr, entry->crc);
+	write_u32le_inc(&wrptr, entry->comp_size);
+	write_u32le_inc(&wrptr, entry->size);
+	write_u16le_inc(&wrptr, name_len);
+	write_u16le_inc(&wrptr, zip64 ? ZIP64_EXTRA_SIZE : 0);
+	write_u16le_inc(&wrptr, 0);
+	write_u16le_inc(&wrptr, 0);
+	write_u16le_inc(&wrptr, 0);
+	write_u32le_inc(&wrptr, 0);
+	write_u32le_inc(&wrptr, zip64 ? G_MAXUINT32 : entry->offset);
+	g_byte_array_append(cd, header, wrptr - header);
+	g_byte_array_append(cd, (const guint8 *)entry->name, name_len);
+
+	if (zip64) {
+		wrptr = header;
+		write_u16le_inc(&wrptr, ZIP64_EXTRA_ID);
+		write_u16le_inc(&wrptr, sizeof(uint64_t));
+		write_u64le_inc(&wrptr, entry->offset);
+		g_byte_array_append(cd, header, wrptr - header);
+	}
+}
+
+/**
+ * Append the end of central directory records.
+ *
+ * @param[in,out] cd The central directory.
+ * @param[in] num_entries The number of members in the directory.
+ * @param[in] cd_offset Offset of the central directory in the archive.
+ * @param[in] cd_size Size of the central directory, which the end of
+ *                    central directory records directly follow.
+ *
+ * @private
+ */
+SR_PRIV void sr_zip_cd_end_append(GByteArray *cd, uint64_t num_entries,
+		uint64_t cd_offset, uint64_t cd_size)
+{
+	uint8_t trailer[ZIP64_EOCD_SIZE + ZIP64_LOCATOR_SIZE + ZIP_EOCD_SIZE];
+	uint8_t *wrptr;
+
+	wrptr = trailer;
+	if (num_entries >= G_MAXUINT16 || cd_offset >= G_MAXUINT32 ||
+			cd_size >= G_MAXUINT32) {
+		write_u32le_inc(&wrptr, ZIP64_EOCD_SIG);
+		write_u64le_inc(&wrptr, ZIP64_EOCD_SIZE - 12);
+		write_u16le_inc(&wrptr, ZIP64_VERSION);
+		write_u16le_inc(&wrptr, ZIP64_VERSION);
+		write_u32le_inc(&wrptr, 0);
+		write_u32le_inc(&wrptr, 0);
+		write_u64le_inc(&wrptr, num_entries);
+		write_u64le_inc(&wrptr, num_entries);
+		write_u64le_inc(&wrptr, cd_size);
+		write_u64le_inc(&wrptr, cd_offset);
+		write_u32le_inc(&wrptr, ZIP64_LOCATOR_SIG);
+		write_u32le_inc(&wrptr, 0);
+		write_u64le_inc(&wrptr, cd_offset + cd_size);
+		write_u32le_inc(&wrptr, 1);
+	}
+	write_u32le_inc(&wrptr, ZIP_EOCD_SIG);
+	write_u16le_inc(&wrptr, 0);
+	write_u16le_inc(&wrptr, 0);
+	write_u16le_inc(&wrptr, MIN(num_entries, G_MAXUINT16));
+	write_u16le_inc(&wrptr, MIN(num_entries, G_MAXUINT16));
+	write_u32le_inc(&wrptr, MIN(cd_size, G_MAXUINT32));
+	write_u32le_inc(&wrptr, MIN(cd_offset, G_MAXUINT32));
+	write_u16le_inc(&wrptr, 0);
+	g_byte_array_append(cd, trailer, wrptr - trailer);
+}
+
+/* Locate the central directory from the end of central directory records. */
+static gboolean zip_cd_find(const uint8_t *base, uint64_t size,
+		uint64_t *cd_offset, uint64_t *cd_size, uint64_t *num_entries)
+{
+	const uint8_t *p;
+	uint64_t pos;
+
+	/* The end of central directory record precedes a short comment. */
+	if (size < ZIP_EOCD_SIZE)
+		return FALSE;
+	pos = size - ZIP_EOCD_SIZE;
+	while (RL32(base + pos) != ZIP_EOCD_SIG) {
+		if (pos == 0 || size - ZIP_EOCD_SIZE - pos >= 0xffff)
+			return FALSE;
+		pos--;
+	}
+	p = base + pos;
+	*num_entries = RL16(p + 10);
+	*cd_size = RL32(p + 12);
+	*cd_offset = RL32(p + 16);
+	if (*num_entries == 0xffff || *cd_size == 0xffffffff ||
+			*cd_offset == 0xffffffff) {
+		if (pos < ZIP64_LOCATOR_SIZE ||
+				RL32(p - ZIP64_LOCATOR_SIZE) != ZIP64_LOCATOR_SIG)
+			return FALSE;
+		pos = RL64(p - ZIP64_LOCATOR_SIZE + 8);
+		if (size < ZIP64_EOCD_SIZE || pos > size - ZIP64_EOCD_SIZE ||
+				RL32(base + pos) != ZIP64_EOCD_SIG)
+			return FALSE;
+		p = base + pos;
+		*num_entries = RL64(p + 32);
+		*cd_size = RL64(p + 40);
+		*cd_offset = RL64(p + 48);
+	}
+
+	return *cd_offset <= size && *cd_size <= size - *cd_offset;
+}
+
+/* Take the values which overflowed from the ZIP64 extra field. */
+static void zip_cd_entry_zip64(struct sr_zip_entry *entry,
+		const uint8_t *extra, size_t extra_len)
+{
+	const uint8_t *extra_end, *field;
+	size_t field_len;
+
+	extra_end = extra + extra_len;
+	while (extra_end - extra >= 4) {
+		field = extra + 4;
+		field_len = RL16(extra + 2);
+		if (field_len > (size_t)(extra_end - field))
+			break;
+		if (RL16(extra) == ZIP64_EXTRA_ID) {
+			if (entry->size == 0xffffffff && field_len >= 8) {
+				entry->size = RL64(field);
+				field += 8;
+				field_len -= 8;
+			}
+			if (entry->comp_size == 0xffffffff && field_len >= 8) {
+				entry->comp_size = RL64(field);
+				field += 8;
+				field_len -= 8;
+			}
+			if (entry->offset == 0xffffffff && field_len >= 8)
+				entry->offset = RL64(field);
+			return;
+		}
+		extra = field + field_len;
+	}
+}
+
+/**
+ * Read the central directory of an archive.
+ *
+ * The directory is read up to the first damaged header.
+ *
+ * @param[in] base The archive's contents.
+ * @param[in] size The archive's size.
+ *
+ * @return An array of struct sr_zip_entry, to be released with
+ *         sr_zip_entries_free(). NULL if the archive has no central
+ *         directory.
+ *
+ * @private
+ */
+SR_PRIV GArray *sr_zip_cd_read(const uint8_t *base, uint64_t size)
+{
+	GArray *entries;
+	struct sr_zip_entry entry;
+	const uint8_t *p;
+	uint64_t pos, cd_offset, cd_size, cd_end, num_entries, i;
+	unsigned int name_len, extra_len, comment_len;
+
+	if (!zip_cd_find(base, size, &cd_offset, &cd_size, &num_entries))
+		return NULL;
+
+	entries = g_array_new(FALSE, FALSE, sizeof(struct sr_zip_entry));
+	pos = cd_offset;
+	cd_end = cd_offset + cd_size;
+	for (i = 0; i < num_entries; i++) {
+		if (cd_end - pos < ZIP_CENTRAL_HEADER_SIZE ||
+				RL32(base + pos) != ZIP_CENTRAL_HEADER_SIG)
+			break;
+		p = base + pos;
+		name_len = RL16(p + 28);
+		extra_len = RL16(p + 30);
+		comment_len = RL16(p + 32);
+		if (cd_end - pos - ZIP_CENTRAL_HEADER_SIZE <
+				(uint64_t)name_len + extra_len + comment_len)
+			break;
+		pos += ZIP_CENTRAL_HEADER_SIZE + name_len + extra_len + comment_len;
+
+		entry.flags = RL16(p + 8);
+		entry.method = RL16(p + 10);
+		entry.dos_time = RL16(p + 12);
+		entry.dos_date = RL16(p + 14);
+		entry.crc = RL32(p + 16);
+		entry.comp_size = RL32(p + 20);
+		entry.size = RL32(p + 24);
+		entry.offset = RL32(p + 42);
+		zip_cd_entry_zip64(&entry,
+			p + ZIP_CENTRAL_HEADER_SIZE + name_len, extra_len);
+		entry.name = g_strndup((const char *)p + ZIP_CENTRAL_HEADER_SIZE,
+			name_len);
+		g_array_append_val(entries, entry);
+	}
+
+	return entries;
+}
+
+/**
+ * Release an array of archive members, and their names.
+ *
+ * @param[in] entries The array, can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_zip_entries_free(GArray *entries)
+{
+	guint i;
+
+	if (!entries)
+		return;
+	for (i = 0; i < entries->len; i++)
+		g_free(g_array_index(entries, struct sr_zip_entry, i).name);
+	g_array_free(entries, TRUE);
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Benchmarks report their timings on stdout. They check the results
+ * they time, but are not part of the testsuite: timings depend on the
+ * machine, and the data sets are large. Run with "make bench".
+ */
+int main(void)
+{
+	int ret;
+	Suite *s;
+	SRunner *srunner;
+
+	s = suite_create("benchmarks");
+	srunner = srunner_create(s);
+
+	srunner_add_suite(srunner, bench_driver_all());
+	srunner_add_suite(srunner, bench_input_csv());
+	srunner_add_suite(srunner, bench_input_vcd());
+	srunner_add_suite(srunner, bench_output_srzip());
+
+	/* Don't fork, so that timings are not disturbed by it. */
+	srunner_set_fork_status(srunner, CK_NOFORK);
+	srunner_run_all(srunner, CK_VERBOSE);
+	ret = srunner_ntests_failed(srunner);
+	srunner_free(srunner);
+
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
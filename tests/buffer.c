@@ -0,0 +1,285 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdint.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+static int release_count;
+
+static void count_release(struct sr_buffer *buf)
+{
+	release_count++;
+	sr_buffer_free(buf);
+}
+
+/* Check reference counting, and the release callback. */
+START_TEST(test_buffer_ref)
+{
+	struct sr_buffer *buf;
+
+	release_count = 0;
+	buf = sr_buffer_new_full(100, count_release, NULL);
+	ck_assert(buf != NULL);
+	ck_assert(buf->size == 100);
+	ck_assert(g_atomic_int_get(&buf->refcount) == 1);
+
+	ck_assert(sr_buffer_ref(buf) == buf);
+	ck_assert(g_atomic_int_get(&buf->refcount) == 2);
+	sr_buffer_unref(buf);
+	ck_assert(release_count == 0);
+	sr_buffer_unref(buf);
+	ck_assert(release_count == 1);
+
+	/* NULL buffers are ignored. */
+	sr_buffer_unref(NULL);
+}
+END_TEST
+
+/* Check whether released buffers get recycled, and the statistics. */
+START_TEST(test_pool_recycle)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *a, *b, *c;
+	struct sr_buffer_pool_stats stats;
+
+	pool = sr_buffer_pool_new(1000, 2, 0);
+	ck_assert(pool != NULL);
+	sr_buffer_pool_stats_get(pool, &stats);
+	ck_assert(stats.block_size == 1000 && stats.allocated == 2);
+	ck_assert(stats.in_use == 0 && stats.requests == 0);
+
+	a = sr_buffer_pool_get(pool);
+	b = sr_buffer_pool_get(pool);
+	ck_assert(a != NULL && b != NULL && a != b);
+	ck_assert(a->size == 1000 && b->size == 1000);
+	ck_assert(((uintptr_t)a->data % 64) == 0);
+	ck_assert(((uintptr_t)b->data % 64) == 0);
+	ck_assert(g_atomic_int_get(&a->refcount) == 1);
+	memset(a->data, 0xaa, a->size);
+	memset(b->data, 0x55, b->size);
+
+	/* Preallocated buffers are exhausted, the next one is a miss. */
+	c = sr_buffer_pool_get(pool);
+	ck_assert(c != NULL);
+	sr_buffer_pool_stats_get(pool, &stats);
+	ck_assert(stats.allocated == 3 && stats.in_use == 3);
+	ck_assert(stats.requests == 3 && stats.misses == 1);
+
+	/* Released buffers are handed out again. */
+	sr_buffer_unref(b);
+	ck_assert(sr_buffer_pool_get(pool) == b);
+	sr_buffer_pool_stats_get(pool, &stats);
+	ck_assert(stats.allocated == 3 && stats.misses == 1);
+	ck_assert(stats.in_use == 3 && stats.in_use_max == 3);
+
+	sr_buffer_unref(a);
+	sr_buffer_unref(b);
+	sr_buffer_unref(c);
+	sr_buffer_pool_stats_get(pool, &stats);
+	ck_assert(stats.in_use == 0 && stats.allocated == 3);
+	ck_assert(stats.failures == 0);
+
+	sr_buffer_pool_destroy(pool);
+}
+END_TEST
+
+/* Check whether a pool's limit is enforced. */
+START_TEST(test_pool_limit)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *a, *b;
+	struct sr_buffer_pool_stats stats;
+
+	pool = sr_buffer_pool_new(16, 0, 2);
+	ck_assert(pool != NULL);
+	a = sr_buffer_pool_get(pool);
+	b = sr_buffer_pool_get(pool);
+	ck_assert(a != NULL && b != NULL);
+	ck_assert(sr_buffer_pool_get(pool) == NULL);
+	sr_buffer_pool_stats_get(pool, &stats);
+	ck_assert(stats.allocated == 2 && stats.failures == 1);
+
+	sr_buffer_unref(a);
+	ck_assert(sr_buffer_pool_get(pool) == a);
+
+	sr_buffer_unref(a);
+	sr_buffer_unref(b);
+	sr_buffer_pool_destroy(pool);
+
+	/* Preallocation beyond the limit fails. */
+	ck_assert(sr_buffer_pool_new(16, 3, 2) == NULL);
+}
+END_TEST
+
+/* Check whether buffers are found from their data. */
+START_TEST(test_pool_lookup)
+{
+	struct sr_buffer_pool *pool, *other;
+	struct sr_buffer *buf, *foreign;
+
+	pool = sr_buffer_pool_new(256, 1, 0);
+	other = sr_buffer_pool_new(256, 1, 0);
+	buf = sr_buffer_pool_get(pool);
+	foreign = sr_buffer_pool_get(other);
+
+	ck_assert(sr_buffer_pool_lookup(pool, buf->data) == buf);
+	ck_assert(sr_buffer_pool_lookup(other, foreign->data) == foreign);
+	ck_assert(sr_buffer_pool_lookup(pool, foreign->data) == NULL);
+
+	sr_buffer_unref(foreign);
+	sr_buffer_unref(buf);
+	sr_buffer_pool_destroy(other);
+	sr_buffer_pool_destroy(pool);
+}
+END_TEST
+
+/* Check that referenced buffers are not handed out for writing. */
+START_TEST(test_pool_get_writable)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *buf, *fresh;
+
+	pool = sr_buffer_pool_new(64, 1, 2);
+
+	/* The only reference, the buffer itself may be overwritten. */
+	buf = sr_buffer_pool_get(pool);
+	ck_assert(sr_buffer_pool_get_writable(pool, buf) == buf);
+	ck_assert(g_atomic_int_get(&buf->refcount) == 1);
+
+	/* A consumer holds on to it, another buffer is returned. */
+	sr_buffer_ref(buf);
+	fresh = sr_buffer_pool_get_writable(pool, buf);
+	ck_assert(fresh != NULL && fresh != buf);
+	ck_assert(g_atomic_int_get(&buf->refcount) == 1);
+	ck_assert(g_atomic_int_get(&fresh->refcount) == 1);
+
+	/* The pool is exhausted, the caller keeps its reference. */
+	sr_buffer_ref(fresh);
+	ck_assert(sr_buffer_pool_get_writable(pool, fresh) == NULL);
+	ck_assert(g_atomic_int_get(&fresh->refcount) == 2);
+
+	sr_buffer_unref(fresh);
+	sr_buffer_unref(fresh);
+	sr_buffer_unref(buf);
+	sr_buffer_pool_destroy(pool);
+}
+END_TEST
+
+/* Buffers which are still held remain valid after pool destruction. */
+START_TEST(test_pool_destroy_held)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *a, *b;
+
+	pool = sr_buffer_pool_new(128, 4, 0);
+	a = sr_buffer_pool_get(pool);
+	b = sr_buffer_pool_get(pool);
+	sr_buffer_unref(b);
+	sr_buffer_pool_destroy(pool);
+
+	/* The pool's memory gets freed when the last buffer is released. */
+	memset(a->data, 0x5a, a->size);
+	ck_assert(a->data[a->size - 1] == 0x5a);
+	sr_buffer_unref(a);
+}
+END_TEST
+
+static gpointer release_thread(gpointer data)
+{
+	g_usleep(10 * 1000);
+	sr_buffer_unref(data);
+
+	return NULL;
+}
+
+/* Check that exhausted pools apply the datafeed queue overrun policy. */
+START_TEST(test_pool_acquire)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_session_stats stats;
+	struct sr_buffer_pool *pool;
+	struct sr_buffer *buf;
+	GThread *thread;
+
+	sdi = srtest_dev_new(1);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	pool = sr_buffer_pool_new(16, 0, 1);
+	buf = sr_buffer_pool_acquire(pool, sdi);
+	ck_assert(buf != NULL);
+
+	/* Dropping data returns right away, and gets counted. */
+	sr_session_datafeed_queue_set(sess, 4, SR_DF_QUEUE_DROP_OLDEST);
+	ck_assert(sr_buffer_pool_acquire(pool, sdi) == NULL);
+	sr_session_stats_get(sess, sdi, &stats);
+	ck_assert(stats.transfers_dropped == 1);
+
+	/* Failing stops the session, which isn't running here. */
+	sr_session_datafeed_queue_set(sess, 4, SR_DF_QUEUE_FAIL);
+	ck_assert(sr_buffer_pool_acquire(pool, sdi) == NULL);
+	sr_session_stats_get(sess, sdi, &stats);
+	ck_assert(stats.transfers_dropped == 2);
+
+	/* Without a queue, wait for a consumer to release the buffer. */
+	sr_session_datafeed_queue_set(sess, 0, SR_DF_QUEUE_BLOCK);
+	thread = g_thread_new("test-release", release_thread, buf);
+	ck_assert(sr_buffer_pool_acquire(pool, sdi) == buf);
+	g_thread_join(thread);
+	sr_session_stats_get(sess, sdi, &stats);
+	ck_assert(stats.transfers_dropped == 2);
+
+	sr_buffer_unref(buf);
+	sr_buffer_pool_destroy(pool);
+	sr_session_destroy(sess);
+	srtest_dev_free(sdi);
+}
+END_TEST
+
+Suite *suite_buffer(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("buffer");
+
+	tc = tcase_create("buffer");
+	tcase_add_test(tc, test_buffer_ref);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("pool");
+	tcase_add_test(tc, test_pool_recycle);
+	tcase_add_test(tc, test_pool_limit);
+	tcase_add_test(tc, test_pool_lookup);
+	tcase_add_test(tc, test_pool_get_writable);
+	tcase_add_test(tc, test_pool_destroy_held);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("acquire");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_pool_acquire);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -18,9 +18,13 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /*
@@ -162,6 +166,195 @@ START_TEST(test_exit_null)
 }
 END_TEST
 
+/* Messages which reached the log callback, in the order they arrived. */
+static struct {
+	GMutex mutex;
+	GCond cond;
+	GPtrArray *msgs;
+	gboolean gate_closed;
+	sr_log_callback output;
+} logged;
+
+static int log_collect(void *cb_data, int loglevel, const char *format,
+		va_list args)
+{
+	(void)cb_data;
+	(void)loglevel;
+
+	g_mutex_lock(&logged.mutex);
+	g_ptr_array_add(logged.msgs, g_strdup_vprintf(format, args));
+	g_cond_signal(&logged.cond);
+	g_mutex_unlock(&logged.mutex);
+
+	return SR_OK;
+}
+
+/* Block the log thread on a "gate" message, output all others. */
+static int log_gated(void *cb_data, int loglevel, const char *format,
+		va_list args)
+{
+	va_list args_copy;
+	char *msg;
+
+	va_copy(args_copy, args);
+	msg = g_strdup_vprintf(format, args_copy);
+	va_end(args_copy);
+	if (!strcmp(msg, "gate")) {
+		g_mutex_lock(&logged.mutex);
+		while (logged.gate_closed)
+			g_cond_wait(&logged.cond, &logged.mutex);
+		g_mutex_unlock(&logged.mutex);
+		g_free(msg);
+		return SR_OK;
+	}
+	g_free(msg);
+
+	return logged.output(cb_data, loglevel, format, args);
+}
+
+static void log_setup(void)
+{
+	logged.msgs = g_ptr_array_new_with_free_func(g_free);
+	sr_log_loglevel_set(SR_LOG_INFO);
+	sr_log_callback_set(log_collect, NULL);
+}
+
+static void log_teardown(void)
+{
+	sr_log_async_set(FALSE);
+	sr_log_callback_set_default();
+	sr_log_loglevel_set(SR_LOG_WARN);
+	g_ptr_array_free(logged.msgs, TRUE);
+}
+
+/* Wait for the log thread to pass on the given number of messages. */
+static gboolean log_wait(guint count)
+{
+	gint64 end_time;
+	gboolean ret;
+
+	end_time = g_get_monotonic_time() + 5 * G_TIME_SPAN_SECOND;
+	ret = TRUE;
+	g_mutex_lock(&logged.mutex);
+	while (ret && logged.msgs->len < count)
+		ret = g_cond_wait_until(&logged.cond, &logged.mutex, end_time);
+	g_mutex_unlock(&logged.mutex);
+
+	return ret;
+}
+
+/* The log thread gets woken up, and keeps the order of messages. */
+START_TEST(test_log_async)
+{
+	char expected[32];
+	guint i;
+
+	ck_assert(sr_log_async_set(TRUE) == SR_OK);
+	ck_assert(sr_log_async_get());
+	for (i = 0; i < 100; i++)
+		sr_log(SR_LOG_INFO, "message %u", i);
+	ck_assert_msg(log_wait(100), "Only %u messages arrived.",
+		logged.msgs->len);
+
+	/* Messages keep arriving after an idle period. */
+	g_usleep(20000);
+	sr_log(SR_LOG_INFO, "message %u", 100);
+	ck_assert(log_wait(101));
+
+	for (i = 0; i <= 100; i++) {
+		snprintf(expected, sizeof(expected), "message %u", i);
+		ck_assert_msg(!strcmp(g_ptr_array_index(logged.msgs, i),
+			expected), "Message %u is '%s'.", i,
+			(char *)g_ptr_array_index(logged.msgs, i));
+	}
+
+	/* Disabled levels don't get queued. */
+	sr_log(SR_LOG_DBG, "hidden");
+	ck_assert(sr_log_async_set(FALSE) == SR_OK);
+	ck_assert(!sr_log_async_get());
+	ck_assert(logged.msgs->len == 101);
+}
+END_TEST
+
+/* Disabling asynchronous logging outputs all pending messages. */
+START_TEST(test_log_async_disable)
+{
+	guint i;
+
+	for (i = 0; i < 3; i++) {
+		ck_assert(sr_log_async_set(TRUE) == SR_OK);
+		sr_log(SR_LOG_INFO, "first %u", i);
+		sr_log(SR_LOG_INFO, "second %u", i);
+		ck_assert(sr_log_async_set(FALSE) == SR_OK);
+		ck_assert_msg(logged.msgs->len == 2 * (i + 1),
+			"%u messages after disable.", logged.msgs->len);
+	}
+
+	/* Synchronous again, messages arrive right away. */
+	sr_log(SR_LOG_INFO, "sync");
+	ck_assert(logged.msgs->len == 7);
+	ck_assert(!strcmp(g_ptr_array_index(logged.msgs, 6), "sync"));
+}
+END_TEST
+
+/* Time stamps of queued messages are taken when they get emitted. */
+START_TEST(test_log_async_timestamp)
+{
+	unsigned int min, sec, usec;
+	int64_t stamps[2];
+	char line[256], word[32];
+	FILE *out;
+	int saved;
+	size_t n;
+
+	sr_log_callback_set_default();
+	sr_log_callback_get(&logged.output, NULL);
+	sr_log_callback_set(log_gated, NULL);
+	sr_log_loglevel_set(SR_LOG_DBG);
+
+	out = tmpfile();
+	ck_assert(out != NULL);
+	fflush(stderr);
+	saved = dup(fileno(stderr));
+	dup2(fileno(out), fileno(stderr));
+
+	/* Both messages wait for the gate, and get output together. */
+	logged.gate_closed = TRUE;
+	sr_log_async_set(TRUE);
+	sr_log(SR_LOG_INFO, "gate");
+	sr_log(SR_LOG_INFO, "first");
+	g_usleep(200000);
+	sr_log(SR_LOG_INFO, "second");
+	g_mutex_lock(&logged.mutex);
+	logged.gate_closed = FALSE;
+	g_cond_broadcast(&logged.cond);
+	g_mutex_unlock(&logged.mutex);
+	sr_log_async_set(FALSE);
+
+	fflush(stderr);
+	dup2(saved, fileno(stderr));
+	close(saved);
+
+	n = 0;
+	rewind(out);
+	while (fgets(line, sizeof(line), out)) {
+		if (sscanf(line, "sr: [%u:%u.%u] %31s", &min, &sec, &usec,
+				word) != 4)
+			continue;
+		if (strcmp(word, n ? "second" : "first"))
+			continue;
+		stamps[n++] = ((int64_t)min * 60 + sec) * G_TIME_SPAN_SECOND + usec;
+		if (n == 2)
+			break;
+	}
+	fclose(out);
+
+	ck_assert_msg(n == 2, "Messages not found in the log output.");
+	ck_assert_msg(stamps[1] - stamps[0] >= 150000,
+		"Messages stamped %" PRId64 " us apart.", stamps[1] - stamps[0]);
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -179,5 +372,12 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_exit_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("log");
+	tcase_add_checked_fixture(tc, log_setup, log_teardown);
+	tcase_add_test(tc, test_log_async);
+	tcase_add_test(tc, test_log_async_disable);
+	tcase_add_test(tc, test_log_async_timestamp);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
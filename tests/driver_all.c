@@ -18,9 +18,12 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /* Check whether at least one driver is available. */
@@ -40,6 +43,436 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+/* Number of sweeps for the key info lookup benchmark. */
+#define KEY_INFO_SWEEPS 10000
+
+/* Get a scanned demo device, or NULL if the demo driver isn't built. */
+static struct sr_dev_inst *demo_dev_get(struct sr_dev_driver **driver)
+{
+	struct sr_dev_driver **drivers;
+	GSList *devs;
+	struct sr_dev_inst *sdi;
+	int i;
+
+	*driver = NULL;
+	drivers = sr_driver_list(srtest_ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			*driver = drivers[i];
+	}
+	if (!*driver)
+		return NULL;
+
+	srtest_driver_init(srtest_ctx, *driver);
+	devs = sr_driver_scan(*driver, NULL);
+	ck_assert_msg(devs != NULL, "Demo driver scan failed.");
+	sdi = devs->data;
+	g_slist_free(devs);
+
+	return sdi;
+}
+
+/* Check whether all demo device options have consistent key info. */
+START_TEST(test_key_info_lookup)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	const struct sr_key_info *info;
+	GArray *opts;
+	uint32_t key;
+	unsigned int i;
+
+	if (!(sdi = demo_dev_get(&driver)))
+		return;
+
+	opts = sr_dev_options(driver, sdi, NULL);
+	ck_assert(opts != NULL);
+	for (i = 0; i < opts->len; i++) {
+		key = g_array_index(opts, uint32_t, i);
+		info = sr_key_info_get(SR_KEY_CONFIG, key);
+		ck_assert_msg(info != NULL, "No key info for key %u.", key);
+		ck_assert(info->key == key);
+		if (!info->id)
+			continue;
+		ck_assert(sr_key_info_name_get(SR_KEY_CONFIG, info->id) == info);
+	}
+	g_array_free(opts, TRUE);
+
+	ck_assert(sr_key_info_get(SR_KEY_CONFIG, 0xffffffff) == NULL);
+	ck_assert(sr_key_info_name_get(SR_KEY_CONFIG, "no_such_key") == NULL);
+	ck_assert(sr_key_info_get(SR_KEY_MQ, SR_MQ_VOLTAGE) != NULL);
+	ck_assert(sr_key_info_get(SR_KEY_MQFLAGS, SR_MQFLAG_FOUR_WIRE) != NULL);
+}
+END_TEST
+
+static const int keytypes[] = { SR_KEY_CONFIG, SR_KEY_MQ, SR_KEY_MQFLAGS, };
+
+/* Reference lookups, the first matching entry in table order. */
+static const struct sr_key_info *key_info_linear_get(int keytype, uint32_t key)
+{
+	const struct sr_key_info *table;
+	int i;
+
+	table = sr_key_info_table_get(keytype);
+	for (i = 0; table[i].key; i++) {
+		if (table[i].key == key)
+			return &table[i];
+	}
+
+	return NULL;
+}
+
+static const struct sr_key_info *key_info_linear_name_get(int keytype,
+		const char *keyid)
+{
+	const struct sr_key_info *table;
+	int i;
+
+	table = sr_key_info_table_get(keytype);
+	for (i = 0; table[i].key; i++) {
+		if (table[i].id && !strcmp(table[i].id, keyid))
+			return &table[i];
+	}
+
+	return NULL;
+}
+
+/* Lookups must find the same entries as a linear scan of the tables. */
+START_TEST(test_key_info_tables)
+{
+	const struct sr_key_info *table;
+	size_t t;
+	int i;
+
+	for (t = 0; t < G_N_ELEMENTS(keytypes); t++) {
+		table = sr_key_info_table_get(keytypes[t]);
+		ck_assert(table != NULL);
+		for (i = 0; table[i].key; i++) {
+			ck_assert_msg(sr_key_info_get(keytypes[t], table[i].key)
+				== key_info_linear_get(keytypes[t], table[i].key),
+				"Key %u of type %d differs.",
+				table[i].key, keytypes[t]);
+			if (!table[i].id)
+				continue;
+			ck_assert_msg(sr_key_info_name_get(keytypes[t], table[i].id)
+				== key_info_linear_name_get(keytypes[t], table[i].id),
+				"Key id %s of type %d differs.",
+				table[i].id, keytypes[t]);
+		}
+	}
+	ck_assert(sr_key_info_table_get(-1) == NULL);
+}
+END_TEST
+
+/*
+ * Benchmark key info lookups on a sweep over all demo device options,
+ * listing each listable key once and then looking the keys up the way
+ * the sr_config_*() checks do, against a linear scan of the table.
+ */
+START_TEST(bench_key_info)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	const struct sr_key_info *info, *ref;
+	GArray *opts;
+	GVariant *gvar;
+	uint32_t key;
+	unsigned int i, sweep, lookups;
+	int64_t start, elapsed, elapsed_ref;
+
+	if (!(sdi = demo_dev_get(&driver)))
+		return;
+
+	opts = sr_dev_options(driver, sdi, NULL);
+	ck_assert(opts != NULL);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < opts->len; i++) {
+		key = g_array_index(opts, uint32_t, i);
+		if (!(sr_dev_config_capabilities_list(sdi, NULL, key) & SR_CONF_LIST))
+			continue;
+		if (sr_config_list(driver, sdi, NULL, key, &gvar) == SR_OK)
+			g_variant_unref(gvar);
+	}
+	elapsed = g_get_monotonic_time() - start;
+	printf("sr_config_list() sweep over %u keys: %" PRId64 " us\n",
+		opts->len, elapsed);
+
+	lookups = 0;
+	start = g_get_monotonic_time();
+	for (sweep = 0; sweep < KEY_INFO_SWEEPS; sweep++) {
+		for (i = 0; i < opts->len; i++) {
+			key = g_array_index(opts, uint32_t, i);
+			info = sr_key_info_get(SR_KEY_CONFIG, key);
+			ck_assert(info != NULL);
+			if (info->id)
+				sr_key_info_name_get(SR_KEY_CONFIG, info->id);
+			lookups++;
+		}
+	}
+	elapsed = g_get_monotonic_time() - start;
+
+	start = g_get_monotonic_time();
+	for (sweep = 0; sweep < KEY_INFO_SWEEPS; sweep++) {
+		for (i = 0; i < opts->len; i++) {
+			key = g_array_index(opts, uint32_t, i);
+			ref = key_info_linear_get(SR_KEY_CONFIG, key);
+			ck_assert(ref != NULL);
+			if (ref->id)
+				key_info_linear_name_get(SR_KEY_CONFIG, ref->id);
+		}
+	}
+	elapsed_ref = g_get_monotonic_time() - start;
+
+	printf("%u key info lookups: %" PRId64 " us, linear scan: %" PRId64
+		" us (%.1fx)\n", lookups, elapsed, elapsed_ref,
+		elapsed ? (double)elapsed_ref / elapsed : 0.0);
+
+	g_array_free(opts, TRUE);
+}
+END_TEST
+
+/* A driver for the batch configuration tests, it keeps values here. */
+static struct {
+	uint64_t samplerate;
+	uint64_t limit_samples;
+	int get_calls;
+	int get_many_calls;
+	int set_calls;
+	int set_many_calls;
+	/* What config_set_many() returns, SR_ERR_NA declines batches. */
+	int set_many_ret;
+} many;
+
+static const uint32_t many_devopts[] = {
+	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_LIMIT_MSEC | SR_CONF_GET,
+};
+
+static int many_config_get(uint32_t key, GVariant **data,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	(void)sdi;
+	(void)cg;
+
+	many.get_calls++;
+	switch (key) {
+	case SR_CONF_SAMPLERATE:
+		*data = g_variant_new_uint64(many.samplerate);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		*data = g_variant_new_uint64(many.limit_samples);
+		break;
+	case SR_CONF_LIMIT_MSEC:
+		*data = g_variant_new_uint64(100);
+		break;
+	default:
+		return SR_ERR_NA;
+	}
+
+	return SR_OK;
+}
+
+static int many_value_set(uint32_t key, GVariant *data)
+{
+	switch (key) {
+	case SR_CONF_SAMPLERATE:
+		many.samplerate = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		many.limit_samples = g_variant_get_uint64(data);
+		break;
+	default:
+		return SR_ERR_NA;
+	}
+
+	return SR_OK;
+}
+
+static int many_config_set(uint32_t key, GVariant *data,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	(void)sdi;
+	(void)cg;
+
+	many.set_calls++;
+
+	return many_value_set(key, data);
+}
+
+static int many_config_list(uint32_t key, GVariant **data,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	(void)sdi;
+	(void)cg;
+
+	if (key != SR_CONF_DEVICE_OPTIONS)
+		return SR_ERR_NA;
+	*data = std_gvar_array_u32(ARRAY_AND_SIZE(many_devopts));
+
+	return SR_OK;
+}
+
+/* Handles the samplerate only, other keys are left to config_get(). */
+static int many_config_get_many(GSList *configs,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+	(void)cg;
+
+	many.get_many_calls++;
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_SAMPLERATE)
+			src->data = g_variant_new_uint64(many.samplerate);
+	}
+
+	return SR_OK;
+}
+
+static int many_config_set_many(GSList *configs,
+	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
+{
+	struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+	(void)cg;
+
+	many.set_many_calls++;
+	if (many.set_many_ret != SR_OK)
+		return many.set_many_ret;
+	for (l = configs; l; l = l->next) {
+		src = l->data;
+		many_value_set(src->key, src->data);
+	}
+
+	return SR_OK;
+}
+
+static struct sr_dev_driver many_driver = {
+	.name = "many",
+	.longname = "Batch configuration test",
+	.api_version = 1,
+	.config_get = many_config_get,
+	.config_set = many_config_set,
+	.config_list = many_config_list,
+	.config_get_many = many_config_get_many,
+	.config_set_many = many_config_set_many,
+};
+
+static struct sr_dev_inst many_sdi = {
+	.driver = &many_driver,
+	.status = SR_ST_ACTIVE,
+	.priv = &many,
+};
+
+static void config_many_setup(void)
+{
+	srtest_setup();
+	memset(&many, 0, sizeof(many));
+	many.samplerate = SR_KHZ(1);
+	many.limit_samples = 10;
+	many.set_many_ret = SR_ERR_NA;
+}
+
+/* Keys the batch left unhandled get queried one by one. */
+START_TEST(test_config_get_many)
+{
+	struct sr_config configs[4];
+	GSList *list;
+	size_t i;
+	int ret;
+
+	memset(configs, 0, sizeof(configs));
+	configs[0].key = SR_CONF_SAMPLERATE;
+	configs[1].key = SR_CONF_LIMIT_SAMPLES;
+	configs[2].key = SR_CONF_LIMIT_MSEC;
+	list = NULL;
+	for (i = 0; i < 3; i++)
+		list = g_slist_append(list, &configs[i]);
+
+	ret = sr_config_get_many(&many_driver, &many_sdi, NULL, list);
+	ck_assert_msg(ret == SR_OK, "sr_config_get_many() error: %d", ret);
+	ck_assert(many.get_many_calls == 1 && many.get_calls == 2);
+	ck_assert(g_variant_get_uint64(configs[0].data) == SR_KHZ(1));
+	ck_assert(g_variant_get_uint64(configs[1].data) == 10);
+	ck_assert(g_variant_get_uint64(configs[2].data) == 100);
+	for (i = 0; i < 3; i++) {
+		ck_assert(!g_variant_is_floating(configs[i].data));
+		g_variant_unref(configs[i].data);
+		configs[i].data = NULL;
+	}
+
+	/* An unpublished key fails, the others are still read. */
+	configs[3].key = SR_CONF_CAPTURE_RATIO;
+	list = g_slist_append(list, &configs[3]);
+	ret = sr_config_get_many(&many_driver, &many_sdi, NULL, list);
+	ck_assert(ret == SR_ERR_ARG);
+	ck_assert(configs[3].data == NULL);
+	for (i = 0; i < 3; i++) {
+		ck_assert(configs[i].data != NULL);
+		g_variant_unref(configs[i].data);
+	}
+
+	g_slist_free(list);
+}
+END_TEST
+
+/* Values get set in a batch or one by one, the list's values are consumed. */
+START_TEST(test_config_set_many)
+{
+	struct sr_config configs[2];
+	GSList *list;
+	GVariant *held;
+	int ret;
+
+	list = g_slist_append(NULL, &configs[0]);
+	list = g_slist_append(list, &configs[1]);
+
+	/* The driver declines the batch. */
+	configs[0].key = SR_CONF_SAMPLERATE;
+	configs[0].data = g_variant_new_uint64(SR_KHZ(2));
+	configs[1].key = SR_CONF_LIMIT_SAMPLES;
+	held = g_variant_ref_sink(g_variant_new_uint64(20));
+	configs[1].data = held;
+	ret = sr_config_set_many(&many_sdi, NULL, list);
+	ck_assert_msg(ret == SR_OK, "sr_config_set_many() error: %d", ret);
+	ck_assert(many.set_many_calls == 1 && many.set_calls == 2);
+	ck_assert(many.samplerate == SR_KHZ(2) && many.limit_samples == 20);
+	ck_assert(configs[0].data == NULL && configs[1].data == NULL);
+	/* The caller's own reference is left alone. */
+	ck_assert(g_variant_get_uint64(held) == 20);
+
+	/* The driver takes the batch. */
+	many.set_many_ret = SR_OK;
+	many.set_calls = 0;
+	configs[0].data = g_variant_new_uint64(SR_KHZ(3));
+	configs[1].data = held;
+	ret = sr_config_set_many(&many_sdi, NULL, list);
+	ck_assert(ret == SR_OK);
+	ck_assert(many.set_many_calls == 2 && many.set_calls == 0);
+	ck_assert(many.samplerate == SR_KHZ(3));
+	ck_assert(configs[0].data == NULL && configs[1].data == NULL);
+	g_variant_unref(held);
+
+	/* A read-only key rejects the whole list, nothing gets set. */
+	configs[0].data = g_variant_new_uint64(SR_KHZ(4));
+	configs[1].key = SR_CONF_LIMIT_MSEC;
+	configs[1].data = g_variant_new_uint64(50);
+	ret = sr_config_set_many(&many_sdi, NULL, list);
+	ck_assert(ret == SR_ERR_ARG);
+	ck_assert(many.set_many_calls == 2 && many.samplerate == SR_KHZ(3));
+	ck_assert(configs[0].data == NULL && configs[1].data == NULL);
+
+	g_slist_free(list);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -74,5 +507,32 @@ Suite *suite_driver_all(void)
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("key_info");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_key_info_lookup);
+	tcase_add_test(tc, test_key_info_tables);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("config_many");
+	tcase_add_checked_fixture(tc, config_many_setup, srtest_teardown);
+	tcase_add_test(tc, test_config_get_many);
+	tcase_add_test(tc, test_config_set_many);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+Suite *bench_driver_all(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("driver-all");
+
+	tc = tcase_create("key_info");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, bench_key_info);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
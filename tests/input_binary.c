@@ -18,6 +18,8 @@
  */
 
 #include <config.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -29,6 +31,8 @@ enum {
 	CHECK_ALL_LOW,
 	CHECK_ALL_HIGH,
 	CHECK_HELLO_WORLD,
+	CHECK_PATTERN,
+	CHECK_INVERTED,
 };
 
 static uint64_t df_packet_counter = 0, sample_counter = 0;
@@ -79,6 +83,40 @@ static void check_hello_world(const struct sr_datafeed_logic *logic)
 	}
 }
 
+static uint8_t pattern_value(uint64_t idx)
+{
+	return (idx * 7) ^ (idx >> 8);
+}
+
+static void check_pattern(const struct sr_datafeed_logic *logic)
+{
+	uint64_t i, offset;
+	uint8_t *data;
+
+	data = logic->data;
+	offset = sample_counter * logic->unitsize;
+	for (i = 0; i < logic->length; i++) {
+		if (data[i] != pattern_value(offset + i)) {
+			ck_abort_msg("Logic data does not match the pattern.");
+		}
+	}
+}
+
+/* The pattern, after the invert transform. */
+static void check_inverted(const struct sr_datafeed_logic *logic)
+{
+	uint64_t i, offset;
+	uint8_t *data;
+
+	data = logic->data;
+	offset = sample_counter * logic->unitsize;
+	for (i = 0; i < logic->length; i++) {
+		if (data[i] != (uint8_t)~pattern_value(offset + i)) {
+			ck_abort_msg("Logic data is not the inverted pattern.");
+		}
+	}
+}
+
 static void datafeed_in(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *packet, void *cb_data)
 {
@@ -163,6 +201,10 @@ static void datafeed_in(const struct sr_dev_inst *sdi,
 			check_all_high(logic);
 		else if (check_to_perform == CHECK_HELLO_WORLD)
 			check_hello_world(logic);
+		else if (check_to_perform == CHECK_PATTERN)
+			check_pattern(logic);
+		else if (check_to_perform == CHECK_INVERTED)
+			check_inverted(logic);
 
 		sample_counter += logic->length / logic->unitsize;
 
@@ -314,6 +356,230 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+/*
+ * Send data in pieces which don't align to the unit size. The module
+ * reads the caller's buffers in place and must carry partial samples
+ * over to subsequent calls.
+ */
+START_TEST(test_input_binary_split)
+{
+	static const size_t piece_sizes[] = { 1, 2, 5, 7, 64, 1000, 4099, };
+	struct sr_input *in;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *gbuf;
+	uint8_t *buf;
+	size_t num_bytes, pos, len, i;
+	int ret;
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_PATTERN;
+	expected_samplerate = NULL;
+
+	/* 24 channels, 3 bytes per sample, plus a partial sample. */
+	num_bytes = 3 * 10000 + 2;
+	expected_samples = num_bytes / 3;
+	buf = g_malloc(num_bytes);
+	for (i = 0; i < num_bytes; i++)
+		buf[i] = pattern_value(i);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(24)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	ck_assert_msg(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(options);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	gbuf = g_string_new(NULL);
+	for (pos = 0, i = 0; pos < num_bytes; pos += len, i++) {
+		len = piece_sizes[i % G_N_ELEMENTS(piece_sizes)];
+		len = MIN(len, num_bytes - pos);
+		g_string_assign(gbuf, "");
+		g_string_append_len(gbuf, (gchar *)&buf[pos], len);
+		ret = sr_input_send(in, gbuf);
+		ck_assert_msg(ret == SR_OK, "sr_input_send() error: %d", ret);
+		if (i == 0)
+			sr_session_dev_add(session, sr_input_dev_inst_get(in));
+		/* The module must not hold on to the caller's buffer. */
+		memset(gbuf->str, 0xa5, gbuf->len);
+	}
+	ret = sr_input_end(in);
+	ck_assert_msg(ret == SR_OK, "sr_input_end() error: %d", ret);
+	ck_assert_msg(have_seen_df_end, "Missing SR_DF_END packet.");
+	sr_input_free(in);
+
+	sr_session_destroy(session);
+	g_string_free(gbuf, TRUE);
+	g_free(buf);
+}
+END_TEST
+
+/*
+ * Transforms modify packets in place, which must not reach the caller's
+ * buffer although the module reads it in place.
+ */
+START_TEST(test_input_binary_transform)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	const struct sr_transform *t;
+	GHashTable *options;
+	GString *gbuf;
+	size_t num_bytes, head, i;
+	int ret;
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_INVERTED;
+	expected_samplerate = NULL;
+
+	/* A sample and a partial one, then the rest of the data. */
+	num_bytes = 3 * 10000;
+	head = 4;
+	expected_samples = num_bytes / 3;
+	gbuf = g_string_sized_new(num_bytes);
+	for (i = 0; i < head; i++)
+		g_string_append_c(gbuf, pattern_value(i));
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(24)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	ck_assert_msg(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(options);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	/* The first call makes the device ready, the transform needs it. */
+	ret = sr_input_send(in, gbuf);
+	ck_assert_msg(ret == SR_OK, "sr_input_send() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	ck_assert_msg(sdi != NULL, "Device not ready after first call.");
+	sr_session_dev_add(session, sdi);
+	t = sr_transform_new(sr_transform_find("invert"), NULL, sdi);
+	ck_assert_msg(t != NULL, "Failed to create transform.");
+
+	g_string_truncate(gbuf, 0);
+	for (i = head; i < num_bytes; i++)
+		g_string_append_c(gbuf, pattern_value(i));
+	ret = sr_input_send(in, gbuf);
+	ck_assert_msg(ret == SR_OK, "sr_input_send() error: %d", ret);
+	ret = sr_input_end(in);
+	ck_assert_msg(ret == SR_OK, "sr_input_end() error: %d", ret);
+	ck_assert_msg(have_seen_df_end, "Missing SR_DF_END packet.");
+	sr_input_free(in);
+	for (i = head; i < num_bytes; i++) {
+		ck_assert_msg((uint8_t)gbuf->str[i - head] == pattern_value(i),
+			"Caller's buffer modified at %zu.", i);
+	}
+
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	g_string_free(gbuf, TRUE);
+}
+END_TEST
+
+/*
+ * Send a file which spans several chunks through the mapped file path,
+ * optionally through the invert transform, which modifies packets in
+ * place.
+ */
+static void check_file(gboolean invert)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	const struct sr_transform *t;
+	GHashTable *options;
+	GError *error;
+	char *filename, *contents;
+	uint8_t *buf;
+	size_t num_bytes, i;
+	gsize len;
+	int fd, ret;
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = invert ? CHECK_INVERTED : CHECK_PATTERN;
+	expected_samplerate = NULL;
+
+	num_bytes = 3 * 2 * 1000 * 1000 + 2;
+	expected_samples = num_bytes / 3;
+	buf = g_malloc(num_bytes);
+	for (i = 0; i < num_bytes; i++)
+		buf[i] = pattern_value(i);
+	fd = g_file_open_tmp("input-binary-XXXXXX.bin", &filename, NULL);
+	ck_assert_msg(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+	error = NULL;
+	ck_assert_msg(g_file_set_contents(filename, (gchar *)buf, num_bytes,
+		&error), "Failed to write %s.", filename);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(24)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	ck_assert_msg(in != NULL, "Failed to create input instance.");
+	g_hash_table_destroy(options);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	/* Returns when the device is ready, then continues to the end. */
+	ret = sr_input_send_file(in, filename);
+	ck_assert_msg(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	ck_assert_msg(sdi != NULL, "Device not ready after first call.");
+	sr_session_dev_add(session, sdi);
+	t = NULL;
+	if (invert) {
+		t = sr_transform_new(sr_transform_find("invert"), NULL, sdi);
+		ck_assert_msg(t != NULL, "Failed to create transform.");
+	}
+	ret = sr_input_send_file(in, filename);
+	ck_assert_msg(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	ret = sr_input_end(in);
+	ck_assert_msg(ret == SR_OK, "sr_input_end() error: %d", ret);
+	ck_assert_msg(have_seen_df_end, "Missing SR_DF_END packet.");
+	sr_input_free(in);
+
+	/* The file is left alone. */
+	ck_assert(g_file_get_contents(filename, &contents, &len, NULL));
+	ck_assert(len == num_bytes && !memcmp(contents, buf, len));
+	g_free(contents);
+	g_free(buf);
+
+	sr_session_destroy(session);
+	if (t)
+		sr_transform_free(t);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+START_TEST(test_input_binary_file)
+{
+	check_file(FALSE);
+}
+END_TEST
+
+START_TEST(test_input_binary_file_transform)
+{
+	check_file(TRUE);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -327,6 +593,10 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_split);
+	tcase_add_test(tc, test_input_binary_file);
+	tcase_add_test(tc, test_input_binary_transform);
+	tcase_add_test(tc, test_input_binary_file_transform);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,341 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Column layout of the generated input: timestamp, analog, logic. */
+#define CSV_ANALOG 4
+#define CSV_LOGIC 8
+#define CSV_FORMATS "t,4a,8l"
+/* Row count of the correctness test and of the benchmark. */
+#define CSV_ROWS 20000
+#define BENCH_ROWS 1000000
+/* Size of the pieces which get passed to sr_input_send(). */
+#define SEND_SIZE (1024 * 1024 + 17)
+#define MAX_CHANNELS (CSV_ANALOG + CSV_LOGIC)
+
+struct csv_result {
+	uint64_t samplerate;
+	GByteArray *logic;
+	GArray *analog[MAX_CHANNELS];
+	gboolean have_seen_df_end;
+};
+
+static struct csv_result *result;
+
+static void csv_result_free(struct csv_result *res)
+{
+	size_t i;
+
+	g_byte_array_free(res->logic, TRUE);
+	for (i = 0; i < MAX_CHANNELS; i++) {
+		if (res->analog[i])
+			g_array_free(res->analog[i], TRUE);
+	}
+	g_free(res);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_config *src;
+	const struct sr_channel *ch;
+	float *values;
+	GSList *l;
+	int ret;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				result->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		ck_assert_msg(logic->unitsize == 1,
+			"Unexpected unit size %u.", logic->unitsize);
+		g_byte_array_append(result->logic, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ck_assert(analog->meaning->channels != NULL);
+		ch = analog->meaning->channels->data;
+		ck_assert(ch->index < MAX_CHANNELS);
+		if (!result->analog[ch->index])
+			result->analog[ch->index] = g_array_new(FALSE, FALSE,
+				sizeof(float));
+		values = g_malloc(analog->num_samples * sizeof(float));
+		ret = sr_analog_to_float(analog, values);
+		ck_assert_msg(ret == SR_OK, "sr_analog_to_float() error: %d", ret);
+		g_array_append_vals(result->analog[ch->index], values,
+			analog->num_samples);
+		g_free(values);
+		break;
+	case SR_DF_END:
+		result->have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Generate rows with timestamps, analog values, and logic levels. */
+static GString *csv_generate(size_t rows)
+{
+	GString *text;
+	size_t row, ch;
+
+	text = g_string_sized_new(rows * 64);
+	g_string_append(text, "; Generated input data.\n");
+	g_string_append(text, "time");
+	for (ch = 0; ch < CSV_ANALOG; ch++)
+		g_string_append_printf(text, ",A%zu", ch);
+	for (ch = 0; ch < CSV_LOGIC; ch++)
+		g_string_append_printf(text, ",D%zu", ch);
+	g_string_append_c(text, '\n');
+	for (row = 0; row < rows; row++) {
+		g_string_append_printf(text, "%.6f", row * 1e-6);
+		for (ch = 0; ch < CSV_ANALOG; ch++) {
+			g_string_append_printf(text, ",%.*f", (int)(ch + 1),
+				((double)(row * (ch + 3) % 20011) - 10005) / 7.0);
+		}
+		for (ch = 0; ch < CSV_LOGIC; ch++) {
+			g_string_append_printf(text, ",%d",
+				(int)((row >> ch) & 1));
+		}
+		/* Sprinkle trailing comments and blank lines. */
+		if (row % 1000 == 500)
+			g_string_append(text, " ; comment\n\n");
+		else
+			g_string_append_c(text, '\n');
+	}
+
+	return text;
+}
+
+/* Import CSV text in pieces, with the given number of parse threads. */
+static struct csv_result *csv_import(GString *text, uint32_t threads)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *piece;
+	size_t pos, len;
+	int ret;
+
+	result = g_malloc0(sizeof(*result));
+	result->logic = g_byte_array_new();
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("column_formats"),
+		g_variant_ref_sink(g_variant_new_string(CSV_FORMATS)));
+	g_hash_table_insert(options, g_strdup("threads"),
+		g_variant_ref_sink(g_variant_new_uint32(threads)));
+	in = sr_input_new(sr_input_find("csv"), options);
+	g_hash_table_destroy(options);
+	ck_assert_msg(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	sdi = NULL;
+	for (pos = 0; pos < text->len; pos += len) {
+		len = MIN(text->len - pos, SEND_SIZE);
+		piece = g_string_new_len(text->str + pos, len);
+		ret = sr_input_send(in, piece);
+		g_string_free(piece, TRUE);
+		ck_assert_msg(ret == SR_OK, "sr_input_send() error: %d", ret);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in)))
+			sr_session_dev_add(session, sdi);
+	}
+	ck_assert_msg(sdi != NULL, "CSV input was not accepted.");
+	ret = sr_input_end(in);
+	ck_assert_msg(ret == SR_OK, "sr_input_end() error: %d", ret);
+	sr_input_free(in);
+
+	sr_session_destroy(session);
+
+	ck_assert_msg(result->have_seen_df_end, "Missing SR_DF_END packet.");
+
+	return result;
+}
+
+/* Check the imported samples against the generated text. */
+static void csv_check(const struct csv_result *res, GString *text, size_t rows)
+{
+	char **lines, **columns;
+	size_t line_idx, row, ch, count;
+	GArray *values;
+	float value;
+
+	ck_assert_msg(res->samplerate == SR_MHZ(1),
+		"Unexpected samplerate %" PRIu64 ".", res->samplerate);
+	ck_assert_msg(res->logic->len == rows,
+		"Expected %zu logic samples, got %u.", rows, res->logic->len);
+	for (row = 0; row < rows; row++) {
+		ck_assert_msg(res->logic->data[row] == (row & 0xff),
+			"Logic sample %zu mismatch.", row);
+	}
+
+	/* Analog channels follow the logic channels. */
+	count = 0;
+	for (ch = 0; ch < MAX_CHANNELS; ch++) {
+		if (!res->analog[ch])
+			continue;
+		ck_assert_msg(res->analog[ch]->len == rows,
+			"Expected %zu analog samples, got %u.",
+			rows, res->analog[ch]->len);
+		count++;
+	}
+	ck_assert_msg(count == CSV_ANALOG, "Unexpected analog channel count.");
+
+	/* Compare against the reference conversion of the text. */
+	lines = g_strsplit(text->str, "\n", 0);
+	row = 0;
+	for (line_idx = 2; lines[line_idx] && row < rows; line_idx++) {
+		if (!lines[line_idx][0] || lines[line_idx][0] == ' ')
+			continue;
+		columns = g_strsplit(lines[line_idx], ",", 0);
+		for (ch = 0; ch < CSV_ANALOG; ch++) {
+			values = res->analog[CSV_LOGIC + ch];
+			value = g_ascii_strtod(columns[1 + ch], NULL);
+			ck_assert_msg(g_array_index(values, float, row) == value,
+				"Analog sample %zu mismatch: %s.",
+				row, columns[1 + ch]);
+		}
+		g_strfreev(columns);
+		row++;
+	}
+	g_strfreev(lines);
+}
+
+/* Compare two imports, sample data must be identical. */
+static void csv_compare(const struct csv_result *a, const struct csv_result *b)
+{
+	size_t ch;
+
+	ck_assert(a->samplerate == b->samplerate);
+	ck_assert(a->logic->len == b->logic->len);
+	ck_assert(memcmp(a->logic->data, b->logic->data, a->logic->len) == 0);
+	for (ch = 0; ch < MAX_CHANNELS; ch++) {
+		ck_assert(!a->analog[ch] == !b->analog[ch]);
+		if (!a->analog[ch])
+			continue;
+		ck_assert(a->analog[ch]->len == b->analog[ch]->len);
+		ck_assert(memcmp(a->analog[ch]->data, b->analog[ch]->data,
+			a->analog[ch]->len * sizeof(float)) == 0);
+	}
+}
+
+/* Parse threads must yield the same samples as sequential parsing. */
+START_TEST(test_csv_threads)
+{
+	GString *text;
+	struct csv_result *seq, *par;
+
+	text = csv_generate(CSV_ROWS);
+	seq = csv_import(text, 0);
+	csv_check(seq, text, CSV_ROWS);
+	par = csv_import(text, 4);
+	csv_check(par, text, CSV_ROWS);
+	csv_compare(seq, par);
+	csv_result_free(seq);
+	csv_result_free(par);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+/* Import time of a multi-channel CSV file, with and without threads. */
+START_TEST(bench_csv_import)
+{
+	static const uint32_t threads[] = { 0, 2, 4, };
+	GString *text;
+	struct csv_result *res, *ref;
+	size_t i;
+	int64_t start, elapsed;
+
+	text = csv_generate(BENCH_ROWS);
+	ref = NULL;
+	for (i = 0; i < G_N_ELEMENTS(threads); i++) {
+		start = g_get_monotonic_time();
+		res = csv_import(text, threads[i]);
+		elapsed = g_get_monotonic_time() - start;
+		printf("csv import of %d rows, %zu bytes, %u threads: %"
+			PRId64 " us\n", BENCH_ROWS, text->len, threads[i],
+			elapsed);
+		ck_assert_msg(res->logic->len == BENCH_ROWS,
+			"Expected %d samples, got %u.",
+			BENCH_ROWS, res->logic->len);
+		if (ref) {
+			csv_compare(ref, res);
+			csv_result_free(res);
+		} else {
+			ref = res;
+		}
+	}
+	csv_result_free(ref);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_csv_threads);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+Suite *bench_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("import");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, bench_csv_import);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,270 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Signal count and timestamp count of the generated benchmark input. */
+#define BENCH_SIGNALS 2048
+#define BENCH_TIMESTAMPS 1000
+/* Every timestamp changes one in BENCH_STRIDE signals. */
+#define BENCH_STRIDE 8
+
+static const uint8_t *expected_logic;
+static const float *expected_analog;
+static size_t expected_unitsize, bench_signals;
+static uint64_t sample_counter, analog_counter;
+static gboolean data_mismatch, have_seen_df_end;
+
+/* Benchmark signal values, one in BENCH_STRIDE signals changes. */
+static gboolean bench_value(size_t sig, uint64_t ts)
+{
+	uint64_t phase;
+
+	phase = sig % BENCH_STRIDE;
+	if (ts < phase)
+		return FALSE;
+	ts -= (ts - phase) % BENCH_STRIDE;
+	return (ts / BENCH_STRIDE) & 1;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const uint8_t *data;
+	float *values;
+	uint64_t i;
+	size_t sig;
+	gboolean bit;
+	int ret;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		ck_assert_msg(logic->unitsize == expected_unitsize,
+			"Unexpected unit size %u.", logic->unitsize);
+		data = logic->data;
+		for (i = 0; i < logic->length / logic->unitsize; i++) {
+			if (expected_logic) {
+				if (data[0] != expected_logic[sample_counter + i])
+					data_mismatch = TRUE;
+			} else {
+				for (sig = 0; sig < bench_signals; sig++) {
+					bit = (data[sig / 8] >> (sig % 8)) & 1;
+					if (bit != bench_value(sig, sample_counter + i))
+						data_mismatch = TRUE;
+				}
+			}
+			data += logic->unitsize;
+		}
+		sample_counter += logic->length / logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ck_assert_msg(expected_analog != NULL, "Unexpected analog data.");
+		values = g_malloc(analog->num_samples * sizeof(float));
+		ret = sr_analog_to_float(analog, values);
+		ck_assert_msg(ret == SR_OK, "sr_analog_to_float() error: %d", ret);
+		for (i = 0; i < analog->num_samples; i++) {
+			if (values[i] != expected_analog[analog_counter + i])
+				data_mismatch = TRUE;
+		}
+		analog_counter += analog->num_samples;
+		g_free(values);
+		break;
+	case SR_DF_END:
+		have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Run a VCD text through the input module, return the sample count. */
+static uint64_t vcd_import(GString *text)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	int ret;
+
+	sample_counter = analog_counter = 0;
+	data_mismatch = have_seen_df_end = FALSE;
+
+	in = sr_input_new(sr_input_find("vcd"), NULL);
+	ck_assert_msg(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	ret = sr_input_send(in, text);
+	ck_assert_msg(ret == SR_OK, "sr_input_send() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	ck_assert_msg(sdi != NULL, "VCD header was not accepted.");
+	sr_session_dev_add(session, sdi);
+	ret = sr_input_end(in);
+	ck_assert_msg(ret == SR_OK, "sr_input_end() error: %d", ret);
+	sr_input_free(in);
+
+	sr_session_destroy(session);
+
+	ck_assert_msg(have_seen_df_end, "Missing SR_DF_END packet.");
+	ck_assert_msg(!data_mismatch, "Imported sample data mismatch.");
+
+	return sample_counter;
+}
+
+/* Generate a VCD identifier, skipping '$' to not look like keywords. */
+static void bench_identifier(char *buf, size_t sig)
+{
+	static const char first = '!', last = '~';
+	char c;
+
+	do {
+		c = first + sig % (last - first);
+		if (c >= '$')
+			c++;
+		*buf++ = c;
+		sig /= last - first;
+	} while (sig);
+	*buf = '\0';
+}
+
+/*
+ * Signals which share an identifier, vector signals, and identifiers
+ * of unsupported types which the module must silently skip.
+ */
+START_TEST(test_vcd_identifiers)
+{
+	static const char *text =
+		"$timescale 1 ns $end\n"
+		"$scope module top $end\n"
+		"$var wire 1 ! a $end\n"
+		"$var wire 1 \" b $end\n"
+		"$var wire 1 ! a_alias $end\n"
+		"$var wire 2 # v [1:0] $end\n"
+		"$var string 1 $ s $end\n"
+		"$var real 64 % r $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n"
+		"#0\n0!\n1\"\nb10 #\nsabc $\nr1.5 %\n"
+		"#1\n1!\nb01 #\n"
+		"#2\n0\"\nr-2 %\nsdef $\n"
+		"#3\n1\"\n";
+	static const uint8_t logic[] = { 0x12, 0x0f, 0x0d, 0x0f, };
+	static const float analog[] = { 1.5, 1.5, -2, -2, };
+	GString *buf;
+	uint64_t samples;
+
+	expected_logic = logic;
+	expected_analog = analog;
+	expected_unitsize = 1;
+	buf = g_string_new(text);
+	samples = vcd_import(buf);
+	g_string_free(buf, TRUE);
+
+	ck_assert_msg(samples == G_N_ELEMENTS(logic),
+		"Expected %zu samples, got %" PRIu64 ".",
+		G_N_ELEMENTS(logic), samples);
+	ck_assert_msg(analog_counter == G_N_ELEMENTS(analog),
+		"Expected %zu analog samples, got %" PRIu64 ".",
+		G_N_ELEMENTS(analog), analog_counter);
+}
+END_TEST
+
+/* Import time of a wide VCD file, value changes for many signals. */
+START_TEST(bench_vcd_import)
+{
+	GString *buf;
+	char id[8];
+	size_t sig;
+	uint64_t ts, samples;
+	int64_t start, elapsed;
+
+	buf = g_string_sized_new(4 * 1024 * 1024);
+	g_string_append(buf, "$timescale 1 us $end\n$scope module top $end\n");
+	for (sig = 0; sig < BENCH_SIGNALS; sig++) {
+		bench_identifier(id, sig);
+		g_string_append_printf(buf, "$var wire 1 %s s%zu $end\n", id, sig);
+	}
+	g_string_append(buf, "$upscope $end\n$enddefinitions $end\n");
+	for (ts = 0; ts < BENCH_TIMESTAMPS; ts++) {
+		g_string_append_printf(buf, "#%" PRIu64 "\n", ts);
+		for (sig = ts % BENCH_STRIDE; sig < BENCH_SIGNALS; sig += BENCH_STRIDE) {
+			bench_identifier(id, sig);
+			g_string_append_printf(buf, "%d%s\n",
+				bench_value(sig, ts) ? 1 : 0, id);
+		}
+	}
+
+	expected_logic = NULL;
+	expected_analog = NULL;
+	expected_unitsize = BENCH_SIGNALS / 8;
+	bench_signals = BENCH_SIGNALS;
+	start = g_get_monotonic_time();
+	samples = vcd_import(buf);
+	elapsed = g_get_monotonic_time() - start;
+	printf("vcd import of %d signals, %zu bytes: %" PRId64 " us\n",
+		BENCH_SIGNALS, buf->len, elapsed);
+	g_string_free(buf, TRUE);
+
+	ck_assert_msg(samples == BENCH_TIMESTAMPS,
+		"Expected %d samples, got %" PRIu64 ".",
+		BENCH_TIMESTAMPS, samples);
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_vcd_identifiers);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+Suite *bench_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("import");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, bench_vcd_import);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
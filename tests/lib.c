@@ -24,6 +24,7 @@
 #include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 struct sr_context *srtest_ctx;
@@ -162,3 +163,55 @@ GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi)
 
 	return channels;
 }
+
+static int srtest_dev_nop(struct sr_dev_inst *sdi)
+{
+	(void)sdi;
+
+	return SR_OK;
+}
+
+static int srtest_dev_acquisition_nop(const struct sr_dev_inst *sdi)
+{
+	(void)sdi;
+
+	return SR_OK;
+}
+
+/* A driver without hardware, its devices get fed by the test code. */
+static struct sr_dev_driver srtest_dev_driver = {
+	.name = "srtest",
+	.longname = "Test device",
+	.api_version = 1,
+	.dev_open = srtest_dev_nop,
+	.dev_close = srtest_dev_nop,
+	.dev_acquisition_start = srtest_dev_acquisition_nop,
+	.dev_acquisition_stop = srtest_dev_acquisition_nop,
+};
+
+/*
+ * Create an open device with the given number of logic channels, which
+ * sessions can run with. Packets get sent by the test via sr_session_send().
+ */
+struct sr_dev_inst *srtest_dev_new(int logic_channels)
+{
+	struct sr_dev_inst *sdi;
+	char name[16];
+	int i;
+
+	sdi = g_malloc0(sizeof(*sdi));
+	sdi->status = SR_ST_ACTIVE;
+	sdi->driver = &srtest_dev_driver;
+	sdi->model = g_strdup("srtest");
+	for (i = 0; i < logic_channels; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_channel_new(sdi, i, SR_CHANNEL_LOGIC, TRUE, name);
+	}
+
+	return sdi;
+}
+
+void srtest_dev_free(struct sr_dev_inst *sdi)
+{
+	sr_dev_inst_free(sdi);
+}
@@ -41,11 +41,17 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 
 GArray *srtest_get_enabled_logic_channels(const struct sr_dev_inst *sdi);
 
+struct sr_dev_inst *srtest_dev_new(int logic_channels);
+void srtest_dev_free(struct sr_dev_inst *sdi);
+
 Suite *suite_core(void);
 Suite *suite_driver_all(void);
 Suite *suite_input_all(void);
 Suite *suite_input_binary(void);
+Suite *suite_input_csv(void);
+Suite *suite_input_vcd(void);
 Suite *suite_output_all(void);
+Suite *suite_output_srzip(void);
 Suite *suite_transform_all(void);
 Suite *suite_session(void);
 Suite *suite_strutil(void);
@@ -54,5 +60,14 @@ Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
 Suite *suite_conv(void);
+Suite *suite_buffer(void);
+Suite *suite_soft_trigger(void);
+Suite *suite_scpi(void);
+
+/* Benchmarks, not part of "make check". Run by tests/bench. */
+Suite *bench_driver_all(void);
+Suite *bench_input_csv(void);
+Suite *bench_input_vcd(void);
+Suite *bench_output_srzip(void);
 
 #endif
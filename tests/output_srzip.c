@@ -0,0 +1,967 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_CHANNELS 8
+#define SAMPLERATE SR_MHZ(1)
+/* Bytes per logic packet, and the srzip module's chunk size. */
+#define PACKET_SIZE (256 * 1024)
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+static uint64_t sample_counter, analog_counter;
+static gboolean data_mismatch, misaligned, have_seen_analog, have_seen_df_end;
+
+/* Sample pattern which differs between chunks but compresses well. */
+static uint8_t sample_value(uint64_t idx)
+{
+	return (idx >> 10) ^ (idx >> 22);
+}
+
+/* Analog values which are exactly representable as float. */
+static float analog_value(uint64_t idx)
+{
+	return (float)(idx & 0xffff) / 16;
+}
+
+static struct sr_dev_inst *dev_new(gboolean with_analog)
+{
+	struct sr_dev_inst *sdi;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	ck_assert_msg(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	for (i = 0; i < NUM_CHANNELS; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	if (with_analog)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_ANALOG, "A0");
+
+	return sdi;
+}
+
+/* Write a capture of the given size through the srzip output module. */
+static void srzip_write(const char *filename, uint64_t num_bytes,
+	GHashTable *options, gboolean with_analog)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet, apacket;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_config src;
+	uint8_t *buf;
+	float *values;
+	uint64_t pos;
+	size_t i, len;
+	GString *out;
+	int ret;
+
+	sdi = dev_new(with_analog);
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, filename);
+	ck_assert_msg(o != NULL, "Failed to create srzip output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SAMPLERATE));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send(o, &packet, &out);
+	ck_assert_msg(ret == SR_OK, "Failed to send meta packet: %d.", ret);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	buf = g_malloc(PACKET_SIZE);
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.data = buf;
+
+	values = g_malloc(PACKET_SIZE * sizeof(float));
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.channels = g_slist_last(sr_dev_inst_channels_get(sdi));
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.data = values;
+	apacket.type = SR_DF_ANALOG;
+	apacket.payload = &analog;
+
+	for (pos = 0; pos < num_bytes; pos += len) {
+		len = MIN(num_bytes - pos, PACKET_SIZE);
+		for (i = 0; i < len; i++)
+			buf[i] = sample_value(pos + i);
+		logic.length = len;
+		ret = sr_output_send(o, &packet, &out);
+		ck_assert_msg(ret == SR_OK, "Failed to send logic packet: %d.", ret);
+		if (!with_analog)
+			continue;
+		for (i = 0; i < len; i++)
+			values[i] = analog_value(pos + i);
+		analog.num_samples = len;
+		ret = sr_output_send(o, &apacket, &out);
+		ck_assert_msg(ret == SR_OK, "Failed to send analog packet: %d.", ret);
+	}
+	g_free(values);
+	g_free(buf);
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	ck_assert_msg(ret == SR_OK, "Failed to send end packet: %d.", ret);
+	sr_output_free(o);
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const uint8_t *data;
+	const float *values;
+	uint64_t i;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		for (i = 0; i < logic->length; i++) {
+			if (data[i] != sample_value(sample_counter + i))
+				data_mismatch = TRUE;
+		}
+		/* Analog data must have caught up with the previous block. */
+		if (have_seen_analog && analog_counter != sample_counter)
+			misaligned = TRUE;
+		sample_counter += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		values = analog->data;
+		for (i = 0; i < analog->num_samples; i++) {
+			if (values[i] != analog_value(analog_counter + i))
+				data_mismatch = TRUE;
+		}
+		/* Analog data covers the range of the preceding logic data. */
+		analog_counter += analog->num_samples;
+		have_seen_analog = TRUE;
+		if (analog_counter != sample_counter)
+			misaligned = TRUE;
+		break;
+	case SR_DF_END:
+		have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Replay a loaded session, starting at the given sample. */
+static void srzip_replay(struct sr_session *session, uint64_t start,
+	uint64_t num_bytes)
+{
+	int ret;
+
+	sample_counter = start;
+	analog_counter = start;
+	data_mismatch = FALSE;
+	misaligned = FALSE;
+	have_seen_analog = FALSE;
+	have_seen_df_end = FALSE;
+
+	sr_session_datafeed_callback_remove_all(session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	ret = sr_session_start(session);
+	ck_assert_msg(ret == SR_OK, "Failed to start session: %d.", ret);
+	sr_session_run(session);
+
+	ck_assert(have_seen_df_end);
+	ck_assert_msg(sample_counter == num_bytes,
+		"Expected %" PRIu64 " samples, got %" PRIu64 ".",
+		num_bytes, sample_counter);
+	ck_assert_msg(!data_mismatch, "Sample data mismatch.");
+	ck_assert_msg(!misaligned, "Logic and analog data not interleaved.");
+}
+
+/* Load a session file and check it against what srzip_write() wrote. */
+static void srzip_check(const char *filename, uint64_t num_bytes)
+{
+	struct sr_session *session;
+	int ret;
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load '%s': %d.", filename, ret);
+	srzip_replay(session, 0, num_bytes);
+	sr_session_destroy(session);
+}
+
+static char *srzip_filename(void)
+{
+	char *filename;
+	int fd;
+
+	fd = g_file_open_tmp("srzip-XXXXXX.sr", &filename, NULL);
+	ck_assert_msg(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+
+	return filename;
+}
+
+/* Check whether a multi-chunk capture survives a write/load cycle. */
+START_TEST(test_srzip_roundtrip)
+{
+	char *filename;
+	uint64_t num_bytes;
+
+	filename = srzip_filename();
+	num_bytes = 3 * CHUNK_SIZE + 12345;
+	srzip_write(filename, num_bytes, NULL, FALSE);
+	srzip_check(filename, num_bytes);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+static GHashTable *srzip_options_new(const char *compression,
+	uint32_t level, uint32_t threads)
+{
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "compression",
+		g_variant_ref_sink(g_variant_new_string(compression)));
+	g_hash_table_insert(options, "level",
+		g_variant_ref_sink(g_variant_new_uint32(level)));
+	g_hash_table_insert(options, "threads",
+		g_variant_ref_sink(g_variant_new_uint32(threads)));
+
+	return options;
+}
+
+/* Check whether all compression settings produce readable files. */
+START_TEST(test_srzip_compression)
+{
+	static const struct {
+		const char *compression;
+		uint32_t level, threads;
+	} settings[] = {
+		{ "store", 6, 0, },
+		{ "store", 6, 4, },
+		{ "deflate", 1, 0, },
+		{ "deflate", 9, 1, },
+		{ "deflate", 6, 4, },
+		{ "lzo", 6, 0, },
+		{ "lzo", 6, 4, },
+	};
+	GHashTable *options;
+	char *filename;
+	uint64_t num_bytes;
+	size_t i;
+
+	filename = srzip_filename();
+	num_bytes = 5 * CHUNK_SIZE / 2;
+	for (i = 0; i < G_N_ELEMENTS(settings); i++) {
+		options = srzip_options_new(settings[i].compression,
+			settings[i].level, settings[i].threads);
+		srzip_write(filename, num_bytes, options, FALSE);
+		g_hash_table_destroy(options);
+		srzip_check(filename, num_bytes);
+	}
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check whether mixed signal captures get replayed with logic and
+ * analog packets covering the same sample ranges, in lockstep.
+ */
+START_TEST(test_srzip_interleaved)
+{
+	char *filename;
+	uint64_t num_samples;
+
+	filename = srzip_filename();
+	num_samples = CHUNK_SIZE + 5000;
+	srzip_write(filename, num_samples, NULL, TRUE);
+	srzip_check(filename, num_samples);
+	ck_assert(analog_counter == num_samples);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check random access reads and seeking within a session file. */
+START_TEST(test_srzip_seek)
+{
+	static const uint64_t starts[] = {
+		0, 1, CHUNK_SIZE - 1, CHUNK_SIZE, 2 * CHUNK_SIZE + 777,
+	};
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	char *filename;
+	uint8_t *buf;
+	uint64_t num_bytes, num_samples, count, i;
+	size_t j;
+	int ret;
+
+	filename = srzip_filename();
+	num_bytes = 3 * CHUNK_SIZE + 12345;
+	srzip_write(filename, num_bytes, NULL, FALSE);
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load '%s': %d.", filename, ret);
+	sr_session_dev_list(session, &devices);
+	ck_assert(devices != NULL);
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_session_file_num_samples(sdi, NULL, &num_samples);
+	ck_assert_msg(ret == SR_OK, "Failed to get sample count: %d.", ret);
+	ck_assert(num_samples == num_bytes);
+
+	/* Windows which start and end within and across chunks. */
+	count = CHUNK_SIZE + 1000;
+	buf = g_malloc(count);
+	for (j = 0; j < G_N_ELEMENTS(starts); j++) {
+		ret = sr_session_file_read(sdi, NULL, starts[j], count, buf);
+		ck_assert_msg(ret == SR_OK, "Failed to read: %d.", ret);
+		for (i = 0; i < count; i++) {
+			if (buf[i] != sample_value(starts[j] + i))
+				ck_abort_msg("Mismatch at sample %" PRIu64 ".",
+					starts[j] + i);
+		}
+	}
+	ret = sr_session_file_read(sdi, NULL, num_bytes - 10, 11, buf);
+	ck_assert(ret == SR_ERR_ARG);
+	g_free(buf);
+
+	for (j = 0; j < G_N_ELEMENTS(starts); j++) {
+		ret = sr_session_file_seek(sdi, starts[j]);
+		ck_assert_msg(ret == SR_OK, "Failed to seek: %d.", ret);
+		srzip_replay(session, starts[j], num_bytes);
+	}
+	ck_assert(sr_session_file_seek(sdi, num_bytes + 1) == SR_ERR_ARG);
+
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check playback of stored captures, which gets served from a memory
+ * mapping of the session file. Seeking to an odd sample makes blocks
+ * straddle chunk boundaries, which get copied instead.
+ */
+START_TEST(test_srzip_stored)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GSList *devices;
+	char *filename, *contents;
+	uint64_t num_samples;
+	gsize len;
+	int ret;
+
+	filename = srzip_filename();
+	num_samples = 2 * CHUNK_SIZE + 999;
+	options = srzip_options_new("store", 6, 2);
+	srzip_write(filename, num_samples, options, TRUE);
+	g_hash_table_destroy(options);
+	srzip_check(filename, num_samples);
+	ck_assert(analog_counter == num_samples);
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load '%s': %d.", filename, ret);
+	sr_session_dev_list(session, &devices);
+	ck_assert(devices != NULL);
+	sdi = devices->data;
+	g_slist_free(devices);
+	ret = sr_session_file_seek(sdi, 12345);
+	ck_assert_msg(ret == SR_OK, "Failed to seek: %d.", ret);
+	srzip_replay(session, 12345, num_samples);
+	ck_assert(have_seen_analog && analog_counter == num_samples);
+	sr_session_destroy(session);
+
+	/* Damaged chunks fail their CRC check, although libzip is bypassed. */
+	ck_assert(g_file_get_contents(filename, &contents, &len, NULL));
+	ck_assert(len > CHUNK_SIZE);
+	contents[CHUNK_SIZE / 2] ^= 0xff;
+	ck_assert(g_file_set_contents(filename, contents, len, NULL));
+	g_free(contents);
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load '%s': %d.", filename, ret);
+	sample_counter = 0;
+	have_seen_df_end = FALSE;
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	ret = sr_session_start(session);
+	ck_assert_msg(ret == SR_OK, "Failed to start session: %d.", ret);
+	sr_session_run(session);
+	ck_assert(have_seen_df_end);
+	ck_assert_msg(sample_counter < num_samples,
+		"Replayed a damaged chunk.");
+	sr_session_destroy(session);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check random access and seeking in LZO compressed mixed signal files. */
+START_TEST(test_srzip_lzo)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GHashTable *options;
+	GSList *devices;
+	char *filename;
+	float *values;
+	uint64_t num_samples, start, count, i;
+	int ret;
+
+	filename = srzip_filename();
+	num_samples = 2 * CHUNK_SIZE + 999;
+	options = srzip_options_new("lzo", 6, 2);
+	srzip_write(filename, num_samples, options, TRUE);
+	g_hash_table_destroy(options);
+
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load '%s': %d.", filename, ret);
+	sr_session_dev_list(session, &devices);
+	ck_assert(devices != NULL);
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	/* Analog chunks hold a quarter of the samples of logic chunks. */
+	ch = g_slist_last(sr_dev_inst_channels_get(sdi))->data;
+	ck_assert(ch->type == SR_CHANNEL_ANALOG);
+	start = CHUNK_SIZE / sizeof(float) - 100;
+	count = CHUNK_SIZE / sizeof(float) + 200;
+	values = g_malloc(count * sizeof(float));
+	ret = sr_session_file_read(sdi, ch, start, count, values);
+	ck_assert_msg(ret == SR_OK, "Failed to read: %d.", ret);
+	for (i = 0; i < count; i++) {
+		if (values[i] != analog_value(start + i))
+			ck_abort_msg("Mismatch at sample %" PRIu64 ".", start + i);
+	}
+	g_free(values);
+
+	srzip_replay(session, 0, num_samples);
+	ret = sr_session_file_seek(sdi, CHUNK_SIZE + 3);
+	ck_assert_msg(ret == SR_OK, "Failed to seek: %d.", ret);
+	srzip_replay(session, CHUNK_SIZE + 3, num_samples);
+	ck_assert(have_seen_analog && analog_counter == num_samples);
+
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check transition encoded logic data with all compression methods.
+ * The sample pattern has long runs, so stored files must come out a
+ * lot smaller than the raw data.
+ */
+START_TEST(test_srzip_transitions)
+{
+	static const char *compressions[] = { "store", "deflate", "lzo", };
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GStatBuf st;
+	GSList *devices;
+	char *filename;
+	uint8_t *buf;
+	uint64_t num_bytes, start, count, i;
+	size_t j;
+	int ret;
+
+	filename = srzip_filename();
+	num_bytes = 5 * CHUNK_SIZE / 2;
+	for (j = 0; j < G_N_ELEMENTS(compressions); j++) {
+		options = srzip_options_new(compressions[j], 6, 2);
+		g_hash_table_insert(options, "transitions",
+			g_variant_ref_sink(g_variant_new_boolean(TRUE)));
+		srzip_write(filename, num_bytes, options, FALSE);
+		g_hash_table_destroy(options);
+		ck_assert(g_stat(filename, &st) == 0);
+		ck_assert_msg((uint64_t)st.st_size < num_bytes / 100,
+			"Transition encoded file too large: %" PRIu64 " bytes.",
+			(uint64_t)st.st_size);
+		srzip_check(filename, num_bytes);
+
+		ret = sr_session_load(srtest_ctx, filename, &session);
+		ck_assert_msg(ret == SR_OK, "Failed to load: %d.", ret);
+		sr_session_dev_list(session, &devices);
+		ck_assert(devices != NULL);
+		sdi = devices->data;
+		g_slist_free(devices);
+
+		start = CHUNK_SIZE - 777;
+		count = CHUNK_SIZE;
+		buf = g_malloc(count);
+		ret = sr_session_file_read(sdi, NULL, start, count, buf);
+		ck_assert_msg(ret == SR_OK, "Failed to read: %d.", ret);
+		for (i = 0; i < count; i++) {
+			if (buf[i] != sample_value(start + i))
+				ck_abort_msg("Mismatch at sample %" PRIu64 ".",
+					start + i);
+		}
+		g_free(buf);
+
+		ret = sr_session_file_seek(sdi, start);
+		ck_assert_msg(ret == SR_OK, "Failed to seek: %d.", ret);
+		srzip_replay(session, start, num_bytes);
+		sr_session_destroy(session);
+	}
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Find the next edge of a logic channel in the sample pattern. */
+static uint64_t pattern_edge(unsigned int bit, uint64_t start,
+	uint64_t num_samples)
+{
+	uint64_t i;
+
+	for (i = MAX(start, 1); i < num_samples; i++) {
+		if ((sample_value(i) ^ sample_value(i - 1)) & (1 << bit))
+			break;
+	}
+
+	return MIN(i, num_samples);
+}
+
+/*
+ * Check the summaries of logic and analog data against the sample
+ * pattern, at several zoom levels, and edge searches with and without
+ * summaries.
+ */
+START_TEST(test_srzip_summaries)
+{
+	static const uint64_t block_samples[] = { 1024, 16384, 1 << 20, };
+	static const unsigned int bits[] = { 0, 3, 7, };
+	static const uint64_t starts[] = {
+		0, 1, 1023, 1024, 5000, 1 << 17, (1 << 17) + 1,
+		CHUNK_SIZE - 1, 5 * CHUNK_SIZE / 2 - 1, 5 * CHUNK_SIZE / 2,
+	};
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch, *ach;
+	GHashTable *options;
+	GSList *devices, *l;
+	char *filename;
+	uint8_t *flags, expected;
+	float *minmax, lo, hi;
+	uint64_t num_samples, num_blocks, first, last, sample, i, j;
+	size_t k, b, s;
+	int with_summaries, ret;
+
+	filename = srzip_filename();
+	num_samples = 5 * CHUNK_SIZE / 2;
+	for (with_summaries = 1; with_summaries >= 0; with_summaries--) {
+		options = srzip_options_new("deflate", 1, 2);
+		g_hash_table_insert(options, "summaries",
+			g_variant_ref_sink(g_variant_new_boolean(with_summaries)));
+		srzip_write(filename, num_samples, options, TRUE);
+		g_hash_table_destroy(options);
+
+		ret = sr_session_load(srtest_ctx, filename, &session);
+		ck_assert_msg(ret == SR_OK, "Failed to load: %d.", ret);
+		sr_session_dev_list(session, &devices);
+		ck_assert(devices != NULL);
+		sdi = devices->data;
+		g_slist_free(devices);
+		ach = NULL;
+		for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+			ch = l->data;
+			if (ch->type == SR_CHANNEL_ANALOG)
+				ach = ch;
+		}
+		ck_assert(ach != NULL);
+
+		for (b = 0; b < G_N_ELEMENTS(bits); b++) {
+			ch = g_slist_nth_data(sr_dev_inst_channels_get(sdi), bits[b]);
+			for (s = 0; s < G_N_ELEMENTS(starts); s++) {
+				ret = sr_session_file_find_edge(sdi, ch,
+					starts[s], &sample);
+				ck_assert_msg(ret == SR_OK,
+					"Failed to find edge: %d.", ret);
+				ck_assert_msg(sample == pattern_edge(bits[b],
+					starts[s], num_samples),
+					"Wrong edge of D%u after %" PRIu64 ": %"
+					PRIu64 ".", bits[b], starts[s], sample);
+			}
+		}
+
+		if (!with_summaries) {
+			ret = sr_session_file_summary(sdi, ach, 1024, 0, 1,
+				&lo);
+			ck_assert_msg(ret == SR_ERR_NA,
+				"Summary without summaries: %d.", ret);
+			sr_session_destroy(session);
+			continue;
+		}
+
+		ret = sr_session_file_summary(sdi, ach, 1000, 0, 1, &lo);
+		ck_assert(ret == SR_ERR_ARG);
+		for (k = 0; k < G_N_ELEMENTS(block_samples); k++) {
+			num_blocks = (num_samples + block_samples[k] - 1) /
+				block_samples[k];
+			flags = g_malloc(num_blocks);
+			minmax = g_malloc(2 * (num_blocks + 1) * sizeof(float));
+			ret = sr_session_file_summary(sdi, ach,
+				block_samples[k], 0, num_blocks + 1, minmax);
+			ck_assert(ret == SR_ERR_ARG);
+			ret = sr_session_file_summary(sdi, ach,
+				block_samples[k], 0, num_blocks, minmax);
+			ck_assert_msg(ret == SR_OK, "Failed to summarize: %d.", ret);
+			for (i = 0; i < num_blocks; i++) {
+				first = i * block_samples[k];
+				last = MIN(first + block_samples[k], num_samples);
+				lo = hi = analog_value(first);
+				for (j = first; j < last; j++) {
+					lo = MIN(lo, analog_value(j));
+					hi = MAX(hi, analog_value(j));
+				}
+				ck_assert_msg(minmax[2 * i] == lo &&
+					minmax[2 * i + 1] == hi,
+					"Analog summary mismatch in block %" PRIu64 ".", i);
+			}
+			for (b = 0; b < G_N_ELEMENTS(bits); b++) {
+				ch = g_slist_nth_data(sr_dev_inst_channels_get(sdi),
+					bits[b]);
+				ret = sr_session_file_summary(sdi, ch,
+					block_samples[k], 0, num_blocks, flags);
+				ck_assert_msg(ret == SR_OK,
+					"Failed to summarize: %d.", ret);
+				for (i = 0; i < num_blocks; i++) {
+					first = i * block_samples[k];
+					last = MIN(first + block_samples[k],
+						num_samples);
+					expected = (sample_value(first) &
+						(1 << bits[b])) ? SR_SUMMARY_HIGH : 0;
+					if (pattern_edge(bits[b], first, last) < last)
+						expected |= SR_SUMMARY_EDGE;
+					ck_assert_msg(flags[i] == expected,
+						"Logic summary mismatch of D%u in "
+						"block %" PRIu64 ".", bits[b], i);
+				}
+			}
+			g_free(minmax);
+			g_free(flags);
+		}
+		sr_session_destroy(session);
+	}
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check whether session files written in journal mode can be recovered
+ * after the writer got interrupted, from the completely written and
+ * undamaged chunks.
+ */
+START_TEST(test_srzip_recover)
+{
+	static const struct {
+		uint64_t cut, damage, num_samples;
+	} cases[] = {
+		{ 5 * CHUNK_SIZE / 2, 0, 2 * CHUNK_SIZE, },
+		{ 5 * CHUNK_SIZE / 2, 3 * CHUNK_SIZE / 2, CHUNK_SIZE, },
+	};
+	struct sr_session *session;
+	GHashTable *options;
+	GStatBuf st;
+	char *filename, *contents;
+	gsize len;
+	off_t size;
+	size_t i;
+	int ret;
+
+	filename = srzip_filename();
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		options = srzip_options_new("store", 6, 2);
+		g_hash_table_insert(options, "journal",
+			g_variant_ref_sink(g_variant_new_boolean(TRUE)));
+		srzip_write(filename, 3 * CHUNK_SIZE, options, FALSE);
+		g_hash_table_destroy(options);
+		srzip_check(filename, 3 * CHUNK_SIZE);
+
+		/* Complete files are left alone. */
+		ck_assert(g_stat(filename, &st) == 0);
+		size = st.st_size;
+		ret = sr_session_file_recover(filename);
+		ck_assert_msg(ret == SR_OK, "Failed to recover: %d.", ret);
+		ck_assert(g_stat(filename, &st) == 0);
+		ck_assert(st.st_size == size);
+
+		ck_assert(g_file_get_contents(filename, &contents, &len, NULL));
+		ck_assert(len > cases[i].cut);
+		if (cases[i].damage)
+			memset(contents + cases[i].damage, 0, 4096);
+		ck_assert(g_file_set_contents(filename, contents,
+			cases[i].cut, NULL));
+		g_free(contents);
+		ret = sr_session_load(srtest_ctx, filename, &session);
+		ck_assert_msg(ret != SR_OK, "Loaded an incomplete file.");
+
+		ret = sr_session_file_recover(filename);
+		ck_assert_msg(ret == SR_OK, "Failed to recover: %d.", ret);
+		srzip_check(filename, cases[i].num_samples);
+	}
+
+	/* Without a journal, the metadata is missing. */
+	srzip_write(filename, 3 * CHUNK_SIZE, NULL, FALSE);
+	ck_assert(g_file_get_contents(filename, &contents, &len, NULL));
+	ck_assert(g_file_set_contents(filename, contents, len / 2, NULL));
+	g_free(contents);
+	ret = sr_session_file_recover(filename);
+	ck_assert_msg(ret == SR_ERR_DATA, "Recovered without metadata: %d.",
+		ret);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check whether playback with chunks decompressed ahead by worker
+ * threads sends the same data, in order.
+ */
+START_TEST(test_srzip_prefetch)
+{
+	static const char *compressions[] = { "deflate", "lzo", };
+	static const struct {
+		unsigned int threads, depth;
+	} settings[] = {
+		{ 0, 0, },
+		{ 1, 1, },
+		{ 2, 2, },
+	};
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GSList *devices;
+	char *filename;
+	uint64_t num_samples, start;
+	size_t i, j;
+	int ret;
+
+	filename = srzip_filename();
+	num_samples = 3 * CHUNK_SIZE + 999;
+	for (i = 0; i < G_N_ELEMENTS(compressions); i++) {
+		options = srzip_options_new(compressions[i], 6, 2);
+		srzip_write(filename, num_samples, options, TRUE);
+		g_hash_table_destroy(options);
+		for (j = 0; j < G_N_ELEMENTS(settings); j++) {
+			ret = sr_session_load(srtest_ctx, filename, &session);
+			ck_assert_msg(ret == SR_OK, "Failed to load: %d.", ret);
+			sr_session_dev_list(session, &devices);
+			ck_assert(devices != NULL);
+			sdi = devices->data;
+			g_slist_free(devices);
+			ret = sr_session_file_prefetch_set(sdi,
+				settings[j].threads, settings[j].depth);
+			ck_assert_msg(ret == SR_OK, "Failed to set: %d.", ret);
+			srzip_replay(session, 0, num_samples);
+
+			start = 3 * CHUNK_SIZE / 2;
+			ret = sr_session_file_seek(sdi, start);
+			ck_assert_msg(ret == SR_OK, "Failed to seek: %d.", ret);
+			srzip_replay(session, start, num_samples);
+			sr_session_destroy(session);
+		}
+	}
+	ret = sr_session_load(srtest_ctx, filename, &session);
+	ck_assert_msg(ret == SR_OK, "Failed to load: %d.", ret);
+	sr_session_dev_list(session, &devices);
+	sdi = devices->data;
+	g_slist_free(devices);
+	ck_assert(sr_session_file_prefetch_set(sdi, 2, 0) == SR_ERR_ARG);
+	ck_assert(sr_session_file_prefetch_set(sdi, 33, 1) == SR_ERR_ARG);
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Benchmark srzip writes for increasing capture sizes. The archive
+ * stays open across chunks, so the time per chunk should not grow
+ * with the number of chunks already written. Compression in the
+ * session thread and in background threads get compared, as well as
+ * deflate and LZO compression.
+ */
+START_TEST(bench_srzip_write)
+{
+	static const char *compressions[] = { "deflate", "lzo", };
+	GHashTable *options;
+	char *filename;
+	unsigned int chunks;
+	uint32_t threads;
+	int64_t start, elapsed;
+	size_t i;
+
+	filename = srzip_filename();
+	for (i = 0; i < G_N_ELEMENTS(compressions); i++) {
+		for (threads = 0; threads <= 4; threads += 4) {
+			options = srzip_options_new(compressions[i], 6, threads);
+			for (chunks = 4; chunks <= 16; chunks *= 2) {
+				start = g_get_monotonic_time();
+				srzip_write(filename, (uint64_t)chunks * CHUNK_SIZE,
+					options, FALSE);
+				elapsed = g_get_monotonic_time() - start;
+				printf("srzip %s write of %u chunks, "
+					"%u threads: %" PRId64 " us (%" PRId64
+					" us per chunk)\n", compressions[i], chunks,
+					threads, elapsed, elapsed / chunks);
+			}
+			g_hash_table_destroy(options);
+		}
+	}
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Benchmark playback of compressed session files, with chunks
+ * decompressed in the session thread and by prefetch workers.
+ */
+START_TEST(bench_srzip_replay)
+{
+	static const char *compressions[] = { "deflate", "lzo", };
+	static const unsigned int threads[] = { 0, 1, 2, 4, };
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GSList *devices;
+	char *filename;
+	uint64_t num_samples;
+	int64_t start, elapsed;
+	size_t i, j;
+	int ret;
+
+	filename = srzip_filename();
+	num_samples = 16 * CHUNK_SIZE;
+	for (i = 0; i < G_N_ELEMENTS(compressions); i++) {
+		options = srzip_options_new(compressions[i], 6, 4);
+		srzip_write(filename, num_samples, options, TRUE);
+		g_hash_table_destroy(options);
+		for (j = 0; j < G_N_ELEMENTS(threads); j++) {
+			ret = sr_session_load(srtest_ctx, filename, &session);
+			ck_assert_msg(ret == SR_OK, "Failed to load: %d.", ret);
+			sr_session_dev_list(session, &devices);
+			sdi = devices->data;
+			g_slist_free(devices);
+			ret = sr_session_file_prefetch_set(sdi, threads[j], 2);
+			ck_assert_msg(ret == SR_OK, "Failed to set: %d.", ret);
+
+			start = g_get_monotonic_time();
+			srzip_replay(session, 0, num_samples);
+			elapsed = g_get_monotonic_time() - start;
+			printf("srzip %s replay of %" PRIu64 " chunks, "
+				"%u prefetch threads: %" PRId64 " us\n",
+				compressions[i], num_samples / CHUNK_SIZE,
+				threads[j], elapsed);
+			sr_session_destroy(session);
+		}
+	}
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+Suite *suite_output_srzip(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-srzip");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_srzip_roundtrip);
+	tcase_add_test(tc, test_srzip_compression);
+	tcase_add_test(tc, test_srzip_interleaved);
+	tcase_add_test(tc, test_srzip_seek);
+	tcase_add_test(tc, test_srzip_stored);
+	tcase_add_test(tc, test_srzip_lzo);
+	tcase_add_test(tc, test_srzip_transitions);
+	tcase_add_test(tc, test_srzip_summaries);
+	tcase_add_test(tc, test_srzip_recover);
+	tcase_add_test(tc, test_srzip_prefetch);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
+
+Suite *bench_output_srzip(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-srzip");
+
+	tc = tcase_create("write");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, bench_srzip_write);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("replay");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, bench_srzip_replay);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,319 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+#include "lib.h"
+
+/*
+ * A device behind a fake transport. It answers queries from a table,
+ * and logs all commands it receives.
+ */
+struct fake_scpi {
+	/* Whether compound queries get all replies, or just the first. */
+	gboolean compound;
+	GPtrArray *sent;
+	GString *reply;
+	size_t read_pos;
+};
+
+static const char *fake_replies[][2] = {
+	{ "VOLT?", "1.5" },
+	{ "CURR?", "0.25" },
+	{ "SYST:NAME?", "\"a;b\"" },
+	{ "MEAS:VOLT?", "12.5" },
+	{ "OUTP?", "1" },
+	{ "SYST:ERR?", "nonsense" },
+};
+
+static const char *fake_reply_get(const char *query)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(fake_replies); i++) {
+		if (!strcmp(fake_replies[i][0], query))
+			return fake_replies[i][1];
+	}
+
+	return "";
+}
+
+static int fake_send(void *priv, const char *command)
+{
+	struct fake_scpi *fake;
+	char *cmd, **queries;
+	size_t i;
+
+	fake = priv;
+	cmd = g_strchomp(g_strdup(command));
+	g_ptr_array_add(fake->sent, cmd);
+	if (!strchr(cmd, '?'))
+		return SR_OK;
+
+	g_string_truncate(fake->reply, 0);
+	fake->read_pos = 0;
+	queries = g_strsplit(cmd, ";", 0);
+	for (i = 0; queries[i]; i++) {
+		if (i && !fake->compound)
+			break;
+		if (i)
+			g_string_append_c(fake->reply, ';');
+		g_string_append(fake->reply, fake_reply_get(
+			queries[i] + (queries[i][0] == ':')));
+	}
+	g_strfreev(queries);
+	g_string_append_c(fake->reply, '\n');
+
+	return SR_OK;
+}
+
+static int fake_read_begin(void *priv)
+{
+	(void)priv;
+
+	return SR_OK;
+}
+
+static int fake_read_data(void *priv, char *buf, int maxlen)
+{
+	struct fake_scpi *fake;
+	int len;
+
+	fake = priv;
+	len = MIN((size_t)maxlen, fake->reply->len - fake->read_pos);
+	memcpy(buf, fake->reply->str + fake->read_pos, len);
+	fake->read_pos += len;
+
+	return len;
+}
+
+static int fake_read_complete(void *priv)
+{
+	struct fake_scpi *fake;
+
+	fake = priv;
+
+	return fake->read_pos == fake->reply->len;
+}
+
+static struct sr_scpi_dev_inst *fake_scpi_new(gboolean compound)
+{
+	struct sr_scpi_dev_inst *scpi;
+	struct fake_scpi *fake;
+
+	fake = g_malloc0(sizeof(*fake));
+	fake->compound = compound;
+	fake->sent = g_ptr_array_new_with_free_func(g_free);
+	fake->reply = g_string_new(NULL);
+
+	scpi = g_malloc0(sizeof(*scpi));
+	scpi->name = "fake";
+	scpi->send = fake_send;
+	scpi->read_begin = fake_read_begin;
+	scpi->read_data = fake_read_data;
+	scpi->read_complete = fake_read_complete;
+	scpi->read_timeout_us = 1000 * 1000;
+	scpi->priv = fake;
+	g_mutex_init(&scpi->scpi_mutex);
+
+	return scpi;
+}
+
+static void fake_scpi_free(struct sr_scpi_dev_inst *scpi)
+{
+	struct fake_scpi *fake;
+
+	fake = scpi->priv;
+	g_ptr_array_free(fake->sent, TRUE);
+	g_string_free(fake->reply, TRUE);
+	g_free(fake);
+	g_mutex_clear(&scpi->scpi_mutex);
+	g_free(scpi->actual_channel_name);
+	g_free(scpi);
+}
+
+static void check_sent(struct sr_scpi_dev_inst *scpi,
+		const char *const *expected, size_t count)
+{
+	struct fake_scpi *fake;
+	size_t i;
+
+	fake = scpi->priv;
+	ck_assert_msg(fake->sent->len == count, "Sent %u commands, not %zu.",
+		fake->sent->len, count);
+	for (i = 0; i < count; i++) {
+		ck_assert_msg(!strcmp(g_ptr_array_index(fake->sent, i),
+			expected[i]), "Sent '%s', not '%s'.",
+			(char *)g_ptr_array_index(fake->sent, i), expected[i]);
+	}
+	g_ptr_array_set_size(fake->sent, 0);
+}
+
+/* Command table entries, like drivers define them. */
+enum {
+	TEST_CMD_SELECT_CHANNEL = 1,
+	TEST_CMD_GET_VOLTAGE,
+	TEST_CMD_GET_ENABLED,
+	TEST_CMD_GET_LIMIT,
+	TEST_CMD_GET_TARGET,
+	TEST_CMD_GET_CURRENT,
+};
+
+static const char *const queries[] = { "VOLT?", "CURR?", ":SYST:NAME?", };
+static const char *const replies[] = { "1.5", "0.25", "\"a;b\"", };
+
+/* Queries get combined, quoted semicolons don't split the reply. */
+START_TEST(test_scpi_get_strings)
+{
+	static const char *const sent[] = { "VOLT?;:CURR?;:SYST:NAME?", };
+	struct sr_scpi_dev_inst *scpi;
+	char *responses[ARRAY_SIZE(queries)];
+	size_t i;
+	int ret;
+
+	scpi = fake_scpi_new(TRUE);
+	ret = sr_scpi_get_strings(scpi, queries, ARRAY_SIZE(queries),
+		responses);
+	ck_assert_msg(ret == SR_OK, "sr_scpi_get_strings() error: %d", ret);
+	check_sent(scpi, sent, ARRAY_SIZE(sent));
+	for (i = 0; i < ARRAY_SIZE(queries); i++) {
+		ck_assert_msg(!g_strcmp0(responses[i], replies[i]),
+			"Reply %zu is '%s'.", i, responses[i]);
+		g_free(responses[i]);
+	}
+	fake_scpi_free(scpi);
+}
+END_TEST
+
+/* Devices which don't answer all queries get asked one by one. */
+START_TEST(test_scpi_get_strings_fallback)
+{
+	static const char *const sent[] = {
+		"VOLT?;:CURR?;:SYST:NAME?", "VOLT?", "CURR?", ":SYST:NAME?",
+	};
+	struct sr_scpi_dev_inst *scpi;
+	char *responses[ARRAY_SIZE(queries)];
+	size_t i;
+	int ret;
+
+	scpi = fake_scpi_new(FALSE);
+	ret = sr_scpi_get_strings(scpi, queries, ARRAY_SIZE(queries),
+		responses);
+	ck_assert(ret == SR_OK);
+	check_sent(scpi, sent, ARRAY_SIZE(sent));
+	for (i = 0; i < ARRAY_SIZE(queries); i++) {
+		ck_assert_msg(!g_strcmp0(responses[i], replies[i]),
+			"Reply %zu is '%s'.", i, responses[i]);
+		g_free(responses[i]);
+	}
+	fake_scpi_free(scpi);
+}
+END_TEST
+
+/* Queries from a command table, for a channel, with converted replies. */
+START_TEST(test_scpi_cmd_resp_many)
+{
+	static const struct scpi_command cmdtable[] = {
+		{ TEST_CMD_SELECT_CHANNEL, "INST:NSEL %s" },
+		{ TEST_CMD_GET_VOLTAGE, "MEAS:VOLT?" },
+		{ TEST_CMD_GET_ENABLED, "OUTP?" },
+		{ TEST_CMD_GET_LIMIT, "SYST:ERR?" },
+		{ TEST_CMD_GET_TARGET, "SOUR%s:VOLT?" },
+		ALL_ZERO
+	};
+	static const char *const sent_select[] = {
+		"INST:NSEL CH2", "MEAS:VOLT?;:OUTP?;:SYST:ERR?",
+	};
+	static const char *const sent_same[] = { "MEAS:VOLT?;:OUTP?", };
+	const int cmds[] = {
+		TEST_CMD_GET_VOLTAGE, TEST_CMD_GET_ENABLED,
+		TEST_CMD_GET_LIMIT,
+	};
+	const GVariantType *gvtypes[] = {
+		G_VARIANT_TYPE_DOUBLE, G_VARIANT_TYPE_BOOLEAN,
+		G_VARIANT_TYPE_DOUBLE,
+	};
+	const int unsupported[] = {
+		TEST_CMD_GET_VOLTAGE, TEST_CMD_GET_CURRENT,
+	};
+	const int with_args[] = {
+		TEST_CMD_GET_VOLTAGE, TEST_CMD_GET_TARGET,
+	};
+	struct sr_dev_inst sdi;
+	struct sr_scpi_dev_inst *scpi;
+	GVariant *gvars[ARRAY_SIZE(cmds)];
+	size_t i;
+	int ret;
+
+	scpi = fake_scpi_new(TRUE);
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.conn = scpi;
+
+	/* The channel gets selected, unparsable replies yield no value. */
+	ret = sr_scpi_cmd_resp_many(&sdi, cmdtable, TEST_CMD_SELECT_CHANNEL,
+		"CH2", gvars, gvtypes, cmds, ARRAY_SIZE(cmds));
+	ck_assert_msg(ret == SR_OK, "sr_scpi_cmd_resp_many() error: %d", ret);
+	check_sent(scpi, sent_select, ARRAY_SIZE(sent_select));
+	ck_assert(gvars[0] && g_variant_get_double(gvars[0]) == 12.5);
+	ck_assert(gvars[1] && g_variant_get_boolean(gvars[1]));
+	ck_assert(gvars[2] == NULL);
+	for (i = 0; i < 2; i++)
+		g_variant_unref(g_variant_ref_sink(gvars[i]));
+
+	/* The channel is selected already. */
+	ret = sr_scpi_cmd_resp_many(&sdi, cmdtable, TEST_CMD_SELECT_CHANNEL,
+		"CH2", gvars, gvtypes, cmds, 2);
+	ck_assert(ret == SR_OK);
+	check_sent(scpi, sent_same, ARRAY_SIZE(sent_same));
+	for (i = 0; i < 2; i++)
+		g_variant_unref(g_variant_ref_sink(gvars[i]));
+
+	/* Missing commands, and commands with arguments, are not sent. */
+	ret = sr_scpi_cmd_resp_many(&sdi, cmdtable, 0, NULL,
+		gvars, gvtypes, unsupported, ARRAY_SIZE(unsupported));
+	ck_assert(ret == SR_ERR_NA);
+	ret = sr_scpi_cmd_resp_many(&sdi, cmdtable, 0, NULL,
+		gvars, gvtypes, with_args, ARRAY_SIZE(with_args));
+	ck_assert(ret == SR_ERR_NA);
+	check_sent(scpi, NULL, 0);
+
+	fake_scpi_free(scpi);
+}
+END_TEST
+
+Suite *suite_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("compound");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_scpi_get_strings);
+	tcase_add_test(tc, test_scpi_get_strings_fallback);
+	tcase_add_test(tc, test_scpi_cmd_resp_many);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
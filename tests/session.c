@@ -19,10 +19,15 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
+/* Depth of the datafeed queue in the overrun tests. */
+#define QUEUE_DEPTH 4
+
 /*
  * Check whether sr_session_new() works.
  * If it returns != SR_OK (or segfaults) this test will fail.
@@ -185,6 +190,564 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/*
+ * Check whether the datafeed queue can get configured and queried.
+ * The statistics of a queue which never ran must be all zero.
+ */
+START_TEST(test_session_datafeed_queue_set_get)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_datafeed_queue_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	/* Without a queue, there are no statistics. */
+	ret = sr_session_datafeed_queue_stats_get(sess, &stats);
+	ck_assert(ret == SR_ERR_NA);
+
+	ret = sr_session_datafeed_queue_set(sess, 64, SR_DF_QUEUE_DROP_OLDEST);
+	ck_assert(ret == SR_OK);
+	ret = sr_session_datafeed_queue_stats_get(sess, &stats);
+	ck_assert(ret == SR_OK);
+	ck_assert(stats.queued == 0 && stats.dropped == 0);
+	ck_assert(stats.overruns == 0 && stats.fill_max == 0);
+
+	/* A depth of zero disables the queue again. */
+	ret = sr_session_datafeed_queue_set(sess, 0, SR_DF_QUEUE_BLOCK);
+	ck_assert(ret == SR_OK);
+	ret = sr_session_datafeed_queue_stats_get(sess, &stats);
+	ck_assert(ret == SR_ERR_NA);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+START_TEST(test_session_datafeed_queue_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_datafeed_queue_stats stats;
+
+	/* NULL session, must not segfault. */
+	ret = sr_session_datafeed_queue_set(NULL, 16, SR_DF_QUEUE_BLOCK);
+	ck_assert(ret == SR_ERR_ARG);
+	ret = sr_session_datafeed_queue_stats_get(NULL, &stats);
+	ck_assert(ret == SR_ERR_ARG);
+
+	/* Unknown policies must be rejected. */
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_datafeed_queue_set(sess, 16, 0);
+	ck_assert(ret == SR_ERR_ARG);
+	ret = sr_session_datafeed_queue_stats_get(sess, NULL);
+	ck_assert(ret == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Datafeed callback state of the queue overrun tests. The callback
+ * records the sequence numbers of logic packets, and blocks the queue's
+ * consumer until the test opens the gate.
+ */
+struct queue_gate {
+	GMutex mutex;
+	GCond cond;
+	gboolean entered;
+	gboolean open;
+	GArray *seqs;
+};
+
+static void queue_gate_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct queue_gate *gate;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	gate = cb_data;
+
+	g_mutex_lock(&gate->mutex);
+	g_array_append_val(gate->seqs, ((const uint8_t *)logic->data)[0]);
+	gate->entered = TRUE;
+	g_cond_broadcast(&gate->cond);
+	while (!gate->open)
+		g_cond_wait(&gate->cond, &gate->mutex);
+	g_mutex_unlock(&gate->mutex);
+}
+
+static void queue_gate_open(struct queue_gate *gate)
+{
+	g_mutex_lock(&gate->mutex);
+	gate->open = TRUE;
+	g_cond_broadcast(&gate->cond);
+	g_mutex_unlock(&gate->mutex);
+}
+
+/* Send a logic packet which carries a sequence number. */
+static int queue_send(const struct sr_dev_inst *sdi, uint8_t seq)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	logic.length = 1;
+	logic.unitsize = 1;
+	logic.data = &seq;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	return sr_session_send(sdi, &packet);
+}
+
+static gpointer queue_send_thread(gpointer data)
+{
+	return GINT_TO_POINTER(queue_send(data, QUEUE_DEPTH + 1));
+}
+
+/*
+ * Start a session with a datafeed queue, and fill the queue: the first
+ * packet is held by the blocked consumer, the next QUEUE_DEPTH packets
+ * are waiting on the queue.
+ */
+static void queue_fill(int policy, struct queue_gate *gate,
+		struct sr_session **sess, struct sr_dev_inst **sdi)
+{
+	struct sr_datafeed_queue_stats stats;
+	int ret, seq;
+
+	memset(gate, 0, sizeof(*gate));
+	g_mutex_init(&gate->mutex);
+	g_cond_init(&gate->cond);
+	gate->seqs = g_array_new(FALSE, FALSE, sizeof(uint8_t));
+
+	*sdi = srtest_dev_new(1);
+	sr_session_new(srtest_ctx, sess);
+	ret = sr_session_datafeed_queue_set(*sess, QUEUE_DEPTH, policy);
+	ck_assert(ret == SR_OK);
+	sr_session_datafeed_callback_add(*sess, queue_gate_cb, gate);
+	sr_session_dev_add(*sess, *sdi);
+	ret = sr_session_start(*sess);
+	ck_assert_msg(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+
+	ret = queue_send(*sdi, 0);
+	ck_assert(ret == SR_OK);
+	g_mutex_lock(&gate->mutex);
+	while (!gate->entered)
+		g_cond_wait(&gate->cond, &gate->mutex);
+	g_mutex_unlock(&gate->mutex);
+
+	for (seq = 1; seq <= QUEUE_DEPTH; seq++) {
+		ret = queue_send(*sdi, seq);
+		ck_assert(ret == SR_OK);
+	}
+	sr_session_datafeed_queue_stats_get(*sess, &stats);
+	ck_assert(stats.fill == QUEUE_DEPTH && stats.overruns == 0);
+}
+
+/* Let the consumer drain the queue, and stop the session. */
+static void queue_drain(struct queue_gate *gate,
+		struct sr_session *sess, struct sr_dev_inst *sdi)
+{
+	int ret;
+
+	queue_gate_open(gate);
+	ret = sr_session_run(sess);
+	ck_assert(ret == SR_OK);
+	sr_session_destroy(sess);
+	srtest_dev_free(sdi);
+}
+
+static void queue_gate_free(struct queue_gate *gate)
+{
+	g_array_free(gate->seqs, TRUE);
+	g_cond_clear(&gate->cond);
+	g_mutex_clear(&gate->mutex);
+}
+
+static void queue_check_seqs(struct queue_gate *gate,
+		const uint8_t *seqs, size_t count)
+{
+	size_t i;
+
+	ck_assert_msg(gate->seqs->len == count,
+		"Expected %zu packets, got %u.", count, gate->seqs->len);
+	for (i = 0; i < count; i++) {
+		ck_assert_msg(g_array_index(gate->seqs, uint8_t, i) == seqs[i],
+			"Packet %zu has sequence number %u, expected %u.", i,
+			g_array_index(gate->seqs, uint8_t, i), seqs[i]);
+	}
+}
+
+/*
+ * Check whether the BLOCK policy makes senders wait for room in a full
+ * queue, and whether all packets get delivered in order.
+ */
+START_TEST(test_session_datafeed_queue_block)
+{
+	static const uint8_t seqs[] = { 0, 1, 2, 3, 4, 5, };
+	struct queue_gate gate;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_queue_stats stats;
+	GThread *thread;
+
+	queue_fill(SR_DF_QUEUE_BLOCK, &gate, &sess, &sdi);
+
+	/* The sender gets blocked, wait until it ran into the overrun. */
+	thread = g_thread_new("test-sender", queue_send_thread, sdi);
+	do {
+		g_usleep(1000);
+		sr_session_datafeed_queue_stats_get(sess, &stats);
+	} while (!stats.overruns);
+	ck_assert(stats.fill == QUEUE_DEPTH);
+
+	queue_gate_open(&gate);
+	ck_assert(GPOINTER_TO_INT(g_thread_join(thread)) == SR_OK);
+	queue_drain(&gate, sess, sdi);
+
+	queue_check_seqs(&gate, seqs, ARRAY_SIZE(seqs));
+	queue_gate_free(&gate);
+}
+END_TEST
+
+/*
+ * Check whether the DROP_OLDEST policy discards the oldest waiting
+ * packets of a full queue, and keeps the newest ones in order.
+ */
+START_TEST(test_session_datafeed_queue_drop_oldest)
+{
+	static const uint8_t seqs[] = { 0, 4, 5, 6, 7, };
+	struct queue_gate gate;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_queue_stats stats;
+	int ret, seq;
+
+	queue_fill(SR_DF_QUEUE_DROP_OLDEST, &gate, &sess, &sdi);
+
+	for (seq = QUEUE_DEPTH + 1; seq <= QUEUE_DEPTH + 3; seq++) {
+		ret = queue_send(sdi, seq);
+		ck_assert(ret == SR_OK);
+	}
+	sr_session_datafeed_queue_stats_get(sess, &stats);
+	ck_assert(stats.fill == QUEUE_DEPTH && stats.fill_max == QUEUE_DEPTH);
+	ck_assert(stats.overruns == 3 && stats.dropped == 3);
+
+	queue_drain(&gate, sess, sdi);
+
+	queue_check_seqs(&gate, seqs, ARRAY_SIZE(seqs));
+	queue_gate_free(&gate);
+}
+END_TEST
+
+/*
+ * Check whether the FAIL policy rejects packets which are sent to a
+ * full queue, and whether the packets which were queued before still
+ * get delivered.
+ */
+START_TEST(test_session_datafeed_queue_fail)
+{
+	static const uint8_t seqs[] = { 0, 1, 2, 3, 4, };
+	struct queue_gate gate;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_queue_stats stats;
+	int ret;
+
+	queue_fill(SR_DF_QUEUE_FAIL, &gate, &sess, &sdi);
+
+	ret = queue_send(sdi, QUEUE_DEPTH + 1);
+	ck_assert(ret == SR_ERR);
+	sr_session_datafeed_queue_stats_get(sess, &stats);
+	ck_assert(stats.overruns == 1 && stats.dropped == 1);
+
+	queue_drain(&gate, sess, sdi);
+
+	queue_check_seqs(&gate, seqs, ARRAY_SIZE(seqs));
+	queue_gate_free(&gate);
+}
+END_TEST
+
+/*
+ * Check whether the instrumentation counters of a new session are zero,
+ * and whether bogus arguments get rejected.
+ */
+START_TEST(test_session_stats)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_stats_get(sess, NULL, &stats);
+	ck_assert(ret == SR_OK);
+	ck_assert(stats.packets == 0 && stats.bytes == 0);
+	ck_assert(stats.send_time == 0 && stats.send_time_max == 0);
+	ck_assert(stats.transfers_dropped == 0 && stats.transfers_overrun == 0);
+	ret = sr_session_stats_reset(sess);
+	ck_assert(ret == SR_OK);
+
+	ret = sr_session_stats_get(sess, NULL, NULL);
+	ck_assert(ret == SR_ERR_ARG);
+	sr_session_destroy(sess);
+
+	/* NULL session, must not segfault. */
+	ret = sr_session_stats_get(NULL, NULL, &stats);
+	ck_assert(ret == SR_ERR_ARG);
+	ret = sr_session_stats_reset(NULL);
+	ck_assert(ret == SR_ERR_ARG);
+}
+END_TEST
+
+/* Number of packets the second thread sends in test_session_stats_send. */
+#define STATS_THREAD_PACKETS 2000
+
+static gpointer stats_send_thread(gpointer data)
+{
+	int i;
+
+	for (i = 0; i < STATS_THREAD_PACKETS; i++)
+		queue_send(data, i);
+
+	return NULL;
+}
+
+/*
+ * Check the instrumentation counters after sending packets from two
+ * threads and two devices, and their reset. Each packet has one byte
+ * of payload, readers must never see the counters of a thread half
+ * updated.
+ */
+START_TEST(test_session_stats_send)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi, *sdi2;
+	struct sr_session_stats stats, prev;
+	GThread *thread;
+	int i;
+
+	sdi = srtest_dev_new(1);
+	sdi2 = srtest_dev_new(1);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_dev_add(sess, sdi2);
+
+	for (i = 0; i < 10; i++)
+		ck_assert(queue_send(sdi, i) == SR_OK);
+	for (i = 0; i < 3; i++)
+		ck_assert(queue_send(sdi2, i) == SR_OK);
+	sr_session_stats_transfer_error(sdi, TRUE);
+	sr_session_stats_transfer_error(sdi2, FALSE);
+	sr_session_stats_transfer_error(sdi2, FALSE);
+
+	sr_session_stats_get(sess, sdi, &stats);
+	ck_assert(stats.packets == 10 && stats.bytes == 10);
+	ck_assert(stats.transfers_overrun == 1 && stats.transfers_dropped == 0);
+	ck_assert(stats.send_time >= stats.send_time_max);
+	sr_session_stats_get(sess, sdi2, &stats);
+	ck_assert(stats.packets == 3 && stats.bytes == 3);
+	ck_assert(stats.transfers_overrun == 0 && stats.transfers_dropped == 2);
+	sr_session_stats_get(sess, NULL, &stats);
+	ck_assert(stats.packets == 13 && stats.bytes == 13);
+	ck_assert(stats.transfers_overrun == 1 && stats.transfers_dropped == 2);
+
+	/* Read and reset while another thread sends. */
+	memset(&prev, 0, sizeof(prev));
+	thread = g_thread_new("test-sender", stats_send_thread, sdi);
+	for (i = 0; i < 200; i++) {
+		if (i == 100) {
+			ck_assert(sr_session_stats_reset(sess) == SR_OK);
+			memset(&prev, 0, sizeof(prev));
+		}
+		sr_session_stats_get(sess, sdi, &stats);
+		ck_assert_msg(stats.bytes == stats.packets,
+			"%" PRIu64 " bytes in %" PRIu64 " packets.",
+			stats.bytes, stats.packets);
+		ck_assert(stats.packets >= prev.packets);
+		prev = stats;
+	}
+	g_thread_join(thread);
+
+	/* Counters of both threads get summed up. */
+	ck_assert(sr_session_stats_reset(sess) == SR_OK);
+	thread = g_thread_new("test-sender", stats_send_thread, sdi);
+	ck_assert(queue_send(sdi, 0) == SR_OK);
+	g_thread_join(thread);
+	sr_session_stats_get(sess, sdi, &stats);
+	ck_assert(stats.packets == STATS_THREAD_PACKETS + 1);
+	ck_assert(stats.bytes == STATS_THREAD_PACKETS + 1);
+	ck_assert(stats.transfers_overrun == 0);
+	sr_session_stats_get(sess, sdi2, &stats);
+	ck_assert(stats.packets == 0 && stats.transfers_dropped == 0);
+
+	sr_session_destroy(sess);
+	srtest_dev_free(sdi2);
+	srtest_dev_free(sdi);
+}
+END_TEST
+
+/*
+ * Check whether sr_packet_copy() copies logic packets, including
+ * multi-byte sample units, and whether sr_packet_free() frees them.
+ */
+START_TEST(test_packet_copy_logic)
+{
+	int ret;
+	uint8_t samples[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+	struct sr_datafeed_logic logic, *logic_copy;
+	struct sr_datafeed_packet packet, *copy;
+
+	logic.length = sizeof(samples);
+	logic.unitsize = 2;
+	logic.data = samples;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	ret = sr_packet_copy(&packet, &copy);
+	ck_assert(ret == SR_OK);
+	ck_assert(copy != NULL);
+	ck_assert(copy->type == SR_DF_LOGIC);
+	logic_copy = (struct sr_datafeed_logic *)copy->payload;
+	ck_assert(logic_copy->length == logic.length);
+	ck_assert(logic_copy->unitsize == logic.unitsize);
+	ck_assert(logic_copy->data != logic.data);
+	ck_assert(!memcmp(logic_copy->data, samples, sizeof(samples)));
+	sr_packet_free(copy);
+}
+END_TEST
+
+/* Packets which were not built by sr_packet_copy() can be freed, too. */
+START_TEST(test_packet_free_foreign)
+{
+	struct sr_datafeed_packet *packet;
+	struct sr_datafeed_logic *logic;
+
+	logic = g_malloc0(sizeof(*logic));
+	logic->length = 4;
+	logic->unitsize = 1;
+	logic->data = g_malloc0(logic->length);
+	packet = g_malloc0(sizeof(*packet));
+	packet->type = SR_DF_LOGIC;
+	packet->payload = logic;
+	sr_packet_free(packet);
+}
+END_TEST
+
+/* Datafeed callback which retains a copy of the last logic packet. */
+static void packet_retain_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct sr_datafeed_packet **copy;
+	int ret;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	copy = cb_data;
+	sr_packet_free(*copy);
+	ret = sr_packet_copy(packet, copy);
+	ck_assert(ret == SR_OK);
+}
+
+/*
+ * Check whether packets which get sent from a buffer are retained by
+ * taking a reference to the buffer instead of copying the sample data.
+ */
+START_TEST(test_packet_copy_buffer)
+{
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	struct sr_buffer *buf;
+	struct sr_datafeed_packet packet, *copy;
+	struct sr_datafeed_logic logic;
+	const struct sr_datafeed_logic *logic_copy;
+	int ret;
+
+	sdi = srtest_dev_new(8);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	copy = NULL;
+	sr_session_datafeed_callback_add(sess, packet_retain_cb, &copy);
+
+	buf = sr_buffer_new(64);
+	memset(buf->data, 0x55, buf->size);
+	logic.length = 16;
+	logic.unitsize = 1;
+	logic.data = buf->data + 8;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	/* The retained copy references the sender's buffer. */
+	ret = sr_session_send_buffer(sdi, &packet, buf);
+	ck_assert(ret == SR_OK);
+	ck_assert(copy != NULL);
+	logic_copy = copy->payload;
+	ck_assert(logic_copy->data == logic.data);
+	ck_assert(logic_copy->length == logic.length);
+	ck_assert(g_atomic_int_get(&buf->refcount) == 2);
+	sr_packet_free(copy);
+	copy = NULL;
+	ck_assert(g_atomic_int_get(&buf->refcount) == 1);
+
+	/* Without a buffer, the sample data gets copied. */
+	ret = sr_session_send(sdi, &packet);
+	ck_assert(ret == SR_OK);
+	ck_assert(copy != NULL);
+	logic_copy = copy->payload;
+	ck_assert(logic_copy->data != logic.data);
+	ck_assert(!memcmp(logic_copy->data, logic.data, logic.length));
+	ck_assert(g_atomic_int_get(&buf->refcount) == 1);
+	sr_packet_free(copy);
+
+	sr_buffer_unref(buf);
+	sr_session_destroy(sess);
+	srtest_dev_free(sdi);
+}
+END_TEST
+
+/*
+ * Check whether only payloads which are fully contained in the buffer
+ * that is currently being sent are found.
+ */
+START_TEST(test_buffer_current_find)
+{
+	struct sr_buffer *buf, *other, *prev;
+
+	buf = sr_buffer_new(32);
+	other = sr_buffer_new(32);
+
+	/* Nothing is being sent. */
+	ck_assert(sr_buffer_current_find(buf->data, 1) == NULL);
+
+	prev = sr_buffer_current_set(buf);
+	ck_assert(prev == NULL);
+	ck_assert(sr_buffer_current_find(buf->data, buf->size) == buf);
+	ck_assert(sr_buffer_current_find(buf->data + 31, 1) == buf);
+	ck_assert(sr_buffer_current_find(buf->data + 16, 0) == buf);
+	ck_assert(sr_buffer_current_find(buf->data + 16, 17) == NULL);
+	ck_assert(sr_buffer_current_find(other->data, 1) == NULL);
+	ck_assert(sr_buffer_current_find(NULL, 0) == NULL);
+
+	/* Nested sends restore the outer buffer. */
+	prev = sr_buffer_current_set(other);
+	ck_assert(prev == buf);
+	ck_assert(sr_buffer_current_find(other->data, 1) == other);
+	ck_assert(sr_buffer_current_find(buf->data, 1) == NULL);
+	prev = sr_buffer_current_set(prev);
+	ck_assert(prev == other);
+	ck_assert(sr_buffer_current_find(buf->data, 1) == buf);
+	sr_buffer_current_set(NULL);
+
+	sr_buffer_unref(other);
+	sr_buffer_unref(buf);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +772,28 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("datafeed_queue");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_datafeed_queue_set_get);
+	tcase_add_test(tc, test_session_datafeed_queue_bogus);
+	tcase_add_test(tc, test_session_datafeed_queue_block);
+	tcase_add_test(tc, test_session_datafeed_queue_drop_oldest);
+	tcase_add_test(tc, test_session_datafeed_queue_fail);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_stats);
+	tcase_add_test(tc, test_session_stats_send);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("packet");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_packet_copy_logic);
+	tcase_add_test(tc, test_packet_free_foreign);
+	tcase_add_test(tc, test_packet_copy_buffer);
+	tcase_add_test(tc, test_buffer_current_find);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
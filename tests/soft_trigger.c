@@ -0,0 +1,593 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok project developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+/* Number of logic channels of the test device. */
+#define LOGIC_CHANNELS 8
+/* The channel which gets triggered on. */
+#define TRIGGER_BIT 2
+/* Sample count of the test buffers: eight full words plus a partial one. */
+#define SAMPLE_COUNT 69
+/* Analog channels A0..A2 of the test device, A1 is disabled. */
+#define ANALOG_CHANNELS 3
+/* Values per analog frame, one for each enabled analog channel. */
+#define FRAME_SIZE 2
+/* Frame count of the analog test buffers: three full blocks plus a tail. */
+#define FRAME_COUNT 53
+
+static struct sr_session *session;
+static struct sr_dev_inst *sdi;
+
+static void soft_trigger_setup(void)
+{
+	srtest_setup();
+	sdi = srtest_dev_new(LOGIC_CHANNELS);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+}
+
+static void soft_trigger_teardown(void)
+{
+	sr_session_destroy(session);
+	srtest_dev_free(sdi);
+	srtest_teardown();
+}
+
+/* A packet seen by the retain test's datafeed callback. */
+struct sent_packet {
+	int type;
+	const uint8_t *data;
+	uint64_t length;
+	struct sr_buffer *buf;
+	int refcount;
+};
+
+static void soft_trigger_analog_setup(void)
+{
+	struct sr_channel *ch;
+	char name[8];
+	int i;
+
+	soft_trigger_setup();
+	for (i = 0; i < ANALOG_CHANNELS; i++) {
+		snprintf(name, sizeof(name), "A%d", i);
+		ch = sr_channel_new(sdi, LOGIC_CHANNELS + i, SR_CHANNEL_ANALOG,
+			i != 1, name);
+		ck_assert(ch != NULL);
+	}
+}
+
+static struct sr_trigger *trigger_new(int match)
+{
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ch = g_slist_nth_data(sdi->channels, TRIGGER_BIT);
+	sr_trigger_match_add(stage, ch, match, 0);
+
+	return trigger;
+}
+
+/*
+ * Run a single stage trigger on a buffer, after an optional single
+ * sample buffer which provides the previous sample for edge matches.
+ * Returns the trigger offset, or -1.
+ */
+static int trigger_check(int match, const uint8_t *prime,
+		uint8_t *buf, int count)
+{
+	struct sr_trigger *trigger;
+	struct soft_trigger_logic *stl;
+	uint8_t sample;
+	int offset;
+
+	trigger = trigger_new(match);
+	stl = soft_trigger_logic_new(sdi, trigger, 0);
+	ck_assert(stl != NULL);
+	if (prime) {
+		sample = *prime;
+		offset = soft_trigger_logic_check(stl, &sample, 1, NULL);
+		ck_assert_msg(offset == -1, "Priming sample triggered.");
+	}
+	offset = soft_trigger_logic_check(stl, buf, count, NULL);
+	soft_trigger_logic_free(stl);
+	sr_trigger_free(trigger);
+
+	return offset;
+}
+
+/*
+ * Fill a buffer with the trigger channel at 'before' up to 'pos', and
+ * at 'after' from there on. Other channels toggle, so that samples
+ * differ from their neighbours.
+ */
+static void fill_step(uint8_t *buf, int count, int pos, int before, int after)
+{
+	int i, level;
+
+	for (i = 0; i < count; i++) {
+		level = i < pos ? before : after;
+		buf[i] = (i & 0x01) | ((i * 7) & 0xf0);
+		buf[i] |= level << TRIGGER_BIT;
+	}
+}
+
+/* Positions at the start, around word boundaries, and in the tail. */
+static const int positions[] = {
+	0, 1, 2, 7, 8, 9, 16, 17, 56, 57, 63, 64, 65, 66, 68,
+};
+
+/*
+ * Check level, rising, falling and edge matches at the first sample,
+ * around the boundaries of the word wide scan, and in the trailing
+ * partial word.
+ */
+START_TEST(test_soft_trigger_positions)
+{
+	static const struct {
+		int match, before, after;
+	} cases[] = {
+		{ SR_TRIGGER_ZERO, 1, 0, },
+		{ SR_TRIGGER_ONE, 0, 1, },
+		{ SR_TRIGGER_RISING, 0, 1, },
+		{ SR_TRIGGER_FALLING, 1, 0, },
+		{ SR_TRIGGER_EDGE, 0, 1, },
+		{ SR_TRIGGER_EDGE, 1, 0, },
+	};
+	uint8_t buf[SAMPLE_COUNT], prime;
+	size_t c, p;
+	int pos, offset;
+
+	for (c = 0; c < ARRAY_SIZE(cases); c++) {
+		prime = cases[c].before << TRIGGER_BIT;
+		for (p = 0; p < ARRAY_SIZE(positions); p++) {
+			pos = positions[p];
+			fill_step(buf, SAMPLE_COUNT, pos,
+				cases[c].before, cases[c].after);
+			offset = trigger_check(cases[c].match, &prime,
+				buf, SAMPLE_COUNT);
+			ck_assert_msg(offset == pos,
+				"Match %d at %d: triggered at %d.",
+				cases[c].match, pos, offset);
+		}
+	}
+}
+END_TEST
+
+/* Without a previous sample, the first sample cannot match an edge. */
+START_TEST(test_soft_trigger_first_edge)
+{
+	uint8_t buf[SAMPLE_COUNT];
+	int offset;
+
+	/* The level matches right away. */
+	fill_step(buf, SAMPLE_COUNT, 0, 0, 1);
+	offset = trigger_check(SR_TRIGGER_ONE, NULL, buf, SAMPLE_COUNT);
+	ck_assert(offset == 0);
+
+	/* The edge right at the start is not seen. */
+	offset = trigger_check(SR_TRIGGER_RISING, NULL, buf, SAMPLE_COUNT);
+	ck_assert(offset == -1);
+	offset = trigger_check(SR_TRIGGER_EDGE, NULL, buf, SAMPLE_COUNT);
+	ck_assert(offset == -1);
+
+	/* Later edges are. */
+	fill_step(buf, SAMPLE_COUNT, 9, 0, 1);
+	offset = trigger_check(SR_TRIGGER_RISING, NULL, buf, SAMPLE_COUNT);
+	ck_assert(offset == 9);
+}
+END_TEST
+
+/*
+ * The scan for the first stage gets resumed after later stages failed.
+ * Three consecutive high samples are to be found, shorter runs precede.
+ */
+START_TEST(test_soft_trigger_rescan)
+{
+	static const int runs[] = { 3, 4, 11, 12, 23, 31, 32, 40, 47, 48, };
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	struct sr_channel *ch;
+	uint8_t buf[SAMPLE_COUNT];
+	size_t i;
+	int offset;
+
+	trigger = sr_trigger_new(NULL);
+	ch = g_slist_nth_data(sdi->channels, TRIGGER_BIT);
+	for (i = 0; i < 3; i++) {
+		stage = sr_trigger_stage_add(trigger);
+		sr_trigger_match_add(stage, ch, SR_TRIGGER_ONE, 0);
+	}
+
+	fill_step(buf, SAMPLE_COUNT, 64, 0, 0);
+	for (i = 0; i < ARRAY_SIZE(runs); i++)
+		buf[runs[i]] |= 1 << TRIGGER_BIT;
+	for (i = 64; i <= 66; i++)
+		buf[i] |= 1 << TRIGGER_BIT;
+
+	stl = soft_trigger_logic_new(sdi, trigger, 0);
+	ck_assert(stl != NULL);
+	offset = soft_trigger_logic_check(stl, buf, SAMPLE_COUNT, NULL);
+	ck_assert_msg(offset == 66, "Triggered at %d.", offset);
+	soft_trigger_logic_free(stl);
+	sr_trigger_free(trigger);
+}
+END_TEST
+
+static void sent_packet_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct sent_packet sent;
+
+	(void)sdi;
+
+	memset(&sent, 0, sizeof(sent));
+	sent.type = packet->type;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		sent.data = logic->data;
+		sent.length = logic->length;
+		sent.buf = sr_buffer_current_find(logic->data, logic->length);
+		if (sent.buf)
+			sent.refcount = g_atomic_int_get(&sent.buf->refcount);
+	}
+	g_array_append_val(cb_data, sent);
+}
+
+/*
+ * With retained buffers, a trigger in the middle of the third buffer
+ * sends the pre-trigger window from the driver's buffers: the tail of
+ * the second one and the start of the third one. The first buffer is
+ * released when it drops out of the window, the others after sending.
+ */
+START_TEST(test_soft_trigger_retain)
+{
+	struct sr_trigger *trigger;
+	struct soft_trigger_logic *stl;
+	struct sr_buffer *bufs[3];
+	struct sent_packet *sent;
+	GArray *packets;
+	size_t i;
+	int offset, pre_trigger_samples;
+
+	packets = g_array_new(FALSE, FALSE, sizeof(struct sent_packet));
+	sr_session_datafeed_callback_add(session, sent_packet_cb, packets);
+
+	for (i = 0; i < ARRAY_SIZE(bufs); i++) {
+		bufs[i] = sr_buffer_new(16);
+		fill_step(bufs[i]->data, 16, i == 2 ? 8 : 16, 0, 1);
+	}
+
+	trigger = trigger_new(SR_TRIGGER_ONE);
+	stl = soft_trigger_logic_new_full(sdi, trigger, 20, TRUE);
+	ck_assert(stl != NULL);
+
+	/* The first two buffers are held, the window covers part of the first. */
+	for (i = 0; i < 2; i++) {
+		offset = soft_trigger_logic_check_buffer(stl, bufs[i],
+			bufs[i]->data, 16, NULL);
+		ck_assert(offset == -1);
+	}
+	ck_assert(packets->len == 0);
+	ck_assert(g_atomic_int_get(&bufs[0]->refcount) == 2);
+	ck_assert(g_atomic_int_get(&bufs[1]->refcount) == 2);
+
+	pre_trigger_samples = -1;
+	offset = soft_trigger_logic_check_buffer(stl, bufs[2], bufs[2]->data,
+		16, &pre_trigger_samples);
+	ck_assert_msg(offset == 8, "Triggered at %d.", offset);
+	ck_assert_msg(pre_trigger_samples == 20,
+		"%d pre-trigger samples.", pre_trigger_samples);
+
+	/* Pre-trigger data points into the buffers, which were still held. */
+	ck_assert_msg(packets->len == 3, "%u packets sent.", packets->len);
+	sent = &g_array_index(packets, struct sent_packet, 0);
+	ck_assert(sent->type == SR_DF_LOGIC);
+	ck_assert(sent->data == bufs[1]->data + 4 && sent->length == 12);
+	ck_assert(sent->buf == bufs[1] && sent->refcount == 2);
+	sent = &g_array_index(packets, struct sent_packet, 1);
+	ck_assert(sent->type == SR_DF_LOGIC);
+	ck_assert(sent->data == bufs[2]->data && sent->length == 8);
+	ck_assert(sent->buf == bufs[2] && sent->refcount == 2);
+	sent = &g_array_index(packets, struct sent_packet, 2);
+	ck_assert(sent->type == SR_DF_TRIGGER);
+
+	/* Only the driver's references remain. */
+	for (i = 0; i < ARRAY_SIZE(bufs); i++) {
+		ck_assert_msg(g_atomic_int_get(&bufs[i]->refcount) == 1,
+			"Buffer %zu still referenced.", i);
+	}
+
+	soft_trigger_logic_free(stl);
+	sr_trigger_free(trigger);
+	for (i = 0; i < ARRAY_SIZE(bufs); i++)
+		sr_buffer_unref(bufs[i]);
+	sr_session_datafeed_callback_remove_all(session);
+	g_array_free(packets, TRUE);
+}
+END_TEST
+
+static struct sr_channel *analog_channel(int idx)
+{
+	return g_slist_nth_data(sdi->channels, LOGIC_CHANNELS + idx);
+}
+
+/* Fill frames with 'before' up to 'pos', and 'after' from there on. */
+static void fill_analog_step(float *frames, int chan, int pos,
+		float before, float after)
+{
+	int i;
+
+	for (i = 0; i < FRAME_COUNT; i++)
+		frames[i * FRAME_SIZE + chan] = i < pos ? before : after;
+}
+
+/* Run a trigger over frames, returns the trigger offset or -1. */
+static int analog_check(struct sr_trigger *trigger, float hysteresis,
+		const float *frames, int count)
+{
+	struct soft_trigger_analog *sta;
+	int offset;
+
+	sta = soft_trigger_analog_new(sdi, trigger, 0, hysteresis);
+	ck_assert(sta != NULL);
+	ck_assert(sta->stages_valid);
+	ck_assert(sta->num_channels == FRAME_SIZE);
+	offset = soft_trigger_analog_check(sta, frames, count, NULL);
+	soft_trigger_analog_free(sta);
+
+	return offset;
+}
+
+/* Analog positions at the start, around block boundaries, and in the tail. */
+static const int frame_positions[] = {
+	0, 1, 15, 16, 17, 31, 32, 47, 48, 52,
+};
+
+/*
+ * Check OVER and UNDER thresholds on either enabled channel, while the
+ * other one is beyond the level. Values equal to the level don't match.
+ */
+START_TEST(test_soft_trigger_analog_threshold)
+{
+	static const struct {
+		int match;
+		float before, after, other;
+	} cases[] = {
+		{ SR_TRIGGER_OVER, 1.0, 1.5, 9.0, },
+		{ SR_TRIGGER_OVER, -3.0, 0.0, 9.0, },
+		{ SR_TRIGGER_UNDER, 1.0, 0.5, -9.0, },
+		{ SR_TRIGGER_UNDER, 3.0, -3.0, -9.0, },
+	};
+	/* Enabled channels A0 and A2 are at frame positions 0 and 1. */
+	static const int chans[][2] = { { 0, 0, }, { 2, 1, }, };
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	float frames[FRAME_COUNT * FRAME_SIZE], level;
+	size_t c, ch, p;
+	int pos, offset;
+
+	for (c = 0; c < ARRAY_SIZE(cases); c++) {
+		level = cases[c].before;
+		for (ch = 0; ch < ARRAY_SIZE(chans); ch++) {
+			trigger = sr_trigger_new(NULL);
+			stage = sr_trigger_stage_add(trigger);
+			sr_trigger_match_add(stage, analog_channel(chans[ch][0]),
+				cases[c].match, level);
+			for (p = 0; p < ARRAY_SIZE(frame_positions); p++) {
+				pos = frame_positions[p];
+				fill_analog_step(frames, chans[ch][1], pos,
+					cases[c].before, cases[c].after);
+				fill_analog_step(frames, 1 - chans[ch][1], 0,
+					cases[c].other, cases[c].other);
+				offset = analog_check(trigger, 0.0,
+					frames, FRAME_COUNT);
+				ck_assert_msg(offset == pos,
+					"Match %d on A%d at %d: triggered at %d.",
+					cases[c].match, chans[ch][0], pos, offset);
+			}
+			sr_trigger_free(trigger);
+		}
+	}
+}
+END_TEST
+
+/*
+ * An OVER and an UNDER match on the same channel hold inside the
+ * window between both values, exclusive.
+ */
+START_TEST(test_soft_trigger_analog_window)
+{
+	static const float outside[] = { -5.0, 1.0, 2.0, 7.5, };
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	float frames[FRAME_COUNT * FRAME_SIZE];
+	size_t p;
+	int i, pos, offset;
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	sr_trigger_match_add(stage, analog_channel(0), SR_TRIGGER_OVER, 1.0);
+	sr_trigger_match_add(stage, analog_channel(0), SR_TRIGGER_UNDER, 2.0);
+
+	/* Values on and beyond both edges of the window never match. */
+	for (i = 0; i < FRAME_COUNT; i++) {
+		frames[i * FRAME_SIZE] = outside[i % ARRAY_SIZE(outside)];
+		frames[i * FRAME_SIZE + 1] = 1.5;
+	}
+	offset = analog_check(trigger, 0.0, frames, FRAME_COUNT);
+	ck_assert_msg(offset == -1, "Triggered outside at %d.", offset);
+
+	for (p = 0; p < ARRAY_SIZE(frame_positions); p++) {
+		pos = frame_positions[p];
+		for (i = 0; i < FRAME_COUNT; i++)
+			frames[i * FRAME_SIZE] = outside[i % ARRAY_SIZE(outside)];
+		frames[pos * FRAME_SIZE] = 1.5;
+		offset = analog_check(trigger, 0.0, frames, FRAME_COUNT);
+		ck_assert_msg(offset == pos, "Window at %d: triggered at %d.",
+			pos, offset);
+	}
+
+	sr_trigger_free(trigger);
+}
+END_TEST
+
+/*
+ * Edges fire on crossing the level, after the signal went beyond the
+ * hysteresis on the other side. The armed state persists across calls.
+ */
+START_TEST(test_soft_trigger_analog_edges)
+{
+	static const struct {
+		int match;
+		float values[8];
+		int offset;
+	} cases[] = {
+		/* Starts high, too small a dip, then arms at 1.4. */
+		{ SR_TRIGGER_RISING, { 3, 3, 1.8, 2.1, 1.4, 1.9, 2.0, 3, }, 6, },
+		{ SR_TRIGGER_FALLING, { 1, 1, 2.2, 1.9, 2.6, 2.1, 2.0, 1, }, 6, },
+		/* Never arms. */
+		{ SR_TRIGGER_RISING, { 2, 3, 1.6, 2.5, 1.5, 2.5, 1.6, 4, }, -1, },
+	};
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_analog *sta;
+	float frames[FRAME_COUNT * FRAME_SIZE];
+	size_t c;
+	int i, offset;
+
+	for (c = 0; c < ARRAY_SIZE(cases); c++) {
+		trigger = sr_trigger_new(NULL);
+		stage = sr_trigger_stage_add(trigger);
+		sr_trigger_match_add(stage, analog_channel(2),
+			cases[c].match, 2.0);
+
+		/* In a single buffer. */
+		for (i = 0; i < 8; i++) {
+			frames[i * FRAME_SIZE] = 0.0;
+			frames[i * FRAME_SIZE + 1] = cases[c].values[i];
+		}
+		offset = analog_check(trigger, 0.5, frames, 8);
+		ck_assert_msg(offset == cases[c].offset,
+			"Case %zu: triggered at %d.", c, offset);
+
+		/* One frame per call. */
+		sta = soft_trigger_analog_new(sdi, trigger, 0, 0.5);
+		for (i = 0; i < 8; i++) {
+			offset = soft_trigger_analog_check(sta,
+				&frames[i * FRAME_SIZE], 1, NULL);
+			if (offset == 0)
+				break;
+			ck_assert(offset == -1);
+		}
+		ck_assert_msg((i < 8 ? i : -1) == cases[c].offset,
+			"Case %zu: triggered in call %d.", c, i);
+		soft_trigger_analog_free(sta);
+
+		sr_trigger_free(trigger);
+	}
+
+	/* Arm and cross in different blocks of the scan. */
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	sr_trigger_match_add(stage, analog_channel(0), SR_TRIGGER_RISING, 2.0);
+	fill_analog_step(frames, 0, 0, 3.0, 3.0);
+	fill_analog_step(frames, 1, 0, 0.0, 0.0);
+	frames[20 * FRAME_SIZE] = 1.0;
+	for (i = 21; i < 37; i++)
+		frames[i * FRAME_SIZE] = 1.9;
+	offset = analog_check(trigger, 0.5, frames, FRAME_COUNT);
+	ck_assert_msg(offset == 37, "Triggered at %d.", offset);
+	sr_trigger_free(trigger);
+}
+END_TEST
+
+/* Pre-trigger frames are limited by the requested count and the data. */
+START_TEST(test_soft_trigger_analog_pre_trigger)
+{
+	static const int cases[][2] = { { 10, 4, }, { 2, 2, }, { 0, 0, }, };
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_analog *sta;
+	float frames[FRAME_COUNT * FRAME_SIZE];
+	size_t c;
+	int offset, pre_trigger_samples;
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	sr_trigger_match_add(stage, analog_channel(0), SR_TRIGGER_OVER, 1.0);
+	fill_analog_step(frames, 1, 0, 0.0, 0.0);
+
+	for (c = 0; c < ARRAY_SIZE(cases); c++) {
+		fill_analog_step(frames, 0, cases[c][0], 0.0, 5.0);
+		sta = soft_trigger_analog_new(sdi, trigger, 4, 0.0);
+		ck_assert(sta != NULL);
+		pre_trigger_samples = -1;
+		offset = soft_trigger_analog_check(sta, frames, FRAME_COUNT,
+			&pre_trigger_samples);
+		ck_assert(offset == cases[c][0]);
+		ck_assert_msg(pre_trigger_samples == cases[c][1],
+			"Trigger at %d: %d pre-trigger samples.",
+			offset, pre_trigger_samples);
+		soft_trigger_analog_free(sta);
+	}
+
+	sr_trigger_free(trigger);
+}
+END_TEST
+
+Suite *suite_soft_trigger(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("soft-trigger");
+
+	tc = tcase_create("logic");
+	tcase_add_checked_fixture(tc, soft_trigger_setup,
+		soft_trigger_teardown);
+	tcase_add_test(tc, test_soft_trigger_positions);
+	tcase_add_test(tc, test_soft_trigger_first_edge);
+	tcase_add_test(tc, test_soft_trigger_rescan);
+	tcase_add_test(tc, test_soft_trigger_retain);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("analog");
+	tcase_add_checked_fixture(tc, soft_trigger_analog_setup,
+		soft_trigger_teardown);
+	tcase_add_test(tc, test_soft_trigger_analog_threshold);
+	tcase_add_test(tc, test_soft_trigger_analog_window);
+	tcase_add_test(tc, test_soft_trigger_analog_edges);
+	tcase_add_test(tc, test_soft_trigger_analog_pre_trigger);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -521,6 +521,40 @@ START_TEST(test_text_line)
 }
 END_TEST
 
+START_TEST(test_text_line_ends)
+{
+	static const char *text = "one\n\ntwo words\r\n  three\nincomplete";
+	static const size_t want[] = { 3, 4, 15, 23, };
+	size_t ends[8], count, idx, pos;
+
+	/* Get all line terminations at once. */
+	count = sr_text_line_ends(text, strlen(text), ends, ARRAY_SIZE(ends));
+	ck_assert_msg(count == ARRAY_SIZE(want),
+		      "Unexpected line count %zu", count);
+	for (idx = 0; idx < count; idx++)
+		ck_assert_msg(ends[idx] == want[idx],
+			      "Unexpected line end %zu", ends[idx]);
+
+	/* Resume after a full array. */
+	pos = 0;
+	for (idx = 0; idx < ARRAY_SIZE(want); idx++) {
+		count = sr_text_line_ends(&text[pos], strlen(text) - pos,
+					  ends, 1);
+		ck_assert_msg(count == 1, "Line end not found");
+		pos += ends[0];
+		ck_assert_msg(pos == want[idx],
+			      "Unexpected line end %zu", pos);
+		pos++;
+	}
+	count = sr_text_line_ends(&text[pos], strlen(text) - pos, ends, 1);
+	ck_assert_msg(count == 0, "Line end found, unexpected");
+
+	/* No text, no array space. */
+	ck_assert(sr_text_line_ends(text, 0, ends, ARRAY_SIZE(ends)) == 0);
+	ck_assert(sr_text_line_ends(text, strlen(text), ends, 0) == 0);
+}
+END_TEST
+
 /*
  * TODO Ideally this table of test cases should reside within the
  * test_text_word() routine. But compilation fails when it's put there
@@ -635,6 +669,7 @@ Suite *suite_strutil(void)
 
 	tc = tcase_create("text");
 	tcase_add_test(tc, test_text_line);
+	tcase_add_test(tc, test_text_line_ends);
 	tcase_add_test(tc, test_text_word);
 	suite_add_tcase(s, tc);
 